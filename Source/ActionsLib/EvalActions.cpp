@@ -16,7 +16,9 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "SimpleEvaluator.h"
+#include "MultiModelEvaluator.h"
 #include "SimpleOutputWriter.h"
+#include "BeamSearchDecoder.h"
 #include "Criterion.h"
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
@@ -134,6 +136,19 @@ void DoCrossValidate(const ConfigParameters& config)
         evalNodeNamesVector.push_back(evalNodeNames[i]);
     }
 
+    // number of models evaluated together in one pass over the data (bounds the number of models in memory);
+    // on the CPU, they are evaluated concurrently, one per thread, only if there are at least as many as numCPUThreads,
+    // otherwise one after another with all threads each (see MultiModelEvaluator)
+    size_t parallelModels = config(L"parallelModels", (size_t)1);
+    if (parallelModels == 0)
+        InvalidArgument("parallelModels must be at least 1.");
+    if (parallelModels > 1 && (enableDistributedMBReading || maxSamplesInRAM != SIZE_MAX || numSubminiBatches != 1 ||
+                               (MPIWrapper::GetInstance() && MPIWrapper::GetInstance()->NumNodesInUse() > 1)))
+    {
+        fprintf(stderr, "parallelModels is not supported with distributed reading, parallel evaluation or sub-minibatches, evaluating one model at a time.\n");
+        parallelModels = 1;
+    }
+
     std::vector<std::vector<EpochCriterion>> cvErrorResults;
     std::vector<std::wstring> cvModels;
 
@@ -157,6 +172,9 @@ void DoCrossValidate(const ConfigParameters& config)
         }
 
         cvModels.push_back(cvModelPath);
+        if (parallelModels > 1)
+            continue; // (evaluated below)
+
         auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, cvModelPath);
         // BUGBUG: ^^ Should use GetModelFromConfig()
         
@@ -170,6 +188,24 @@ void DoCrossValidate(const ConfigParameters& config)
         ::Sleep(1000 * sleepSecondsBetweenRuns);
     }
 
+    // evaluate up to parallelModels models at a time in a single pass over the data
+    for (size_t first = 0; parallelModels > 1 && first < cvModels.size(); first += parallelModels)
+    {
+        size_t end = min(first + parallelModels, cvModels.size());
+        vector<ComputationNetworkPtr> nets;
+        for (size_t k = first; k < end; k++)
+        {
+            fprintf(stderr, "Model %d: %ls\n", (int) (k - first), cvModels[k].c_str());
+            nets.push_back(ComputationNetwork::CreateFromFile<ElemType>(deviceId, cvModels[k]));
+        }
+
+        MultiModelEvaluator<ElemType> eval(nets, traceLevel);
+        auto evalErrors = eval.Evaluate(&cvDataReader, evalNodeNamesVector, mbSize[0], epochSize);
+        cvErrorResults.insert(cvErrorResults.end(), evalErrors.begin(), evalErrors.end());
+
+        ::Sleep(1000 * sleepSecondsBetweenRuns);
+    }
+
     // find best model
     if (cvErrorResults.size() == 0)
         LogicError("No model is evaluated.");
@@ -244,6 +280,27 @@ void DoWriteOutput(const ConfigParameters& config)
         DataWriter testDataWriter(writerConfig);
         writer.WriteOutput(testDataReader, mbSize[0], testDataWriter, outputNodeNamesVector, epochSize, writerUnittest);
     }
+    else if (config.Exists("outputPath") && EqualCI(config(L"outputFormat", L"text"), L"binary"))
+    {
+        // packed feature archives, which the HTK deserializer can read back ('packedArchive')
+        wstring outputPath = config(L"outputPath");
+        wstring elementTypeName = config(L"outputElementType", L"float");
+        PackedArchiveElementType elementType;
+        if (EqualCI(elementTypeName, L"float"))
+            elementType = PackedArchiveElementType::Float32;
+        else if (EqualCI(elementTypeName, L"fp16"))
+            elementType = PackedArchiveElementType::Float16;
+        else
+            InvalidArgument("write command: outputElementType must be 'float' or 'fp16'.");
+        size_t chunkFrames = config(L"chunkFrames", (size_t)(15 * 60 * 100));
+        string featureKind = config(L"outputFeatureKind", "USER");
+        unsigned int samplePeriod = config(L"outputSamplePeriod", (unsigned int)100000); // in units of 100ns, i.e. 10 ms
+
+        vector<string> sequenceKeys; // one per line, in the order in which the reader delivers the sequences
+        if (config.Exists("sequenceKeysFile"))
+            File::LoadLabelFile(config(L"sequenceKeysFile"), sequenceKeys);
+        writer.WriteBinaryOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, elementType, chunkFrames, featureKind, samplePeriod, sequenceKeys, epochSize);
+    }
     else if (config.Exists("outputPath"))
     {
         wstring outputPath = config(L"outputPath");
@@ -257,3 +314,48 @@ void DoWriteOutput(const ConfigParameters& config)
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBeamSearch() - implements CNTK "beamSearch" command
+// ===========================================================================
+
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("randomize", "None"); // we don't want randomization when output results
+
+    DataReader dataReader(readerConfig);
+
+    ConfigArray minibatchSize = config(L"minibatchSize", "2048");
+    intargvector mbSize = minibatchSize;
+
+    size_t epochSize = config(L"epochSize", "0");
+    if (epochSize == 0)
+        epochSize = requestDataSize;
+
+    vector<wstring> outputNodeNamesVector;
+    let net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeName", outputNodeNamesVector);
+    if (outputNodeNamesVector.size() != 1)
+        InvalidArgument("beamSearch command: Exactly one 'outputNodeName' must be specified.");
+
+    wstring inputNodeName = config(L"inputNodeName");
+    size_t beamWidth = config(L"beamWidth", "5");
+    size_t endSymbolId = config(L"endSymbolId");
+    size_t maxLength = config(L"maxLength", "100");
+    size_t numBest = config(L"numBest", "1");
+    bool outputIsProbability = config(L"outputIsProbability", "false");
+    wstring outputPath = config(L"outputPath");
+    int traceLevel = config(L"traceLevel", "0");
+
+    vector<string> labelMapping;
+    wstring labelMappingFile = config(L"labelMappingFile", L"");
+    if (!labelMappingFile.empty())
+        File::LoadLabelFile(labelMappingFile, labelMapping);
+
+    BeamSearchDecoder<ElemType> decoder(net, inputNodeName, outputNodeNamesVector[0], beamWidth, endSymbolId, maxLength, outputIsProbability, traceLevel);
+    decoder.Decode(dataReader, mbSize[0], outputPath, numBest, labelMapping, epochSize);
+}
+
+template void DoBeamSearch<float>(const ConfigParameters& config);
+template void DoBeamSearch<double>(const ConfigParameters& config);
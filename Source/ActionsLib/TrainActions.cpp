@@ -66,6 +66,38 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// the size and modification time of each file named in a reader configuration (including its sub-sections), so that
+// the key changes when a data file is rewritten under the same name
+static wstring GetDataFileStamps(const ConfigParameters& readerConfig)
+{
+    wstring stamps;
+    for (const auto& entry : readerConfig)
+    {
+        const string& value = entry.second;
+        if (!value.empty() && value[0] == '[')
+            stamps += GetDataFileStamps(ConfigParameters(entry.second));
+        else
+        {
+            wstring path = msra::strfun::utf16(value);
+            int64_t size, time;
+            if (getfilestamp(path, size, time))
+                stamps += msra::strfun::wstrprintf(L"%ls: %lld bytes, modified at %lld\n", path.c_str(), (long long) size, (long long) time);
+        }
+    }
+    return stamps;
+}
+
+// text that identifies the training data, used as the key of cached results computed from it (e.g. by PreCompute)
+static wstring GetDataConfigurationKey(const ScriptableObjects::IConfigRecord& /*config*/)
+{
+    return wstring(); // (not available as text in BrainScript, see SGD parameter 'preComputeCacheKey')
+}
+static wstring GetDataConfigurationKey(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    return msra::strfun::utf16(config(L"reader")) + L"\n" + GetDataFileStamps(readerConfig);
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
@@ -95,6 +127,7 @@ void DoTrain(const ConfigRecordType& config)
         optimizer = make_shared<SGD<ElemType>>(configSGD);
     }
 
+    optimizer->SetDataConfigurationKey(GetDataConfigurationKey(config));
     optimizer->InitMPI(MPIWrapper::GetInstance());
     optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
 }
@@ -166,6 +199,7 @@ void DoAdapt(const ConfigParameters& config)
     SGD<ElemType> sgd(configSGD);
 
     sgd.InitMPI(MPIWrapper::GetInstance());
+    sgd.SetDataConfigurationKey(GetDataConfigurationKey(config));
     sgd.Adapt(origModelFileName, refNodeName, dataReader.get(), cvDataReader.get(), deviceId, makeMode);
 }
 
@@ -18,6 +18,7 @@
 #include "NDLNetworkBuilder.h"
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
+#include "CPUKernels.h" // used for GetCPUInstructionSet()
 #include "CommonMatrix.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
@@ -167,6 +168,11 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
     {
         LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
     }
+    bool numaBindThreads = config(L"numaBindThreads", false);
+    NumaPlacement numaPlacement = ParseNumaPlacement(config(L"numaPlacement", L"none"));
+    if (numaBindThreads || numaPlacement != NumaPlacement::none)
+        CPUMatrix<ElemType>::SetNumaPolicy(numaBindThreads, numaPlacement);
+    LOGPRINTF(stderr, "Using %s CPU kernels.\n", GetCPUInstructionSetName(GetCPUInstructionSet()));
 
     bool progressTracing = config(L"progressTracing", false);
 
@@ -261,6 +267,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoWriteOutput<ElemType>(commandParams);
                 }
+                else if (thisAction == "beamSearch")
+                {
+                    DoBeamSearch<ElemType>(commandParams);
+                }
                 else if (thisAction == "devtest")
                 {
                     TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -479,6 +489,7 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         mpi = MPIWrapper::GetInstance(true /*create*/);
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
+    ComputationNetwork::SetLoopConcurrency(config(L"concurrentLoops", false), config(L"wavefrontLoops", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -505,6 +516,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
     if (numCPUThreads > 0)
         LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
+    bool numaBindThreads = config(L"numaBindThreads", false);
+    NumaPlacement numaPlacement = ParseNumaPlacement(config(L"numaPlacement", L"none"));
+    if (numaBindThreads || numaPlacement != NumaPlacement::none)
+        CPUMatrix<float /*any will do*/>::SetNumaPolicy(numaBindThreads, numaPlacement);
+    LOGPRINTF(stderr, "Using %s CPU kernels.\n", GetCPUInstructionSetName(GetCPUInstructionSet()));
 
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
@@ -577,6 +593,7 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         mpi = MPIWrapper::GetInstance(true /*create*/);
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
+    ComputationNetwork::SetLoopConcurrency(config(L"concurrentLoops", false), config(L"wavefrontLoops", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
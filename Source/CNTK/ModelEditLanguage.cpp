@@ -606,6 +606,29 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
             fprintf(stderr, "Revise node %ls using parameter file %s\n", pNodes->NodeName().c_str(), paramPath.c_str());
         }
     }
+    else if (EqualInsensitive(name, "SetParameterStorage"))
+    {
+        // e.g. SetParameterStorage(m1.*, fp16) before SaveModel() halves the size of the model, see HalfMatrix
+        if (params.size() != 2)
+            RuntimeError("Invalid number of parameters: Valid parameters are: SetParameterStorage(nodeName, float|fp16|bf16)");
+        std::string formatName = params[1];
+        HalfPrecisionFormat format = ParseHalfPrecisionFormat(msra::strfun::utf16(formatName));
+
+        NetNdl<ElemType>* netNdl;
+        vector<ComputationNodeBasePtr> nodes = FindSymbols(params[0], netNdl);
+
+        size_t numParameters = 0;
+        for (auto& node : nodes)
+        {
+            // wildcards select all kinds of nodes, only parameters are affected
+            auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+            if (!parameter)
+                continue;
+            parameter->SetStorageFormat(format);
+            numParameters++;
+        }
+        fprintf(stderr, "SetParameterStorage: %d parameters are stored as %ls\n", (int) numParameters, HalfPrecisionFormatName(format));
+    }
     else
     {
         RuntimeError("Unknown Editor function %s", name.c_str());
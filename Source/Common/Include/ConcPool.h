@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "ConcQueue.h"
+#include <thread>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// conc_pool -- lock-free pool of reusable objects, e.g. per-sequence scratch buffers of readers.
+// Same interface as conc_stack, but built on conc_bounded_queue, so threads that share the pool inside
+// a parallel loop do not serialize on a mutex. The pool is bounded: an item pushed into a full pool is
+// destroyed, which can only happen if more items are in flight at once than the capacity.
+// -----------------------------------------------------------------------
+
+template <typename T>
+class conc_pool
+{
+public:
+    typedef T value_type;
+
+    conc_pool()
+        : m_items(std::max<size_t>(64, 4 * std::thread::hardware_concurrency()))
+    {
+    }
+
+    explicit conc_pool(size_t capacity)
+        : m_items(capacity)
+    {
+    }
+
+    template <class Factory>
+    value_type pop_or_create(Factory factory)
+    {
+        value_type item;
+        if (m_items.try_pop(item))
+            return item;
+        return factory();
+    }
+
+    void push(const value_type& item)
+    {
+        m_items.try_push(item);
+    }
+
+    void push(value_type&& item)
+    {
+        m_items.try_push(std::move(item));
+    }
+
+public:
+    conc_pool(const conc_pool&) = delete;
+    conc_pool& operator=(const conc_pool&) = delete;
+
+private:
+    conc_bounded_queue<value_type> m_items;
+};
+} } }
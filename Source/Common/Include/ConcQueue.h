@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// conc_bounded_queue -- lock-free bounded multi-producer/multi-consumer FIFO queue.
+// Each cell carries a sequence number that tells producers and consumers whether it is free for the
+// current lap around the ring (D. Vyukov's bounded MPMC queue). A push or pop costs one CAS on the
+// enqueue or dequeue position, and threads never block each other; try_push() fails if the queue is full,
+// try_pop() if it is empty.
+// T must be default-constructible and move-assignable; popped cells are left in the moved-from state.
+// -----------------------------------------------------------------------
+
+template <typename T>
+class conc_bounded_queue
+{
+public:
+    typedef T value_type;
+
+    // the capacity is rounded up to a power of two
+    explicit conc_bounded_queue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+        m_dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    bool try_push(value_type&& item)
+    {
+        size_t pos;
+        Cell* cell = claim_for_push(pos);
+        if (!cell)
+            return false;
+        cell->item = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release); // now visible to consumers
+        return true;
+    }
+
+    bool try_push(const value_type& item)
+    {
+        size_t pos;
+        Cell* cell = claim_for_push(pos);
+        if (!cell)
+            return false;
+        cell->item = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(value_type& item)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) (pos + 1);
+            if (diff == 0) // filled in the current lap: try to claim it
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(cell.item);
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release); // free for the next lap
+                    return true;
+                }
+                // (on failure, 'pos' was updated to the current position)
+            }
+            else if (diff < 0) // not yet filled: empty
+                return false;
+            else // another consumer got it first
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+public:
+    conc_bounded_queue(const conc_bounded_queue&) = delete;
+    conc_bounded_queue& operator=(const conc_bounded_queue&) = delete;
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        value_type item;
+    };
+
+    // claims the cell at the enqueue position 'pos', or returns nullptr if the queue is full
+    Cell* claim_for_push(size_t& pos)
+    {
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) pos;
+            if (diff == 0) // free in the current lap: try to claim it
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return &cell;
+            }
+            else if (diff < 0) // not yet consumed in the previous lap: full
+                return nullptr;
+            else // another producer got it first
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // the two positions are kept on separate cache lines, since producers and consumers update them concurrently
+    static const size_t cacheLineSize = 64;
+    char m_pad0[cacheLineSize];
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    char m_pad1[cacheLineSize];
+    std::atomic<size_t> m_enqueuePos;
+    char m_pad2[cacheLineSize];
+    std::atomic<size_t> m_dequeuePos;
+    char m_pad3[cacheLineSize];
+};
+} } }
@@ -289,6 +289,45 @@ class VariableSchema : public std::vector<VariableLayout>
         }
 };
 
+//
+// Streaming evaluation of models with left-to-right recurrence (PastValue), e.g. for online speech recognition.
+// The frames of many independent streams (e.g. live utterances) are passed in chunks as they arrive, and only the
+// new frames are computed: the recurrent state that each stream reached at the end of its previous chunk is kept
+// in the session. The chunks of all streams passed to one call are evaluated together as one minibatch.
+// A session is obtained from IEvaluateModelExtended::StartStreamingSession(). It uses the model's network, so
+// ForwardPass() must not be called while it exists, and like ForwardPass() it is not reentrant.
+//
+template <typename ElemType>
+class IStreamingSession
+{
+public:
+    //
+    // OpenStream - start a new stream (which has no history), and return its id
+    //
+    virtual size_t OpenStream() = 0;
+
+    //
+    // CloseStream - discard the state of a stream
+    //
+    virtual void CloseStream(size_t streamId) = 0;
+
+    //
+    // ForwardChunks - evaluate the next chunk of frames of each of the given streams. A stream may occur once per call.
+    // inputs[k] and outputs[k] are the input and output buffers for stream streamIds[k], laid out as for
+    // IEvaluateModelExtended::ForwardPass(). All inputs of a stream must have the same number of frames, and the
+    // outputs get one sample for each of them. Output buffers must be preallocated, as for ForwardPass().
+    //
+    virtual void ForwardChunks(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // Destroy - end the session and release its memory
+    //
+    virtual void Destroy() = 0;
+
+protected:
+    virtual ~IStreamingSession() { }
+};
+
 //
 // Extended interface, allowing for sparse input.
 // Implementation constraints: 
@@ -336,6 +375,13 @@ public:
     // (e.g. when vectors are manages by .net)
     // 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) = 0;
+
+    //
+    // StartStreamingSession - like StartForwardEvaluation(), but for evaluating streams chunk by chunk (see
+    // IStreamingSession). All inputs and outputs must be sequences along the same dynamic axis.
+    // The session must be destroyed before this model.
+    //
+    virtual IStreamingSession<ElemType>* StartStreamingSession(const std::vector<std::wstring>& outputs) = 0;
 };
 
 template <typename ElemType>
@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HalfFloat.h -- conversions between float and the 16-bit IEEE 754 half precision (fp16) and bfloat16 (bf16) formats
+//
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// rounds to nearest even; values beyond 65504 become Inf
+inline unsigned short FloatToHalf(float f)
+{
+    unsigned int x;
+    memcpy(&x, &f, sizeof(x));
+    const unsigned short sign = (unsigned short) ((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+
+    if (x >= 0x7f800000) // Inf and NaN (kept quiet)
+        return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0);
+    if (x >= 0x477ff000) // 65520 and above round to Inf
+        return sign | 0x7c00;
+    if (x < 0x38800000) // below 2^-14: fp16 subnormal, in units of 2^-24 (exact, since it is a power of 2)
+    {
+        float a;
+        memcpy(&a, &x, sizeof(a));
+        return sign | (unsigned short) std::nearbyint(a * 16777216.0f);
+    }
+
+    // rebias the exponent from 127 to 15 and round the mantissa from 23 to 10 bits; a carry correctly increments the exponent
+    unsigned int h = (x - 0x38000000) >> 13;
+    unsigned int rest = x & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+        h++;
+    return sign | (unsigned short) h;
+}
+
+// exact; the exponent and mantissa are moved into place and rebiased by multiplying with 2^(127 - 15), which also
+// turns fp16 subnormals into normal floats
+inline float HalfToFloat(unsigned short h)
+{
+    unsigned int bits = (unsigned int) (h & 0x7fff) << 13;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    f *= 5.192296858534828e+33f; // 2^112
+    memcpy(&bits, &f, sizeof(f));
+    if ((h & 0x7c00) == 0x7c00) // Inf and NaN
+        bits |= 0x7f800000;
+    bits |= (unsigned int) (h & 0x8000) << 16;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// rounds to nearest even
+inline unsigned short FloatToBFloat16(float f)
+{
+    unsigned int x;
+    memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) // NaN (kept quiet)
+        return (unsigned short) ((x >> 16) | 0x40);
+    return (unsigned short) ((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+}}}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A packed feature archive stores the frames of many utterances in a single file, grouped into chunks,
+// so that a chunk is paged in with a single sequential read instead of opening a file per utterance.
+// Archives are created from HTK feature files by the htkpack tool, or from the outputs of a network by the
+// "write" action with outputFormat=binary, and read by the HTK deserializer when the feature stream is given
+// a 'packedArchive' instead of an 'scpFile'.
+//
+// Layout of the file (native byte order):
+//   PackedArchiveHeader
+//   chunk data:       each chunk starts at a multiple of PackedArchiveAlignment and holds the frames of its
+//                     utterances consecutively, featureDimension elements of header.elementType each
+//   index:            at header.indexOffset
+//     feature kind    header.featureKindLength characters
+//     chunks          header.numChunks x PackedArchiveChunk
+//     utterances      header.numUtterances x PackedArchiveUtterance, in chunk order
+//     keys            header.keyBytes characters, the concatenated logical paths of the utterances
+
+const char PackedArchiveMagic[8] = { 'C', 'N', 'T', 'K', 'P', 'F', 'A', '\0' };
+const uint32_t PackedArchiveVersion = 2; // version 1 has no elementType, its frames are always float
+const size_t PackedArchiveAlignment = 4096;
+
+enum class PackedArchiveElementType : uint32_t
+{
+    Float32 = 0,
+    Float16 = 1 // IEEE 754 half precision, widened to float when read
+};
+
+#pragma pack(push, 1)
+struct PackedArchiveHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t featureDimension;
+    uint32_t samplePeriod; // in units of 100ns, as in HTK
+    uint32_t featureKindLength;
+    uint64_t numChunks;
+    uint64_t numUtterances;
+    uint64_t keyBytes;
+    uint64_t indexOffset;
+    // version 2
+    uint32_t elementType; // PackedArchiveElementType
+    uint32_t reserved;
+};
+
+struct PackedArchiveChunk
+{
+    uint64_t offset;         // position of the chunk data in the file
+    uint64_t numFrames;
+    uint64_t firstUtterance; // index of the first utterance of the chunk in the utterance table
+    uint64_t numUtterances;
+};
+
+struct PackedArchiveUtterance
+{
+    uint64_t keyOffset;  // position of the logical path in the keys
+    uint32_t keyLength;
+    uint32_t numFrames;
+    uint64_t firstFrame; // index of the first frame inside the chunk
+};
+#pragma pack(pop)
+
+// Read access to a packed feature archive. The index is loaded when constructed;
+// chunk data is read on demand, possibly from several threads at once.
+class PackedFeatureArchive
+{
+public:
+    explicit PackedFeatureArchive(const std::wstring& path);
+
+    const std::wstring& GetPath() const { return m_path; }
+    const std::string& GetFeatureKind() const { return m_featureKind; }
+    size_t GetFeatureDimension() const { return m_header.featureDimension; }
+    unsigned int GetSamplePeriod() const { return m_header.samplePeriod; }
+    PackedArchiveElementType GetElementType() const { return (PackedArchiveElementType) m_header.elementType; }
+
+    size_t GetNumberOfChunks() const { return m_chunks.size(); }
+    const PackedArchiveChunk& GetChunk(size_t chunkIndex) const { return m_chunks[chunkIndex]; }
+    const PackedArchiveUtterance& GetUtterance(size_t utteranceIndex) const { return m_utterances[utteranceIndex]; }
+    std::string GetKey(size_t utteranceIndex) const;
+
+    // Reads all frames of a chunk, featureDimension floats per frame, with a single read.
+    // Frames stored in fp16 are widened.
+    void ReadChunk(size_t chunkIndex, std::vector<float>& frames) const;
+
+private:
+    std::wstring m_path;
+    PackedArchiveHeader m_header;
+    std::string m_featureKind;
+    std::vector<PackedArchiveChunk> m_chunks;
+    std::vector<PackedArchiveUtterance> m_utterances;
+    std::vector<char> m_keys;
+};
+
+typedef std::shared_ptr<PackedFeatureArchive> PackedFeatureArchivePtr;
+
+// Creates a packed feature archive. Utterances are added in order and grouped into chunks
+// of at least 'chunkFrames' frames; a chunk is written out as soon as it is complete.
+class PackedFeatureArchiveWriter
+{
+public:
+    PackedFeatureArchiveWriter(const std::wstring& path, const std::string& featureKind, size_t featureDimension, unsigned int samplePeriod, size_t chunkFrames,
+                               PackedArchiveElementType elementType = PackedArchiveElementType::Float32);
+    ~PackedFeatureArchiveWriter();
+
+    // Adds an utterance of numFrames frames, stored consecutively with featureDimension floats each.
+    // They are rounded to the element type of the archive when the chunk is written.
+    void AddUtterance(const std::string& key, const float* frames, size_t numFrames);
+
+    // Writes the last chunk and the index. Must be called for the archive to be valid.
+    void Close();
+
+private:
+    void WriteChunk();
+
+    FILE* m_file;
+    PackedArchiveHeader m_header;
+    std::string m_featureKind;
+    size_t m_chunkFrames;
+    std::vector<float> m_chunkData;
+    std::vector<PackedArchiveChunk> m_chunks;
+    std::vector<PackedArchiveUtterance> m_utterances;
+    std::string m_keys;
+};
+
+}}}
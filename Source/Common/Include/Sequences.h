@@ -1010,6 +1010,17 @@ static inline Matrix<ElemType> DataWithMBLayoutFor(const Matrix<ElemType> &data,
     return data.ColumnSlice(columnRange.first, columnRange.second);
 }
 
+// same but re-targeting a caller-owned view, which avoids allocating a new slice object (for per-time-step code)
+template <class ElemType>
+static inline Matrix<ElemType>& DataWithMBLayoutFor(MatrixSliceView<ElemType> &view,
+                                                    const Matrix<ElemType> &data,
+                                                    const FrameRange &fr /*select frame or entire batch*/,
+                                                    const MBLayoutPtr &pMBLayout /*the MB layout of 'data'*/)
+{
+    auto columnRange = ColumnRangeWithMBLayoutFor(data.GetNumCols(), fr, pMBLayout);
+    return view.Assign(data, columnRange.first, columnRange.second);
+}
+
 // -----------------------------------------------------------------------
 // TensorSliceWithMBLayoutFor() -- Return tensor slice for a FrameRange with a given MBLayout.
 // This implements the logic of interpreting the FrameRange object.
@@ -612,6 +612,12 @@ bool getfiletime(const std::wstring& path, FILETIME& time);
 void setfiletime(const std::wstring& path, const FILETIME& time);
 
 #endif
+// ----------------------------------------------------------------------------
+// getfilestamp(): size and modification time of a file, which change when it is rewritten
+// ----------------------------------------------------------------------------
+
+bool getfilestamp(const std::wstring& path, int64_t& size, int64_t& time);
+
 // ----------------------------------------------------------------------------
 // expand_wildcards() -- expand a path with wildcards (also intermediate ones)
 // ----------------------------------------------------------------------------
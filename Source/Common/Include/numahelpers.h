@@ -10,8 +10,21 @@
 #ifndef __unix__
 #include <Windows.h>
 #include "pplhelpers.h"
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <atomic>
+#include <memory>
+#include <stdlib.h>
+#include <algorithm>
+#include <omp.h>
 #endif
 #include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "simple_checked_arrays.h"
 #include "Basics.h" // for FormatWin32Error
 
@@ -26,6 +39,31 @@ static inline void overridenode(int n = -1)
     node_override = n;
 }
 
+// parse a list of numbers and ranges such as "0-3,8-11", as used by Linux sysfs
+static inline std::vector<size_t> parsesyslist(const std::string &list)
+{
+    std::vector<size_t> result;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        size_t dash = range.find('-');
+        try
+        {
+            size_t first = std::stoul(range.substr(0, dash));
+            size_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+            for (size_t i = first; i <= last; i++)
+                result.push_back(i);
+        }
+        catch (const std::exception &) // (trailing newline or empty list)
+        {
+        }
+    }
+    return result;
+}
+
+#ifndef __unix__
+
 // get the number of NUMA nodes we would like to distinguish
 static inline size_t getnumnodes()
 {
@@ -77,21 +115,6 @@ void parallel_for_on_each_numa_node(bool multistep, const FUNCTION &body)
     //assert (totalloops == nodes * steps);
 }
 
-// execute a passed function once for each NUMA node
-// This must be run from the main thread only.
-// ... TODO: honor ppl_cores == 1 for comparative measurements against single threads.
-template <typename FUNCTION>
-static void foreach_node_single_threaded(const FUNCTION &f)
-{
-    const size_t n = getnumnodes();
-    for (size_t i = 0; i < n; i++)
-    {
-        overridenode((int) i);
-        f();
-    }
-    overridenode(-1);
-}
-
 // get the current NUMA node
 static inline size_t getcurrentnode()
 {
@@ -186,6 +209,245 @@ static inline size_t getmostspaciousnumanode()
     return bestnode;
 }
 
+// get the logical processors of a NUMA node (only the first 64 processors are seen)
+static inline std::vector<size_t> getnodecpus(size_t node)
+{
+    std::vector<size_t> cpus;
+    ULONGLONG mask = 0;
+    if (GetNumaNodeProcessorMask((UCHAR) node, &mask))
+    {
+        for (size_t i = 0; i < 64; i++)
+            if (mask & (1ull << i))
+                cpus.push_back(i);
+    }
+    return cpus;
+}
+
+// restrict the calling thread to the processors of a NUMA node; returns false if that is not possible
+static inline bool bindcurrentthreadtonode(size_t node)
+{
+    ULONGLONG mask = 0;
+    if (!GetNumaNodeProcessorMask((UCHAR) node, &mask) || mask == 0)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) mask) != 0;
+}
+
+// spread the pages of a not yet touched memory range across all NUMA nodes
+// There is no Win32 API for this on committed memory, so the range is left to first-touch placement.
+static inline bool interleave(void * /*p*/, size_t /*n*/)
+{
+    return false;
+}
+
+#else // Linux: topology from sysfs, placement through the mbind() system call (so that libnuma is not required)
+
+// helpers for reading /sys/devices/system/node
+static inline std::string readsysfile(const std::string &path)
+{
+    std::ifstream f(path);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+static inline std::string nodesyspath(size_t node)
+{
+    return "/sys/devices/system/node/node" + std::to_string(node);
+}
+
+// get the number of NUMA nodes we would like to distinguish (highest node number + 1, as on Windows)
+static inline size_t getnumnodes()
+{
+    static size_t numnodes = 0;
+    if (numnodes == 0)
+    {
+        auto nodes = parsesyslist(readsysfile("/sys/devices/system/node/possible"));
+        numnodes = nodes.empty() ? 1 : nodes.back() + 1;
+    }
+    return numnodes;
+}
+
+// get the logical processors of a NUMA node
+static inline std::vector<size_t> getnodecpus(size_t node)
+{
+    return parsesyslist(readsysfile(nodesyspath(node) + "/cpulist"));
+}
+
+// get the current NUMA node
+static inline size_t getcurrentnode()
+{
+    // we can force it to be a certain node, for use in initializations
+    if (node_override >= 0)
+        return (size_t) node_override;
+    int cpu = sched_getcpu();
+    if (cpu < 0)
+        return 0;
+    for (size_t node = 0; node < getnumnodes(); node++)
+    {
+        auto cpus = getnodecpus(node);
+        if (std::find(cpus.begin(), cpus.end(), (size_t) cpu) != cpus.end())
+            return node;
+    }
+    return 0;
+}
+
+// get the free memory of a NUMA node in bytes, from the "Node <n> MemFree: <k> kB" line of its meminfo
+static inline size_t getavailablememory(size_t node)
+{
+    std::stringstream ss(readsysfile(nodesyspath(node) + "/meminfo"));
+    std::string line;
+    while (std::getline(ss, line))
+    {
+        size_t pos = line.find("MemFree:");
+        if (pos != std::string::npos)
+            return (size_t) std::stoull(line.substr(pos + 8)) * 1024;
+    }
+    return 0;
+}
+
+// policies of the mbind() system call (from <numaif.h>)
+enum
+{
+    mpol_preferred = 1,
+    mpol_interleave = 3
+};
+
+// set the memory policy of the pages in [p, p + n) that are fully contained in it; no-op if there is only one node
+static inline bool setmemorypolicy(void *p, size_t n, int mode, const std::vector<size_t> &nodes)
+{
+    if (getnumnodes() <= 1 || nodes.empty())
+        return false;
+    const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t begin = ((size_t) p + pagesize - 1) / pagesize * pagesize;
+    size_t end = ((size_t) p + n) / pagesize * pagesize;
+    if (end <= begin)
+        return false;
+    const size_t bitsperword = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> nodemask((getnumnodes() + bitsperword - 1) / bitsperword, 0);
+    for (size_t node : nodes)
+        nodemask[node / bitsperword] |= 1ul << (node % bitsperword);
+    return syscall(SYS_mbind, (void *) begin, end - begin, mode, nodemask.data(), nodemask.size() * bitsperword + 1, 0) == 0;
+}
+
+// spread the pages of a not yet touched memory range across all NUMA nodes that have memory
+static inline bool interleave(void *p, size_t n)
+{
+    auto nodes = parsesyslist(readsysfile("/sys/devices/system/node/has_memory"));
+    return setmemorypolicy(p, n, mpol_interleave, nodes);
+}
+
+// restrict the calling thread to the processors of a NUMA node; returns false if that is not possible
+static inline bool bindcurrentthreadtonode(size_t node)
+{
+    auto cpus = getnodecpus(node);
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return sched_setaffinity(0 /*calling thread*/, sizeof(set), &set) == 0;
+}
+
+// execute body (node, i, n), i in [0,n) on all NUMA nodes in small chunks
+// Same as the Windows version, with the OpenMP threads in place of PPL.
+template <typename FUNCTION>
+void parallel_for_on_each_numa_node(bool multistep, const FUNCTION &body)
+{
+    const size_t cores = (size_t) omp_get_max_threads();
+    const size_t nodes = getnumnodes();
+    const size_t corespernode = (cores - 1) / nodes + 1;
+    const size_t stepspernode = multistep ? 16 : 1;
+    const size_t steps = corespernode * stepspernode;
+    std::unique_ptr<std::atomic<size_t>[]> nextstepcounters(new std::atomic<size_t>[nodes]); // next block to run for a NUMA node
+    for (size_t k = 0; k < nodes; k++)
+        nextstepcounters[k] = 0;
+    overridenode();
+#pragma omp parallel
+    {
+        const size_t numanodeid = getcurrentnode(); // (reads sysfs, hence once per thread; a thread may migrate, but then only loses locality)
+#pragma omp for schedule(dynamic)
+        for (long i = 0; i < (long) (nodes * steps); i++)
+        {
+            // find a node that still has work left, preferring our own node
+            for (size_t node1 = numanodeid; node1 < numanodeid + nodes; node1++)
+            {
+                const size_t node = node1 % nodes;
+                const size_t step = nextstepcounters[node]++; // grab this step
+                if (step >= steps)
+                    continue;
+                body(node, step, steps);
+                break;
+            }
+        }
+    }
+}
+
+// allocate memory on the current NUMA node
+static inline void *malloc(size_t n, size_t align)
+{
+    const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    void *p = nullptr;
+    if (posix_memalign(&p, std::max(align, pagesize), n) != 0)
+    {
+        fprintf(stderr, "numa::malloc: failed allocating %d bytes with alignment %d\n", (int) n, (int) align);
+        return nullptr;
+    }
+    setmemorypolicy(p, n, mpol_preferred, std::vector<size_t>(1, getcurrentnode()));
+    return p;
+}
+
+// free memory allocated with numa::malloc()
+static inline void free(void *p)
+{
+    assert(p != NULL);
+    ::free(p);
+}
+
+// dump memory allocation
+static inline void showavailablememory(const char *what)
+{
+    size_t n = getnumnodes();
+    for (size_t i = 0; i < n; i++)
+        fprintf(stderr, "%s: %8.2f MB available on NUMA node %d\n", what, getavailablememory(i) / (1024.0 * 1024.0), (int) i);
+}
+
+// determine NUMA node with most memory available
+static inline size_t getmostspaciousnumanode()
+{
+    size_t n = getnumnodes();
+    size_t bestnode = 0;
+    size_t bestavailbytes = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t availbytes = getavailablememory(i);
+        if (availbytes > bestavailbytes)
+        {
+            bestavailbytes = availbytes;
+            bestnode = i;
+        }
+    }
+    return bestnode;
+}
+
+#endif
+
+// execute a passed function once for each NUMA node
+// This must be run from the main thread only.
+// ... TODO: honor ppl_cores == 1 for comparative measurements against single threads.
+template <typename FUNCTION>
+static void foreach_node_single_threaded(const FUNCTION &f)
+{
+    const size_t n = getnumnodes();
+    for (size_t i = 0; i < n; i++)
+    {
+        overridenode((int) i);
+        f();
+    }
+    overridenode(-1);
+}
+
 #if 0 // this is no longer used (we now parallelize the big matrix products directly)
 // class to manage multiple copies of data on local NUMA nodes
 template<class DATATYPE,class CACHEDTYPE> class numalocaldatacache
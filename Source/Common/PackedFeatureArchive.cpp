@@ -0,0 +1,167 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "PackedFeatureArchive.h"
+#include "Basics.h"
+#include "fileutil.h"
+#include "HalfFloat.h"
+#include <cstring>
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+PackedFeatureArchive::PackedFeatureArchive(const wstring& path)
+    : m_path(path)
+{
+    auto_file_ptr f(fopenOrDie(path, L"rb"));
+    memset(&m_header, 0, sizeof(m_header));
+    const size_t version1Size = offsetof(PackedArchiveHeader, elementType);
+    freadOrDie(&m_header, version1Size, 1, f);
+    if (memcmp(m_header.magic, PackedArchiveMagic, sizeof(PackedArchiveMagic)) != 0)
+        RuntimeError("PackedFeatureArchive: '%ls' is not a packed feature archive.", path.c_str());
+    if (m_header.version < 1 || m_header.version > PackedArchiveVersion)
+        RuntimeError("PackedFeatureArchive: '%ls' has unsupported version %d.", path.c_str(), (int)m_header.version);
+    if (m_header.version >= 2)
+        freadOrDie((char*) &m_header + version1Size, sizeof(m_header) - version1Size, 1, f);
+    if (GetElementType() != PackedArchiveElementType::Float32 && GetElementType() != PackedArchiveElementType::Float16)
+        RuntimeError("PackedFeatureArchive: '%ls' has unknown element type %d.", path.c_str(), (int)m_header.elementType);
+
+    fsetpos(f, m_header.indexOffset);
+    m_featureKind.resize(m_header.featureKindLength);
+    if (!m_featureKind.empty())
+        freadOrDie(&m_featureKind[0], 1, m_featureKind.size(), f);
+    m_chunks.resize(m_header.numChunks);
+    if (!m_chunks.empty())
+        freadOrDie(m_chunks.data(), sizeof(PackedArchiveChunk), m_chunks.size(), f);
+    m_utterances.resize(m_header.numUtterances);
+    if (!m_utterances.empty())
+        freadOrDie(m_utterances.data(), sizeof(PackedArchiveUtterance), m_utterances.size(), f);
+    m_keys.resize(m_header.keyBytes);
+    if (!m_keys.empty())
+        freadOrDie(m_keys.data(), 1, m_keys.size(), f);
+}
+
+string PackedFeatureArchive::GetKey(size_t utteranceIndex) const
+{
+    const auto& utterance = m_utterances[utteranceIndex];
+    return string(m_keys.data() + utterance.keyOffset, utterance.keyLength);
+}
+
+void PackedFeatureArchive::ReadChunk(size_t chunkIndex, vector<float>& frames) const
+{
+    const auto& chunk = m_chunks[chunkIndex];
+    frames.resize(chunk.numFrames * m_header.featureDimension);
+
+    // Each call opens the file, so that chunks can be read concurrently.
+    auto_file_ptr f(fopenOrDie(m_path, L"rb"));
+    fsetpos(f, chunk.offset);
+    if (GetElementType() == PackedArchiveElementType::Float32)
+        freadOrDie(frames.data(), sizeof(float), frames.size(), f);
+    else
+    {
+        vector<unsigned short> halfFrames(frames.size());
+        freadOrDie(halfFrames.data(), sizeof(unsigned short), halfFrames.size(), f);
+        for (size_t i = 0; i < frames.size(); i++)
+            frames[i] = HalfToFloat(halfFrames[i]);
+    }
+}
+
+PackedFeatureArchiveWriter::PackedFeatureArchiveWriter(const wstring& path, const string& featureKind, size_t featureDimension, unsigned int samplePeriod, size_t chunkFrames,
+                                                       PackedArchiveElementType elementType)
+    : m_featureKind(featureKind), m_chunkFrames(chunkFrames)
+{
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.magic, PackedArchiveMagic, sizeof(PackedArchiveMagic));
+    m_header.version = PackedArchiveVersion;
+    m_header.featureDimension = (uint32_t)featureDimension;
+    m_header.samplePeriod = samplePeriod;
+    m_header.featureKindLength = (uint32_t)featureKind.size();
+    m_header.elementType = (uint32_t)elementType;
+
+    m_file = fopenOrDie(path, L"wb");
+    // the header is written again by Close(), when the index is known
+    fwriteOrDie(&m_header, sizeof(m_header), 1, m_file);
+}
+
+PackedFeatureArchiveWriter::~PackedFeatureArchiveWriter()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+void PackedFeatureArchiveWriter::AddUtterance(const string& key, const float* frames, size_t numFrames)
+{
+    if (m_chunks.empty() || m_chunks.back().numFrames >= m_chunkFrames)
+    {
+        if (!m_chunks.empty())
+            WriteChunk();
+        PackedArchiveChunk chunk = {};
+        chunk.firstUtterance = m_utterances.size();
+        m_chunks.push_back(chunk);
+    }
+
+    auto& chunk = m_chunks.back();
+    PackedArchiveUtterance utterance = {};
+    utterance.keyOffset = m_keys.size();
+    utterance.keyLength = (uint32_t)key.size();
+    utterance.numFrames = (uint32_t)numFrames;
+    utterance.firstFrame = chunk.numFrames;
+    m_utterances.push_back(utterance);
+    m_keys += key;
+
+    m_chunkData.insert(m_chunkData.end(), frames, frames + numFrames * m_header.featureDimension);
+    chunk.numFrames += numFrames;
+    chunk.numUtterances++;
+}
+
+void PackedFeatureArchiveWriter::WriteChunk()
+{
+    // pad to the alignment
+    uint64_t position = fgetpos(m_file);
+    uint64_t offset = (position + PackedArchiveAlignment - 1) / PackedArchiveAlignment * PackedArchiveAlignment;
+    vector<char> padding(offset - position, 0);
+    if (!padding.empty())
+        fwriteOrDie(padding.data(), 1, padding.size(), m_file);
+
+    m_chunks.back().offset = offset;
+    if ((PackedArchiveElementType) m_header.elementType == PackedArchiveElementType::Float32)
+        fwriteOrDie(m_chunkData.data(), sizeof(float), m_chunkData.size(), m_file);
+    else
+    {
+        vector<unsigned short> halfData(m_chunkData.size());
+        for (size_t i = 0; i < halfData.size(); i++)
+            halfData[i] = FloatToHalf(m_chunkData[i]);
+        fwriteOrDie(halfData.data(), sizeof(unsigned short), halfData.size(), m_file);
+    }
+    m_chunkData.clear();
+}
+
+void PackedFeatureArchiveWriter::Close()
+{
+    if (!m_chunks.empty())
+        WriteChunk();
+
+    m_header.numChunks = m_chunks.size();
+    m_header.numUtterances = m_utterances.size();
+    m_header.keyBytes = m_keys.size();
+    m_header.indexOffset = fgetpos(m_file);
+
+    fwriteOrDie(m_featureKind.data(), 1, m_featureKind.size(), m_file);
+    if (!m_chunks.empty())
+        fwriteOrDie(m_chunks.data(), sizeof(PackedArchiveChunk), m_chunks.size(), m_file);
+    if (!m_utterances.empty())
+        fwriteOrDie(m_utterances.data(), sizeof(PackedArchiveUtterance), m_utterances.size(), m_file);
+    fwriteOrDie(m_keys.data(), 1, m_keys.size(), m_file);
+
+    fsetpos(m_file, (uint64_t)0);
+    fwriteOrDie(&m_header, sizeof(m_header), 1, m_file);
+    fcloseOrDie(m_file);
+    m_file = nullptr;
+}
+
+}}}
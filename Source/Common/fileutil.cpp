@@ -1730,6 +1730,26 @@ bool getfiletime(const wstring& path, FILETIME& time)
 #endif
 }
 
+// ----------------------------------------------------------------------------
+// getfilestamp(): size and modification time (in seconds since 1970) of a regular file
+// ----------------------------------------------------------------------------
+
+bool getfilestamp(const wstring& path, int64_t& size, int64_t& time)
+{ // false if 'path' is not a regular file
+#ifdef _WIN32
+    struct _stat64 fileinfo;
+    if (_wstat64(path.c_str(), &fileinfo) != 0 || (fileinfo.st_mode & _S_IFREG) == 0)
+        return false;
+#else
+    struct stat fileinfo;
+    if (stat(wtocharpath(path.c_str()).c_str(), &fileinfo) != 0 || !S_ISREG(fileinfo.st_mode))
+        return false;
+#endif
+    size = fileinfo.st_size;
+    time = fileinfo.st_mtime;
+    return true;
+}
+
 // ----------------------------------------------------------------------------
 // expand_wildcards -- wildcard expansion of a path, including directories.
 // ----------------------------------------------------------------------------
@@ -1463,10 +1463,41 @@ void ComputationNetwork::SaveToDbnFile(ComputationNetworkPtr net, const std::wst
     PutTag("EDBN");
 }
 
+template <class ElemType>
+size_t ComputationNetwork::CreateHalfPrecisionParameterValues()
+{
+    size_t savedBytes = 0;
+    for (const auto& node : GetAllNodes())
+    {
+        auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+        if (!parameter || parameter->GetStorageFormat() == HalfPrecisionFormat::None || parameter->GetHalfPrecisionValue())
+            continue;
+
+        bool usable = true;
+        for (const auto& consumer : GetAllNodes())
+        {
+            const auto& inputs = consumer->GetInputs();
+            for (size_t i = 0; i < inputs.size() && usable; i++)
+            {
+                auto halfPrecisionConsumer = dynamic_pointer_cast<IHalfPrecisionWeightsNode>(consumer);
+                usable = inputs[i] != node || (i == 0 && halfPrecisionConsumer && halfPrecisionConsumer->CanUseHalfPrecisionWeights());
+            }
+        }
+        if (!usable)
+            continue;
+
+        size_t bytes = parameter->Value().GetNumElements() * sizeof(ElemType);
+        if (parameter->CreateHalfPrecisionValue())
+            savedBytes += bytes - parameter->GetHalfPrecisionValue()->GetSizeInBytes();
+    }
+    return savedBytes;
+}
+
 template void ComputationNetwork::InitLearnableParameters<float>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const float initValueScale, bool initOnCPUOnly);
 template void ComputationNetwork::Read<float>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::CreateHalfPrecisionParameterValues<float>();
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
@@ -1477,6 +1508,7 @@ template void ComputationNetwork::InitLearnableParameters<double>(const Computat
 template void ComputationNetwork::Read<double>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::CreateHalfPrecisionParameterValues<double>();
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
@@ -32,6 +32,8 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class ConcurrentLoopWorkers; // (defined in ComputationNetworkEvaluation.cpp)
+
 // ===========================================================================
 // ComputationNetwork -- computation graph and operations
 // ===========================================================================
@@ -146,6 +148,7 @@ public:
     static void BumpEvalTimeStamp(const std::vector<ComputationNodeBasePtr>& nodes);
     void ResetEvalTimeStamps();
 
+
     // and for a set of nodes
     void StartEvaluateMinibatchLoop(const ComputationNodeBasePtr& rootNode) // (ugly name; meant to be unique so we can rename if needed)
     {
@@ -201,6 +204,7 @@ public:
 
     void FormNestedNetwork(const ComputationNodeBasePtr& rootNode);
     ComputationNodeBasePtr GetNestedNetwork(const ComputationNodeBasePtr& rootNode);
+    void ReleaseSliceViews(const ComputationNodeBasePtr& rootNode);
 
     // The methods below determine evaluation order, which is tricky in presence of recurrent loops.
     // TODO: Can this be moved to a separate class?
@@ -212,6 +216,28 @@ private:
     void DetermineLoopForwardOrderR(std::unordered_set<ComputationNodeBasePtr>& visited, std::unordered_set<ComputationNodeBasePtr>& recStack, std::list<ComputationNodeBasePtr>& nodesStack, ComputationNodeBasePtr cur);
     void GatherLoopNodesR(const ComputationNodeBasePtr& rootNode, std::unordered_set<ComputationNodeBasePtr>& visited, std::map<int, std::list<ComputationNodeBasePtr>>& recurrentResult, std::list<ComputationNodeBasePtr>& noRecurrentResult);
     void ReorderLoops(std::list<ComputationNodeBasePtr>& nodes, const std::map<int, std::list<ComputationNodeBasePtr>>& /*recurrentNodes*/, const std::list<ComputationNodeBasePtr>& /*noRecurrentNodes*/);
+    void ReorderLoopsForConcurrency(std::list<ComputationNodeBasePtr>& nodes);
+    void FormConcurrentLoopGroups(const std::list<ComputationNodeBasePtr>& nodes);
+
+public:
+    // Concurrent execution of recurrent loops on the CPU. With 'concurrentLoops', loops that do not depend on each other,
+    // e.g. the two directions of a bidirectional LSTM, run on separate threads. With 'wavefrontLoops', a loop that is
+    // stacked on another one with the same stepping direction also runs concurrently with it, following it step by step.
+    // This is a process-wide setting that applies to networks compiled afterwards.
+    static void SetLoopConcurrency(bool concurrentLoops, bool wavefrontLoops)
+    {
+        s_concurrentLoops = concurrentLoops || wavefrontLoops;
+        s_wavefrontLoops = wavefrontLoops;
+    }
+
+    // the concurrent group of the loop that 'loopNode' is part of, or -1 if that loop runs by itself (e.g. for tests)
+    int GetConcurrentLoopGroupId(const ComputationNodeBasePtr& loopNode) const;
+    // whether the loop of 'loopNode' follows the loop of 'sourceNode' step by step
+    bool IsWavefrontFollowerOf(const ComputationNodeBasePtr& loopNode, const ComputationNodeBasePtr& sourceNode) const;
+
+private:
+    static bool s_concurrentLoops;
+    static bool s_wavefrontLoops;
 
 public:
     // -----------------------------------------------------------------------
@@ -679,6 +705,11 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    // For inference: parameters with fp16/bf16 storage that are only used as weights by nodes that can compute with
+    // their 16-bit copy (IHalfPrecisionWeightsNode) get that copy. Returns the bytes that one evaluation reads less.
+    template <class ElemType>
+    size_t CreateHalfPrecisionParameterValues();
+
     template <class ElemType>
     void SaveToDbnFile(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
@@ -964,14 +995,29 @@ protected:
         virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool);
         virtual bool IsOutOfDateWrtInputs() const override;
 
+        // ForwardProp() while other loops of the same group run on other threads (see PARTraversalFlowControlNode::ForwardPropConcurrently()).
+        // Each time step first computes 'stepInputs', and waits until 'source', if given, has completed the same time step.
+        void ForwardPropConcurrently(const std::vector<ComputationNodeBasePtr>& stepInputs, const SEQTraversalFlowControlNode* source);
+        void WaitForStep(size_t step) const;
+
     public:
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
         int m_steppingDirection;             // +1 if left to right (t=0..T-1), -1 if rightt to left (t=T-1..0)
 
+        // concurrent execution, determined by FormConcurrentLoopGroups()
+        int m_concurrentGroupId;                                        // index into m_concurrentLoopGroups, or -1 if the loop always runs by itself
+        std::shared_ptr<SEQTraversalFlowControlNode> m_wavefrontSource; // loop of the same group that this loop follows step by step, or nullptr
+        std::vector<ComputationNodeBasePtr> m_wavefrontInputs;          // non-loop nodes between m_wavefrontSource and this loop, computed step by step by this loop
+        std::atomic<size_t> m_numStepsDone;                             // progress of ForwardPropConcurrently()
+        std::atomic<bool> m_aborted;                                    // ForwardPropConcurrently() failed, so that a loop waiting for it gives up
+
         SEQTraversalFlowControlNode(int loopId, ComputationNodeBasePtr cur)
             : m_loopId(loopId),
-              m_sourceNode(cur)
+              m_sourceNode(cur),
+              m_concurrentGroupId(-1),
+              m_numStepsDone(0),
+              m_aborted(false)
         {
             SetNodeName(L"Loop_" + m_sourceNode->NodeName());
         }
@@ -1027,6 +1073,16 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+    private:
+        void FormConcurrentRanges(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo);
+        bool CanRunConcurrently(size_t begin, size_t end, bool forward) const;
+        void ForwardPropConcurrently(size_t begin, size_t end);
+        void BackpropConcurrently(size_t begin, size_t end, const FrameRange& fr);
+
+        // ranges [begin, end) of m_nestedNodes that hold the loops of a concurrent group, and the step inputs of its wavefront loops
+        std::vector<std::pair<size_t, size_t>> m_concurrentRanges;
+        std::shared_ptr<ConcurrentLoopWorkers> m_workers; // threads that run the loops, created on first use
     };
 
 public:
@@ -1080,6 +1136,7 @@ private:
     std::vector<ComputationNodeBasePtr> m_allRoots;
 
     std::vector<std::shared_ptr<SEQTraversalFlowControlNode>> m_allSEQNodes; // [loopId] cached set of SEQTraversalFlowControlNodes to allow sharing and idempotence of FormRecurrentLoops()
+    std::vector<std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>> m_concurrentLoopGroups; // [groupId] loops that may run concurrently; consecutive in the global eval order (see FormConcurrentLoopGroups())
 
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
@@ -9,8 +9,12 @@
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "ReshapingNodes.h"
 #include <string>
 #include <set>
+#include <unordered_map>
 
 using namespace std;
 
@@ -160,7 +164,13 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
 
         ReorderLoops(reorderedNodes, recurrentNodes, noRecurrentNodes); // group nodes in loops together
 
+        if (s_concurrentLoops && !rootNode)
+            ReorderLoopsForConcurrency(reorderedNodes); // make independent loops consecutive
+
         UpdateEvalOrder(rootNode, reorderedNodes); // TODO: Get rid of this after-the-fact patch.
+
+        if (!rootNode)
+            FormConcurrentLoopGroups(reorderedNodes);
     }
 
     // --- END reorder process   --TODO: eliminate this process
@@ -328,21 +338,21 @@ void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
 #if 1
                 if (loopId != m_allSEQNodes.size())
                     LogicError("DetermineSCCsR: %ls %ls operation has inconsistent loopId (%d) vs. m_allSEQNodes.size() (%d)", cur->NodeName().c_str(), cur->OperationName().c_str(), (int)loopId, (int)m_allSEQNodes.size());
-                SEQTraversalFlowControlNode rInfo(m_allSEQNodes.size(), cur);
+                auto rInfo = make_shared<SEQTraversalFlowControlNode>(m_allSEQNodes.size(), cur);
 #else
                 assert(loopId == m_allSEQNodes.size()); // BUGBUG: Only true if all loops are shared among roots. Fix: use m_allSEQNodes.size() instead
-                SEQTraversalFlowControlNode rInfo(loopId, cur);
+                auto rInfo = make_shared<SEQTraversalFlowControlNode>(loopId, cur);
 #endif
                 // TODO: can we prove that 'cur' == nestedNodes.front()? If so, we won't need to store it separately.
-                rInfo.m_nestedNodes = move(nestedNodes); // TODO: make these two part of the constructor
-                for (auto node : rInfo.m_nestedNodes)
+                rInfo->m_nestedNodes = move(nestedNodes); // TODO: make these two part of the constructor
+                for (auto node : rInfo->m_nestedNodes)
                 {
                     node->m_isPartOfLoop = true; // this is the only flag in ComputationNode that escapes FormRecurrentLoops()!
                     // TODO: ^^ We should instead remember a pointer to our loop sentinel
-                    node->m_loopId = rInfo.m_loopId; // Note: m_loopId is only used inside this source file, and only for reordering
+                    node->m_loopId = rInfo->m_loopId; // Note: m_loopId is only used inside this source file, and only for reordering
                 }
-                rInfo.m_steppingDirection = DetermineLoopDirection(rInfo.m_nestedNodes);
-                m_allSEQNodes.push_back(make_shared<SEQTraversalFlowControlNode>(move(rInfo)));
+                rInfo->m_steppingDirection = DetermineLoopDirection(rInfo->m_nestedNodes);
+                m_allSEQNodes.push_back(rInfo);
                 loopId++; // and count it  TODO: may be removed
             }
         }
@@ -446,6 +456,246 @@ void ComputationNetwork::ReorderLoops(list<ComputationNodeBasePtr>& nodes,
     nodes = newList;
 }
 
+// -----------------------------------------------------------------------
+// concurrent execution of loops
+// -----------------------------------------------------------------------
+
+/*static*/ bool ComputationNetwork::s_concurrentLoops = false;
+/*static*/ bool ComputationNetwork::s_wavefrontLoops = false;
+
+// checks whether a node outside of loops can be computed one time step at a time, because each output frame only
+// depends on the same frame of its inputs. Such nodes between two stacked loops can be computed in a wavefront.
+// Whether the MBLayouts agree as well can only be checked at runtime.
+static bool IsFrameLocal(const ComputationNodeBasePtr& node)
+{
+    static const set<wstring> frameLocalOperations =
+    {
+        OperationNameOf(PlusNode), OperationNameOf(MinusNode), OperationNameOf(ElementTimesNode),
+        OperationNameOf(TimesNode), OperationNameOf(DiagTimesNode), OperationNameOf(RowStackNode),
+        OperationNameOf(SigmoidNode), OperationNameOf(TanhNode), OperationNameOf(RectifiedLinearNode),
+        OperationNameOf(ExpNode), OperationNameOf(LogNode), OperationNameOf(NegateNode), OperationNameOf(PassNode)
+    };
+    return !node->IsPartOfLoop() && frameLocalOperations.find(node->OperationName()) != frameLocalOperations.end();
+}
+
+// moves non-loop nodes that sit between two loops in front of the first one, if they do not depend on it, so that
+// loops that do not depend on each other become consecutive. E.g. for a bidirectional LSTM, the input projection
+// of the backward direction is moved in front of the forward loop. Nodes that depend on the first loop but are not
+// needed by the second one, e.g. one that combines the first two of three independent loops, are moved behind the
+// second one. This is repeated for a run of loops as long as the nodes between them are either independent of the
+// run or can be computed in a wavefront.
+// Called only from FormRecurrentLoops(), for the global eval order.
+void ComputationNetwork::ReorderLoopsForConcurrency(list<ComputationNodeBasePtr>& nodes)
+{
+    vector<ComputationNodeBasePtr> order(nodes.begin(), nodes.end());
+    unordered_set<ComputationNodeBasePtr> run; // nodes of the current run of loops, and the nodes between them that depend on those
+    size_t runStart = 0;
+    for (size_t i = 0; i < order.size();)
+    {
+        if (order[i]->m_loopId < 0)
+        {
+            i++;
+            continue;
+        }
+        // order[i] is the first node of a loop
+        if (run.empty())
+            runStart = i;
+        int loopId = order[i]->m_loopId;
+        size_t loopEnd = i;
+        while (loopEnd < order.size() && order[loopEnd]->m_loopId == loopId)
+            run.insert(order[loopEnd++]);
+        size_t next = loopEnd;
+        while (next < order.size() && order[next]->m_loopId < 0)
+            next++;
+        if (next == order.size())
+            break;
+        size_t nextEnd = next;
+        while (nextEnd < order.size() && order[nextEnd]->m_loopId == order[next]->m_loopId)
+            nextEnd++;
+
+        // nodes up to the next loop that it reads from, directly or indirectly
+        unordered_set<ComputationNodeBasePtr> needed;
+        for (size_t k = nextEnd; k-- > loopEnd;)
+        {
+            if (k < next && needed.find(order[k]) == needed.end())
+                continue;
+            for (const auto& input : order[k]->GetInputs())
+                needed.insert(input);
+        }
+
+        // split the nodes up to the next loop
+        vector<ComputationNodeBasePtr> independent, dependent, postponed;
+        bool allFrameLocal = true;
+        for (size_t k = loopEnd; k < next; k++)
+        {
+            const auto& node = order[k];
+            const auto& inputs = node->GetInputs();
+            if (any_of(inputs.begin(), inputs.end(), [&](const ComputationNodeBasePtr& input) { return run.find(input) != run.end(); }))
+            {
+                run.insert(node);
+                if (needed.find(node) != needed.end())
+                {
+                    dependent.push_back(node);
+                    allFrameLocal &= IsFrameLocal(node);
+                }
+                else
+                    postponed.push_back(node);
+            }
+            else
+                independent.push_back(node);
+        }
+
+        // new order of [runStart, nextEnd): independent nodes, the run so far, dependent nodes, the next loop, postponed nodes
+        if (!independent.empty() || !postponed.empty())
+        {
+            vector<ComputationNodeBasePtr> runNodes(order.begin() + runStart, order.begin() + loopEnd);
+            vector<ComputationNodeBasePtr> nextLoopNodes(order.begin() + next, order.begin() + nextEnd);
+            auto out = copy(independent.begin(), independent.end(), order.begin() + runStart);
+            out = copy(runNodes.begin(), runNodes.end(), out);
+            out = copy(dependent.begin(), dependent.end(), out);
+            out = copy(nextLoopNodes.begin(), nextLoopNodes.end(), out);
+            copy(postponed.begin(), postponed.end(), out);
+            runStart += independent.size();
+            next = nextEnd - nextLoopNodes.size() - postponed.size();
+        }
+
+        // the run ends where the nodes between two loops must be computed in full before the next loop starts
+        if (!dependent.empty() && (!s_wavefrontLoops || !allFrameLocal))
+            run.clear();
+        i = next;
+    }
+    nodes.assign(order.begin(), order.end());
+}
+
+// determines which loops may run concurrently, based on the reordered global eval order:
+//  - consecutive loops that do not depend on each other form a group
+//  - with s_wavefrontLoops, a loop that depends on a single loop of the group with the same stepping direction,
+//    directly or through frame-local nodes in between (its m_wavefrontInputs), joins the group as well and follows that
+//    loop step by step
+// The loops of a group are consecutive in every eval order, since all eval orders are subsets of the global one.
+// Called only from FormRecurrentLoops().
+void ComputationNetwork::FormConcurrentLoopGroups(const list<ComputationNodeBasePtr>& nodes)
+{
+    for (auto& loop : m_allSEQNodes)
+    {
+        loop->m_concurrentGroupId = -1;
+        loop->m_wavefrontSource = nullptr;
+        loop->m_wavefrontInputs.clear();
+    }
+    m_concurrentLoopGroups.clear();
+    if (!s_concurrentLoops)
+        return;
+    if (m_deviceId != CPUDEVICE)
+    {
+        fprintf(stderr, "\nFormConcurrentLoopGroups: Loops run concurrently on the CPU only; running them one by one.\n");
+        return;
+    }
+
+    vector<shared_ptr<SEQTraversalFlowControlNode>> group;                      // loops of the group being formed
+    unordered_map<ComputationNodeBasePtr, shared_ptr<SEQTraversalFlowControlNode>> owners; // [node of the group] loop that computes it
+    vector<ComputationNodeBasePtr> between;                                     // non-loop nodes after the last loop of the group
+    auto closeGroup = [&]()
+    {
+        if (group.size() > 1)
+        {
+            for (auto& loop : group)
+                loop->m_concurrentGroupId = (int) m_concurrentLoopGroups.size();
+            m_concurrentLoopGroups.push_back(group);
+        }
+        else
+        {
+            for (auto& loop : group)
+            {
+                loop->m_wavefrontSource = nullptr;
+                loop->m_wavefrontInputs.clear();
+            }
+        }
+        group.clear();
+        owners.clear();
+    };
+    for (auto iter = nodes.begin(); iter != nodes.end();)
+    {
+        if ((*iter)->m_loopId < 0)
+        {
+            if (!group.empty())
+                between.push_back(*iter);
+            iter++;
+            continue;
+        }
+        auto loop = m_allSEQNodes[(*iter)->m_loopId];
+        while (iter != nodes.end() && (*iter)->m_loopId == loop->m_loopId) // (the nodes of a loop are consecutive)
+            iter++;
+
+        // which loops of the group do the loop and the nodes before it read from?
+        set<shared_ptr<SEQTraversalFlowControlNode>> sources;
+        bool allFrameLocal = true;
+        auto gatherSources = [&](const ComputationNodeBasePtr& node)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                auto owner = owners.find(input);
+                if (owner != owners.end())
+                    sources.insert(owner->second);
+            }
+        };
+        for (const auto& node : between)
+        {
+            gatherSources(node);
+            allFrameLocal &= IsFrameLocal(node);
+        }
+        for (const auto& node : loop->m_nestedNodes)
+            gatherSources(node);
+
+        bool joins;
+        if (sources.empty()) // independent; but nodes in between must run before it
+            joins = between.empty();
+        else // wavefront
+            joins = s_wavefrontLoops && allFrameLocal && sources.size() == 1 && (*sources.begin())->m_steppingDirection == loop->m_steppingDirection;
+        if (joins && !sources.empty())
+        {
+            loop->m_wavefrontSource = *sources.begin();
+            loop->m_wavefrontInputs = between;
+        }
+        else if (!joins)
+            closeGroup();
+
+        group.push_back(loop);
+        for (const auto& node : loop->m_wavefrontInputs)
+            owners[node] = loop;
+        for (const auto& node : loop->m_nestedNodes)
+            owners[node] = loop;
+        between.clear();
+    }
+    closeGroup();
+
+    // log the groups
+    for (const auto& loops : m_concurrentLoopGroups)
+    {
+        fprintf(stderr, "\nConcurrent loops:");
+        for (const auto& loop : loops)
+        {
+            fprintf(stderr, " %ls", loop->NodeName().c_str());
+            if (loop->m_wavefrontSource)
+                fprintf(stderr, " (following %ls, %d step inputs)", loop->m_wavefrontSource->NodeName().c_str(), (int) loop->m_wavefrontInputs.size());
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+int ComputationNetwork::GetConcurrentLoopGroupId(const ComputationNodeBasePtr& loopNode) const
+{
+    if (loopNode->m_loopId < 0)
+        InvalidArgument("GetConcurrentLoopGroupId: Node %ls is not part of a loop.", loopNode->NodeName().c_str());
+    return m_allSEQNodes[loopNode->m_loopId]->m_concurrentGroupId;
+}
+
+bool ComputationNetwork::IsWavefrontFollowerOf(const ComputationNodeBasePtr& loopNode, const ComputationNodeBasePtr& sourceNode) const
+{
+    if (loopNode->m_loopId < 0 || sourceNode->m_loopId < 0)
+        InvalidArgument("IsWavefrontFollowerOf: Nodes %ls and %ls must both be part of loops.", loopNode->NodeName().c_str(), sourceNode->NodeName().c_str());
+    return m_allSEQNodes[loopNode->m_loopId]->m_wavefrontSource == m_allSEQNodes[sourceNode->m_loopId];
+}
+
 // set m_steppingDirection for all loops
 // TODO: Move this up to where it is used (in a separate commit since git cannot track moving and changing at the same time).
 // BUGBUG: Need to extend to multi-dimensional loop directions. Use a vector<int>.
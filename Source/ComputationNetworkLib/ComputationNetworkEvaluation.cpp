@@ -10,12 +10,21 @@
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
+#include "CPUMatrix.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -40,7 +49,22 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
     VerifyIsCompiled("ForwardProp");
 
     // traverse all nodes in the pre-determined evaluation order
-    GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    try
+    {
+        GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    }
+    catch (...) // nodes whose EndForwardProp() did not run still hold slice views; a network that is used again must be able to resize
+    {
+        ReleaseSliceViews(rootNode);
+        throw;
+    }
+}
+
+// release the slice views of all nodes below rootNode (normally done by their EndForwardProp() and EndBackprop())
+void ComputationNetwork::ReleaseSliceViews(const ComputationNodeBasePtr& rootNode)
+{
+    for (const auto& node : GetEvalOrder(rootNode))
+        node->ReleaseSliceViews();
 }
 
 // set the gradient matrix of a (root) node 1.0
@@ -76,7 +100,15 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    try
+    {
+        GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    }
+    catch (...) // (see ForwardProp())
+    {
+        ReleaseSliceViews(rootNode);
+        throw;
+    }
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -128,11 +160,27 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             nodeIter++; // and consume this node
         }
     }
+
+    FormConcurrentRanges(recurrentInfo);
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
-    for (auto& node : m_nestedNodes)
+    auto concurrentRange = m_concurrentRanges.begin();
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
     {
+        if (concurrentRange != m_concurrentRanges.end() && concurrentRange->first == i)
+        {
+            if (CanRunConcurrently(concurrentRange->first, concurrentRange->second, /*forward=*/true))
+            {
+                ForwardPropConcurrently(concurrentRange->first, concurrentRange->second);
+                i = concurrentRange->second - 1;
+                concurrentRange++;
+                continue;
+            }
+            concurrentRange++; // (if not, e.g. when some loops are up to date, run them one by one)
+        }
+
+        auto& node = m_nestedNodes[i];
 #if 0
         if (dynamic_pointer_cast<LearnableParameter<float>>(node))
             dynamic_pointer_cast<ComputationNode<float>>(node)->DebugLogMinibatch();
@@ -152,15 +200,299 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
     // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    auto concurrentRange = m_concurrentRanges.rbegin();
+    for (size_t i = m_nestedNodes.size(); i-- > 0;) // iterate backwards over evaluation order
     {
-        auto& node = *pnode;
+        if (concurrentRange != m_concurrentRanges.rend() && concurrentRange->second == i + 1)
+        {
+            if (CanRunConcurrently(concurrentRange->first, concurrentRange->second, /*forward=*/false))
+            {
+                BackpropConcurrently(concurrentRange->first, concurrentRange->second, fr);
+                i = concurrentRange->first;
+                concurrentRange++;
+                continue;
+            }
+            concurrentRange++;
+        }
+
+        auto& node = m_nestedNodes[i];
 
         node->BeginBackprop();
         node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
         node->EndBackprop();
     }
 }
+
+// -----------------------------------------------------------------------
+// concurrent execution of loops (see ComputationNetwork::SetLoopConcurrency())
+//
+// The loops of a group (see FormConcurrentLoopGroups()) are consecutive in
+// m_nestedNodes. All their BeginForwardProp() and EndForwardProp() calls are made
+// on the calling thread, while the time steps of the loops run on separate
+// threads. A wavefront loop computes its step inputs one time step at a time,
+// and waits for its source loop before each step. AllocateAllMatrices() keeps the
+// members of a group from sharing matrices with each other.
+// In backprop, only the time steps of loops without wavefront dependencies
+// run concurrently; the propagation into nodes outside of the loops, which
+// accumulates into shared gradients, stays on the calling thread.
+// -----------------------------------------------------------------------
+
+// threads that run tasks concurrently, kept across minibatches
+class ConcurrentLoopWorkers
+{
+public:
+    ConcurrentLoopWorkers()
+        : m_tasks(nullptr), m_generation(0), m_numPending(0), m_numThreadsPerTask(1), m_stop(false)
+    {
+    }
+
+    ~ConcurrentLoopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    // Runs the tasks concurrently, the first one on the calling thread, and returns when all have completed.
+    // The OpenMP threads of the caller are split evenly between the tasks. If tasks fail, the exception
+    // of the first failed one is rethrown.
+    void Run(const std::vector<std::function<void()>>& tasks)
+    {
+        int numThreads = 1;
+#ifdef _OPENMP
+        numThreads = omp_get_max_threads();
+#endif
+        std::unique_lock<std::mutex> lock(m_lock);
+        while (m_threads.size() + 1 < tasks.size())
+            m_threads.push_back(std::thread(&ConcurrentLoopWorkers::Work, this, m_threads.size() + 1, m_generation));
+        m_tasks = &tasks;
+        m_errors.assign(tasks.size(), nullptr);
+        m_numThreadsPerTask = std::max(1, numThreads / (int) tasks.size());
+        m_numPending = tasks.size() - 1;
+        m_generation++;
+        lock.unlock();
+        m_wakeUp.notify_all();
+
+        int previousNumThreads = CPUMatrix<float>::SetNumThreadsForCurrentThread(m_numThreadsPerTask);
+        RunTask(0);
+        CPUMatrix<float>::SetNumThreadsForCurrentThread(previousNumThreads);
+
+        lock.lock();
+        m_done.wait(lock, [this]() { return m_numPending == 0; });
+        m_tasks = nullptr;
+        for (auto& error : m_errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void Work(size_t taskIndex, size_t generation)
+    {
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wakeUp.wait(lock, [&]() { return m_stop || m_generation != generation; });
+            if (m_stop)
+                return;
+            generation = m_generation;
+            if (taskIndex >= m_tasks->size()) // (not needed this time)
+                continue;
+            int numThreads = m_numThreadsPerTask;
+            lock.unlock();
+
+            CPUMatrix<float>::SetNumThreadsForCurrentThread(numThreads);
+            RunTask(taskIndex);
+
+            lock.lock();
+            if (--m_numPending == 0)
+                m_done.notify_all();
+        }
+    }
+
+    void RunTask(size_t taskIndex)
+    {
+        try
+        {
+            (*m_tasks)[taskIndex]();
+        }
+        catch (...)
+        {
+            m_errors[taskIndex] = std::current_exception();
+        }
+    }
+
+    std::vector<std::thread> m_threads; // [taskIndex - 1]
+    std::mutex m_lock;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_done;
+    const std::vector<std::function<void()>>* m_tasks;
+    std::vector<std::exception_ptr> m_errors; // [taskIndex]
+    size_t m_generation;                      // bumped for every Run()
+    size_t m_numPending;                      // tasks of worker threads that have not completed
+    int m_numThreadsPerTask;
+    bool m_stop;
+};
+
+// determines m_concurrentRanges from the loop groups; called from the constructor
+void ComputationNetwork::PARTraversalFlowControlNode::FormConcurrentRanges(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo)
+{
+    std::set<ComputationNodeBasePtr> loopsHere;
+    for (auto& node : m_nestedNodes)
+    {
+        if (dynamic_pointer_cast<SEQTraversalFlowControlNode>(node))
+            loopsHere.insert(node);
+    }
+    // a non-loop node belongs to a range if it is computed step by step by a loop of the group that is also executed here
+    auto isStepInputOfGroup = [&](const ComputationNodeBasePtr& node, int groupId)
+    {
+        for (auto& loop : recurrentInfo)
+        {
+            if (loop->m_concurrentGroupId == groupId && loopsHere.find(loop) != loopsHere.end() &&
+                std::find(loop->m_wavefrontInputs.begin(), loop->m_wavefrontInputs.end(), node) != loop->m_wavefrontInputs.end())
+                return true;
+        }
+        return false;
+    };
+
+    for (size_t i = 0; i < m_nestedNodes.size();)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (!loop || loop->m_concurrentGroupId < 0)
+        {
+            i++;
+            continue;
+        }
+        size_t numLoops = 1;
+        size_t end = i + 1;
+        for (size_t k = i + 1; k < m_nestedNodes.size(); k++)
+        {
+            auto nextLoop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k]);
+            if (nextLoop && nextLoop->m_concurrentGroupId == loop->m_concurrentGroupId)
+            {
+                numLoops++;
+                end = k + 1;
+            }
+            else if (nextLoop || !isStepInputOfGroup(m_nestedNodes[k], loop->m_concurrentGroupId))
+                break;
+        }
+        if (numLoops > 1)
+            m_concurrentRanges.push_back(make_pair(i, end));
+        i = end;
+    }
+}
+
+// checks whether the loops of a range can run concurrently in this minibatch
+bool ComputationNetwork::PARTraversalFlowControlNode::CanRunConcurrently(size_t begin, size_t end, bool forward) const
+{
+    std::set<ComputationNodeBasePtr> rangeNodes(m_nestedNodes.begin() + begin, m_nestedNodes.begin() + end);
+    for (size_t i = begin; i < end; i++)
+    {
+        const auto& node = m_nestedNodes[i];
+        if (forward && !node->IsOutOfDateWrtInputs()) // partial re-evaluation: run one by one
+            return false;
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        if (!loop) // step input
+        {
+            if (!forward)
+                return false;
+            // the step inputs are computed with the time steps of the loop that follows them, which requires the same layout
+            size_t k = i + 1;
+            while (!dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k])) // (a range ends with a loop)
+                k++;
+            auto stepLayout = m_nestedNodes[k]->GetMBLayout();
+            if (node->GetMBLayout() != stepLayout)
+                return false;
+            for (const auto& input : node->GetInputs())
+            {
+                if (input->HasMBLayout() && input->GetMBLayout() != stepLayout)
+                    return false;
+            }
+        }
+        else if (loop->m_wavefrontSource && rangeNodes.find(loop->m_wavefrontSource) != rangeNodes.end())
+        {
+            if (!forward || loop->m_wavefrontSource->GetMBLayout() != loop->GetMBLayout())
+                return false;
+        }
+    }
+    return true;
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropConcurrently(size_t begin, size_t end)
+{
+    // lazily created state of the layouts must not be created by several threads at once
+    for (size_t i = begin; i < end; i++)
+    {
+        auto pMBLayout = m_nestedNodes[i]->GetMBLayout();
+        if (pMBLayout && pMBLayout->HasGaps())
+            pMBLayout->GetColumnsValidityMask(CPUDEVICE);
+    }
+
+    for (size_t i = begin; i < end; i++)
+        m_nestedNodes[i]->BeginForwardProp();
+
+    // one task per loop, which also computes the step inputs in front of it
+    std::set<ComputationNodeBasePtr> rangeNodes(m_nestedNodes.begin() + begin, m_nestedNodes.begin() + end);
+    std::vector<std::function<void()>> tasks;
+    std::vector<ComputationNodeBasePtr> stepInputs;
+    for (size_t i = begin; i < end; i++)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (!loop)
+        {
+            stepInputs.push_back(m_nestedNodes[i]);
+            continue;
+        }
+        loop->m_numStepsDone = 0;
+        loop->m_aborted = false;
+        // a source outside of this range has completed already
+        const SEQTraversalFlowControlNode* source = rangeNodes.find(loop->m_wavefrontSource) != rangeNodes.end() ? loop->m_wavefrontSource.get() : nullptr;
+        tasks.push_back([loop, stepInputs, source]() { loop->ForwardPropConcurrently(stepInputs, source); });
+        stepInputs.clear();
+    }
+
+    if (!m_workers)
+        m_workers = make_shared<ConcurrentLoopWorkers>();
+    m_workers->Run(tasks);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        m_nestedNodes[i]->EndForwardProp();
+        m_nestedNodes[i]->BumpEvalTimeStamp();
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropConcurrently(size_t begin, size_t end, const FrameRange& fr)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        auto pMBLayout = m_nestedNodes[i]->GetMBLayout();
+        if (pMBLayout && pMBLayout->HasGaps())
+            pMBLayout->GetColumnsValidityMask(CPUDEVICE);
+    }
+
+    // the time steps only propagate within each loop (see SEQTraversalFlowControlNode::Backprop())
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = end; i-- > begin;)
+    {
+        auto node = m_nestedNodes[i];
+        node->BeginBackprop();
+        FrameRange nodeRange = fr.WithLayout(node->GetMBLayout());
+        tasks.push_back([node, nodeRange]() { node->Backprop(nodeRange, true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/); });
+    }
+
+    if (!m_workers)
+        m_workers = make_shared<ConcurrentLoopWorkers>();
+    m_workers->Run(tasks);
+
+    for (size_t i = end; i-- > begin;)
+        m_nestedNodes[i]->EndBackprop();
+}
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -226,6 +558,47 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     }
 }
 
+// ForwardProp() of a loop of a concurrent group, running on its own thread
+void ComputationNetwork::SEQTraversalFlowControlNode::ForwardPropConcurrently(const std::vector<ComputationNodeBasePtr>& stepInputs, const SEQTraversalFlowControlNode* source)
+{
+    assert(GetMBLayout() == m_nestedNodes[0]->GetMBLayout());
+    try
+    {
+        FrameRangeIteration range(GetMBLayout(), m_steppingDirection);
+        size_t step = 0;
+        for (auto t = range.begin(); t != range.end(); t++)
+        {
+            if (source)
+                source->WaitForStep(step);
+            for (auto& node : stepInputs)
+                node->ForwardProp(t);
+            for (auto& node : m_nestedNodes)
+            {
+                node->ForwardProp(t);
+                node->BumpEvalTimeStamp();
+            }
+            m_numStepsDone = ++step;
+        }
+    }
+    catch (...)
+    {
+        m_aborted = true;
+        throw;
+    }
+}
+
+// waits until ForwardPropConcurrently() has completed a time step
+void ComputationNetwork::SEQTraversalFlowControlNode::WaitForStep(size_t step) const
+{
+    // The steps are short, so spin rather than block.
+    while (m_numStepsDone <= step)
+    {
+        if (m_aborted)
+            RuntimeError("ForwardProp: Stopped waiting for %ls, which failed.", NodeName().c_str());
+        std::this_thread::yield();
+    }
+}
+
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndForwardProp() /*override*/
 {
     // tell all that loop is done  --e.g. PastValueNode will capture its state for BPTT processing
@@ -381,6 +754,7 @@ void ComputationNetwork::InvalidateCompiledNetwork()
 {
     m_isCompiled = false;
     m_allSEQNodes.clear();
+    m_concurrentLoopGroups.clear();
     m_evalOrders.clear();
     m_nestedNetworks.clear();
     m_inputValues.clear();
@@ -917,12 +1291,70 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
-    set<ComputationNodeBasePtr> completedEvaluate;
     for (auto& nodeIter : compositeForwardPropEvalOrder)
-    {
         nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
 
-        if (nodeIter->IsPartOfLoop())
+    // Loops of a concurrent group run at the same time, and so do the step inputs of wavefront loops.
+    // Hence all members of a group request their matrices before any of them releases anything.
+    std::unordered_map<ComputationNodeBasePtr, int> stepInputGroups; // [step input] index into m_concurrentLoopGroups
+    for (auto& loops : m_concurrentLoopGroups)
+    {
+        for (auto& loop : loops)
+        {
+            for (auto& node : loop->m_wavefrontInputs)
+                stepInputGroups[node] = loop->m_concurrentGroupId;
+        }
+    }
+    auto getConcurrentGroupId = [&](const ComputationNodeBasePtr& node)
+    {
+        if (node->IsPartOfLoop())
+            return FindInRecurrentLoops(m_allSEQNodes, node)->m_concurrentGroupId;
+        auto stepInput = stepInputGroups.find(node);
+        return stepInput != stepInputGroups.end() ? stepInput->second : -1;
+    };
+    // members of a group that are in a set of nodes, in evaluation order
+    auto getConcurrentGroupMembers = [&](int groupId, const std::unordered_set<ComputationNodeBasePtr>& nodes)
+    {
+        std::vector<ComputationNodeBasePtr> members;
+        for (auto& loop : m_concurrentLoopGroups[groupId])
+        {
+            for (auto& node : loop->m_wavefrontInputs)
+            {
+                if (nodes.find(node) != nodes.end())
+                    members.push_back(node);
+            }
+            if (nodes.find(loop->m_nestedNodes.front()) != nodes.end())
+                members.push_back(loop);
+        }
+        return members;
+    };
+
+    std::unordered_set<ComputationNodeBasePtr> compositeForwardPropNodes(compositeForwardPropEvalOrder.begin(), compositeForwardPropEvalOrder.end());
+    set<ComputationNodeBasePtr> completedEvaluate;
+    for (auto& nodeIter : compositeForwardPropEvalOrder)
+    {
+        int groupId = getConcurrentGroupId(nodeIter);
+        if (groupId >= 0)
+        {
+            if (completedEvaluate.insert(m_concurrentLoopGroups[groupId].front()).second) // (marks the whole group)
+            {
+                auto members = getConcurrentGroupMembers(groupId, compositeForwardPropNodes);
+                for (auto& member : members)
+                    member->RequestMatricesBeforeForwardProp(m_matrixPool);
+                for (auto& member : members)
+                {
+                    auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(member);
+                    if (loop)
+                    {
+                        for (auto& nodeLoopIter : loop->m_nestedNodes)
+                            ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
+                    }
+                    else
+                        ReleaseMatricesAfterEvalForChildren(member, parentCount);
+                }
+            }
+        }
+        else if (nodeIter->IsPartOfLoop())
         {
             // TODO: use FormNestedNetwork() here to avoid completedEvaluate[] check
             shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, nodeIter);
@@ -949,6 +1381,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     if (trainRootNode != nullptr)
     {
         const std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
+        std::unordered_set<ComputationNodeBasePtr> backPropNodeSet(backPropNodes.begin(), backPropNodes.end());
 
         // now, simulate the gradient computation order to determine how to allocate matrices
         set<ComputationNodeBasePtr> completedGradient;
@@ -959,7 +1392,23 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
         {
             auto n = *iter;
-            if (n->IsPartOfLoop())
+            int groupId = getConcurrentGroupId(n);
+            if (groupId >= 0)
+            {
+                // concurrent group: allocate for all, then deallocate
+                if (completedGradient.insert(m_concurrentLoopGroups[groupId].front()).second)
+                {
+                    auto members = getConcurrentGroupMembers(groupId, backPropNodeSet);
+                    for (auto member = members.rbegin(); member != members.rend(); member++)
+                        (*member)->AllocateGradientMatricesForInputs(m_matrixPool);
+                    for (auto member = members.rbegin(); member != members.rend(); member++)
+                    {
+                        if (dynamic_pointer_cast<SEQTraversalFlowControlNode>(*member) || (*member)->NeedsGradient())
+                            (*member)->ReleaseMatricesAfterBackprop(m_matrixPool);
+                    }
+                }
+            }
+            else if (n->IsPartOfLoop())
             {
                 std::vector<ComputationNodeBasePtr> recurrentNodes;
                 shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, n);
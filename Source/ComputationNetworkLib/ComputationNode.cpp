@@ -801,6 +801,8 @@ atomic_ullong TimeStamp::s_timeStampCounter = ATOMIC_VAR_INIT(0);
 
 template <> map<size_t, map<size_t, shared_ptr<SingleMatrix>>> ComputationNode<float>::s_constOnes{};
 template <> map<size_t, map<size_t, shared_ptr<DoubleMatrix>>> ComputationNode<double>::s_constOnes{};
+template <> mutex ComputationNode<float>::s_constOnesLock{};
+template <> mutex ComputationNode<double>::s_constOnesLock{};
 
 // -----------------------------------------------------------------------
 // instantiate the core class templates
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <mutex>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -38,7 +39,8 @@
 #define CNTK_MODEL_VERSION_7 7 // ElemType tag in model file
 #define CNTK_MODEL_VERSION_8 8 // DynamicAxis for inputs
 #define CNTK_MODEL_VERSION_9 9 // Transpose flag in ConvolutionNode to support deconvolution. 
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_9
+#define CNTK_MODEL_VERSION_10 10 // fp16/bf16 storage of LearnableParameter
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_10
 
 extern bool g_shareNodeValueMatrices;
 
@@ -135,6 +137,24 @@ struct /*interface*/ IStatefulNode
 };
 typedef IStatefulNode::NodeStatePtr NodeStatePtr;
 
+// =======================================================================
+//  Interface for nodes that carry their input's value over to the next minibatch (PastValueNode).
+//  This allows a decoder to choose which column each parallel sequence of the next minibatch continues from,
+//  e.g. to extend several hypotheses of the same history one frame at a time (see BeamSearchDecoder), and
+//  to keep the state of sequences that are evaluated chunk by chunk (see CNTKStreamingSession).
+// =======================================================================
+
+struct /*interface*/ ICarriedOverStateNode
+{
+    // Reduces the carried-over value to the given columns (which may repeat), as the single frame of a minibatch
+    // of columns.size() parallel sequences that all continue into the next minibatch.
+    virtual void SelectCarriedOverState(const std::vector<size_t>& columns) = 0;
+    // Copies the given columns of the carried-over value into 'state' (a Matrix of the node's element type).
+    virtual void GetCarriedOverState(const std::vector<size_t>& columns, MatrixBase& state) const = 0;
+    // Makes 'state' the carried-over value, with one parallel sequence per column as in SelectCarriedOverState().
+    virtual void SetCarriedOverState(const MatrixBase& state) = 0;
+};
+
 // =======================================================================
 // ComputationNetworkOwnedNodeState -- class to collect ComputationNode members that are really owned by ComputationNetwork
 // These members are only to be set, changed, and read by ComputationNetwork code.
@@ -692,6 +712,11 @@ public:
 #endif
     }
 
+    // Nodes that own slice views (MatrixSliceView) release them here. A view keeps the matrix it was last re-targeted to
+    // from being resized, which other nodes that share its memory must be able to do. Called after the last iteration
+    // step of ForwardProp() and Backprop(), and by ComputationNetwork when those fail half-way.
+    virtual void ReleaseSliceViews() { }
+
     // check whether a node is out of date w.r.t. its children, for lazy evaluation
     // If this returns true, node must be evaluated to update m_value.
     // This is virtual because it is overridden by traversal nodes, which would check all their nodes' inputs.
@@ -1227,6 +1252,24 @@ public:
 
     Matrix<ElemType> ValueFor   (const FrameRange& fr /*select frame or entire batch*/)       { return DataFor(Value(),    fr); }
     Matrix<ElemType> GradientFor(const FrameRange& fr /*select frame or entire batch*/)       { return DataFor(Gradient(), fr); }
+
+    // versions of the above that re-target a view owned by the caller instead of creating a new slice object
+    // Use these in code that runs once per time step, e.g. ForwardProp() and BackpropTo() of nodes inside loops.
+    // The result is valid until the view is re-targeted again.
+    Matrix<ElemType>& DataFor(MatrixSliceView<ElemType>& view, Matrix<ElemType>& data, const FrameRange& fr /*select frame or entire batch*/)
+    {
+        try
+        {
+            return DataWithMBLayoutFor(view, data, fr, m_pMBLayout);
+        }
+        catch (const std::exception& e) // catch the error and rethrow it with the node name attached
+        {
+            Rethrow(e);
+        }
+    }
+    Matrix<ElemType>& ValueFor   (MatrixSliceView<ElemType>& view, const FrameRange& fr) { return DataFor(view, Value(),    fr); }
+    Matrix<ElemType>& GradientFor(MatrixSliceView<ElemType>& view, const FrameRange& fr) { return DataFor(view, Gradient(), fr); }
+
 #if 0 // causes grief with gcc
     Matrix<ElemType> ValueFor   (const FrameRange& fr /*select frame or entire batch*/) const { return DataFor(Value(),    fr); }
     Matrix<ElemType> GradientFor(const FrameRange& fr /*select frame or entire batch*/) const { return DataFor(Gradient(), fr); }
@@ -1355,6 +1398,7 @@ public:
     virtual void /*IComputationNode::*/ EndForwardProp() override
     {
         Base::EndForwardProp();
+        ReleaseSliceViews();
 #ifdef _DEBUG
 #ifdef TRACK_GAP_NANS
         MaskMissingValueColumnsToZero(FrameRange(m_pMBLayout)); // HasNaN() operates on a whole matrix, so first flatten all gaps to 0
@@ -1378,10 +1422,11 @@ public:
         }
 #endif
 
-#ifdef _DEBUG
     virtual void /*IComputationNode::*/ EndBackprop() override
     {
         Base::EndBackprop();
+        ReleaseSliceViews();
+#ifdef _DEBUG
 #ifdef TRACK_GAP_NANS
         for (size_t i = 0; i < m_inputs.size(); i++)
         {
@@ -1394,8 +1439,8 @@ public:
             }
         }
 #endif
-    }
 #endif
+    }
 
     // this is the entry point from Network; while it will call virtual BackpropTo() into the actual node implementation
     // TODO: move to -Base (or -Network?)
@@ -1678,13 +1723,15 @@ public:
         }
     }
 
-    // NOTE: we should reimplement this to be thread-safe and use a larger than requested initialized memory block
+    // NOTE: we should reimplement this to use a larger than requested initialized memory block
     // we can then just wrap that memory block in a matrix of the correct dimensions since it will be const no one can change it
     // should only need one memory block per device
-    // Thread-safety could be achieved by changing this to a shared_ptr.
+    // The lock is needed because several networks may be evaluated concurrently (see MultiModelEvaluator),
+    // and loops may run concurrently (see ComputationNetwork::SetLoopConcurrency()).
     // When using the TensorView interface, one could instead just use a 1x1 matrix with a view that broadcasts its columns (stride 0).
     static const Matrix<ElemType>& ConstOnes(const size_t rows, const size_t cols, const DEVICEID_TYPE deviceId)
     {
+        std::lock_guard<std::mutex> lock(s_constOnesLock);
         if (s_constOnes.find(rows) == s_constOnes.end() ||
             s_constOnes[rows].find(cols) == s_constOnes[rows].end()) // not found
         {
@@ -1708,6 +1755,7 @@ protected:
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
 
     static std::map<size_t, std::map<size_t, shared_ptr<Matrix<ElemType>>>> s_constOnes;
+    static std::mutex s_constOnesLock;
 };
 
 // convenience wrapper for ComputationNode::New()
@@ -1889,6 +1937,36 @@ struct IPreComputeNode
     // call this with 'false' at start and with 'true' at end
     // This is used for resetting and updating from accumulators.
     virtual void MarkComputed(const bool hasComputed) = 0;
+    // When the data is split across workers, each accumulates over its part, and this merges the accumulators of all
+    // workers before MarkComputed(true). 'sumAcrossWorkers' replaces a vector by its elementwise sum over all workers.
+    virtual void AggregateAccumulators(const std::function<void(std::vector<double>&)>& sumAcrossWorkers) = 0;
+};
+
+// =======================================================================
+// IInt8QuantizableNode -- interface implemented by ComputationNodes that can run inference with int8 weights
+// =======================================================================
+
+struct IInt8QuantizableNode
+{
+    // while on, ForwardProp() records the largest absolute value of the data input, for QuantizeWeightsToInt8()
+    virtual void SetInt8Calibration(bool calibrating) = 0;
+    // Replaces the weights (input 0, a parameter) by an int8 copy with one scale per column, which ForwardProp() uses from then on.
+    // The data input is quantized with the recorded range if 'useCalibratedInputRange', else per column as it comes.
+    // Returns false if the node does not qualify, e.g. because it is not on the CPU.
+    virtual bool QuantizeWeightsToInt8(bool useCalibratedInputRange) = 0;
+    // size of the int8 weights in bytes; 0 if not quantized
+    virtual size_t GetInt8WeightsSize() const = 0;
+};
+
+// =======================================================================
+// IHalfPrecisionWeightsNode -- interface implemented by ComputationNodes that can use weights kept in fp16/bf16 only
+// =======================================================================
+
+struct IHalfPrecisionWeightsNode
+{
+    // whether ForwardProp() can use the 16-bit copy of input 0 instead of its full-precision value
+    // (see LearnableParameter::CreateHalfPrecisionValue())
+    virtual bool CanUseHalfPrecisionWeights() const = 0;
 };
 
 // =======================================================================
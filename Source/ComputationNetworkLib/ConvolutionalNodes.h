@@ -11,6 +11,21 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// The part for the frames 'fr' of a max pooling node's storage of the positions of the maxima of its output 'value'
+// (see ConvolutionEngine::ForwardPooling()), with which backward of these frames uses those of their own forward pass.
+// Null if the engine does not record them.
+template <class ElemType>
+static int* MaxPoolingArgmaxFor(const ConvolutionEngine<ElemType>& engine, std::vector<int>& argmax,
+                                const Matrix<ElemType>& value, const FrameRange& fr, const MBLayoutPtr& pMBLayout)
+{
+    if (engine.GetPoolKind() != PoolKind::Max || value.GetDeviceId() != CPUDEVICE) // (only the CPU engines do)
+        return nullptr;
+    if (argmax.size() != value.GetNumElements()) // (the same for all frames of a minibatch)
+        argmax.resize(value.GetNumElements());
+    auto columnRange = ColumnRangeWithMBLayoutFor(value.GetNumCols(), fr, pMBLayout);
+    return argmax.data() + columnRange.first * value.GetNumRows();
+}
+
 // -----------------------------------------------------------------------
 // ConvolutionNodeBase
 // -----------------------------------------------------------------------
@@ -456,7 +471,7 @@ public:
     {
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         const Matrix<ElemType>& input0 = Input(0)->ValueFor(fr);
-        m_convEng->ForwardPooling(input0, sliceOutputValue);
+        m_convEng->ForwardPooling(input0, sliceOutputValue, MaxPoolingArgmaxFor(*m_convEng, m_argmax, Value(), fr, GetMBLayout()));
     }
 
     void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -466,7 +481,8 @@ public:
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        m_convEng->BackwardPooling(sliceOutputValue, sliceOutputGrad, sliceInput0Value, sliceInput0Grad);
+        m_convEng->BackwardPooling(sliceOutputValue, sliceOutputGrad, sliceInput0Value, sliceInput0Grad,
+                                   MaxPoolingArgmaxFor(*m_convEng, m_argmax, Value(), fr, GetMBLayout()));
     }
 
     bool OutputUsedInComputingInputNodesGradients() const override
@@ -510,6 +526,8 @@ protected:
                                                             m_sharing, m_autoPad, m_lowerPad, m_upperPad);
         SetDims(outDims, HasMBLayout());
     }
+
+    std::vector<int> m_argmax; // (see MaxPoolingArgmaxFor())
 };
 
 // -----------------------------------------------------------------------
@@ -688,7 +706,7 @@ public:
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        m_convEng->ForwardPooling(sliceInput0Value, sliceOutputValue);
+        m_convEng->ForwardPooling(sliceInput0Value, sliceOutputValue, MaxPoolingArgmaxFor(*m_convEng, m_argmax, Value(), fr, GetMBLayout()));
     }
 
     void BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
@@ -699,7 +717,8 @@ public:
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        m_convEng->BackwardPooling(sliceOutputValue, sliceOutputGrad, sliceInput0Value, sliceInput0Grad);
+        m_convEng->BackwardPooling(sliceOutputValue, sliceOutputGrad, sliceInput0Value, sliceInput0Grad,
+                                   MaxPoolingArgmaxFor(*m_convEng, m_argmax, Value(), fr, GetMBLayout()));
     }
 
     void Validate(bool isFinalValidationPass) override
@@ -766,6 +785,7 @@ protected:
 
     ConvolveGeometryPtr m_geometry;
     std::unique_ptr<ConvolutionEngine<ElemType>> m_convEng;
+    std::vector<int> m_argmax; // (see MaxPoolingArgmaxFor())
 };
 
 // add this at the start of each derived class, to get access to the members of ComputationNode
@@ -168,7 +168,17 @@ void LearnableParameter<ElemType>::Save(File& fstream) const /*override*/
     Base::Save(fstream);
     fstream << m_learningRateMultiplier;
     m_sampleLayout.Save(fstream);
-    fstream << Value();
+    fstream << (int) m_storageFormat;
+    if (m_storageFormat == HalfPrecisionFormat::None)
+        fstream << Value();
+    else if (m_halfValue)
+        fstream << *m_halfValue;
+    else
+    {
+        HalfMatrix<ElemType> halfValue;
+        halfValue.Assign(Value(), m_storageFormat);
+        fstream << halfValue;
+    }
 }
 
 template <class ElemType>
@@ -201,11 +211,67 @@ void LearnableParameter<ElemType>::Load(File& fstream, size_t modelVersion) /*ov
         }
     }
 
-    LoadValue(fstream);
+    m_storageFormat = HalfPrecisionFormat::None;
+    if (modelVersion >= CNTK_MODEL_VERSION_10)
+    {
+        int storageFormat;
+        fstream >> storageFormat;
+        m_storageFormat = (HalfPrecisionFormat) storageFormat;
+    }
+    m_halfValue = nullptr;
+
+    if (m_storageFormat == HalfPrecisionFormat::None)
+        LoadValue(fstream);
+    else // stored in fp16/bf16: widen it (inference may read a 16-bit copy, see CreateHalfPrecisionValue())
+    {
+        HalfMatrix<ElemType> halfValue;
+        fstream >> halfValue;
+        m_storageFormat = halfValue.GetFormat();
+        CreateMatrixIfNull(m_value);
+        halfValue.CopyTo(Value());
+    }
     SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
     VerifyDataSize(Value());      // sanity check
 }
 
+template <class ElemType>
+/*virtual*/ void LearnableParameter<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const /*override*/
+{
+    Base::CopyTo(nodeP, newName, flags);
+    if (flags & CopyNodeFlags::copyNodeValue)
+    {
+        auto node = dynamic_pointer_cast<LearnableParameter<ElemType>>(nodeP);
+        node->m_storageFormat = m_storageFormat;
+        node->m_halfValue = m_halfValue;
+    }
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SetStorageFormat(HalfPrecisionFormat format)
+{
+    m_halfValue = nullptr;
+    m_storageFormat = format;
+    if (format != HalfPrecisionFormat::None && !Value().IsEmpty())
+    {
+        HalfMatrix<ElemType> halfValue;
+        halfValue.Assign(Value(), format);
+        halfValue.CopyTo(Value());
+    }
+}
+
+template <class ElemType>
+bool LearnableParameter<ElemType>::CreateHalfPrecisionValue()
+{
+    if (m_storageFormat == HalfPrecisionFormat::None)
+        return false;
+    if (!m_halfValue)
+    {
+        m_halfValue = make_shared<HalfMatrix<ElemType>>();
+        m_halfValue->Assign(Value(), m_storageFormat);
+    }
+    return true;
+}
+
 // computation functions don't do anything for parameter nodes
 template <class ElemType>
 /*virtual*/ void LearnableParameter<ElemType>::UpdateFunctionMBSize() /*override*/
@@ -281,6 +347,11 @@ template <class ElemType>
         fstream << string(str);
         sprintf(str, "learningRateMultiplier=%f  NeedsGradient=%s", m_learningRateMultiplier, m_learningRateMultiplier>0 ? "true" : "false"); // TODO: update NDL to accept a better matching name as well
         fstream << string(str);
+        if (m_storageFormat != HalfPrecisionFormat::None)
+        {
+            sprintf(str, "  storage=%ls", HalfPrecisionFormatName(m_storageFormat));
+            fstream << string(str);
+        }
     }
 
     PrintNodeValuesToFile(printValues, printMetadata, fstream);
@@ -9,6 +9,8 @@
 #include "ScriptableObjects.h"
 #include "TensorShape.h"
 #include "Matrix.h"
+#include "Int8Matrix.h"
+#include "HalfMatrix.h"
 
 #include <string>
 
@@ -30,13 +32,13 @@ class LearnableParameter : public ComputationNode<ElemType>, public NumInputs<0>
 
 public:
     LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_storageFormat(HalfPrecisionFormat::None)
     {
         SetLearningRateMultiplier(1.0f); // enable normal learning by default
         MarkValueNonSharable();
     }
     LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& shape)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_storageFormat(HalfPrecisionFormat::None)
     {
         SetLearningRateMultiplier(1.0f);
         MarkValueNonSharable();
@@ -91,6 +93,19 @@ public:
 
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
+
+    // Element format of the values in the model file (see HalfMatrix). With fp16 or bf16, the values are rounded
+    // to it right away, so that they are the same as after saving and loading the model. This is set from MEL.
+    void SetStorageFormat(HalfPrecisionFormat format);
+    HalfPrecisionFormat GetStorageFormat() const { return m_storageFormat; }
+
+    // For inference with fp16/bf16 storage: makes a 16-bit copy of Value() for the nodes that can compute with it
+    // (see IHalfPrecisionWeightsNode), which halves the bytes they read. Value() is kept as it is, with its dimensions,
+    // for everything else that reads the parameter. Returns false if the storage format is ElemType.
+    bool CreateHalfPrecisionValue();
+    // the 16-bit copy, if it has been created; nullptr otherwise
+    const HalfMatrix<ElemType>* GetHalfPrecisionValue() const { return m_halfValue.get(); }
 
     // computation functions don't do anything for parameter nodes
     virtual void UpdateFunctionMBSize() override;
@@ -106,6 +121,10 @@ public:
     void InferInputDimsFrom(const TensorShape& otherShape);
 
     virtual void DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const override;
+
+private:
+    HalfPrecisionFormat m_storageFormat;
+    shared_ptr<HalfMatrix<ElemType>> m_halfValue; // read instead of Value() after CreateHalfPrecisionValue()
 };
 
 // -----------------------------------------------------------------------
@@ -485,7 +504,7 @@ private:
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class LookupTableNode : public ComputationNode<ElemType>, public NumInputs<2>
+class LookupTableNode : public ComputationNode<ElemType>, public NumInputs<2>, public IInt8QuantizableNode, public IHalfPrecisionWeightsNode
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
     static const std::wstring TypeName() { return L"LookupTable"; }
@@ -548,6 +567,20 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& t) override
     {
+        if (m_int8Weights) // inference with int8 weights, see QuantizeWeightsToInt8()
+        {
+            ForwardPropInt8(t);
+            return;
+        }
+        if (auto parameter = dynamic_cast<const LearnableParameter<ElemType>*>(Input(0).get()))
+        {
+            if (const auto* halfWeights = parameter->GetHalfPrecisionValue()) // the parameter has a 16-bit copy
+            {
+                ForwardPropHalf(t, halfWeights->Reshaped(Input(0)->GetAsMatrixNumRows(), Input(0)->GetAsMatrixNumCols()));
+                return;
+            }
+        }
+
         // input0 is the weight (each column is an embedding of one word), input 1 contains m_nbrLooked words in each column (sample)
         Matrix<ElemType> functionValues =           ValueFor(t);
         const Matrix<ElemType>&  input0 = Input(0)->ValueAsMatrix();
@@ -583,6 +616,86 @@ public:
         SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * wordsInEachSample), true);
     }
 
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // as in TimesNode: with sparse input words, the embedding gradient only has the columns of the words seen in the minibatch
+        if (Input(0)->NeedsGradient() && Input(1)->Value().GetMatrixType() == SPARSE && m_deviceId == CPUDEVICE)
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        // allocate the special ones first so that the default allocator will not allocate them again
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
+    // the input is not quantized, so there is nothing to calibrate
+    virtual void /*IInt8QuantizableNode::*/ SetInt8Calibration(bool) override { }
+
+    virtual bool /*IInt8QuantizableNode::*/ QuantizeWeightsToInt8(bool /*useCalibratedInputRange*/) override
+    {
+        // each embedding gets its own scale
+        if (m_deviceId != CPUDEVICE || !Input(0)->IsLeaf() || Input(0)->HasMBLayout())
+            return false;
+        // sparse input can only be used as it is, without reshaping it to one word per column
+        if (Input(1)->Value().GetMatrixType() == SPARSE && Input(1)->GetSampleMatrixNumRows() != Input(0)->GetAsMatrixNumCols())
+            return false;
+
+        m_int8Weights = make_shared<Int8Matrix<ElemType>>();
+        m_int8Weights->Quantize(Input(0)->ValueAsMatrix(), /*transpose=*/false);
+        return true;
+    }
+
+    virtual size_t /*IInt8QuantizableNode::*/ GetInt8WeightsSize() const override
+    {
+        return m_int8Weights ? m_int8Weights->GetSizeInBytes() : 0;
+    }
+
+    virtual bool /*IHalfPrecisionWeightsNode::*/ CanUseHalfPrecisionWeights() const override
+    {
+        return m_deviceId == CPUDEVICE && !m_int8Weights && !Input(0)->HasMBLayout() &&
+               (Input(1)->Value().GetMatrixType() == DENSE || Input(1)->GetSampleMatrixNumRows() == Input(0)->GetAsMatrixNumCols());
+    }
+
+private:
+    // same as ForwardProp() with the int8 weights, which are dequantized for the words looked up
+    void ForwardPropInt8(const FrameRange& t)
+    {
+        Matrix<ElemType> functionValues = ValueFor(t);
+        Matrix<ElemType> input1 = Input(1)->ValueFor(t);
+
+        size_t wordsInEachSample = input1.GetNumRows() / m_int8Weights->GetNumCols();
+        if (wordsInEachSample == 1)
+            functionValues.AssignInt8ProductOf(*m_int8Weights, false, input1);
+        else
+        {
+            auto input1Reshaped = input1.Reshaped(m_int8Weights->GetNumCols(), input1.GetNumCols() * wordsInEachSample);
+            auto functionValuesReshaped = functionValues.Reshaped(m_int8Weights->GetNumRows(), input1Reshaped.GetNumCols());
+            functionValuesReshaped.AssignInt8ProductOf(*m_int8Weights, false, input1Reshaped);
+        }
+    }
+
+    // same with the fp16/bf16 weights, widening the words looked up
+    void ForwardPropHalf(const FrameRange& t, const HalfMatrix<ElemType>& weights)
+    {
+        Matrix<ElemType> functionValues = ValueFor(t);
+        Matrix<ElemType> input1 = Input(1)->ValueFor(t);
+
+        size_t wordsInEachSample = input1.GetNumRows() / weights.GetNumCols();
+        if (wordsInEachSample == 1)
+            functionValues.AssignHalfProductOf(weights, false, input1);
+        else
+        {
+            auto input1Reshaped = input1.Reshaped(weights.GetNumCols(), input1.GetNumCols() * wordsInEachSample);
+            auto functionValuesReshaped = functionValues.Reshaped(weights.GetNumRows(), input1Reshaped.GetNumCols());
+            functionValuesReshaped.AssignHalfProductOf(weights, false, input1Reshaped);
+        }
+    }
+
+    shared_ptr<Int8Matrix<ElemType>> m_int8Weights;
+
+public:
+
     bool UnitTest()
     {
         try
@@ -8,6 +8,8 @@
 #include "ComputationNode.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "Int8Matrix.h"
+#include "InputAndParamNodes.h" // for LearnableParameter::GetHalfPrecisionValue()
 
 #include <unordered_set>
 #include <map>
@@ -223,13 +225,13 @@ template class ElementTimesNode<double>;
 // -----------------------------------------------------------------------
 
 template <class ElemType, bool m_transpose>
-class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
+class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>, public IInt8QuantizableNode, public IHalfPrecisionWeightsNode
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers; using Base::OperationName;                                                                                                                           \
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1)
-        : Base(deviceId, name), m_outputRank(outputRank)
+        : Base(deviceId, name), m_outputRank(outputRank), m_int8Calibrating(false), m_int8InputRange(0), m_int8UseInputRange(false)
     {
     }
 
@@ -277,6 +279,24 @@ private:
 public:
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (m_int8Calibrating)
+        {
+            Input(1)->MaskMissingValueColumnsToZero(fr);
+            m_int8InputRange = std::max(m_int8InputRange, Input(1)->ValueFor(m_input1SliceView, fr).MatrixNormInf());
+        }
+        if (m_int8Weights) // inference with int8 weights, see QuantizeWeightsToInt8()
+        {
+            ValueFor(m_outputSliceView, fr).AssignInt8ProductOf(*m_int8Weights, true, Input(1)->ValueFor(m_input1SliceView, fr), m_int8UseInputRange ? m_int8InputRange : 0);
+            return;
+        }
+        if (const auto* halfWeights = HalfPrecisionWeights()) // the parameter has a 16-bit copy
+        {
+            const size_t m = GetSampleMatrixNumRows();
+            const size_t k = Input(1)->GetSampleMatrixNumRows();
+            ValueFor(m_outputSliceView, fr).AssignHalfProductOf(m_transpose ? halfWeights->Reshaped(k, m) : halfWeights->Reshaped(m, k), m_transpose, Input(1)->ValueFor(m_input1SliceView, fr));
+            return;
+        }
+
         // If argument A is minibatch data, then this must be performed frame-by-frame, sequence-by-sequence, one GEMM call each.
         // This will be inefficient. We hope this will be the baseline of a future, more efficient TensorView-based implementation.
         if (!fr.IsOneColumnWrt(Input(0)->GetMBLayout()))
@@ -453,8 +473,75 @@ public:
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
 
+    virtual void /*IInt8QuantizableNode::*/ SetInt8Calibration(bool calibrating) override
+    {
+        m_int8Calibrating = calibrating && CanQuantizeWeightsToInt8();
+    }
+
+    virtual bool /*IInt8QuantizableNode::*/ QuantizeWeightsToInt8(bool useCalibratedInputRange) override
+    {
+        if (!CanQuantizeWeightsToInt8())
+            return false;
+
+        // The int8 product is this = A'^T * B with one scale per column of A', so A' is A^T [K x M],
+        // i.e. each output dimension gets its own scale.
+        const size_t m = GetSampleMatrixNumRows();
+        const size_t k = Input(1)->GetSampleMatrixNumRows();
+        bool transpose = m_transpose;
+        m_int8Weights = make_shared<Int8Matrix<ElemType>>();
+        if (transpose)
+            m_int8Weights->Quantize(Input(0)->Value().Reshaped(k, m), /*transpose=*/false);
+        else
+            m_int8Weights->Quantize(Input(0)->Value().Reshaped(m, k), /*transpose=*/true);
+        m_int8UseInputRange = useCalibratedInputRange && m_int8InputRange > 0;
+        return true;
+    }
+
+    virtual size_t /*IInt8QuantizableNode::*/ GetInt8WeightsSize() const override
+    {
+        return m_int8Weights ? m_int8Weights->GetSizeInBytes() : 0;
+    }
+
+    // same requirements as for int8 weights, except that sparse data works without transposing
+    virtual bool /*IHalfPrecisionWeightsNode::*/ CanUseHalfPrecisionWeights() const override
+    {
+        return m_deviceId == CPUDEVICE && !m_int8Weights && !Input(0)->HasMBLayout() &&
+               (!m_transpose || Input(1)->Value().GetMatrixType() == DENSE) &&
+               Input(0)->GetSampleLayout().GetNumElements() == GetSampleMatrixNumRows() * Input(1)->GetSampleMatrixNumRows();
+    }
+
+    virtual void ReleaseSliceViews() override
+    {
+        Base::ReleaseSliceViews();
+        m_outputSliceView.Release();
+        m_input1SliceView.Release();
+    }
+
 private:
+    const HalfMatrix<ElemType>* HalfPrecisionWeights() const
+    {
+        auto parameter = dynamic_cast<const LearnableParameter<ElemType>*>(Input(0).get());
+        return parameter ? parameter->GetHalfPrecisionValue() : nullptr;
+    }
+
+    // int8 weights are supported for a parameter times dense minibatch data, as plain matrix product on the CPU
+    bool CanQuantizeWeightsToInt8() const
+    {
+        return m_deviceId == CPUDEVICE &&
+               Input(0)->IsLeaf() && !Input(0)->HasMBLayout() &&
+               Input(1)->HasMBLayout() && Input(1)->Value().GetMatrixType() == DENSE &&
+               Input(0)->GetSampleLayout().GetNumElements() == GetSampleMatrixNumRows() * Input(1)->GetSampleMatrixNumRows();
+    }
+
     size_t m_outputRank;
+
+    // inference with int8 weights
+    shared_ptr<Int8Matrix<ElemType>> m_int8Weights;
+    bool m_int8Calibrating;
+    ElemType m_int8InputRange; // largest absolute input value seen while calibrating
+    bool m_int8UseInputRange;
+
+    MatrixSliceView<ElemType> m_outputSliceView, m_input1SliceView; // per-frame slices for the int8/half products, see MatrixSliceView
 };
 
 // -----------------------------------------------------------------------
@@ -548,15 +635,17 @@ public:
     {
         if (inputIndex == 0) // left derivative
         {
-            Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(fr); // use Masked- version since this is reducing over frames
-            Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(fr);
+            MaskMissingGradientColumnsToZero(fr); // since this is reducing over frames
+            Input(1)->MaskMissingValueColumnsToZero(fr);
+            auto& sliceOutputGrad = GradientFor(m_outputSliceView, fr);
+            auto& sliceInput1Value = Input(1)->ValueFor(m_input1SliceView, fr);
             m_innerproduct->AssignInnerProductOf(sliceOutputGrad, sliceInput1Value, false);
             Input(0)->GradientAsMatrix() += *m_innerproduct;
         }
         else // right derivative
         {
-            Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
-            Matrix<ElemType> sliceInput1Grad = Input(1)->GradientFor(fr);
+            auto& sliceOutputGrad = GradientFor(m_outputSliceView, fr);
+            auto& sliceInput1Grad = Input(1)->GradientFor(m_input1SliceView, fr);
             m_rightGradient->SetValue(sliceOutputGrad);
             m_rightGradient->ColumnElementMultiplyWith(Input(0)->ValueAsMatrix());
             sliceInput1Grad += *m_rightGradient;
@@ -572,8 +661,8 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        auto& sliceInput1Value = Input(1)->ValueFor(m_input1SliceView, fr);
+        auto& sliceOutputValue = ValueFor(m_outputSliceView, fr);
 
         sliceOutputValue.AssignValuesOf(sliceInput1Value);
         sliceOutputValue.ColumnElementMultiplyWith(Input(0)->ValueAsMatrix());
@@ -642,9 +731,17 @@ public:
         ReleaseMatrixToPool(m_rightGradient, matrixPool);
     }
 
+    virtual void ReleaseSliceViews() override
+    {
+        Base::ReleaseSliceViews();
+        m_outputSliceView.Release();
+        m_input1SliceView.Release();
+    }
+
 private:
     shared_ptr<Matrix<ElemType>> m_innerproduct;
     shared_ptr<Matrix<ElemType>> m_rightGradient;
+    MatrixSliceView<ElemType> m_outputSliceView, m_input1SliceView; // re-targeted per call, see MatrixSliceView
 };
 
 template class DiagTimesNode<float>;
@@ -851,24 +948,24 @@ public:
         else // right derivative
             m_temp->AssignElementProductOf(*m_invNorm1, *m_invNorm1);
 
-        m_temp->ElementMultiplyWith(ValueFor(fr));
-        m_rightTerm->SetValue(Input(inputIndex)->ValueFor(fr));
+        m_temp->ElementMultiplyWith(ValueFor(m_outputSliceView, fr));
+        m_rightTerm->SetValue(Input(inputIndex)->ValueFor(m_input0SliceView, fr));
         m_rightTerm->RowElementMultiplyWith(*m_temp);
 
         m_temp->AssignElementProductOf(*m_invNorm0, *m_invNorm1);
-        m_leftTerm->SetValue(Input(1 - inputIndex)->ValueFor(fr));
+        m_leftTerm->SetValue(Input(1 - inputIndex)->ValueFor(m_input1SliceView, fr));
         m_leftTerm->RowElementMultiplyWith(*m_temp);
 
         *m_leftTerm -= *m_rightTerm;
-        m_leftTerm->RowElementMultiplyWith(GradientFor(fr));
-        Input(inputIndex)->GradientFor(fr) += *m_leftTerm;
+        m_leftTerm->RowElementMultiplyWith(GradientFor(m_outputSliceView, fr));
+        Input(inputIndex)->GradientFor(m_input0SliceView, fr) += *m_leftTerm;
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
-        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        auto& sliceInput0Value = Input(0)->ValueFor(m_input0SliceView, fr);
+        auto& sliceInput1Value = Input(1)->ValueFor(m_input1SliceView, fr);
+        auto& sliceOutputValue = ValueFor(m_outputSliceView, fr);
 
         m_invNorm0->AssignVectorNorm2Of(sliceInput0Value, true);
         m_invNorm0->AssignElementInverseOf(*m_invNorm0);
@@ -935,6 +1032,14 @@ public:
         ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
+    virtual void ReleaseSliceViews() override
+    {
+        Base::ReleaseSliceViews();
+        m_outputSliceView.Release();
+        m_input0SliceView.Release();
+        m_input1SliceView.Release();
+    }
+
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
@@ -943,6 +1048,8 @@ private:
     shared_ptr<Matrix<ElemType>> m_leftTerm;
     shared_ptr<Matrix<ElemType>> m_rightTerm;
     shared_ptr<Matrix<ElemType>> m_temp;
+    // slices of the current frame range, re-targeted per call (in BackpropTo(), m_input0SliceView is the input we backprop into)
+    MatrixSliceView<ElemType> m_outputSliceView, m_input0SliceView, m_input1SliceView;
 };
 
 template class CosDistanceNode<float>;
@@ -973,19 +1080,19 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+        auto& sliceOutputGrad = GradientFor(m_outputSliceView, fr);
 
         if (inputIndex == 0) // left derivative
         {
-            Matrix<ElemType> sliceInput0Grad = Input(0)->GradientFor(fr);
-            Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
+            auto& sliceInput0Grad = Input(0)->GradientFor(m_input0SliceView, fr);
+            auto& sliceInput1Value = Input(1)->ValueFor(m_input1SliceView, fr);
 
             sliceInput0Grad.AddColumnReshapeProductOf(sliceOutputGrad, sliceInput1Value, false);
         }
         else // right derivative
         {
-            Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
-            Matrix<ElemType> sliceInput1Grad = Input(1)->GradientFor(fr);
+            auto& sliceInput0Value = Input(0)->ValueFor(m_input0SliceView, fr);
+            auto& sliceInput1Grad = Input(1)->GradientFor(m_input1SliceView, fr);
 
             sliceInput1Grad.AddColumnReshapeProductOf(sliceOutputGrad, sliceInput0Value, true);
         }
@@ -1000,7 +1107,7 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        ValueFor(fr).AssignKhatriRaoProductOf(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr));
+        ValueFor(m_outputSliceView, fr).AssignKhatriRaoProductOf(Input(0)->ValueFor(m_input0SliceView, fr), Input(1)->ValueFor(m_input1SliceView, fr));
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1015,6 +1122,17 @@ public:
         // TODO: ^^ Is that correct? Should we use a tensor here, TensorShape(rows0, rows1)?
         SetDims(TensorShape(rows0 * rows1), HasMBLayout());
     }
+
+    virtual void ReleaseSliceViews() override
+    {
+        Base::ReleaseSliceViews();
+        m_outputSliceView.Release();
+        m_input0SliceView.Release();
+        m_input1SliceView.Release();
+    }
+
+private:
+    MatrixSliceView<ElemType> m_outputSliceView, m_input0SliceView, m_input1SliceView; // re-targeted per call, see MatrixSliceView
 };
 
 template class KhatriRaoProductNode<float>;
@@ -172,7 +172,7 @@ public:
     // virtual ComputationNodeBase * NewThis(DEVICEID_TYPE deviceId, const wstring & name) = 0;
     DeclareConstructorFromConfigWithNumInputs(SoftmaxNodeBase);
     SoftmaxNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_unusedArgument(deviceId)
     {
     }
 
@@ -183,10 +183,10 @@ public:
 
         // get the args
         // Some do not consume input and/or output values. Don't touch those, pass dummies instead, since memshare may have taken them away already.
-        auto sliceOutputGrad = GradientFor(fr);          // propagate from this one...
-        auto sliceInputGrad = Input(0)->GradientFor(fr); // ...to this one
-        auto sliceInputValue = InputUsedInComputingInputNodesGradients(0) ? Input(0)->ValueFor(fr) : Matrix<ElemType>(sliceInputGrad.GetDeviceId());
-        auto sliceOutputValue = OutputUsedInComputingInputNodesGradients() ? ValueFor(fr) : Matrix<ElemType>(sliceInputGrad.GetDeviceId());
+        auto& sliceOutputGrad = GradientFor(m_outputGradientView, fr);          // propagate from this one...
+        auto& sliceInputGrad = Input(0)->GradientFor(m_inputGradientView, fr); // ...to this one
+        const auto& sliceInputValue = InputUsedInComputingInputNodesGradients(0) ? Input(0)->ValueFor(m_inputValueView, fr) : m_unusedArgument;
+        const auto& sliceOutputValue = OutputUsedInComputingInputNodesGradients() ? ValueFor(m_outputValueView, fr) : m_unusedArgument;
 
         // do the actual operation
         BackpropToV(*m_gradientTemp, sliceInputValue, sliceInputGrad, sliceOutputGrad, sliceOutputValue);
@@ -201,8 +201,7 @@ public:
         // TODO: once this gets reimplemented using TensorView, then this is no longer needed.
         Input(0)->Value().TransferToDeviceIfNotThere(Value().GetDeviceId(), /*isBeingMoved=*/ false);
 
-        auto values = ValueFor(fr);
-        ForwardPropV(values, Input(0)->ValueFor(fr));
+        ForwardPropV(ValueFor(m_outputValueView, fr), Input(0)->ValueFor(m_inputValueView, fr));
     }
 
     // derived class implement the actual non-linear operation
@@ -237,8 +236,22 @@ public:
         ReleaseMatrixToPool(m_gradientTemp, matrixPool);
     }
 
+    virtual void ReleaseSliceViews() override
+    {
+        Base::ReleaseSliceViews();
+        m_outputValueView.Release();
+        m_outputGradientView.Release();
+        m_inputValueView.Release();
+        m_inputGradientView.Release();
+    }
+
 protected:
     shared_ptr<Matrix<ElemType>> m_gradientTemp;
+
+private:
+    // slices of the current frame range; these are re-targeted per call rather than allocated, since this node is often evaluated per time step
+    MatrixSliceView<ElemType> m_outputValueView, m_outputGradientView, m_inputValueView, m_inputGradientView;
+    Matrix<ElemType> m_unusedArgument; // passed to BackpropToV() for values it does not use
 };
 
 #define UsingSoftmaxNodeBaseMembers         \
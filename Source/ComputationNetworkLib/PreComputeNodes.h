@@ -104,6 +104,17 @@ public:
         }
     }
 
+    // set the result of an earlier precomputation, e.g. from a cache (unlike SideLoadFromMatrix(), this keeps the sample layout)
+    void SetPrecomputedValue(const Matrix<ElemType>& value)
+    {
+        if (value.GetNumRows() != GetSampleLayout().GetNumElements() || value.GetNumCols() != 1)
+            InvalidArgument("%ls %ls operation: Precomputed value has dimensions [%d x %d], but the node has %d elements.",
+                            NodeName().c_str(), OperationName().c_str(), (int) value.GetNumRows(), (int) value.GetNumCols(), (int) GetSampleLayout().GetNumElements());
+        UpdateFunctionValuesSize();
+        Value().SetValue(value);
+        m_hasComputed = true;
+    }
+
     // this is for the special-purpose "convertdbn" command (initialize values directly from another well-trained model)
     virtual void SideLoadFromMatrix(const Matrix<ElemType>& value)
     {
@@ -192,13 +203,67 @@ public:
 protected:
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
+
+    // Merges the per-worker means (and, if 'var' is given, variances around them) into those of all samples, in place.
+    // This is the pairwise combination of Chan et al. in two rounds of sums: first the mean from the weighted means,
+    // then the variance as the weighted sum of the workers' variances plus the squared distances of their means from it.
+    // This avoids forming sums of squares, which lose precision for data with a large mean.
+    void AggregateMeanVar(Matrix<ElemType>& mean, Matrix<ElemType>* var, const std::function<void(std::vector<double>&)>& sumAcrossWorkers)
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: AggregateAccumulators() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+
+        const size_t dim = mean.GetNumElements();
+        std::vector<ElemType> localMean(dim), localVar(dim);
+        ElemType* buffer = localMean.data();
+        size_t bufferSize = dim; // (large enough, so that CopyToArray() does not reallocate)
+        mean.CopyToArray(buffer, bufferSize);
+        if (var)
+        {
+            buffer = localVar.data();
+            var->CopyToArray(buffer, bufferSize);
+        }
+
+        // round 1: number of samples and mean
+        const double n = (double) m_numSamples;
+        std::vector<double> sums(dim + 1);
+        sums[0] = n;
+        for (size_t i = 0; i < dim; i++)
+            sums[i + 1] = n * localMean[i];
+        sumAcrossWorkers(sums);
+        const double totalNumSamples = sums[0];
+        if (totalNumSamples == 0)
+            return; // (reported by MarkComputed(true))
+        std::vector<ElemType> newMean(dim);
+        for (size_t i = 0; i < dim; i++)
+            newMean[i] = (ElemType) (sums[i + 1] / totalNumSamples);
+
+        // round 2: variance around the new mean
+        if (var)
+        {
+            std::vector<double> m2(dim);
+            for (size_t i = 0; i < dim; i++)
+            {
+                double d = (double) localMean[i] - (double) newMean[i];
+                m2[i] = n * ((double) localVar[i] + d * d);
+            }
+            sumAcrossWorkers(m2);
+            for (size_t i = 0; i < dim; i++)
+                localVar[i] = (ElemType) (m2[i] / totalNumSamples);
+            var->SetValue(var->GetNumRows(), var->GetNumCols(), var->GetDeviceId(), localVar.data());
+        }
+
+        mean.SetValue(mean.GetNumRows(), mean.GetNumCols(), mean.GetDeviceId(), newMean.data());
+        m_numSamples = (size_t) totalNumSamples;
+    }
 };
 
 #define UsingMeanInvStdDevNodeBaseNodeMembers \
     ComputationNodeBoilerplate;               \
     UsingPreComputedNodeMembers;              \
     using Base::m_numSamples;                 \
-    using Base::IsAccumulating
+    using Base::IsAccumulating;               \
+    using Base::AggregateMeanVar
 
 // -----------------------------------------------------------------------
 // MeanNode (features)
@@ -232,6 +297,11 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(std::vector<double>&)>& sumAcrossWorkers) override
+    {
+        AggregateMeanVar(Value(), nullptr, sumAcrossWorkers);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -248,7 +318,7 @@ public:
         size_t totalNumSamples = m_numSamples + numNewSamples;
         if (totalNumSamples == 0)
             totalNumSamples = 1; // 0/0=1 in this context
-        ElemType alpha =                   1.0f / totalNumSamples;
+        ElemType alpha = (ElemType)1            / totalNumSamples;
         ElemType beta  = (ElemType)m_numSamples / totalNumSamples;
 
         size_t rank = DetermineElementwiseTensorRank();
@@ -313,6 +383,11 @@ public:
         }
     }
 
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(std::vector<double>&)>& sumAcrossWorkers) override
+    {
+        AggregateMeanVar(*m_mean, m_var.get(), sumAcrossWorkers);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -329,7 +404,7 @@ public:
         size_t totalNumSamples = m_numSamples + numNewSamples;
         if (totalNumSamples == 0)
             totalNumSamples = 1; // 0/0=1 in this context
-        ElemType alpha =                   1.0f / totalNumSamples;
+        ElemType alpha = (ElemType)1            / totalNumSamples;
         ElemType beta  = (ElemType)m_numSamples / totalNumSamples;
 
         size_t rank = DetermineElementwiseTensorRank();
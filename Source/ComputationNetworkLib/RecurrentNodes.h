@@ -89,9 +89,9 @@ protected:
 
 // TODO: 'direction' is really too general. signOfTimeOffset?
 template <class ElemType, int direction /*-1 for Past/left-to-right or +1 for Future/right-to-left*/ /*, MinibatchPackingFlags SequenceStart_or_End/*-Start or -End*/>
-class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public NumInputs<1>
+class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public ICarriedOverStateNode, public NumInputs<1>
 {
-    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers;
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers; using Base::OperationName;
     typedef std::shared_ptr<DelayedValueNodeState<ElemType>> DelayedNodeStatePtr;
 
 private:
@@ -223,20 +223,20 @@ public:
                     //       m_pMBLayout->IsGap(fr.Sequence(id)) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)));
                     if (!(m_pMBLayout->IsGap(fr.Sequence(id)) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)))) // don't propagate boundary frames or gaps
                     {
-                        Matrix<ElemType> frm = GradientFor(fr.Sequence(id));
+                        Matrix<ElemType>& frm = GradientFor(m_outputSliceView, fr.Sequence(id));
                         // TODO: use delayed FrameRange here as well
                         // Matrix<ElemType> to = Input(0)->GradientFor(FrameRange(m_pMBLayout, t_delayed).Sequence(id));
-                        Matrix<ElemType> to = Input(0)->GradientFor(frDelayed.Sequence(id));
+                        Matrix<ElemType>& to = Input(0)->GradientFor(m_inputSliceView, frDelayed.Sequence(id));
                         to += frm;
                     }
                 }
             }
             else // operate on entire time step in one go (over all parallel sequences)
             {
-                Matrix<ElemType> frm = GradientFor(fr);
+                Matrix<ElemType>& frm = GradientFor(m_outputSliceView, fr);
                 // TODO: use something like fr.WithDelay(t) instead, instead of recreating FrameRanges
                 // Matrix<ElemType> to = Input(0)->GradientFor(FrameRange(m_pMBLayout, t_delayed));
-                Matrix<ElemType> to = Input(0)->GradientFor(frDelayed);
+                Matrix<ElemType>& to = Input(0)->GradientFor(m_inputSliceView, frDelayed);
                 to += frm;
             }
         }
@@ -255,6 +255,7 @@ public:
         //  - we don't need to keep anything if all sequences are closed (sentence end)
         //    This condition includes full-sequence mode.
         // TODO: Can we optimize this and only copy if there is a sequence spanning across the end of the MB? And add a check to BeginForwardProp() to make sure we got one if there is a boundary at the start?
+        ReleaseSliceViews(); // (the last step may have read m_delayedValue through a view, which would keep it from being resized)
         m_delayedValue.SetValue(Input(0)->Value());
         if (!m_delayedActivationMBLayout)
             m_delayedActivationMBLayout = make_shared<MBLayout>();
@@ -293,7 +294,7 @@ public:
         size_t t = fr.t();
         int t_delayed = (int) (t + direction * m_timeStep); // this might end up outside the current window
 
-        Matrix<ElemType> inp((DEVICEID_TYPE)m_value->GetDeviceId());
+        const Matrix<ElemType>* inp; // (slices are views owned by this node, re-targeted per time step without allocation)
 
         // if any sequence at this time step has a boundary flag, then process one by one
         // TODO: Would there be an efficiency gain from grouping consecutive sequences with identical flags?
@@ -305,7 +306,7 @@ public:
                 if (m_pMBLayout->IsGap(fr.Sequence(id))) // if output is in a gap then don't bother filling it
                     continue;
 
-                Matrix<ElemType> out = ValueFor(fr.Sequence(id));
+                Matrix<ElemType>& out = ValueFor(m_outputSliceView, fr.Sequence(id));
 
                 // assert(m_pShiftedMBLayout->Is(id, t, SequenceStart_or_End) == m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)));
                 if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)))
@@ -314,20 +315,20 @@ public:
                 {
                     // inside the sequence: access delayed value
                     if (t_delayed < 0)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
+                        inp = &DataWithMBLayoutFor(m_inputSliceView, m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
                     else if (t_delayed >= T)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
+                        inp = &DataWithMBLayoutFor(m_inputSliceView, m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
                     else
-                        inp = Input(0)->ValueFor(frDelayed.Sequence(id));
+                        inp = &Input(0)->ValueFor(m_inputSliceView, frDelayed.Sequence(id));
                     // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed).Sequence(id));
 
-                    out.AssignValuesOf(inp);
+                    out.AssignValuesOf(*inp);
                 }
             }
         }
         else // frame has no boundary flags: use ValueFor directly (still may have a gap here)
         {
-            Matrix<ElemType> out = ValueFor(fr);
+            Matrix<ElemType>& out = ValueFor(m_outputSliceView, fr);
 
             if (t_delayed < 0)
             {
@@ -336,10 +337,10 @@ public:
                     if (IsPartOfLoop())
                         InvalidArgument("The delay node tries to access past values that are out of bound, possibly because there is no sentence start marker in the MBLayout.");
                     else //use first frame
-                        inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, 0));
+                        inp = &Input(0)->ValueFor(m_inputSliceView, FrameRange(m_pMBLayout, 0));
                 }
                 else
-                    inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation), m_delayedActivationMBLayout);
+                    inp = &DataWithMBLayoutFor(m_inputSliceView, m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation), m_delayedActivationMBLayout);
             }
 
             else if (t_delayed >= T)
@@ -349,16 +350,16 @@ public:
                     if (IsPartOfLoop())
                         InvalidArgument("The delay node tries to access future values that are out of bound, possibly because there is no sentence end marker in the MBLayout.");
                     else //use last frame
-                        inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, T - 1));
+                        inp = &Input(0)->ValueFor(m_inputSliceView, FrameRange(m_pMBLayout, T - 1));
                 }
                 else
-                    inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T), m_delayedActivationMBLayout);
+                    inp = &DataWithMBLayoutFor(m_inputSliceView, m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T), m_delayedActivationMBLayout);
             }
             else
-                inp = Input(0)->ValueFor(frDelayed);
+                inp = &Input(0)->ValueFor(m_inputSliceView, frDelayed);
             // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed));
 
-            out.AssignValuesOf(inp);
+            out.AssignValuesOf(*inp);
         }
     }
 
@@ -464,12 +465,63 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    virtual void /*ICarriedOverStateNode::*/ SelectCarriedOverState(const std::vector<size_t>& columns) override
+    {
+        Matrix<ElemType> selected(m_delayedValue.GetDeviceId());
+        GetCarriedOverState(columns, selected);
+        SetCarriedOverState(selected);
+    }
+
+    virtual void /*ICarriedOverStateNode::*/ GetCarriedOverState(const std::vector<size_t>& columns, MatrixBase& state) const override
+    {
+        VerifyCarriedOverStateSupported();
+        if (!m_delayedActivationMBLayout)
+            LogicError("%ls %ls operation: GetCarriedOverState() called before any minibatch was processed.", NodeName().c_str(), OperationName().c_str());
+
+        vector<ElemType> indices(columns.size());
+        for (size_t j = 0; j < columns.size(); j++)
+            indices[j] = (ElemType) columns[j];
+        Matrix<ElemType> indexMatrix(1, indices.size(), indices.data(), m_delayedValue.GetDeviceId());
+        dynamic_cast<Matrix<ElemType>&>(state).DoGatherColumnsOf(0, indexMatrix, m_delayedValue, 1);
+    }
+
+    virtual void /*ICarriedOverStateNode::*/ SetCarriedOverState(const MatrixBase& state) override
+    {
+        VerifyCarriedOverStateSupported();
+        const auto& value = dynamic_cast<const Matrix<ElemType>&>(state);
+        m_delayedValue.SetValue(value);
+
+        // a single frame whose sequences run on into the next minibatch, where ForwardProp() reads them at t_delayed = -1
+        if (!m_delayedActivationMBLayout)
+            m_delayedActivationMBLayout = make_shared<MBLayout>();
+        m_delayedActivationMBLayout->Init(value.GetNumCols(), 1);
+        for (size_t s = 0; s < value.GetNumCols(); s++)
+            m_delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, 2);
+    }
+
+    virtual void ReleaseSliceViews() override
+    {
+        Base::ReleaseSliceViews();
+        m_outputSliceView.Release();
+        m_inputSliceView.Release();
+    }
+
+private:
+    void VerifyCarriedOverStateSupported() const
+    {
+        int dir = direction;
+        if (dir != -1 || m_timeStep != 1)
+            RuntimeError("%ls %ls operation: Access to the carried-over state is only supported for PastValue with timeStep=1.", NodeName().c_str(), OperationName().c_str());
+    }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
     Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
     MBLayoutPtr m_delayedActivationMBLayout; // layout for m_delayedValue
     int m_timeStep;                          // delay in frames (typ. 1)
     function<void()> m_attachInputsFn;       // for late expansion of inputs (scripting)
+    MatrixSliceView<ElemType> m_outputSliceView; // per-time-step slices of our own value/gradient and of the input's
+    MatrixSliceView<ElemType> m_inputSliceView;
 };
 
 #define UsingDelayedValueNodeMembers        \
@@ -432,4 +432,75 @@ template <class ElemType>
 template class ScatterPackedNode<float>;
 template class ScatterPackedNode<double>;
 
+// -----------------------------------------------------------------------
+// SpliceContextNode (input, leftContext, rightContext) -- context window
+// -----------------------------------------------------------------------
+
+// The output, viewed as a matrix of WindowSize() input columns per output column, is gathered from the input.
+// This computes for each of these columns the input column it is copied from.
+template <class ElemType>
+void SpliceContextNode<ElemType>::UpdateIndex()
+{
+    let& pMBLayout = GetMBLayout();
+    let numParallelSequences = pMBLayout->GetNumParallelSequences();
+    let numTimeSteps = pMBLayout->GetNumTimeSteps();
+    let windowSize = WindowSize();
+
+    vector<ElemType> index(pMBLayout->GetNumCols() * windowSize, (ElemType)-1);
+    for (let& seq : pMBLayout->GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+        // frames of the sequence that are present in this minibatch
+        let tFirst = max(seq.tBegin, (ptrdiff_t)0);
+        let tLast  = (ptrdiff_t)min(seq.tEnd, numTimeSteps) - 1;
+        for (ptrdiff_t t = tFirst; t <= tLast; t++)
+        {
+            let j = t * numParallelSequences + seq.s;
+            for (size_t k = 0; k < windowSize; k++)
+            {
+                let tSource = min(max(t + (ptrdiff_t)k - (ptrdiff_t)m_leftContext, tFirst), tLast);
+                index[j * windowSize + k] = (ElemType)(tSource * numParallelSequences + seq.s);
+            }
+        }
+    }
+    m_index->SetValue(1, index.size(), m_deviceId, index.data());
+}
+
+template <class ElemType>
+/*virtual*/ void SpliceContextNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    UpdateIndex();
+    let& input = Input(0)->Value();
+    auto& output = Value();
+    let numRows = output.GetNumRows(), numCols = output.GetNumCols();
+    output.Reshape(input.GetNumRows(), input.GetNumCols() * WindowSize()); // (a reshaped view cannot be the target of a gather)
+    output.DoGatherColumnsOf(/*beta=*/0, *m_index, input, /*alpha=*/1);
+    output.Reshape(numRows, numCols);
+}
+
+template <class ElemType>
+/*virtual*/ void SpliceContextNode<ElemType>::BackpropToNonLooping(size_t /*inputIndex*/) /*override*/
+{
+    // frames repeated at the boundaries receive the gradients of all their copies
+    auto& inputGradient = Input(0)->Gradient();
+    let outputGradient = Gradient().Reshaped(inputGradient.GetNumRows(), inputGradient.GetNumCols() * WindowSize());
+    inputGradient.DoScatterColumnsOf(/*beta=*/1, *m_index, outputGradient, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void SpliceContextNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass && !HasMBLayout())
+        InvalidArgument("%ls requires its input to be a sequence (must have an MBLayout).", NodeDescription().c_str());
+
+    SetDims(TensorShape(Input(0)->GetSampleLayout().GetNumElements() * WindowSize()), HasMBLayout());
+}
+
+template class SpliceContextNode<float>;
+template class SpliceContextNode<double>;
+
 }}}
@@ -773,6 +773,68 @@ public:
     virtual void Validate(bool isFinalValidationPass) override;
 };
 
+// -----------------------------------------------------------------------
+// SpliceContextNode (input, leftContext, rightContext) -- context window
+// Stacks each frame with its 'leftContext' preceding and 'rightContext' following
+// frames of the same sequence, in time order, like the context expansion of the
+// HTK readers. Frames beyond the sequence boundaries (or beyond the minibatch, for
+// truncated sequences) are replaced by the first or last available frame.
+// This allows the reader to deliver raw frames (HTKDeserializer with
+// spliceContext=false) and to splice them inside the network instead.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SpliceContextNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"SpliceContext"; }
+
+public:
+    SpliceContextNode(DEVICEID_TYPE deviceId, const wstring& name, size_t leftContext = 0, size_t rightContext = 0)
+        : Base(deviceId, name), m_leftContext(leftContext), m_rightContext(rightContext), m_index(make_shared<Matrix<ElemType>>(deviceId))
+    {
+    }
+
+    SpliceContextNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SpliceContextNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"leftContext"), configp->Get(L"rightContext"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        auto node = dynamic_pointer_cast<SpliceContextNode<ElemType>>(nodeP);
+        node->m_leftContext  = m_leftContext;
+        node->m_rightContext = m_rightContext;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_leftContext >> m_rightContext;
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_leftContext << m_rightContext;
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override;
+
+private:
+    size_t WindowSize() const { return 1 + m_leftContext + m_rightContext; }
+    void UpdateIndex();
+
+    size_t m_leftContext, m_rightContext;
+    shared_ptr<Matrix<ElemType>> m_index; // for each frame of each window, the input column it is copied from (-1 for gaps)
+};
+
 // -----------------------------------------------------------------------
 // DiagonalNode -- extract diagonal elements of a square matrix into a row vector
 // -----------------------------------------------------------------------
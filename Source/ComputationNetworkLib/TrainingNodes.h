@@ -15,6 +15,7 @@
 #include <stdexcept>
 #include <list>
 #include <memory>
+#include <limits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -712,39 +713,126 @@ public:
           m_softMax(deviceId),
           m_grdToSoftMaxInput(deviceId),
           m_clsLogSoftmax(deviceId),
-          m_clsSoftmax(deviceId)
+          m_clsSoftmax(deviceId),
+          m_groupedColumns(deviceId),
+          m_groupedInput(deviceId),
+          m_groupedInputGradient(deviceId),
+          m_wordSelector(deviceId),
+          m_classIndices(deviceId),
+          m_tokenValues(deviceId)
     {
     }
 
 private:
-    // iterate over a large workspace that contains all class-conditioned probs concatenated
-    // 'sz' is the offset into that vector. We will iterate over these vectors at a few places. Always use this same boilerplate code.
-    template<class F>
-    size_t ForColumnsWithClass(const F& op)
-    {
-        const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
+    // All tokens of a class share the same word range, so the tokens of the minibatch are grouped by class
+    // and each class is processed with one matrix product over all of its tokens instead of one per token.
+    // The workspace vectors (m_logSoftmax, m_softMax, m_grdToSoftMaxInput) hold one [nbrWrd x numTokens] block per class.
+    struct ClassGroup
+    {
+        size_t lftBnd;     // index of first word belonging to the class
+        size_t nbrWrd;     // number of words in the class
+        size_t firstToken; // index of the class's first token in the grouped token order
+        size_t numTokens;  // number of tokens of the class in the minibatch
+        size_t offset;     // offset of the class's block in the workspace vectors
+    };
+
+    // Reads the labels and groups the tokens of the minibatch by class, skipping gaps.
+    // Sets m_classGroups, m_totalNbrWords, the column of each grouped token, the selector of the word labels, and the
+    // indices of the class labels.
+    void GroupTokensByClass()
+    {
+        const Matrix<ElemType>& labels = Input(LABELDATA)->Value();
+        const auto& pMBLayout = Input(LABELDATA)->GetMBLayout();
+        const size_t nT = pMBLayout->GetNumTimeSteps();
+        const size_t nS = pMBLayout->GetNumParallelSequences();
+
+        // collect the tokens of each class
+        vector<size_t> groupOfClass(m_nbrCls, SIZE_MAX);
+        vector<vector<size_t>> columnsOfGroup;
+        vector<size_t> wordOfColumn(nT * nS);
+        m_classGroups.clear();
+        for (size_t t = 0; t < nT; t++)
+            for (size_t s = 0; s < nS; s++)
             {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
+                if (pMBLayout->IsGap(FrameRange(pMBLayout, t).Sequence(s))) // skip gaps
                     continue;
 
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t y_t = (size_t)lbl_t(0, 0);     // current word token index
-                size_t c_t = (size_t)lbl_t(1, 0);     // current word token's class index
-                size_t lft_bnd = (size_t)lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t)lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd); // number of words in the class
+                size_t j = t * nS + s;
+                size_t y_t = (size_t)labels(0, j);     // current word token index
+                size_t c_t = (size_t)labels(1, j);     // current word token's class index
+                size_t lft_bnd = (size_t)labels(2, j); // index of first word belonging to current word token's class
+                size_t rgt_bnd = (size_t)labels(3, j); // and end of that range
+                size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
+
+                if (nbr_wrd == 0)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Encountered a class of size 0.");
+                if (y_t < lft_bnd || y_t >= lft_bnd + nbr_wrd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Word index out of bounds of class-member index range (word not a class member).");
+                if (c_t >= m_nbrCls)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Class index %d out of bounds of the %d classes.", (int)c_t, (int)m_nbrCls);
+
+                if (groupOfClass[c_t] == SIZE_MAX)
+                {
+                    groupOfClass[c_t] = m_classGroups.size();
+                    m_classGroups.push_back(ClassGroup{ lft_bnd, nbr_wrd, 0, 0, 0 });
+                    columnsOfGroup.push_back(vector<size_t>());
+                }
+                const auto& group = m_classGroups[groupOfClass[c_t]];
+                if (group.lftBnd != lft_bnd || group.nbrWrd != nbr_wrd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Tokens of class %d have different class-member index ranges.", (int)c_t);
 
-                // perform the operation
-                op(s, t, fr, y_t, c_t, sz, lft_bnd, nbr_wrd);
+                columnsOfGroup[groupOfClass[c_t]].push_back(j);
+                wordOfColumn[j] = y_t - lft_bnd;
+            }
 
-                sz += nbr_wrd;
+        // lay out the groups
+        size_t numTokens = 0;
+        m_totalNbrWords = 0;
+        for (size_t g = 0; g < m_classGroups.size(); g++)
+        {
+            auto& group = m_classGroups[g];
+            group.firstToken = numTokens;
+            group.numTokens = columnsOfGroup[g].size();
+            group.offset = m_totalNbrWords;
+            numTokens += group.numTokens;
+            m_totalNbrWords += group.nbrWrd * group.numTokens;
+        }
+
+        // the indices into the [nbr_cls x T] class matrices are passed as ElemType, like the column indices of gather/scatter
+        if (m_nbrCls * nT * nS > (size_t)1 << std::numeric_limits<ElemType>::digits)
+            RuntimeError("ClassBasedCrossEntropyWithSoftmax: The minibatch of %d frames is too large for %d classes in this precision.", (int)(nT * nS), (int)m_nbrCls);
+
+        // column of each grouped token, the selector of the words: 1 at the word in the workspace,
+        // and the index of the class of each token in the [nbr_cls x T] class matrices
+        vector<ElemType> columns(numTokens);
+        vector<ElemType> wordSelector(m_totalNbrWords, 0);
+        vector<ElemType> classIndices(numTokens);
+        for (size_t g = 0; g < m_classGroups.size(); g++)
+        {
+            const auto& group = m_classGroups[g];
+            for (size_t k = 0; k < group.numTokens; k++)
+            {
+                size_t j = columnsOfGroup[g][k];
+                columns[group.firstToken + k] = (ElemType)j;
+                wordSelector[group.offset + k * group.nbrWrd + wordOfColumn[j]] = 1;
+                classIndices[group.firstToken + k] = (ElemType)(j * m_nbrCls + (size_t)labels(1, j));
             }
-        return sz;
+        }
+        m_groupedColumns.SetValue(1, numTokens, m_deviceId, columns.data());
+        m_wordSelector.SetValue(1, m_totalNbrWords, m_deviceId, wordSelector.data());
+        m_classIndices.SetValue(1, numTokens, m_deviceId, classIndices.data());
+    }
+
+    // view of a [nbr_cls x T] class matrix as one row, which m_classIndices index
+    static Matrix<ElemType> ClassElements(const Matrix<ElemType>& classMatrix)
+    {
+        return classMatrix.Reshaped(1, classMatrix.GetNumElements());
+    }
+
+    // view of the [nbrWrd x numTokens] block of a class in one of the workspace vectors
+    static Matrix<ElemType> ClassBlock(const Matrix<ElemType>& workspace, const ClassGroup& group)
+    {
+        return workspace.ColumnSlice(group.offset, group.nbrWrd * group.numTokens).Reshaped(group.nbrWrd, group.numTokens);
     }
 
     // compute gradients to input observations, the weights to the observations, and the class log posterior probabilites
@@ -756,65 +844,58 @@ private:
 
         ComputeSoftMaxPartial(); // Note: Flag m_needRecomputeGradientToSoftmaxInput guards so that this computes only once.
 
-        ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& fr, size_t /*y_t*/, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+        switch (inputIndex)
         {
-            // compute prb - 1 and prb
-            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-            Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-            Matrix<ElemType> grd_to_soft_max_input = m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd);
-
-            switch (inputIndex)
+            case 1:
             {
-                case 1:
+                // gradient to input, computed per class in the grouped order, then added to the columns of the tokens
+                m_groupedInputGradient.Resize(Input(INPUTDATA)->GetSampleMatrixNumRows(), m_groupedColumns.GetNumCols());
+                for (const auto& group : m_classGroups)
                 {
-                    // gradient to input
-                    Matrix<ElemType> grd_t = Input(INPUTDATA)->GradientFor(fr);
-                    Matrix<ElemType>::MultiplyAndAdd(weightForClass, false, grd_to_soft_max_input, true, grd_t);
-                    break;
-                }
-                case 2:
-                {
-                    // gradient to input weight
-                    Matrix<ElemType> grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                    Matrix<ElemType>::MultiplyAndAdd(obs, false, grd_to_soft_max_input, false, grd_to_wgt_t);
-                    break;
+                    Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(group.lftBnd, group.nbrWrd);
+                    Matrix<ElemType> grd_t = m_groupedInputGradient.ColumnSlice(group.firstToken, group.numTokens);
+                    grd_t.AssignProductOf(weightForClass, false, ClassBlock(m_grdToSoftMaxInput, group), false);
                 }
-                case 3:
+                Input(INPUTDATA)->Gradient().DoScatterColumnsOf(1, m_groupedColumns, m_groupedInputGradient, 1);
+                break;
+            }
+            case 2:
+            {
+                // gradient to input weight
+                for (const auto& group : m_classGroups)
                 {
-                    Matrix<ElemType> grd_t = Input(CLASSPROBINDATA)->GradientFor(fr);
-                    grd_t.AssignValuesOf(Input(CLASSPROBINDATA)->DataFor(m_clsSoftmax, fr));
-                    ComputeCEPartialToSoftmaxInputs(grd_t, Gradient(), c_t);
-                    break;
+                    Matrix<ElemType> grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(group.lftBnd, group.nbrWrd);
+                    Matrix<ElemType> obs = m_groupedInput.ColumnSlice(group.firstToken, group.numTokens);
+                    Matrix<ElemType>::MultiplyAndAdd(obs, false, ClassBlock(m_grdToSoftMaxInput, group), true, grd_to_wgt_t);
                 }
+                break;
             }
-        });
+            case 3:
+            {
+                // softmax minus 1 at the class of each token
+                Matrix<ElemType>& grd = Input(CLASSPROBINDATA)->Gradient();
+                grd.SetValue(m_clsSoftmax);
+                m_tokenValues.Resize(1, m_classIndices.GetNumCols());
+                m_tokenValues.SetValue(1);
+                ClassElements(grd).DoScatterColumnsOf(1, m_classIndices, m_tokenValues, -1);
+                Matrix<ElemType>::Scale(Gradient(), grd);
+                Input(CLASSPROBINDATA)->MaskMissingGradientColumnsToZero(FrameRange(Input(CLASSPROBINDATA)->GetMBLayout()));
+                break;
+            }
+        }
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 
 private:
-    void ComputeCEPartialToSoftmaxInputs(Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& gradientValues, size_t y_t)
-    {
-        Matrix<ElemType>::MinusOneAt(inputGradientValues, y_t);
-        Matrix<ElemType>::Scale(gradientValues, inputGradientValues);
-    }
-
     // gradient of cross entropy w.r.t. to input to softmax
     void ComputeSoftMaxPartial()
     {
         if (m_needRecomputeGradientToSoftmaxInput)
         {
-            m_grdToSoftMaxInput.Resize(1, m_totalNbrWords); // buffer that contains a concatenation of class-conditional values
-
-            ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& /*fr*/, size_t y_t, size_t /*c_t*/, size_t sz, size_t lft_bnd, size_t nbr_wrd)
-            {
-                Matrix<ElemType> softMax = m_softMax.ColumnSlice(sz, nbr_wrd);
-
-                size_t idx_in_class = y_t - lft_bnd;
-                ComputeCEPartialToSoftmaxInputs(softMax, Gradient(), idx_in_class);
-
-                m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd).AssignValuesOf(softMax);
-            });
+            // buffer that contains a concatenation of class-conditional values
+            m_grdToSoftMaxInput.AssignDifferenceOf(m_softMax, m_wordSelector);
+            Matrix<ElemType>::Scale(Gradient(), m_grdToSoftMaxInput);
 
             m_needRecomputeGradientToSoftmaxInput = false;
         }
@@ -832,71 +913,49 @@ public:
         // get the label matrix to CPU, ideally in location=BOTH state
         Input(LABELDATA)->Value().TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ false/*means: BOTH state OK*/, /*emptyTransfer =*/ false, /*updatePreferredDevice =*/ false);
 
-        auto& functionValues = Value();
-
-        const size_t hdSize = Input(INPUTDATA)->GetSampleMatrixNumRows();
         assert(m_nbrCls == Input(CLASSPROBINDATA)->GetSampleMatrixNumRows());
 
         // compute the class posteriors
         m_clsLogSoftmax.SetValue(Input(CLASSPROBINDATA)->Value());
         m_clsLogSoftmax.InplaceLogSoftmax(true);   // log
+        MaskMissingColumnsToZero(m_clsLogSoftmax, Input(CLASSPROBINDATA)->GetMBLayout(), FrameRange(Input(CLASSPROBINDATA)->GetMBLayout()));
         m_clsSoftmax.AssignExpOf(m_clsLogSoftmax); // non-log
 
-        // create a large workspace to contain all class-conditioned probs concatenated
-        m_totalNbrWords = ForColumnsWithClass([](size_t /*s*/, size_t /*t*/, const FrameRange& /*fr*/, size_t y_t, size_t /*c_t*/, size_t /*sz*/, size_t lft_bnd, size_t nbr_wrd)
-        {
-            if (nbr_wrd == 0)
-                LogicError("ClassBasedCrossEntropyWithSoftmax: Encountered a class of size 0.");
-            if (y_t < lft_bnd || y_t >= lft_bnd + nbr_wrd)
-                LogicError("ClassBasedCrossEntropyWithSoftmax: Word index out of bounds of class-member index range (word not a class member).");
-        });
-        // now m_totalNbrWords = total size of concatenated vector
+        // group the tokens by class; m_totalNbrWords = total size of the concatenated class-conditioned prob vectors
+        GroupTokensByClass();
+
+        // hidden activation vectors of all tokens in the grouped order
+        m_groupedInput.DoGatherColumnsOf(0, m_groupedColumns, Input(INPUTDATA)->Value(), 1);
 
         // buffer to hold the concatenated class-conditioned prob vectors
         m_softMax.Resize(1, m_totalNbrWords);
         m_logSoftmax.Resize(1, m_totalNbrWords);
 
-        // accumulate objective
-        functionValues.SetValue(0);
-        ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+        for (const auto& group : m_classGroups)
         {
-            // now get views of various arrays that correspond to the index range of words belonging to this class
-
             // get hidden vectors for the words in this class
-            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
-
-            // buffer to hold the class-conditional distribution
-            Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
-            Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
+            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(group.lftBnd, group.nbrWrd); // [hdSize x nbr_wrd]
 
-            Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
+            // multiply the hidden activations of all tokens of the class with the weight matrix (the slice for the range of class members)
+            Matrix<ElemType> obs = m_groupedInput.ColumnSlice(group.firstToken, group.numTokens); // [hdSize x numTokens]
+            Matrix<ElemType> logSoftMax = ClassBlock(m_logSoftmax, group);                       // [nbr_wrd x numTokens]
+            logSoftMax.AssignProductOf(weightForClass, true, obs, false);
 
-            // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
-            // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
-            obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
-            logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
-
-            // log softmax(W x_t)
-            logSoftMax_t.InplaceLogSoftmax(false);
-
-            // and non-log version
-            softMax_t.SetValue(logSoftMax_t);
-            softMax_t.InplaceExp();
-            // we now have a column vector of class-conditional probabilities over the class members
-
-            // add  the word's class-conditional log posterior
-            size_t idx_in_class = y_t - lft_bnd;
-            Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
+            // log softmax(W x_t) for each token
+            logSoftMax.InplaceLogSoftmax(true);
+        }
 
-            // add the class log posterior probability (for backprop)
-            auto clsLogSoftmax_t = Input(CLASSPROBINDATA)->DataFor(m_clsLogSoftmax, fr);
-            Matrix<ElemType>::AddElementToElement(clsLogSoftmax_t, c_t, 0, functionValues, 0, 0); // (1x1)
-        });
+        // and non-log version
+        // we now have a column vector of class-conditional probabilities over the class members for each token
+        m_softMax.AssignExpOf(m_logSoftmax);
 
-        functionValues *= (-1);
+        // sum up the words' class-conditional log posteriors and the class log posterior probabilities
+        m_tokenValues.DoGatherColumnsOf(0, m_classIndices, ClassElements(m_clsLogSoftmax), 1);
+        ElemType logLikelihood = Matrix<ElemType>::InnerProductOfMatrices(m_logSoftmax, m_wordSelector) + m_tokenValues.SumOfElements();
+        Value().SetValue(-logLikelihood);
 
 #if NANCHECK
-        functionValues.HasNan("ClassBasedCrossEntropyWithSoftmax");
+        Value().HasNan("ClassBasedCrossEntropyWithSoftmax");
 #endif
         m_needRecomputeGradientToSoftmaxInput = true;
     }
@@ -934,6 +993,15 @@ protected:
     Matrix<ElemType> m_grdToSoftMaxInput;
     bool m_needRecomputeGradientToSoftmaxInput;
 
+    // tokens of the minibatch grouped by class
+    std::vector<ClassGroup> m_classGroups;
+    Matrix<ElemType> m_groupedColumns;        // [1 x numTokens] minibatch column of each token, in the grouped order
+    Matrix<ElemType> m_groupedInput;          // [hdSize x numTokens] hidden activations in the grouped order
+    Matrix<ElemType> m_groupedInputGradient;  // [hdSize x numTokens] gradient to the hidden activations in the grouped order
+    Matrix<ElemType> m_wordSelector;          // 1 at the label word of each token in the workspace vectors, 0 elsewhere
+    Matrix<ElemType> m_classIndices;          // [1 x numTokens] index of the class of each token in the [nbr_cls x T] class matrices
+    Matrix<ElemType> m_tokenValues;           // [1 x numTokens] temp for gathering and scattering at m_classIndices
+
     size_t m_nbrCls;
     size_t m_totalNbrWords;
 };
@@ -23,6 +23,8 @@
 #include "NoRandomizer.h"
 #include "HeapMemoryProvider.h"
 #include "InputAndParamNodes.h"
+#include "TimerUtility.h"
+#include <set>
 
 // TODO: Temporary mechanism to enable memory sharing for
 // node output value matrices. This will go away when the
@@ -38,7 +40,14 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     m_config.Parse(config);
     size_t nThreads = m_config("numCPUThreads", "1");
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
+    bool numaBindThreads = m_config(L"numaBindThreads", false);
+    NumaPlacement numaPlacement = ParseNumaPlacement(m_config(L"numaPlacement", L"none"));
+    // The thread that calls us belongs to the host application, so it is not bound: only the OpenMP worker threads
+    // that evaluate for it are. Other threads of the host that evaluate have teams of their own, which are not bound.
+    if (numaBindThreads || numaPlacement != NumaPlacement::none)
+        CPUMatrix<ElemType>::SetNumaPolicy(numaBindThreads, numaPlacement, false /*bindCallingThread*/);
     g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+    ComputationNetwork::SetLoopConcurrency(m_config(L"concurrentLoops", false), m_config(L"wavefrontLoops", false));
 }
 
 
@@ -57,6 +66,15 @@ void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription
     {
         LogicError("Unable to construct network from description");
     }
+
+    // Parameters stored in fp16/bf16 are read in 16 bits where possible (not needed with int8 weights, which replace them).
+    wstring quantization = m_config(L"quantization", L"none");
+    if (!EqualCI(quantization, L"int8"))
+    {
+        size_t savedBytes = m_net->CreateHalfPrecisionParameterValues<ElemType>();
+        if (savedBytes > 0)
+            fprintf(stderr, "Parameters stored in fp16/bf16 are read in 16 bits, which saves reading %.1f MB per evaluation.\n", savedBytes / 1e6);
+    }
 }
 
 
@@ -267,9 +285,153 @@ void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstrin
             RuntimeError("Sparse outputs are not supported by this API.");
     }
 
+    m_zeroCopy = m_config(L"zeroCopy", true);
+
+    wstring quantization = m_config(L"quantization", L"none");
+    if (EqualCI(quantization, L"int8"))
+        QuantizeWeightsToInt8();
+    else if (!EqualCI(quantization, L"none"))
+        InvalidArgument("quantization: '%ls' is not supported, expected 'none' or 'int8'.", quantization.c_str());
+
     m_started = true;
 }
 
+// Switches to int8 weights for inference on the CPU ('quantization=int8'). The weights of Times and LookupTable nodes
+// are quantized with one scale per column, and the float weights are released if nothing else uses them.
+// If a 'calibration' block is given, its reader is used to record the input range of each Times node
+// (instead of quantizing the inputs per sample), and to report accuracy and speed against the float network:
+//     calibration = [ reader = [ ... ] ; minibatchSize = 256 ; numMinibatches = 10 ]
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::QuantizeWeightsToInt8()
+{
+    if (m_quantized) // the weights may have been released
+        return;
+
+    std::vector<ComputationNodeBasePtr> nodes;
+    for (const auto& output : m_outputNodes)
+        for (const auto& node : m_net->GetAllNodesForRoot(output))
+            if (dynamic_pointer_cast<IInt8QuantizableNode>(node) && std::find(nodes.begin(), nodes.end(), node) == nodes.end())
+                nodes.push_back(node);
+
+    bool calibrate = m_config.Exists(L"calibration");
+    ConfigParameters calibrationConfig;
+    std::vector<std::vector<ElemType>> referenceOutputs;
+    double referenceSeconds = 0;
+    size_t numSamples = 0;
+    if (calibrate)
+    {
+        calibrationConfig = m_config(L"calibration");
+        for (const auto& node : nodes)
+            dynamic_pointer_cast<IInt8QuantizableNode>(node)->SetInt8Calibration(true);
+        ForwardCalibrationData(calibrationConfig, referenceOutputs, numSamples);
+        for (const auto& node : nodes)
+            dynamic_pointer_cast<IInt8QuantizableNode>(node)->SetInt8Calibration(false);
+
+        // once more without recording, for the reference time
+        referenceSeconds = ForwardCalibrationData(calibrationConfig, referenceOutputs, numSamples);
+    }
+
+    size_t numQuantized = 0, int8Bytes = 0;
+    std::set<ComputationNodeBasePtr> weights;
+    for (const auto& node : nodes)
+    {
+        auto quantizable = dynamic_pointer_cast<IInt8QuantizableNode>(node);
+        if (quantizable->QuantizeWeightsToInt8(calibrate))
+        {
+            numQuantized++;
+            int8Bytes += quantizable->GetInt8WeightsSize();
+            weights.insert(node->GetInputs()[0]);
+        }
+    }
+    m_quantized = true;
+
+    // release the float weights that are only used by quantized nodes
+    size_t releasedBytes = 0;
+    for (const auto& weight : weights)
+    {
+        bool usedElsewhere = false;
+        for (const auto& node : m_net->GetAllNodes())
+        {
+            const auto& inputs = node->GetInputs();
+            for (size_t i = 0; i < inputs.size() && !usedElsewhere; i++)
+            {
+                auto quantizable = dynamic_pointer_cast<IInt8QuantizableNode>(node);
+                usedElsewhere = inputs[i] == weight && (i != 0 || !quantizable || quantizable->GetInt8WeightsSize() == 0);
+            }
+        }
+        if (usedElsewhere)
+            continue;
+
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(weight)->Value();
+        releasedBytes += value.GetNumElements() * sizeof(ElemType);
+        value.Resize(0, 0, 0, /*growOnly=*/false);
+    }
+
+    fprintf(stderr, "Int8 inference: Quantized the weights of %d of %d Times and LookupTable nodes to %.1f MB, released %.1f MB of float weights.\n",
+            (int) numQuantized, (int) nodes.size(), int8Bytes / 1e6, releasedBytes / 1e6);
+
+    if (calibrate)
+    {
+        std::vector<std::vector<ElemType>> outputs;
+        double seconds = ForwardCalibrationData(calibrationConfig, outputs, numSamples);
+
+        fprintf(stderr, "Int8 inference: %d calibration samples: forward pass %.2f ms with float weights, %.2f ms with int8 weights (%.2fx).\n",
+                (int) numSamples, referenceSeconds * 1000, seconds * 1000, seconds > 0 ? referenceSeconds / seconds : 0.0);
+        for (size_t i = 0; i < m_outputNodes.size(); i++)
+        {
+            const auto& reference = referenceOutputs[i];
+            double sumSqrDiff = 0, sumSqr = 0, maxAbsDiff = 0;
+            for (size_t k = 0; k < reference.size(); k++)
+            {
+                double diff = (double) outputs[i][k] - reference[k];
+                sumSqrDiff += diff * diff;
+                sumSqr += (double) reference[k] * reference[k];
+                maxAbsDiff = std::max(maxAbsDiff, fabs(diff));
+            }
+            fprintf(stderr, "Int8 inference: Output %ls: relative RMS error %.5f, max absolute difference %.5f.\n",
+                    m_outputNodes[i]->NodeName().c_str(), sumSqr > 0 ? sqrt(sumSqrDiff / sumSqr) : 0.0, maxAbsDiff);
+        }
+    }
+}
+
+// Runs the outputs over the minibatches of the calibration reader, collecting their values (gaps are zeroed).
+// Returns the time spent in the forward passes.
+template<typename ElemType>
+double CNTKEvalExtended<ElemType>::ForwardCalibrationData(const ConfigParameters& calibrationConfig, std::vector<std::vector<ElemType>>& outputs, size_t& numSamples)
+{
+    size_t minibatchSize = calibrationConfig(L"minibatchSize", (size_t) 256);
+    size_t numMinibatches = calibrationConfig(L"numMinibatches", (size_t) 10);
+    ConfigParameters readerConfig(calibrationConfig(L"reader"));
+    DataReader reader(readerConfig);
+    reader.StartMinibatchLoop(minibatchSize, 0, requestDataSize);
+
+    outputs.assign(m_outputNodes.size(), std::vector<ElemType>());
+    numSamples = 0;
+    double seconds = 0;
+    Timer timer;
+    size_t actualMBSize;
+    for (size_t mb = 0; mb < numMinibatches && DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(reader, m_net, nullptr, false, false, m_inputMatrices, actualMBSize, nullptr); mb++)
+    {
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+        timer.Restart();
+        for (const auto& node : m_outputNodes)
+            m_net->ForwardProp(node);
+        timer.Stop();
+        seconds += timer.ElapsedSeconds();
+        numSamples += actualMBSize;
+
+        for (size_t i = 0; i < m_outputNodes.size(); i++)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_outputNodes[i]);
+            if (node->HasMBLayout())
+                node->MaskMissingValueColumnsToZero(FrameRange(node->GetMBLayout()));
+            std::unique_ptr<ElemType[]> values(node->Value().CopyToArray());
+            outputs[i].insert(outputs[i].end(), values.get(), values.get() + node->Value().GetNumElements());
+        }
+    }
+    return seconds;
+}
+
 template<typename ElemType>
 VariableSchema CNTKEvalExtended<ElemType>::GetOutputSchema() const
 {
@@ -313,7 +475,18 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
     if (outputs.size() != m_outputNodes.size())
         RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
 
+    // Dense inputs and outputs in CPU memory are bound to the caller's buffers (matrixFlagDontOwnBuffer) instead of
+    // being copied. The bindings are released again on return (also by an exception), so that no matrix refers
+    // to the caller's memory between calls.
+    std::vector<shared_ptr<Matrix<ElemType>>> boundMatrices;
+    auto releaseBindings = MakeScopeExit([&boundMatrices]()
+    {
+        for (auto& matrix : boundMatrices)
+            matrix->SetValue(0, 0, CPUDEVICE, nullptr, matrixFlagNormal);
+    });
+
     size_t i = 0;
+    MBLayoutPtr boundLayout;
     for (auto& input : m_inputMatrices)
     {
         // const cast: The matrix class takes this over without copying and could theoretically change the contents,
@@ -348,7 +521,13 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         input.second.pMBLayout->Init(1, numCols);
         input.second.pMBLayout->AddSequence(0, 0, 0, numCols);
 
-        if (type == MatrixType::DENSE)
+        if (type == MatrixType::DENSE && m_zeroCopy && matrix->GetDeviceId() == CPUDEVICE)
+        {
+            matrix->SetValue(numRows, numCols, CPUDEVICE, buffer.m_buffer.data(), matrixFlagDontOwnBuffer);
+            boundMatrices.push_back(matrix);
+            boundLayout = input.second.pMBLayout;
+        }
+        else if (type == MatrixType::DENSE)
             matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
         else if (type == MatrixType::SPARSE)
         {
@@ -363,10 +542,33 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
 
     ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
 
+    // An output along the dynamic axis of a bound input has a known size, and can be computed in place.
+    std::vector<bool> outputBound(m_outputNodes.size(), false);
+    for (size_t i = 0; i < m_outputNodes.size() && boundLayout; ++i)
+    {
+        auto node = m_outputNodes[i];
+        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        if (node->GetMBLayout() != boundLayout || outputMatrix->GetDeviceId() != CPUDEVICE ||
+            std::find(m_inputNodes.begin(), m_inputNodes.end(), node) != m_inputNodes.end())
+            continue;
+
+        size_t numElements = node->GetSampleMatrixNumRows() * boundLayout->GetNumCols();
+        ValueContainer<ElemType>& vec = outputs[i].m_buffer;
+        if (vec.capacity() < numElements)
+            RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+        vec.resize(numElements);
+        outputMatrix->SetValue(node->GetSampleMatrixNumRows(), boundLayout->GetNumCols(), CPUDEVICE, vec.data(), matrixFlagDontOwnBuffer);
+        boundMatrices.push_back(outputMatrix);
+        outputBound[i] = true;
+    }
+
     for (size_t i = 0; i < m_outputNodes.size(); ++i)
     {
         auto node = m_outputNodes[i];
         m_net->ForwardProp(node);
+        if (outputBound[i]) // (the single-sequence layout is that of the inputs)
+            continue;
+
         shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
         auto pMBLayout = node->GetMBLayout();
         if (!pMBLayout)
@@ -407,6 +609,265 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs);
 }
 
+template<typename ElemType>
+IStreamingSession<ElemType>* CNTKEvalExtended<ElemType>::StartStreamingSession(const std::vector<wstring>& outputNodeNames)
+{
+    StartForwardEvaluation(outputNodeNames);
+    return new CNTKStreamingSession<ElemType>(m_net, m_inputNodes, m_outputNodes, m_inputMatrices);
+}
+
+// ------------------------------------------------------------------------
+// Streaming session
+// ------------------------------------------------------------------------
+
+// The streams of a call to ForwardChunks() are the parallel sequences of one minibatch, with gaps after the shorter
+// chunks. A stream that has state continues a sequence that began in an earlier minibatch, so the PastValue nodes
+// read its first frame's history from their carried-over value, which is set from the stored state of the streams
+// before, and stored per stream from the frame where its chunk ends after the forward pass.
+template <typename ElemType>
+CNTKStreamingSession<ElemType>::CNTKStreamingSession(ComputationNetworkPtr net, const std::vector<ComputationNodeBasePtr>& inputNodes, const std::vector<ComputationNodeBasePtr>& outputNodes,
+                                                     const StreamMinibatchInputs& inputMatrices)
+    : m_net(net), m_inputNodes(inputNodes), m_outputNodes(outputNodes), m_inputMatrices(inputMatrices), m_numSlots(0), m_nextStreamId(0)
+{
+    if (m_inputNodes.empty())
+        InvalidArgument("Streaming session: The outputs do not depend on any input.");
+    auto pMBLayout = m_inputNodes[0]->GetMBLayout();
+    for (const auto& node : m_inputNodes)
+        if (!node->HasMBLayout() || node->GetMBLayout() != pMBLayout)
+            InvalidArgument("Streaming session: Input %ls is not a sequence along the same dynamic axis as the other inputs.", node->GetName().c_str());
+    for (const auto& node : m_outputNodes)
+        if (node->GetMBLayout() != pMBLayout)
+            InvalidArgument("Streaming session: Output %ls is not a sequence along the dynamic axis of the inputs.", node->GetName().c_str());
+
+    for (const auto& output : m_outputNodes)
+    {
+        for (const auto& node : m_net->GetAllNodesForRoot(output))
+        {
+            auto recurrentNode = dynamic_pointer_cast<IRecurrentNode>(node);
+            if (recurrentNode && recurrentNode->GetRecurrenceSteppingDirection() != +1)
+                InvalidArgument("Streaming session: %ls %ls operation looks into the future, which is not available when streaming.", node->NodeName().c_str(), node->OperationName().c_str());
+            if (dynamic_pointer_cast<ICarriedOverStateNode>(node))
+            {
+                if (std::find(m_stateNodes.begin(), m_stateNodes.end(), node) == m_stateNodes.end())
+                {
+                    m_stateNodes.push_back(node);
+                    m_states.push_back(make_shared<Matrix<ElemType>>(node->GetDeviceId()));
+                }
+            }
+            else if (dynamic_pointer_cast<IStatefulNode>(node))
+                InvalidArgument("Streaming session: The state of %ls %ls operation cannot be kept per stream.", node->NodeName().c_str(), node->OperationName().c_str());
+        }
+    }
+}
+
+template <typename ElemType>
+size_t CNTKStreamingSession<ElemType>::OpenStream()
+{
+    Stream stream;
+    if (!m_freeSlots.empty())
+    {
+        stream.slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+        stream.slot = m_numSlots++;
+    stream.started = false;
+
+    size_t streamId = m_nextStreamId++;
+    m_streams[streamId] = stream;
+    return streamId;
+}
+
+template <typename ElemType>
+void CNTKStreamingSession<ElemType>::CloseStream(size_t streamId)
+{
+    auto iter = m_streams.find(streamId);
+    if (iter == m_streams.end())
+        InvalidArgument("CloseStream: There is no open stream %d.", (int) streamId);
+    m_freeSlots.push_back(iter->second.slot);
+    m_streams.erase(iter);
+}
+
+template <typename ElemType>
+size_t CNTKStreamingSession<ElemType>::GetNumFrames(const ValueBuffer<ElemType, Vector>& buffer, size_t inputIndex) const
+{
+    const auto& input = std::next(m_inputMatrices.begin(), inputIndex)->second;
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(input.matrix);
+    size_t numRows = input.sampleLayout.GetNumElements();
+    if (matrix->GetMatrixType() == MatrixType::SPARSE)
+    {
+        if (buffer.m_colIndices.size() < 2 || buffer.m_colIndices[0] != 0 || buffer.m_colIndices.back() != (int) buffer.m_indices.size() || buffer.m_indices.size() != buffer.m_buffer.size())
+            RuntimeError("Input %ls: Expected at least one frame in consistent sparse buffers.", m_inputNodes[inputIndex]->GetName().c_str());
+        return buffer.m_colIndices.size() - 1;
+    }
+    if (buffer.m_buffer.size() == 0 || buffer.m_buffer.size() % numRows != 0)
+        RuntimeError("Input %ls: Expected input data to be a nonzero multiple of %d, but it is %d.", m_inputNodes[inputIndex]->GetName().c_str(), (int) numRows, (int) buffer.m_buffer.size());
+    return buffer.m_buffer.size() / numRows;
+}
+
+template <typename ElemType>
+void CNTKStreamingSession<ElemType>::ForwardChunks(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    const size_t numStreams = streamIds.size();
+    if (inputs.size() != numStreams || outputs.size() != numStreams)
+        RuntimeError("ForwardChunks: Expected inputs and outputs for %d streams, but got %d and %d.", (int) numStreams, (int) inputs.size(), (int) outputs.size());
+    if (numStreams == 0)
+        return;
+
+    const size_t numInputs = (size_t) std::distance(m_inputMatrices.begin(), m_inputMatrices.end());
+    std::vector<Stream*> streams(numStreams);
+    std::vector<size_t> numFrames(numStreams);
+    size_t numTimeSteps = 0;
+    bool anyStarted = false;
+    for (size_t k = 0; k < numStreams; k++)
+    {
+        auto iter = m_streams.find(streamIds[k]);
+        if (iter == m_streams.end())
+            InvalidArgument("ForwardChunks: There is no open stream %d.", (int) streamIds[k]);
+        if (std::find(streams.begin(), streams.begin() + k, &iter->second) != streams.begin() + k)
+            InvalidArgument("ForwardChunks: Stream %d is passed more than once.", (int) streamIds[k]);
+        streams[k] = &iter->second;
+        anyStarted |= streams[k]->started;
+
+        if (inputs[k].size() != numInputs)
+            RuntimeError("ForwardChunks: Expected %d inputs for stream %d, but got %d.", (int) numInputs, (int) streamIds[k], (int) inputs[k].size());
+        if (outputs[k].size() != m_outputNodes.size())
+            RuntimeError("ForwardChunks: Expected %d outputs for stream %d, but got %d.", (int) m_outputNodes.size(), (int) streamIds[k], (int) outputs[k].size());
+        numFrames[k] = GetNumFrames(inputs[k][0], 0);
+        for (size_t i = 1; i < numInputs; i++)
+            if (GetNumFrames(inputs[k][i], i) != numFrames[k])
+                RuntimeError("ForwardChunks: The inputs of stream %d have different numbers of frames.", (int) streamIds[k]);
+        numTimeSteps = std::max(numTimeSteps, numFrames[k]);
+    }
+
+    // The end of a stream is not known yet; the sequence is declared to end with the chunk, which nothing that
+    // can be streamed (only looking into the past) depends on.
+    auto pMBLayout = m_inputNodes[0]->GetMBLayout();
+    pMBLayout->Init(numStreams, numTimeSteps);
+    for (size_t k = 0; k < numStreams; k++)
+    {
+        pMBLayout->AddSequence(streamIds[k], k, streams[k]->started ? -1 : 0, numFrames[k]);
+        if (numFrames[k] < numTimeSteps)
+            pMBLayout->AddGap(k, numFrames[k], numTimeSteps);
+    }
+
+    // continue from the stored state (streams without state start at a sequence begin, so their column is not read)
+    if (anyStarted)
+    {
+        std::vector<ElemType> slots(numStreams);
+        for (size_t k = 0; k < numStreams; k++)
+            slots[k] = streams[k]->started ? (ElemType) streams[k]->slot : -1;
+        for (size_t i = 0; i < m_stateNodes.size(); i++)
+        {
+            Matrix<ElemType> slotIndices(1, numStreams, slots.data(), m_states[i]->GetDeviceId());
+            Matrix<ElemType> state(m_states[i]->GetDeviceId());
+            state.DoGatherColumnsOf(0, slotIndices, *m_states[i], 1);
+            dynamic_pointer_cast<ICarriedOverStateNode>(m_stateNodes[i])->SetCarriedOverState(state);
+        }
+    }
+
+    SetInputs(streams, inputs, numFrames, numTimeSteps);
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+
+    for (size_t o = 0; o < m_outputNodes.size(); o++)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_outputNodes[o]);
+        m_net->ForwardProp(m_outputNodes[o]);
+        const size_t numRows = node->Value().GetNumRows();
+        std::unique_ptr<ElemType[]> values(node->Value().CopyToArray());
+        for (size_t k = 0; k < numStreams; k++)
+        {
+            auto& vec = outputs[k][o].m_buffer;
+            if (vec.capacity() < numFrames[k] * numRows)
+                RuntimeError("Not enough space in output buffer for output '%ls' of stream %d.", node->GetName().c_str(), (int) streamIds[k]);
+            vec.resize(numFrames[k] * numRows);
+            for (size_t t = 0; t < numFrames[k]; t++)
+                memcpy(vec.data() + t * numRows, values.get() + (t * numStreams + k) * numRows, sizeof(ElemType) * numRows);
+        }
+    }
+
+    StoreState(streams, numFrames);
+    for (const auto& stream : streams)
+        stream->started = true;
+}
+
+// Sets the input matrices to the chunks of the streams, as parallel sequences of numTimeSteps frames.
+template <typename ElemType>
+void CNTKStreamingSession<ElemType>::SetInputs(const std::vector<Stream*>& streams, const std::vector<Values<ElemType>>& inputs, const std::vector<size_t>& numFrames, size_t numTimeSteps)
+{
+    const size_t numStreams = streams.size();
+    const size_t numCols = numStreams * numTimeSteps;
+    size_t i = 0;
+    for (auto& input : m_inputMatrices)
+    {
+        shared_ptr<Matrix<ElemType>> matrix = dynamic_pointer_cast<Matrix<ElemType>>(input.second.matrix);
+        size_t numRows = input.second.sampleLayout.GetNumElements();
+
+        if (matrix->GetMatrixType() == MatrixType::DENSE)
+        {
+            std::vector<ElemType> values(numRows * numCols, 0); // gaps are zero
+            for (size_t k = 0; k < numStreams; k++)
+                for (size_t t = 0; t < numFrames[k]; t++)
+                    memcpy(values.data() + (t * numStreams + k) * numRows, inputs[k][i].m_buffer.data() + t * numRows, sizeof(ElemType) * numRows);
+            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), values.data(), matrixFlagNormal);
+        }
+        else
+        {
+            std::vector<int> colIndices(1, 0), indices;
+            std::vector<ElemType> values;
+            for (size_t t = 0; t < numTimeSteps; t++)
+            {
+                for (size_t k = 0; k < numStreams; k++)
+                {
+                    if (t < numFrames[k])
+                    {
+                        const auto& buffer = inputs[k][i];
+                        indices.insert(indices.end(), buffer.m_indices.begin() + buffer.m_colIndices[t], buffer.m_indices.begin() + buffer.m_colIndices[t + 1]);
+                        values.insert(values.end(), buffer.m_buffer.begin() + buffer.m_colIndices[t], buffer.m_buffer.begin() + buffer.m_colIndices[t + 1]);
+                    }
+                    colIndices.push_back((int) indices.size());
+                }
+            }
+            matrix->SetMatrixFromCSCFormat(colIndices.data(), indices.data(), values.data(), values.size(), numRows, numCols);
+        }
+        ++i;
+    }
+}
+
+// Keeps the carried-over value at the last frame of each stream's chunk, in the stream's slot.
+template <typename ElemType>
+void CNTKStreamingSession<ElemType>::StoreState(const std::vector<Stream*>& streams, const std::vector<size_t>& numFrames)
+{
+    const size_t numStreams = streams.size();
+    std::vector<size_t> lastColumns(numStreams);
+    for (size_t k = 0; k < numStreams; k++)
+        lastColumns[k] = (numFrames[k] - 1) * numStreams + k;
+
+    for (size_t i = 0; i < m_stateNodes.size(); i++)
+    {
+        auto& stored = m_states[i];
+        Matrix<ElemType> state(stored->GetDeviceId());
+        dynamic_pointer_cast<ICarriedOverStateNode>(m_stateNodes[i])->GetCarriedOverState(lastColumns, state);
+
+        if (stored->GetNumRows() != state.GetNumRows() || stored->GetNumCols() < m_numSlots) // streams were opened: grow, keeping the state of the others
+        {
+            auto grown = make_shared<Matrix<ElemType>>(state.GetNumRows(), m_numSlots, stored->GetDeviceId());
+            grown->SetValue(0);
+            if (stored->GetNumRows() == state.GetNumRows() && stored->GetNumCols() > 0)
+                grown->SetColumnSlice(*stored, 0, stored->GetNumCols());
+            stored = grown;
+        }
+        for (size_t k = 0; k < numStreams; k++)
+            stored->SetColumnSlice(state.ColumnSlice(k, 1), streams[k]->slot, 1);
+    }
+}
+
+template <typename ElemType>
+void CNTKStreamingSession<ElemType>::Destroy()
+{
+    delete this;
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
@@ -431,4 +892,6 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
 
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
+template class CNTKStreamingSession<double>;
+template class CNTKStreamingSession<float>;
 } } }
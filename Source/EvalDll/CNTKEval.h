@@ -90,7 +90,7 @@ template <typename ElemType>
 class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
 {
 public:
-    CNTKEvalExtended() : CNTKEvalBase<ElemType>(), m_started(false) {}
+    CNTKEvalExtended() : CNTKEvalBase<ElemType>(), m_started(false), m_quantized(false), m_zeroCopy(true) {}
 
     virtual VariableSchema GetOutputSchema() const override;
 
@@ -102,6 +102,8 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) override;
 
+    virtual IStreamingSession<ElemType>* StartStreamingSession(const std::vector<std::wstring>& outputs) override;
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -120,9 +122,55 @@ private:
     std::vector<ComputationNodeBasePtr> m_inputNodes;
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
+    bool m_quantized;
+    bool m_zeroCopy; // bind dense CPU inputs and outputs to the caller's buffers rather than copying them ('zeroCopy', default true)
+
+    void QuantizeWeightsToInt8();
+    double ForwardCalibrationData(const ConfigParameters& calibrationConfig, std::vector<std::vector<ElemType>>& outputs, size_t& numSamples);
 
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs);
 };
+
+// ------------------------------------------------------------------------
+// Streaming session: frames of many streams evaluated chunk by chunk
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKStreamingSession : public IStreamingSession<ElemType>
+{
+public:
+    CNTKStreamingSession(ComputationNetworkPtr net, const std::vector<ComputationNodeBasePtr>& inputNodes, const std::vector<ComputationNodeBasePtr>& outputNodes,
+                         const StreamMinibatchInputs& inputMatrices);
+
+    virtual size_t OpenStream() override;
+
+    virtual void CloseStream(size_t streamId) override;
+
+    virtual void ForwardChunks(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual void Destroy() override;
+
+private:
+    struct Stream
+    {
+        size_t slot;  // column of the stored state
+        bool started; // whether any frames have been evaluated, i.e. whether there is state
+    };
+
+    size_t GetNumFrames(const ValueBuffer<ElemType, Vector>& buffer, size_t inputIndex) const;
+    void SetInputs(const std::vector<Stream*>& streams, const std::vector<Values<ElemType>>& inputs, const std::vector<size_t>& numFrames, size_t numTimeSteps);
+    void StoreState(const std::vector<Stream*>& streams, const std::vector<size_t>& numFrames);
+
+    ComputationNetworkPtr m_net;
+    std::vector<ComputationNodeBasePtr> m_inputNodes;
+    std::vector<ComputationNodeBasePtr> m_outputNodes;
+    StreamMinibatchInputs m_inputMatrices;
+    std::vector<ComputationNodeBasePtr> m_stateNodes;        // the PastValue nodes, which implement ICarriedOverStateNode
+    std::vector<std::shared_ptr<Matrix<ElemType>>> m_states; // per state node, one column per slot
+    std::map<size_t, Stream> m_streams;
+    std::vector<size_t> m_freeSlots;
+    size_t m_numSlots;
+    size_t m_nextStreamId;
+};
 } } }
@@ -0,0 +1,170 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUKernels.cpp -- instruction set detection and the baseline (SSE3) kernels
+//
+
+#include "stdafx.h"
+#include "CPUKernels.h"
+#include "CPUKernelsImpl.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+void InitializeCPUKernelsSSE3(CPUKernels<float>& kernels)
+{
+    FillCPUKernels(kernels);
+}
+
+void InitializeCPUKernelsSSE3(CPUKernels<double>& kernels)
+{
+    FillCPUKernels(kernels);
+}
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+static void CPUID(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    __cpuidex((int*) regs, (int) leaf, (int) subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// register state enabled by the OS (XCR0)
+static unsigned long long XGETBV()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+// The AVX variants need both the instructions and the OS saving the wider registers on context switches.
+static CPUInstructionSet DetectCPUInstructionSet()
+{
+    unsigned int regs[4];
+    CPUID(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+    if (maxLeaf < 7)
+        return CPUInstructionSet::SSE3;
+
+    CPUID(1, 0, regs);
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx     = (regs[2] & (1u << 28)) != 0;
+    bool fma     = (regs[2] & (1u << 12)) != 0;
+    bool f16c    = (regs[2] & (1u << 29)) != 0;
+    if (!osxsave || !avx || !fma || !f16c)
+        return CPUInstructionSet::SSE3;
+
+    unsigned long long xcr0 = XGETBV();
+    bool ymmState = (xcr0 & 0x06) == 0x06; // SSE and AVX state
+    bool zmmState = (xcr0 & 0xe6) == 0xe6; // additionally opmask and upper ZMM state
+
+    CPUID(7, 0, regs);
+    bool avx2    = (regs[1] & (1u << 5)) != 0;
+    bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+    if (avx2 && avx512f && ymmState && zmmState)
+        return CPUInstructionSet::AVX512;
+    if (avx2 && ymmState)
+        return CPUInstructionSet::AVX2;
+    return CPUInstructionSet::SSE3;
+}
+#else
+static CPUInstructionSet DetectCPUInstructionSet()
+{
+    return CPUInstructionSet::SSE3;
+}
+#endif
+
+static CPUInstructionSet SelectCPUInstructionSet()
+{
+    CPUInstructionSet isa = DetectCPUInstructionSet();
+
+    // allow to lower (never raise) the instruction set, e.g. to compare results
+    const char* requested = getenv("CNTK_CPU_ISA");
+    if (requested && *requested)
+    {
+        if (_stricmp(requested, "sse3") == 0)
+            isa = CPUInstructionSet::SSE3;
+        else if (_stricmp(requested, "avx2") == 0 && isa == CPUInstructionSet::AVX512)
+            isa = CPUInstructionSet::AVX2;
+        else if (_stricmp(requested, "avx2") != 0 && _stricmp(requested, "avx512") != 0)
+            fprintf(stderr, "CNTK_CPU_ISA: unknown instruction set '%s' ignored, expected sse3, avx2 or avx512.\n", requested);
+    }
+
+    // fall back if this build has no kernels for the instruction set
+    CPUKernels<float> probe;
+    if (isa == CPUInstructionSet::AVX512 && !InitializeCPUKernelsAVX512(probe))
+        isa = CPUInstructionSet::AVX2;
+    if (isa == CPUInstructionSet::AVX2 && !InitializeCPUKernelsAVX2(probe))
+        isa = CPUInstructionSet::SSE3;
+    return isa;
+}
+
+template <class ElemType>
+static CPUKernels<ElemType> CreateCPUKernels(CPUInstructionSet isa)
+{
+    CPUKernels<ElemType> kernels;
+    switch (isa)
+    {
+    case CPUInstructionSet::AVX512:
+        InitializeCPUKernelsAVX512(kernels);
+        break;
+    case CPUInstructionSet::AVX2:
+        InitializeCPUKernelsAVX2(kernels);
+        break;
+    default:
+        InitializeCPUKernelsSSE3(kernels);
+        break;
+    }
+    return kernels;
+}
+
+// The selection and the tables are made on first use rather than when the library is loaded, so that
+// initializers of other static objects (e.g. constant matrices) can already run the kernels.
+CPUInstructionSet GetCPUInstructionSet()
+{
+    static const CPUInstructionSet isa = SelectCPUInstructionSet();
+    return isa;
+}
+
+const char* GetCPUInstructionSetName(CPUInstructionSet isa)
+{
+    switch (isa)
+    {
+    case CPUInstructionSet::AVX512:
+        return "AVX-512";
+    case CPUInstructionSet::AVX2:
+        return "AVX2";
+    default:
+        return "SSE3";
+    }
+}
+
+template <>
+const CPUKernels<float>& GetCPUKernels<float>()
+{
+    static const CPUKernels<float> kernels = CreateCPUKernels<float>(GetCPUInstructionSet());
+    return kernels;
+}
+
+template <>
+const CPUKernels<double>& GetCPUKernels<double>()
+{
+    static const CPUKernels<double> kernels = CreateCPUKernels<double>(GetCPUInstructionSet());
+    return kernels;
+}
+
+}}}
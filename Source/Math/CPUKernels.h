@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUKernels.h -- hot CPU kernels compiled for several instruction sets, selected at load time
+//
+// The library as a whole is built for SSE3 so that it runs on any x64 machine. The kernels declared here
+// are additionally compiled with AVX2 and AVX-512 code generation (CPUKernelsAVX2.cpp, CPUKernelsAVX512.cpp),
+// all from the same source in CPUKernelsImpl.h, and the widest variant the processor and OS support is used.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include "TensorShape.h"
+#include <array>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class CPUInstructionSet
+{
+    SSE3,   // baseline the library is compiled for
+    AVX2,   // AVX2, FMA and F16C
+    AVX512  // AVX-512 foundation
+};
+
+// Instruction set of the kernels in use. Detected once via CPUID; can be lowered
+// by setting the environment variable CNTK_CPU_ISA to 'sse3' or 'avx2'.
+MATH_API CPUInstructionSet GetCPUInstructionSet();
+MATH_API const char* GetCPUInstructionSetName(CPUInstructionSet isa);
+
+// Table of the kernels of one instruction set. All pointers refer to raw column-major data.
+template <class ElemType>
+struct CPUKernels
+{
+    // elementwise tensor operations with optional reduction, see CPUMatrix::TensorOp()
+    void (*unaryTensorOp)(ElemType beta, std::array<ElemType*, 2> pointers, ElemType alpha, ElementWiseOperator op,
+                          const std::array<size_t, 2>& offsets,
+                          const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                          const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
+    void (*binaryTensorOp)(ElemType beta, std::array<ElemType*, 3> pointers, ElemType alpha, ElementWiseOperator op,
+                           const std::array<size_t, 3>& offsets,
+                           const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                           const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
+    void (*ternaryTensorOp)(ElemType beta, std::array<ElemType*, 4> pointers, ElemType alpha, ElementWiseOperator op,
+                            const std::array<size_t, 4>& offsets,
+                            const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
+                            const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+
+    // column-wise log softmax of a (numRows x numCols) into us; us may be the same as a
+    void (*logSoftmaxColumns)(const ElemType* a, ElemType* us, size_t numRows, size_t numCols);
+
+    // optimizer updates on n elements, see CPUMatrix::Adagrad(), FSAdagrad() and RmsProp()
+    ElemType (*adagrad)(ElemType* accumulator, ElemType* gradients, size_t n, bool needAveMultiplier);
+    void (*fsAdagrad)(const ElemType* gradients, ElemType* smoothAda, ElemType* smoothMom, ElemType* functionValues, size_t n,
+                      ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    ElemType (*rmsProp)(ElemType* gradients, ElemType* avars, ElemType* signs, ElemType* steps, size_t n,
+                        ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                        bool needAveMultiplier);
+
+    // us = a^T * b with int8 a [k x m] (one scale per column) and b [k x n] quantized per column on the fly,
+    // with the fixed range bRange if > 0; see Int8Matrix::TransposeTimes()
+    void (*int8TransposeTimes)(const signed char* a, const ElemType* aScales, const ElemType* b, ElemType* us, size_t k, size_t m, size_t n, ElemType bRange);
+
+    // widens n fp16 values (or bf16 values if 'bfloat16') to ElemType; see HalfMatrix
+    void (*widenHalf)(const unsigned short* a, ElemType* us, size_t n, bool bfloat16);
+    // us = a * b, or a^T * b if 'transpose', with a [m x k] (or [k x m]) in fp16/bf16 and b [k x n] with few columns
+    void (*halfTimes)(const unsigned short* a, bool bfloat16, bool transpose, const ElemType* b, ElemType* us, size_t m, size_t k, size_t n);
+};
+
+// Kernels for the instruction set returned by GetCPUInstructionSet().
+template <class ElemType>
+const CPUKernels<ElemType>& GetCPUKernels();
+template <>
+const CPUKernels<float>& GetCPUKernels<float>();
+template <>
+const CPUKernels<double>& GetCPUKernels<double>();
+
+// Fill in the kernels of one instruction set. The AVX variants return false if the
+// compiler did not generate code for that instruction set; the table is then left untouched.
+// Exported for tests that compare the variants; a variant wider than GetCPUInstructionSet() must not be called.
+MATH_API void InitializeCPUKernelsSSE3(CPUKernels<float>& kernels);
+MATH_API void InitializeCPUKernelsSSE3(CPUKernels<double>& kernels);
+MATH_API bool InitializeCPUKernelsAVX2(CPUKernels<float>& kernels);
+MATH_API bool InitializeCPUKernelsAVX2(CPUKernels<double>& kernels);
+MATH_API bool InitializeCPUKernelsAVX512(CPUKernels<float>& kernels);
+MATH_API bool InitializeCPUKernelsAVX512(CPUKernels<double>& kernels);
+
+}}}
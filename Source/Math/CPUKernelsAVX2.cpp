@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUKernelsAVX2.cpp -- the kernels of CPUKernelsImpl.h, compiled for AVX2, FMA and F16C
+//
+// Like all other files, this one is compiled with the baseline flags. With gcc, only the kernels are compiled for
+// the wider instruction set (see CPUKernelsImpl.h). Visual Studio cannot do that per function, so there the kernels
+// use the AVX2 and F16C intrinsics they are written with, and are otherwise compiled for the baseline.
+//
+
+#include "CPUKernels.h"
+
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_KERNELS_AVX2
+#define CPU_KERNELS_F16C
+#define CPU_KERNELS_TARGET_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma,f16c\")")
+#define CPU_KERNELS_TARGET_END _Pragma("GCC pop_options")
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define CPU_KERNELS_AVX2
+#define CPU_KERNELS_F16C
+#endif
+
+#ifdef CPU_KERNELS_AVX2
+#include "CPUKernelsImpl.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// If the compiler cannot generate AVX2 code, these report that the variant is not available.
+#ifdef CPU_KERNELS_AVX2
+bool InitializeCPUKernelsAVX2(CPUKernels<float>& kernels)
+{
+    FillCPUKernels(kernels);
+    return true;
+}
+
+bool InitializeCPUKernelsAVX2(CPUKernels<double>& kernels)
+{
+    FillCPUKernels(kernels);
+    return true;
+}
+#else
+bool InitializeCPUKernelsAVX2(CPUKernels<float>&)
+{
+    return false;
+}
+
+bool InitializeCPUKernelsAVX2(CPUKernels<double>&)
+{
+    return false;
+}
+#endif
+
+}}}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUKernelsAVX512.cpp -- the kernels of CPUKernelsImpl.h, compiled for AVX-512 foundation, FMA and F16C (gcc)
+//
+// Like all other files, this one is compiled with the baseline flags; only the kernels are compiled for the wider
+// instruction set (see CPUKernelsImpl.h).
+// The Visual Studio toolset in use cannot generate AVX-512 code, so on Windows this variant reports itself unavailable.
+//
+
+#include "CPUKernels.h"
+
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_KERNELS_AVX512
+#define CPU_KERNELS_AVX2 // (AVX-512 foundation includes AVX2)
+#define CPU_KERNELS_F16C
+#define CPU_KERNELS_TARGET_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f,fma,f16c\")")
+#define CPU_KERNELS_TARGET_END _Pragma("GCC pop_options")
+#endif
+
+#ifdef CPU_KERNELS_AVX512
+#include "CPUKernelsImpl.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// If the compiler cannot generate AVX-512 code, these report that the variant is not available.
+#ifdef CPU_KERNELS_AVX512
+bool InitializeCPUKernelsAVX512(CPUKernels<float>& kernels)
+{
+    FillCPUKernels(kernels);
+    return true;
+}
+
+bool InitializeCPUKernelsAVX512(CPUKernels<double>& kernels)
+{
+    FillCPUKernels(kernels);
+    return true;
+}
+#else
+bool InitializeCPUKernelsAVX512(CPUKernels<float>&)
+{
+    return false;
+}
+
+bool InitializeCPUKernelsAVX512(CPUKernels<double>&)
+{
+    return false;
+}
+#endif
+
+}}}
@@ -0,0 +1,744 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUKernelsImpl.h -- source of the kernels declared in CPUKernels.h
+//
+// This file is included by one translation unit per instruction set. All of them are compiled with the baseline
+// flags; a variant defines CPU_KERNELS_TARGET_BEGIN/END to switch code generation for the kernels below (gcc
+// '#pragma GCC target'), and CPU_KERNELS_AVX2/CPU_KERNELS_F16C to enable the code written for these instruction sets.
+// The headers included here are shared with other translation units and stay outside of the switch, so that none
+// of their inline functions or template instances is compiled for a wider instruction set (the linker keeps one
+// of the copies for the whole program). The kernels are in an anonymous namespace, so that the instances of the
+// different translation units stay separate and the linker never substitutes e.g. an AVX2 one for an SSE3 one.
+//
+
+#pragma once
+
+#include <cmath> // (before TensorOps.h, which uses the C math functions without including it)
+#include "Basics.h"
+#include "CPUKernels.h"
+#include "TensorOps.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#ifdef CPU_KERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// OpenMP 4 'simd' allows the compiler to vectorize reductions, which it otherwise may not reorder.
+// Compilers with older OpenMP just compile the plain loops.
+#ifdef _MSC_VER
+#define CPU_KERNELS_PRAGMA(x) __pragma(x)
+#else
+#define CPU_KERNELS_PRAGMA(x) _Pragma(#x)
+#endif
+#if defined(_OPENMP) && _OPENMP >= 201307
+#define CPU_KERNELS_SIMD_REDUCTION(op, var) CPU_KERNELS_PRAGMA(omp simd reduction(op : var))
+#define CPU_KERNELS_PARALLEL_FOR_SIMD CPU_KERNELS_PRAGMA(omp parallel for simd)
+#else
+#define CPU_KERNELS_SIMD_REDUCTION(op, var)
+#define CPU_KERNELS_PARALLEL_FOR_SIMD CPU_KERNELS_PRAGMA(omp parallel for)
+#endif
+
+#ifdef CPU_KERNELS_TARGET_BEGIN
+CPU_KERNELS_TARGET_BEGIN
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+using std::array;
+using std::exp;
+using std::log;
+using std::sqrt;
+
+// =======================================================================
+// TensorView support
+// =======================================================================
+
+// To save time, this makes extensive use of templates and macros.
+
+// -----------------------------------------------------------------------
+// function to compute the value for a given output location (perform reduction if needed)
+// -----------------------------------------------------------------------
+
+// perform loop over reduction index m
+// This function is declared inside a wrapper struct to allow partial specialization (m = -1).
+template <class ElemType, typename OPFN, size_t N, int m>
+struct TensorOpReduction
+{
+    // reduction case (non-reduction case is specialized)
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
+        for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
+            strides[i] = reducingStrides[i][(size_t) m];
+        double /*ElemType*/ aggregate = 0;
+        for (size_t dim = reducingOpDims[(size_t) m]; dim-- > 0;)
+        {
+            // need to descend into one loop deeper
+            aggregate += TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
+            // advance the pointers
+            for (size_t i = 0; i < N - 1; i++)
+                pointers[i] += strides[i]; // note: last pointer (result) is unused and untouched here
+        }
+        return (ElemType) aggregate;
+    }
+};
+
+// perform loop over reduction index m
+// This is the specialized version for m = -1, which terminates the recursion.
+template <class ElemType, typename OPFN, size_t N>
+struct TensorOpReduction<ElemType, OPFN, N, -1>
+{
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
+                                const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
+    {
+        return opfn(pointers); // finally we are doing some work!!!
+    }
+};
+
+// -----------------------------------------------------------------------
+// perform loop over regular index k for N-nary operations (N counting the output)
+// -----------------------------------------------------------------------
+
+// perform loop over regular index k and reducing index m for N operands (counting the output)
+template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m, int k>
+struct TensorOpIteration
+{
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        // non-scalar case: still nested result loops left
+        array<ptrdiff_t, N> strides;
+        for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
+            strides[i] = regularStrides[i][(size_t) k];
+        for (size_t dim = regularOpDims[(size_t) k]; dim-- > 0;)
+        {
+            // need to descend into one loop deeper
+            TensorOpIteration<ElemType, OPFN, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            // advance the pointers
+            for (size_t i = 0; i < N; i++)
+                pointers[i] += strides[i];
+        }
+    }
+};
+
+// Special version for innermost loop with strides all being 1 and no further reduction. Compiler can use SSE.
+// This is a very common case, e.g. adding vectors or computing the Sigmoid.
+template <class ElemType, typename OPFN>
+struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
+{
+    static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn,
+                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
+    {
+        ElemType* pa = pointers[0];
+        ElemType* pb = pointers[1];
+        ElemType* pc = pointers[2];
+        size_t K = regularOpDims[0];
+        // special-case beta and alpha to allow the compiler to short-circuit it
+        if (beta != 0)
+#pragma omp parallel for
+            for (int k = 0; k < (int) K; k++)
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else if (alpha != 1)
+#pragma omp parallel for
+            for (int k = 0; k < (int) K; k++)
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else
+#pragma omp parallel for
+            for (int k = 0; k < (int) K; k++)
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
+        // TODO: The signedness of k (required for omp) causes an extra sign-extend.
+        // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
+    }
+};
+// and unary
+template <class ElemType, typename OPFN>
+struct TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
+{
+    static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn,
+                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+    {
+        ElemType* pa = pointers[0];
+        ElemType* pb = pointers[1];
+        size_t K = regularOpDims[0];
+        // special-case beta and alpha to allow the compiler to short-circuit it
+        if (beta != 0)
+#pragma omp parallel for
+            for (int k = 0; k < (int) K; k++)
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else if (alpha != 1)
+#pragma omp parallel for
+            for (int k = 0; k < (int) K; k++)
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else
+#pragma omp parallel for
+            for (int k = 0; k < (int) K; k++)
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    }
+};
+
+template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m>
+struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
+{
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+                            const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        // we are at element level for the result: perform the op (there may still be reduction)
+        ElemType val = TensorOpReduction<ElemType, OPFN, N, m>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
+        // scale
+        val *= alpha;
+        // combine with previous value in target matrix, then write it out
+        auto* pout = pointers.back();
+        if (beta != 0)
+            val += beta * *pout;
+        // save
+        *pout = val;
+        return;
+    }
+};
+
+// -----------------------------------------------------------------------
+// map runtime parameters N to template parameters
+// -----------------------------------------------------------------------
+
+// tensor operation with k+1 dimensions (-1 means scalar)
+template <class ElemType, typename OPFN, size_t N, int k>
+static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn,
+                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    size_t dims = reducingOpDims.size();
+    switch (dims)
+    {
+    case 2:
+        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    case 1:
+        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    case 0:
+    {
+        // if all leading dimensions are 1, we can let the compiler do some unrolling
+        bool leadingAllOne = true;
+        for (size_t i = 0; i < N; i++)
+            leadingAllOne &= k >= 0 && regularStrides[i][0] == 1;
+        if (leadingAllOne) // special version that uses a hard-coded increment of 1 for all leading dimensions
+            return TensorOpIteration<ElemType, OPFN, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else
+            return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    }
+    default:
+        LogicError("TensorOp: %d non-flattened reduction dimensions are not supported.", (int) dims);
+    }
+}
+
+// tensor operation, generalized in number of arguments, operation already provided as a lambda
+// This function now expands into different k.
+template <class ElemType, typename OPFN, size_t N>
+static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+                           const array<size_t, N>& offsets,
+                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                           const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
+        pointers[i] += offsets[i];
+    size_t dims = regularOpDims.size();
+    switch (dims)
+    {
+    case 4:
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 3>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    case 3:
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 2>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    case 2:
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    case 1:
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 0>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    case 0:
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, -1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    default:
+        LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int) dims);
+    }
+}
+
+// -----------------------------------------------------------------------
+// entry points from CPUMatrix::TensorOp(); map op to a lambda
+// -----------------------------------------------------------------------
+
+// perform unary operation 'op' on a giving the result, pointers = {a, result}
+template <class ElemType>
+void UnaryTensorOp(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, ElementWiseOperator op,
+                   const array<size_t, 2>& offsets,
+                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                   const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+// TODO: Change the lambda to take a pointer and a number of elements, so that we can pass it 1 or 4 elements, in order for it to SSE-vectorize.
+#define CaseUnaryTensorOp(oper)                                                        \
+    case ElementWiseOperator::op##oper:                                                \
+        return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 2>& pp) \
+                              {                                                        \
+                                  return Op##oper((*(pp[0])));                         \
+                              },                                                       \
+                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+
+    switch (op)
+    {
+        ForAllUnaryOps(CaseUnaryTensorOp);
+    default:
+        LogicError("TensorOp: Unknown unary op code %d.", (int) op);
+    }
+}
+
+// perform binary operation 'op' on a and b giving the result, pointers = {a, b, result}
+template <class ElemType>
+void BinaryTensorOp(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, ElementWiseOperator op,
+                    const array<size_t, 3>& offsets,
+                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
+{
+#define CaseBinaryTensorOp(oper)                                                       \
+    case ElementWiseOperator::op##oper:                                                \
+        return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 3>& pp) \
+                              {                                                        \
+                                  return Op##oper((*(pp[0])), (*(pp[1])));             \
+                              },                                                       \
+                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+
+    switch (op)
+    {
+        ForAllBinaryOps(CaseBinaryTensorOp);
+    default:
+        LogicError("TensorOp: Unknown op binary code %d.", (int) op);
+    }
+}
+
+// perform ternary operation 'op' on a, b and c giving the result, pointers = {a, b, c, result}
+template <class ElemType>
+void TernaryTensorOp(ElemType beta, array<ElemType*, 4> pointers, ElemType alpha, ElementWiseOperator op,
+                     const array<size_t, 4>& offsets,
+                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
+                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
+{
+#define CaseTernaryTensorOp(oper)                                                      \
+    case ElementWiseOperator::op##oper:                                                \
+        return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 4>& pp) \
+                              {                                                        \
+                                  return Op##oper((*(pp[0])), (*(pp[1])), (*(pp[2]))); \
+                              },                                                       \
+                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+
+    switch (op)
+    {
+        ForAllTernaryOps(CaseTernaryTensorOp);
+    default:
+        LogicError("TensorOp: Unknown ternary op code %d.", (int) op);
+    }
+}
+
+// =======================================================================
+// softmax
+// =======================================================================
+
+// The loops are split so that all but the exp() one can be vectorized.
+template <class ElemType>
+void LogSoftmaxColumns(const ElemType* a, ElemType* us, size_t numRows, size_t numCols)
+{
+#pragma omp parallel for
+    for (long j = 0; j < (long) numCols; j++)
+    {
+        const ElemType* pa = a + j * numRows;
+        ElemType* pus = us + j * numRows;
+
+        // we need to extract max before applying exp to avoid overflow
+        ElemType maxV = pa[0];
+        CPU_KERNELS_SIMD_REDUCTION(max, maxV)
+        for (long i = 0; i < (long) numRows; i++)
+            maxV = maxV < pa[i] ? pa[i] : maxV;
+
+        for (long i = 0; i < (long) numRows; i++)
+            pus[i] = pa[i] - maxV;
+
+        ElemType sum = 0;
+        CPU_KERNELS_SIMD_REDUCTION(+, sum)
+        for (long i = 0; i < (long) numRows; i++)
+            sum += exp(pus[i]);
+        sum = log(sum);
+
+        for (long i = 0; i < (long) numRows; i++)
+            pus[i] -= sum;
+    }
+}
+
+// =======================================================================
+// optimizer updates
+// =======================================================================
+
+template <class ElemType, bool needAveMultiplier>
+ElemType AdagradLoop(ElemType* a, ElemType* d_v, size_t n)
+{
+    const ElemType floor = 1e-16f;
+    ElemType aveMultiplier = 0;
+
+    // no omp parallel for here, aveMultiplier would need to be accumulated across threads
+    CPU_KERNELS_SIMD_REDUCTION(+, aveMultiplier)
+    for (long i = 0; i < (long) n; i++)
+    {
+        a[i] += d_v[i] * d_v[i];
+        ElemType a0 = sqrt(a[i] + floor);
+        d_v[i] /= a0;
+        if (needAveMultiplier)
+            aveMultiplier += 1 / a0;
+    }
+    return aveMultiplier;
+}
+
+template <class ElemType>
+ElemType Adagrad(ElemType* accumulator, ElemType* gradients, size_t n, bool needAveMultiplier)
+{
+    if (!needAveMultiplier)
+    {
+        AdagradLoop<ElemType, false>(accumulator, gradients, n);
+        return 1;
+    }
+
+    ElemType aveMultiplier = AdagradLoop<ElemType, true>(accumulator, gradients, n);
+    return n > 0 ? aveMultiplier / n : 1;
+}
+
+template <class ElemType>
+void FSAdagrad(const ElemType* grad, ElemType* smoothAda, ElemType* smoothMom, ElemType* val, size_t n,
+               ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    CPU_KERNELS_PARALLEL_FOR_SIMD
+    for (long i = 0; i < (long) n; i++)
+    {
+        ElemType g = grad[i];
+        ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+        smoothAda[i] = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType ada = sqrt(adaSqr);
+            ElemType w = adaMul * ((ElemType) 1.0 / ada);
+            g *= w > 10.0f ? (ElemType) 10.0f : w;
+        }
+
+        if (momentum > 0.0f)
+        {
+            g = momentum * smoothMom[i] + (1.0f - momentum) * g;
+            smoothMom[i] = g;
+        }
+
+        val[i] -= g * learnRatePerSample;
+    }
+}
+
+template <class ElemType>
+ElemType RmsProp(ElemType* curr_grad, ElemType* avars, ElemType* signs, ElemType* steps, size_t n,
+                 ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                 bool needAveMultiplier)
+{
+    const ElemType floor = 1e-6f;
+    ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+
+    // the sign is kept as ElemType, so that the loop is free of conversions and can be vectorized
+    ElemType aveMultiplier = 0;
+    CPU_KERNELS_SIMD_REDUCTION(+, aveMultiplier)
+    for (long i = 0; i < (long) n; i++)
+    {
+        avars[i] = RMS_GAMMA * avars[i] + ONE_MINUS_GAMMA * (curr_grad[i] * curr_grad[i]);
+        const ElemType grad_sign = (ElemType)(ElemType(0) < curr_grad[i]) - (ElemType)(curr_grad[i] < ElemType(0));
+
+        steps[i] = signs[i] * grad_sign > 0 ? std::min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX)
+                                            : std::max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+        ElemType a = steps[i] / sqrt(avars[i] + floor);
+        curr_grad[i] *= a;
+        signs[i] = grad_sign;
+        aveMultiplier += a;
+    }
+
+    if (needAveMultiplier)
+        return aveMultiplier / n;
+    else
+        return 1;
+}
+
+// =======================================================================
+// int8 matrix product
+// =======================================================================
+
+// Quantizes n values to int8 and returns the scale, range / 127. The range is the largest absolute value,
+// unless a fixed 'range' > 0 is given; values outside of it are clipped.
+template <class ElemType>
+ElemType QuantizeToInt8(const ElemType* v, signed char* q, size_t n, ElemType range)
+{
+    if (range <= 0)
+    {
+        range = 0;
+        CPU_KERNELS_SIMD_REDUCTION(max, range)
+        for (long i = 0; i < (long) n; i++)
+        {
+            ElemType x = v[i] < 0 ? -v[i] : v[i];
+            range = range < x ? x : range;
+        }
+        if (range == 0)
+        {
+            memset(q, 0, n);
+            return 0;
+        }
+    }
+
+    const ElemType invScale = 127 / range;
+    for (long i = 0; i < (long) n; i++)
+    {
+        ElemType x = v[i] * invScale;
+        x = x > 127 ? 127 : (x < -127 ? -127 : x);
+        q[i] = (signed char) (x < 0 ? x - (ElemType) 0.5 : x + (ElemType) 0.5);
+    }
+    return range / 127;
+}
+
+#if defined(CPU_KERNELS_AVX2) || defined(__SSE2__) || defined(_M_X64)
+inline int HorizontalSum(__m128i s)
+{
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+#endif
+#ifdef CPU_KERNELS_AVX2
+inline int HorizontalSum(__m256i v)
+{
+    return HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+#endif
+
+// int32 dot products of the int8 vector a with the NB vectors b[], n elements each.
+// 16 elements at a time are widened to int16 and multiplied and pairwise added into int32 (pmaddwd);
+// SSE2 has no sign extension of bytes, so there they are unpacked into the upper half and shifted down.
+template <size_t NB>
+void DotProductsInt8(const signed char* a, const signed char* const* b, size_t n, int* sums)
+{
+    long i = 0;
+#ifdef CPU_KERNELS_AVX2
+    __m256i acc[NB];
+    for (size_t j = 0; j < NB; j++)
+        acc[j] = _mm256_setzero_si256();
+    for (; i + 16 <= (long) n; i += 16)
+    {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (a + i)));
+        for (size_t j = 0; j < NB; j++)
+        {
+            __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (b[j] + i)));
+            acc[j] = _mm256_add_epi32(acc[j], _mm256_madd_epi16(va, vb));
+        }
+    }
+    for (size_t j = 0; j < NB; j++)
+        sums[j] = HorizontalSum(acc[j]);
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i acc[NB];
+    for (size_t j = 0; j < NB; j++)
+        acc[j] = _mm_setzero_si128();
+    for (; i + 16 <= (long) n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i vaLo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+        __m128i vaHi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+        for (size_t j = 0; j < NB; j++)
+        {
+            __m128i vb = _mm_loadu_si128((const __m128i*) (b[j] + i));
+            __m128i vbLo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+            __m128i vbHi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+            acc[j] = _mm_add_epi32(acc[j], _mm_add_epi32(_mm_madd_epi16(vaLo, vbLo), _mm_madd_epi16(vaHi, vbHi)));
+        }
+    }
+    for (size_t j = 0; j < NB; j++)
+        sums[j] = HorizontalSum(acc[j]);
+#else
+    for (size_t j = 0; j < NB; j++)
+        sums[j] = 0;
+#endif
+    for (; i < (long) n; i++)
+    {
+        short x = a[i];
+        for (size_t j = 0; j < NB; j++)
+            sums[j] += x * (short) b[j][i];
+    }
+}
+
+// us = a^T * b, with a [k x m] in int8 with one scale per column, and b [k x n], which is quantized per column first.
+// The products are accumulated in int32 (exact for k up to 2^31 / 127^2, i.e. 133,000).
+template <class ElemType>
+void Int8TransposeTimes(const signed char* a, const ElemType* aScales, const ElemType* b, ElemType* us, size_t k, size_t m, size_t n, ElemType bRange)
+{
+    std::vector<signed char> bq(k * n);
+    std::vector<ElemType> bScales(n);
+#pragma omp parallel for
+    for (long j = 0; j < (long) n; j++)
+        bScales[j] = QuantizeToInt8(b + j * k, bq.data() + j * k, k, bRange);
+
+    // Parallel over the columns of a, so that single samples also use all threads. Each column of a
+    // is multiplied with 4 columns of b at a time, so that it is read once per 4 columns.
+#pragma omp parallel for
+    for (long i = 0; i < (long) m; i++)
+    {
+        const signed char* pa = a + i * k;
+        int sums[4];
+        long j = 0;
+        for (; j + 4 <= (long) n; j += 4)
+        {
+            const signed char* pb[4] = { &bq[(j + 0) * k], &bq[(j + 1) * k], &bq[(j + 2) * k], &bq[(j + 3) * k] };
+            DotProductsInt8<4>(pa, pb, k, sums);
+            for (long jj = 0; jj < 4; jj++)
+                us[(j + jj) * m + i] = sums[jj] * aScales[i] * bScales[j + jj];
+        }
+        for (; j < (long) n; j++)
+        {
+            const signed char* pb = &bq[j * k];
+            DotProductsInt8<1>(pa, &pb, k, sums);
+            us[j * m + i] = sums[0] * aScales[i] * bScales[j];
+        }
+    }
+}
+
+// =======================================================================
+// 16-bit floating point
+// =======================================================================
+
+// Branch-free, so that the loop in WidenHalf() vectorizes: the exponent and mantissa are moved into place
+// and rebiased by multiplying with 2^(127 - 15), which also turns fp16 subnormals into normal floats.
+inline float HalfToFloat(unsigned short h)
+{
+    unsigned int bits = (unsigned int) (h & 0x7fff) << 13;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    f *= 5.192296858534828e+33f; // 2^112
+    memcpy(&bits, &f, sizeof(f));
+    if ((h & 0x7c00) == 0x7c00) // Inf and NaN
+        bits |= 0x7f800000;
+    bits |= (unsigned int) (h & 0x8000) << 16;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline float BFloat16ToFloat(unsigned short h)
+{
+    unsigned int bits = (unsigned int) h << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// With F16C (which comes with every AVX2 processor), fp16 to float is a single instruction for 8 values.
+template <class ElemType>
+void WidenHalf(const unsigned short* a, ElemType* us, size_t n, bool bfloat16)
+{
+    long i = 0;
+    if (bfloat16)
+    {
+        for (; i < (long) n; i++)
+            us[i] = BFloat16ToFloat(a[i]);
+        return;
+    }
+#ifdef CPU_KERNELS_F16C
+    if (std::is_same<ElemType, float>::value)
+    {
+        for (; i + 8 <= (long) n; i += 8)
+            _mm256_storeu_ps((float*) us + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (a + i))));
+    }
+#endif
+    for (; i < (long) n; i++)
+        us[i] = HalfToFloat(a[i]);
+}
+
+// us = a * b, or a^T * b if 'transpose', with a [m x k] (or [k x m]) in fp16/bf16 and few columns n in b [k x n].
+// This is bound by reading a, so a is read once: with 'transpose' a column of a is widened and then multiplied
+// with all columns of b; otherwise blocks of rows of us are accumulated in cache, a column piece at a time.
+template <class ElemType>
+void HalfTimes(const unsigned short* a, bool bfloat16, bool transpose, const ElemType* b, ElemType* us, size_t m, size_t k, size_t n)
+{
+    if (transpose)
+    {
+#pragma omp parallel
+        {
+            std::vector<ElemType> column(k);
+#pragma omp for
+            for (long i = 0; i < (long) m; i++)
+            {
+                WidenHalf(a + i * k, column.data(), k, bfloat16);
+                for (size_t j = 0; j < n; j++)
+                {
+                    const ElemType* pb = b + j * k;
+                    ElemType sum = 0;
+                    CPU_KERNELS_SIMD_REDUCTION(+, sum)
+                    for (long c = 0; c < (long) k; c++)
+                        sum += column[c] * pb[c];
+                    us[j * m + i] = sum;
+                }
+            }
+        }
+        return;
+    }
+
+    const size_t blockRows = 256;
+#pragma omp parallel
+    {
+        ElemType piece[blockRows];
+#pragma omp for
+        for (long block = 0; block < (long) ((m + blockRows - 1) / blockRows); block++)
+        {
+            const size_t i0 = block * blockRows;
+            const size_t rows = std::min(blockRows, m - i0);
+            for (size_t j = 0; j < n; j++)
+                memset(us + j * m + i0, 0, sizeof(ElemType) * rows);
+            for (size_t c = 0; c < k; c++)
+            {
+                WidenHalf(a + c * m + i0, piece, rows, bfloat16);
+                for (size_t j = 0; j < n; j++)
+                {
+                    const ElemType w = b[j * k + c];
+                    ElemType* pu = us + j * m + i0;
+                    for (long r = 0; r < (long) rows; r++)
+                        pu[r] += w * piece[r];
+                }
+            }
+        }
+    }
+}
+
+// =======================================================================
+// kernel table
+// =======================================================================
+
+template <class ElemType>
+void FillCPUKernels(CPUKernels<ElemType>& kernels)
+{
+    kernels.unaryTensorOp = &UnaryTensorOp<ElemType>;
+    kernels.binaryTensorOp = &BinaryTensorOp<ElemType>;
+    kernels.ternaryTensorOp = &TernaryTensorOp<ElemType>;
+    kernels.logSoftmaxColumns = &LogSoftmaxColumns<ElemType>;
+    kernels.adagrad = &Adagrad<ElemType>;
+    kernels.fsAdagrad = &FSAdagrad<ElemType>;
+    kernels.rmsProp = &RmsProp<ElemType>;
+    kernels.int8TransposeTimes = &Int8TransposeTimes<ElemType>;
+    kernels.widenHalf = &WidenHalf<ElemType>;
+    kernels.halfTimes = &HalfTimes<ElemType>;
+}
+
+} // anonymous namespace
+
+}}}
+
+#ifdef CPU_KERNELS_TARGET_END
+CPU_KERNELS_TARGET_END
+#endif
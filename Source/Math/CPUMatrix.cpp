@@ -11,6 +11,8 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "CPUKernels.h"
+#include "numahelpers.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -119,11 +121,31 @@ CPUMatrix<ElemType>::CPUMatrix()
     ZeroInit();
 }
 
+// placement of newly allocated buffers of at least numaPlacementMinBytes, see SetNumaPolicy()
+static NumaPlacement s_numaPlacement = NumaPlacement::none;
+static const size_t numaPlacementMinBytes = 1024 * 1024;
+
+// Allocates a large buffer without touching it, then zeroes it with the static schedule of the elementwise loops,
+// so that each page is placed on the NUMA node of the thread that will process it (unless interleaved before).
+template <class ElemType>
+static ElemType* NewNumaPlacedArray(size_t n)
+{
+    ElemType* p = new ElemType[n];
+    if (s_numaPlacement == NumaPlacement::interleave)
+        msra::numa::interleave(p, n * sizeof(ElemType));
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long) n; i++)
+        p[i] = 0;
+    return p;
+}
+
 // helper to allocate an array of ElemType
 // Use this instead of new[] to get NaN initialization for debugging.
 template <class ElemType>
 static ElemType* NewArray(size_t n)
 {
+    if (s_numaPlacement != NumaPlacement::none && n * sizeof(ElemType) >= numaPlacementMinBytes)
+        return NewNumaPlacedArray<ElemType>(n);
     ElemType* p = new ElemType[n]();
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
@@ -240,6 +262,19 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignColumnSlice(const CPUMatrix<Elem
     return *this;
 }
 
+// same as AssignColumnSlice(), but for re-targeting a view object over and over (e.g. once per time step):
+// Clear() would allocate a new storage object, and copying the storage reference would cost two atomic operations.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignColumnSliceView(const CPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
+{
+    if (startColumn + numCols > fromMatrix.m_numCols)
+        InvalidArgument("The slice (%d+%d) is out of range of the source matrix (%d).", (int) startColumn, (int) numCols, (int) fromMatrix.m_numCols);
+
+    ShallowCopyColumnsFrom(fromMatrix, numCols, fromMatrix.m_sliceViewOffset + startColumn * fromMatrix.m_numRows);
+
+    return *this;
+}
+
 // set this(: , startColumn:startColumn+numCols-1)= fromMatrix;
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::SetColumnSlice(const CPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
@@ -688,16 +723,51 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
     Scale(beta, us); // if beta is 0, then this will be a memset()
 
-#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows.
     foreach_column(jIn, a)
     {
-        auto jOutF = idx(0, jIn);           // this is the column we copy/add into
-        if (std::isnan(jOutF) || jOutF < 0) // negative index means gap
-            continue;
-        size_t jOut = (size_t)jOutF;
-        if (jOut >= GetNumCols())
-            InvalidArgument("DoGatherColumnsOf: Map out of bounds.");
-        ScaleAndAddColumn(/*beta=*/(ElemType)1, &us(0, jOut), &a(0, jIn), us.GetNumRows(), alpha);
+        auto jOutF = idx(0, jIn);
+        if (!std::isnan(jOutF) && jOutF >= 0 && (size_t)jOutF >= GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Map out of bounds.");
+    }
+
+    // A target column may receive several source columns. With enough rows, the threads split the rows; with few
+    // rows (e.g. scattering the gradient of a context window), they split the target columns instead, and each
+    // thread adds only the source columns that map into its own range, so no column is written by two threads.
+    const size_t rowBlock = 64;
+    const size_t numRowBlocks = (GetNumRows() + rowBlock - 1) / rowBlock;
+    if (numRowBlocks >= (size_t) omp_get_max_threads())
+    {
+#pragma omp parallel for
+        for (long i0 = 0; i0 < (long) GetNumRows(); i0 += rowBlock)
+        {
+            size_t numRows = min(rowBlock, GetNumRows() - i0);
+            foreach_column(jIn, a)
+            {
+                auto jOutF = idx(0, jIn);           // this is the column we copy/add into
+                if (std::isnan(jOutF) || jOutF < 0) // negative index means gap
+                    continue;
+                ScaleAndAddColumn(/*beta=*/(ElemType)1, &us(i0, (size_t)jOutF), &a(i0, jIn), numRows, alpha);
+            }
+        }
+    }
+    else
+    {
+#pragma omp parallel
+        {
+            const size_t numThreads = omp_get_num_threads();
+            const size_t t = omp_get_thread_num();
+            const size_t jOutBegin = GetNumCols() * t / numThreads;
+            const size_t jOutEnd = GetNumCols() * (t + 1) / numThreads;
+            foreach_column(jIn, a)
+            {
+                auto jOutF = idx(0, jIn);
+                if (std::isnan(jOutF) || jOutF < 0)
+                    continue;
+                size_t jOut = (size_t) jOutF;
+                if (jOut >= jOutBegin && jOut < jOutEnd)
+                    ScaleAndAddColumn(/*beta=*/(ElemType)1, &us(0, jOut), &a(0, jIn), GetNumRows(), alpha);
+            }
+        }
     }
 
     return *this;
@@ -886,15 +956,26 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free previous array allocation if any before overwriting
-		delete[] Buffer();
+        if (!HasExternalBuffer())
+            delete[] Buffer();
 
         m_numRows = numRows;
         m_numCols = numCols;
+        m_sliceViewOffset = 0;
         SetBuffer(pArray, GetNumElements() * sizeof(ElemType), true);
         SetSizeAllocated(GetNumElements());
     }
     else
     {
+        // a previously bound external buffer is let go rather than written to
+        if (HasExternalBuffer())
+        {
+            m_numRows = 0;
+            m_numCols = 0;
+            m_sliceViewOffset = 0;
+            SetBuffer(nullptr, 0);
+            SetSizeAllocated(0);
+        }
         RequireSize(numRows, numCols);
 
         if (!IsEmpty())
@@ -1153,8 +1234,6 @@ void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
-    ElemType aveMultiplier = 0;
-
     if (IsEmpty() || gradients.GetNumCols() != GetNumCols() || gradients.GetNumRows() != GetNumRows())
     {
         RequireSize(gradients.GetNumRows(), gradients.GetNumCols());
@@ -1163,55 +1242,7 @@ ElemType CPUMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& gradients, const bool
 
     assert(GetNumRows() == gradients.GetNumRows() && GetNumCols() == gradients.GetNumCols());
 
-    ElemType *a = Data(), *d_v = gradients.Data();
-    size_t n = GetNumElements();
-
-    const ElemType floor = 1e-16f;
-    ElemType a0, a1, a2, a3;
-
-    // disable omp here because aveMultiper needs to be added atomically. however, it seems the result is incorrect even if rmp atomic and amp critical are used.
-    // #pragma omp parallel for
-    for (long i = 0; i < (n & ~3); i += 4) // four-way unrolling
-    {
-        a[i] += d_v[i] * d_v[i];
-        a[i + 1] += d_v[i + 1] * d_v[i + 1];
-        a[i + 2] += d_v[i + 2] * d_v[i + 2];
-        a[i + 3] += d_v[i + 3] * d_v[i + 3];
-
-        a0 = sqrt(a[i] + floor);
-        a1 = sqrt(a[i + 1] + floor);
-        a2 = sqrt(a[i + 2] + floor);
-        a3 = sqrt(a[i + 3] + floor);
-
-        d_v[i] /= a0;
-        d_v[i + 1] /= a1;
-        d_v[i + 2] /= a2;
-        d_v[i + 3] /= a3;
-
-        if (needAveMultiplier)
-        {
-            aveMultiplier += 1 / a0 + 1 / a1 + 1 / a2 + 1 / a3;
-        }
-    }
-
-    // get the last few elements if any
-    for (long i = n & ~3; i < n; i++)
-    {
-        a[i] += d_v[i] * d_v[i];
-
-        a0 = sqrt(a[i] + floor);
-        d_v[i] /= a0;
-
-        if (needAveMultiplier)
-        {
-            aveMultiplier += 1 / a0;
-        }
-    }
-
-    if (needAveMultiplier && n > 0)
-        return aveMultiplier / n;
-    else
-        return 1;
+    return GetCPUKernels<ElemType>().adagrad(Data(), gradients.Data(), GetNumElements(), needAveMultiplier);
 }
 
 template <class ElemType>
@@ -1233,36 +1264,9 @@ void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
     assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
 
     size_t n = gradients.GetNumElements();
-    ElemType* grad = gradients.Data();
     ElemType* smoothAda = Data();
     ElemType* smoothMom = Data() + n;
-    ElemType* val = functionValues.Data();
-#pragma omp parallel for
-    // TODO: Unroll 4-times for better performance leveraging vectorization
-    for (long i = 0; i < n; i++)
-    {
-        ElemType g = grad[i];
-        ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
-        smoothAda[i] = adaSqr;
-        if (adaSqr != 0.0f)
-        {
-            ElemType ada = sqrt(adaSqr);
-            ElemType w = adaMul * ((ElemType) 1.0 / ada);
-
-            if (w > 10.0f)
-                w = 10.0f;
-            g *= w;
-        }
-
-        if (momentum > 0.0f)
-        {
-            g = momentum * smoothMom[i] + (1.0f - momentum) * g;
-            smoothMom[i] = g;
-        }
-
-        g *= learnRatePerSample;
-        val[i] -= g;
-    }
+    GetCPUKernels<ElemType>().fsAdagrad(gradients.Data(), smoothAda, smoothMom, functionValues.Data(), n, learnRatePerSample, momentum, adaWeight, adaMul);
 }
 
 template <class ElemType>
@@ -1274,8 +1278,6 @@ ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
                                       ElemType RMS_WGT_MIN,
                                       const bool needAveMultiplier)
 {
-    const ElemType floor = 1e-6f;
-
     size_t n = gradients.GetNumElements();
     ElemType* curr_grad = gradients.Data();
 
@@ -1302,7 +1304,6 @@ ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
 
     assert(GetNumRows() == gradients.GetNumRows() && GetNumCols() == gradients.GetNumCols() * 3);
 
-    ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
     // int upd[] = {
     //    2,2,0,
     //    2,2,0,
@@ -1336,29 +1337,7 @@ ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
     //    curr_grad[i] *= steps[i] / sqrt(avars[i] + floor);
     //      }
 
-    ElemType aveMultiplier = 0, a;
-    for (long i = 0; i < n; i++)
-    {
-        avars[i] = RMS_GAMMA * avars[i] + ONE_MINUS_GAMMA * (curr_grad[i] * curr_grad[i]);
-        const int grad_sign = (ElemType(0) < curr_grad[i]) - (curr_grad[i] < ElemType(0));
-
-        if (signs[i] * grad_sign > 0)
-            steps[i] = std::min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX);
-        else
-            steps[i] = std::max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
-
-        a = steps[i] / sqrt(avars[i] + floor);
-        curr_grad[i] *= a;
-        signs[i] = (ElemType) grad_sign;
-
-        if (needAveMultiplier)
-            aveMultiplier += a;
-    }
-
-    if (needAveMultiplier)
-        return aveMultiplier / n;
-    else
-        return 1;
+    return GetCPUKernels<ElemType>().rmsProp(curr_grad, avars, signs, steps, n, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
 }
 
 template <class ElemType>
@@ -1388,9 +1367,13 @@ void CPUMatrix<ElemType>::RequireSize(const size_t numRows, const size_t numCols
 template <class ElemType>
 void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, bool growOnly /*=true*/)
 {
+    bool sameSize = GetNumRows() == numRows && GetNumCols() == numCols;
+    if (sameSize && HasExternalBuffer()) // (a bound external buffer can thus be written by nodes; views still cannot be resized, like on the GPU)
+        return;
+
     VerifyResizable(__func__);
 
-    if (GetNumRows() == numRows && GetNumCols() == numCols)
+    if (sameSize)
         return;
 
     size_t numElements = numRows * numCols;
@@ -2264,21 +2247,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
 
     if (isColWise)
     {
-#pragma omp parallel for
-        foreach_column (j, a)
-        {
-            // we need to extract max before applying exp to avoid overflow
-            ElemType maxV = a(0, j);
-            foreach_row (i, a)
-                maxV = std::max(maxV, a(i, j));
-
-            ElemType sum = 0;
-            foreach_row (i, a)
-                sum += exp(us(i, j) = a(i, j) - maxV);
-            sum = log(sum);
-            foreach_row (i, us)
-                us(i, j) -= sum;
-        }
+        GetCPUKernels<ElemType>().logSoftmaxColumns(a.Data(), us.Data(), a.GetNumRows(), a.GetNumCols());
     }
     else
     {
@@ -4413,6 +4382,239 @@ void CPUMatrix<ElemType>::AveragePoolingBackward(const CPUMatrix<int>& mpRowCol,
     }
 }
 
+// Number of channels interleaved by the blocked pooling kernels below. 8 lanes fill one AVX register
+// (two SSE registers) for float, so the innermost per-pixel loops vectorize without gathers.
+static const size_t PoolingChannelBlock = 8;
+
+// Computes the range [begin, end) of input coordinates covered by pooling window 'o' along one dimension,
+// clipped to the input (cells in the padding are not part of the window).
+static inline void PoolingWindowRange(size_t o, size_t stride, int start, size_t kernel, size_t dim, int& begin, int& end)
+{
+    begin = (int) (o * stride) + start;
+    end = std::min(begin + (int) kernel, (int) dim);
+    begin = std::max(begin, 0);
+}
+
+// Repacks [W x H x C] samples into channel-blocked layout [block x W x H x ceil(C / block)] so that
+// the PoolingChannelBlock channels of one pixel are adjacent in memory. Unused lanes are zero-filled.
+template <class ElemType>
+static void PackChannelBlocked(const CPUMatrix<ElemType>& in, size_t channels, size_t planeSize, CPUMatrix<ElemType>& packed)
+{
+    const size_t B = PoolingChannelBlock;
+    const size_t blockCount = (channels + B - 1) / B;
+    const size_t batchSize = in.GetNumCols();
+    packed.RequireSize(planeSize * blockCount * B, batchSize);
+
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t) (batchSize * blockCount); task++)
+    {
+        size_t sample = task / blockCount;
+        size_t block = task % blockCount;
+        size_t lanes = std::min(B, channels - block * B);
+        const ElemType* src = in.Data() + sample * in.GetNumRows() + block * B * planeSize;
+        ElemType* dst = packed.Data() + sample * packed.GetNumRows() + block * B * planeSize;
+        for (size_t pix = 0; pix < planeSize; pix++, dst += B)
+        {
+            for (size_t lane = 0; lane < lanes; lane++)
+                dst[lane] = src[lane * planeSize + pix];
+            for (size_t lane = lanes; lane < B; lane++)
+                dst[lane] = 0;
+        }
+    }
+}
+
+// The blocked pooling kernels pool each channel of a [W x H x C] sample independently with a 2D window.
+// Forward work is split into (sample, channel block, output row) tasks so that even a single image keeps all
+// threads busy. Max pooling records the winning input index of every output so that backward is a plain scatter.
+template <class ElemType>
+void CPUMatrix<ElemType>::MaxPoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                                   size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                                   CPUMatrix<ElemType>& workspace, CPUMatrix<ElemType>& output, CPUMatrix<int>& argmax) const
+{
+    const size_t B = PoolingChannelBlock;
+    const size_t inPlane = inW * inH;
+    const size_t outPlane = outW * outH;
+    const size_t blockCount = (channels + B - 1) / B;
+    const size_t batchSize = GetNumCols();
+    assert(GetNumRows() == inPlane * channels);
+    assert(output.GetNumRows() == outPlane * channels && output.GetNumCols() == batchSize);
+    assert(argmax.GetNumRows() == output.GetNumRows() && argmax.GetNumCols() == batchSize);
+
+    PackChannelBlocked(*this, channels, inPlane, workspace);
+
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t) (batchSize * blockCount * outH); task++)
+    {
+        size_t sample = task / (blockCount * outH);
+        size_t block = (task / outH) % blockCount;
+        size_t oy = task % outH;
+        size_t lanes = std::min(B, channels - block * B);
+
+        const ElemType* src = workspace.Data() + sample * workspace.GetNumRows() + block * B * inPlane;
+        ElemType* dst = output.Data() + sample * output.GetNumRows() + block * B * outPlane;
+        int* dstIdx = argmax.Data() + sample * argmax.GetNumRows() + block * B * outPlane;
+
+        int y0, y1;
+        PoolingWindowRange(oy, strideH, startH, kernelH, inH, y0, y1);
+        for (size_t ox = 0; ox < outW; ox++)
+        {
+            int x0, x1;
+            PoolingWindowRange(ox, strideW, startW, kernelW, inW, x0, x1);
+
+            ElemType maxVal[B];
+            int maxPix[B];
+            for (size_t lane = 0; lane < B; lane++)
+            {
+                maxVal[lane] = -std::numeric_limits<ElemType>::infinity();
+                maxPix[lane] = y0 * (int) inW + x0;
+            }
+            for (int y = y0; y < y1; y++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    int pix = y * (int) inW + x;
+                    const ElemType* px = src + pix * B;
+                    for (size_t lane = 0; lane < B; lane++)
+                    {
+                        bool greater = px[lane] > maxVal[lane];
+                        maxVal[lane] = greater ? px[lane] : maxVal[lane];
+                        maxPix[lane] = greater ? pix : maxPix[lane];
+                    }
+                }
+            }
+
+            size_t row = oy * outW + ox;
+            for (size_t lane = 0; lane < lanes; lane++)
+            {
+                dst[lane * outPlane + row] = maxVal[lane];
+                dstIdx[lane * outPlane + row] = (int) ((block * B + lane) * inPlane) + maxPix[lane];
+            }
+        }
+    }
+}
+
+// Note: 'this' is the gradient of the pooling output; argmax comes from MaxPoolingForwardBlocked.
+template <class ElemType>
+void CPUMatrix<ElemType>::MaxPoolingBackwardBlocked(const CPUMatrix<int>& argmax, size_t channels, CPUMatrix<ElemType>& grad) const
+{
+    const size_t outPlane = GetNumRows() / channels;
+    const size_t batchSize = GetNumCols();
+    assert(argmax.GetNumRows() == GetNumRows() && argmax.GetNumCols() == batchSize);
+    assert(grad.GetNumCols() == batchSize);
+
+    // Windows within a channel plane may overlap but argmax never leaves its own plane,
+    // so planes can be processed concurrently without write conflicts.
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t) (batchSize * channels); task++)
+    {
+        size_t sample = task / channels;
+        size_t c = task % channels;
+        const ElemType* srcGrad = Data() + sample * GetNumRows() + c * outPlane;
+        const int* idx = argmax.Data() + sample * argmax.GetNumRows() + c * outPlane;
+        ElemType* dst = grad.Data() + sample * grad.GetNumRows();
+        for (size_t row = 0; row < outPlane; row++)
+        {
+            assert(0 <= idx[row] && idx[row] < grad.GetNumRows());
+            dst[idx[row]] += srcGrad[row];
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AveragePoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                                       size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                                       CPUMatrix<ElemType>& workspace, CPUMatrix<ElemType>& output) const
+{
+    const size_t B = PoolingChannelBlock;
+    const size_t inPlane = inW * inH;
+    const size_t outPlane = outW * outH;
+    const size_t blockCount = (channels + B - 1) / B;
+    const size_t batchSize = GetNumCols();
+    assert(GetNumRows() == inPlane * channels);
+    assert(output.GetNumRows() == outPlane * channels && output.GetNumCols() == batchSize);
+
+    PackChannelBlocked(*this, channels, inPlane, workspace);
+
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t) (batchSize * blockCount * outH); task++)
+    {
+        size_t sample = task / (blockCount * outH);
+        size_t block = (task / outH) % blockCount;
+        size_t oy = task % outH;
+        size_t lanes = std::min(B, channels - block * B);
+
+        const ElemType* src = workspace.Data() + sample * workspace.GetNumRows() + block * B * inPlane;
+        ElemType* dst = output.Data() + sample * output.GetNumRows() + block * B * outPlane;
+
+        int y0, y1;
+        PoolingWindowRange(oy, strideH, startH, kernelH, inH, y0, y1);
+        for (size_t ox = 0; ox < outW; ox++)
+        {
+            int x0, x1;
+            PoolingWindowRange(ox, strideW, startW, kernelW, inW, x0, x1);
+
+            ElemType sum[B];
+            for (size_t lane = 0; lane < B; lane++)
+                sum[lane] = 0;
+            for (int y = y0; y < y1; y++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    const ElemType* px = src + (y * (int) inW + x) * B;
+                    for (size_t lane = 0; lane < B; lane++)
+                        sum[lane] += px[lane];
+                }
+            }
+
+            // Same as the reference implementation: divide by the number of cells that are not padding.
+            ElemType count = (ElemType) ((y1 - y0) * (x1 - x0));
+            size_t row = oy * outW + ox;
+            for (size_t lane = 0; lane < lanes; lane++)
+                dst[lane * outPlane + row] = sum[lane] / count;
+        }
+    }
+}
+
+// Note: 'this' is the gradient of the pooling output.
+template <class ElemType>
+void CPUMatrix<ElemType>::AveragePoolingBackwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                                        size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                                        CPUMatrix<ElemType>& grad) const
+{
+    const size_t inPlane = inW * inH;
+    const size_t outPlane = outW * outH;
+    const size_t batchSize = GetNumCols();
+    assert(GetNumRows() == outPlane * channels);
+    assert(grad.GetNumRows() == inPlane * channels && grad.GetNumCols() == batchSize);
+
+    // As in max pooling backward, overlapping windows only conflict within a channel plane.
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t) (batchSize * channels); task++)
+    {
+        size_t sample = task / channels;
+        size_t c = task % channels;
+        const ElemType* srcGrad = Data() + sample * GetNumRows() + c * outPlane;
+        ElemType* dst = grad.Data() + sample * grad.GetNumRows() + c * inPlane;
+        for (size_t oy = 0; oy < outH; oy++)
+        {
+            int y0, y1;
+            PoolingWindowRange(oy, strideH, startH, kernelH, inH, y0, y1);
+            for (size_t ox = 0; ox < outW; ox++)
+            {
+                int x0, x1;
+                PoolingWindowRange(ox, strideW, startW, kernelW, inW, x0, x1);
+                ElemType g = srcGrad[oy * outW + ox] / (ElemType) ((y1 - y0) * (x1 - x0));
+                for (int y = y0; y < y1; y++)
+                {
+                    ElemType* px = dst + y * (int) inW;
+                    for (int x = x0; x < x1; x++)
+                        px[x] += g;
+                }
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor,
                                                     CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runInvStdDev, CPUMatrix<ElemType>& out, double epsilon,
@@ -6030,226 +6232,91 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     return numThreads;
 }
 
-// =======================================================================
-// TensorView support
-// =======================================================================
-
-// To save time, this makes extensive use of templates and macros.
-
-// -----------------------------------------------------------------------
-// function to compute the value for a given output location (perform reduction if needed)
-// -----------------------------------------------------------------------
-
-// perform loop over reduction index m
-// This function is declared inside a wrapper struct to allow partial specialization (m = -1).
-template <class ElemType, typename OPFN, size_t N, int m>
-struct TensorOpReduction
+// Sets the number of threads of the operations that the calling thread starts, e.g. when several threads run computations
+// concurrently and share the cores. OpenMP and MKL keep this per thread; the ACML and OpenBLAS thread counts are
+// process-wide and are left unchanged.
+// note: this function does not depend on the <ElemType> parameter
+template <class ElemType>
+int CPUMatrix<ElemType>::SetNumThreadsForCurrentThread(int numThreads)
 {
-    // reduction case (non-reduction case is specialized)
-    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
-                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
-    {
-        array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
-        for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
-            strides[i] = reducingStrides[i][(size_t) m];
-        double /*ElemType*/ aggregate = 0;
-        for (size_t dim = reducingOpDims[(size_t) m]; dim-- > 0;)
-        {
-            // need to descend into one loop deeper
-            aggregate += TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
-            // advance the pointers
-            for (size_t i = 0; i < N - 1; i++)
-                pointers[i] += strides[i]; // note: last pointer (result) is unused and untouched here
-        }
-        return (ElemType) aggregate;
-    }
-};
+#ifdef _OPENMP
+    int previous = omp_get_max_threads();
+    omp_set_num_threads(numThreads);
+#ifdef USE_MKL
+    mkl_set_num_threads_local(numThreads);
+#endif
+    return previous;
+#else
+    numThreads;
+    return 1;
+#endif
+}
 
-// perform loop over reduction index m
-// This is the specialized version for m = -1, which terminates the recursion.
-template <class ElemType, typename OPFN, size_t N>
-struct TensorOpReduction<ElemType, OPFN, N, -1>
+// Binds the OpenMP threads to NUMA nodes and sets the placement of large buffers allocated from now on; reports both with the topology.
+// Thread t of n is bound to node t * nodes / n, so that the contiguous index ranges of a statically scheduled loop,
+// and thus the pages first touched by them, stay on one node.
+// The threads are those of the team of the calling thread, which is itself thread 0 of it; a host that calls us from
+// a thread of its own passes bindCallingThread = false, so that only the OpenMP worker threads are bound, and thread 0
+// stays wherever the host's scheduling puts it. (Teams of other threads of the host are not affected either way.)
+// note: this function does not depend on the <ElemType> parameter
+template <class ElemType>
+void CPUMatrix<ElemType>::SetNumaPolicy(bool bindThreads, NumaPlacement placement, bool bindCallingThread)
 {
-    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
-                                const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
+    const size_t numNodes = msra::numa::getnumnodes();
+    vector<size_t> cpuNodes; // nodes that have processors
+    for (size_t node = 0; node < numNodes; node++)
     {
-        return opfn(pointers); // finally we are doing some work!!!
+        size_t numCpus = msra::numa::getnodecpus(node).size();
+        if (numCpus > 0)
+            cpuNodes.push_back(node);
+        fprintf(stderr, "NUMA node %d: %d logical processors\n", (int) node, (int) numCpus);
     }
-};
 
-// -----------------------------------------------------------------------
-// perform loop over regular index k for N-nary operations (N counting the output)
-// -----------------------------------------------------------------------
-
-// perform loop over regular index k and reducing index m for N operands (counting the output)
-template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m, int k>
-struct TensorOpIteration
-{
-    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
-                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    if (bindThreads && cpuNodes.size() > 1)
     {
-        // non-scalar case: still nested result loops left
-        array<ptrdiff_t, N> strides;
-        for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
-            strides[i] = regularStrides[i][(size_t) k];
-        for (size_t dim = regularOpDims[(size_t) k]; dim-- > 0;)
+        vector<int> threadNodes(omp_get_max_threads(), -1);
+#pragma omp parallel
         {
-            // need to descend into one loop deeper
-            TensorOpIteration<ElemType, OPFN, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-            // advance the pointers
-            for (size_t i = 0; i < N; i++)
-                pointers[i] += strides[i];
+            int t = omp_get_thread_num();
+            size_t node = cpuNodes[t * cpuNodes.size() / omp_get_num_threads()];
+            if (t < (int) threadNodes.size() && (t > 0 || bindCallingThread) && msra::numa::bindcurrentthreadtonode(node))
+                threadNodes[t] = (int) node;
         }
+        for (size_t node : cpuNodes)
+            fprintf(stderr, "NUMA node %d: %d threads bound\n", (int) node, (int) count(threadNodes.begin(), threadNodes.end(), (int) node));
+        size_t numUnbound = count(threadNodes.begin(), threadNodes.end(), -1) - (bindCallingThread ? 0 : 1);
+        if (!bindCallingThread)
+            fprintf(stderr, "SetNumaPolicy: the calling thread is not bound\n");
+        if (numUnbound > 0)
+            fprintf(stderr, "SetNumaPolicy: %d threads could not be bound\n", (int) numUnbound);
     }
-};
-
-// Special version for innermost loop with strides all being 1 and no further reduction. Compiler can use SSE.
-// This is a very common case, e.g. adding vectors or computing the Sigmoid.
-template <class ElemType, typename OPFN>
-struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
-{
-    static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn,
-                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
-    {
-        ElemType* pa = pointers[0];
-        ElemType* pb = pointers[1];
-        ElemType* pc = pointers[2];
-        size_t K = regularOpDims[0];
-        // special-case beta and alpha to allow the compiler to short-circuit it
-        if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
-        // TODO: The signedness of k (required for omp) causes an extra sign-extend.
-        // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
-    }
-};
-// and unary
-template <class ElemType, typename OPFN>
-struct TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
-{
-    static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn,
-                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
-    {
-        ElemType* pa = pointers[0];
-        ElemType* pb = pointers[1];
-        size_t K = regularOpDims[0];
-        // special-case beta and alpha to allow the compiler to short-circuit it
-        if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    }
-};
+    else if (bindThreads)
+        fprintf(stderr, "SetNumaPolicy: single NUMA node, threads are not bound\n");
 
-template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m>
-struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
-{
-    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
-                            const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
-    {
-        // we are at element level for the result: perform the op (there may still be reduction)
-        ElemType val = TensorOpReduction<ElemType, OPFN, N, m>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
-        // scale
-        val *= alpha;
-        // combine with previous value in target matrix, then write it out
-        auto* pout = pointers.back();
-        if (beta != 0)
-            val += beta * *pout;
-        // save
-        *pout = val;
-        return;
+#ifndef __unix__
+    if (placement == NumaPlacement::interleave)
+    {
+        fprintf(stderr, "SetNumaPolicy: interleaving is not supported on this platform, using first-touch placement\n");
+        placement = NumaPlacement::firstTouch;
     }
-};
+#endif
+    s_numaPlacement = placement;
+    fprintf(stderr, "NUMA placement of CPU matrices of %d bytes or more: %s\n", (int) numaPlacementMinBytes,
+            placement == NumaPlacement::interleave ? "interleave" : placement == NumaPlacement::firstTouch ? "firstTouch" : "none");
+}
 
-// -----------------------------------------------------------------------
-// map runtime parameters N to template parameters
-// -----------------------------------------------------------------------
+// =======================================================================
+// TensorView support
+// =======================================================================
 
-// tensor operation with k+1 dimensions (-1 means scalar)
-template <class ElemType, typename OPFN, size_t N, int k>
-static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn,
-                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
-{
-    size_t dims = reducingOpDims.size();
-    switch (dims)
-    {
-    case 2:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    case 1:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    case 0:
-    {
-        // if all leading dimensions are 1, we can let the compiler do some unrolling
-        bool leadingAllOne = true;
-        for (size_t i = 0; i < N; i++)
-            leadingAllOne &= k >= 0 && regularStrides[i][0] == 1;
-        if (leadingAllOne) // special version that uses a hard-coded increment of 1 for all leading dimensions
-            return TensorOpIteration<ElemType, OPFN, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else
-            return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    }
-    default:
-        LogicError("TensorOp: %d non-flattened reduction dimensions are not supported.", (int) dims);
-    }
-}
+// The loops are in CPUKernelsImpl.h, compiled once per instruction set.
 
-// tensor operation, generalized in number of arguments, operation already provided as a lambda
-// This function now expands into different k.
-template <class ElemType, typename OPFN, size_t N>
-static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
-                           const array<size_t, N>& offsets,
-                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-                           const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
-{
-    for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
-        pointers[i] += offsets[i];
-    size_t dims = regularOpDims.size();
-    switch (dims)
-    {
-    case 4:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 3>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    case 3:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 2>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    case 2:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    case 1:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 0>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    case 0:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, -1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-    default:
-        LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int) dims);
-    }
-}
 
 // -----------------------------------------------------------------------
-// entry points from Matrix.cpp; also map op to a lambda
+// entry points from Matrix.cpp
 // -----------------------------------------------------------------------
 
 // perform unary operation 'op' on a giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
-// This maps 'op' to a lambda.
 template <class ElemType>
 void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 2>& offsets,
@@ -6259,26 +6326,11 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     if (reductionOp != ElementWiseOperator::opSum) // TODO: enable the reduction ops
         InvalidArgument("TensorOp: Unary reduction operations other than opSum not yet implemented.");
 
-// TODO: Change the lambda to take a pointer and a number of elements, so that we can pass it 1 or 4 elements, in order for it to SSE-vectorize.
-#define CaseUnaryTensorOp(oper)                                                        \
-    case ElementWiseOperator::op##oper:                                                \
-        return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 2>& pp) \
-                              {                                                        \
-                                  return Op##oper((*(pp[0])));                         \
-                              },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
-
     array<ElemType*, 2> pointers = {a.Data(), Data()};
-    switch (op)
-    {
-        ForAllUnaryOps(CaseUnaryTensorOp);
-    default:
-        LogicError("TensorOp: Unknown unary op code %d.", (int) op);
-    }
+    GetCPUKernels<ElemType>().unaryTensorOp(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 // perform binary operation 'op' on a and b giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
-// This maps 'op' to a lambda.
 template <class ElemType>
 void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 3>& offsets,
@@ -6288,25 +6340,11 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     if (reductionOp != ElementWiseOperator::opSum)
         InvalidArgument("TensorOp (binary): The only permitted binary reduction operation is opSum.");
 
-#define CaseBinaryTensorOp(oper)                                                       \
-    case ElementWiseOperator::op##oper:                                                \
-        return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 3>& pp) \
-                              {                                                        \
-                                  return Op##oper((*(pp[0])), (*(pp[1])));             \
-                              },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
-
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
-    switch (op)
-    {
-        ForAllBinaryOps(CaseBinaryTensorOp);
-    default:
-        LogicError("TensorOp: Unknown op binary code %d.", (int) op);
-    }
+    GetCPUKernels<ElemType>().binaryTensorOp(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 // perform ternary operation 'op' on a, and c giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
-// This maps 'op' to a lambda.
 template <class ElemType>
 void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 4>& offsets,
@@ -6316,21 +6354,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     if (reductionOp != ElementWiseOperator::opSum)
         InvalidArgument("TensorOp: The only permitted ternary reduction operation is opSum.");
 
-#define CaseTernaryTensorOp(oper)                                                      \
-    case ElementWiseOperator::op##oper:                                                \
-        return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 4>& pp) \
-                              {                                                        \
-                                  return Op##oper((*(pp[0])), (*(pp[1])), (*(pp[2]))); \
-                              },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
-
     array<ElemType*, 4> pointers = {a.Data(), b.Data(), c.Data(), Data()};
-    switch (op)
-    {
-        ForAllTernaryOps(CaseTernaryTensorOp);
-    default:
-        LogicError("TensorOp: Unknown ternary op code %d.", (int) op);
-    }
+    GetCPUKernels<ElemType>().ternaryTensorOp(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 // =======================================================================
@@ -27,6 +27,25 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 double logadd(double x, double y);
 
+// placement of large CPU matrix buffers on the NUMA nodes, see CPUMatrix::SetNumaPolicy()
+enum class NumaPlacement
+{
+    none,       // zeroed by the allocating thread, i.e. all pages on its node
+    firstTouch, // zeroed by all threads, each page on the node of the thread that processes it in elementwise loops
+    interleave  // pages spread round-robin across all nodes (Linux only), e.g. for weights read by all threads
+};
+
+static inline NumaPlacement ParseNumaPlacement(const std::wstring& s)
+{
+    if (EqualCI(s, L"none"))
+        return NumaPlacement::none;
+    else if (EqualCI(s, L"firstTouch"))
+        return NumaPlacement::firstTouch;
+    else if (EqualCI(s, L"interleave"))
+        return NumaPlacement::interleave;
+    InvalidArgument("Invalid NUMA placement '%ls', must be none, firstTouch, or interleave.", s.c_str());
+}
+
 //To compy with BLAS libraries matrices are stored in ColMajor. However, by default C/C++/C# use RowMajor
 //convertion is need when passing data between CPUMatrix and C++ matrices
 template <class ElemType>
@@ -45,6 +64,7 @@ class MATH_API CPUMatrix : public BaseMatrix<ElemType>
     using Base::ZeroValues;
     using Base::m_sob;
     using Base::ShallowCopyFrom;
+    using Base::ShallowCopyColumnsFrom;
     using Base::VerifyResizable;
 
 public:
@@ -84,6 +104,7 @@ public:
 
     CPUMatrix<ElemType> ColumnSlice(size_t startColumn, size_t numCols) const;
     CPUMatrix<ElemType>& AssignColumnSlice(const CPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols);
+    CPUMatrix<ElemType>& AssignColumnSliceView(const CPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols); // like AssignColumnSlice() but without reallocating the storage reference
     CPUMatrix<ElemType>& SetColumnSlice(const CPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols);
 
     void CopyColumnsStrided(const CPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride);
@@ -373,6 +394,19 @@ public:
     void AveragePoolingBackward(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices,
                                 CPUMatrix<ElemType>& grad) const;
 
+    // Pooling of [W x H x C] samples with a 2D window per channel, using a channel-blocked copy of the input kept in workspace.
+    // startW/startH are the input coordinates of the first window cell, negative when the input is padded.
+    void MaxPoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                  size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                  CPUMatrix<ElemType>& workspace, CPUMatrix<ElemType>& output, CPUMatrix<int>& argmax) const;
+    void MaxPoolingBackwardBlocked(const CPUMatrix<int>& argmax, size_t channels, CPUMatrix<ElemType>& grad) const;
+    void AveragePoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                      size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                      CPUMatrix<ElemType>& workspace, CPUMatrix<ElemType>& output) const;
+    void AveragePoolingBackwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                       size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                       CPUMatrix<ElemType>& grad) const;
+
     void BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor, CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runInvStdDev,
                                    CPUMatrix<ElemType>& out, double epsilon, CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev) const;
     void BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
@@ -380,6 +414,8 @@ public:
 
 public:
     static int SetNumThreads(int numThreads); // note: this does not depend on <ElemType>, i.e. you can call it on any <ElemType>
+    static int SetNumThreadsForCurrentThread(int numThreads); // (same; only for operations started by the calling thread; returns the previous number)
+    static void SetNumaPolicy(bool bindThreads, NumaPlacement placement, bool bindCallingThread = true); // (same; call after SetNumThreads())
 
     // static BLAS functions
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
@@ -243,7 +243,8 @@ void CPUSparseMatrix<ElemType>::SetValue(const size_t row, const size_t col, con
     }
 	// Note we don't have m_nz anymore. In order for the change from m_nz to
     // NzCount to make sense, we need to propogate nz+1 to all col slices.
-    for (size_t max = c + 1; max < m_numCols + 1; max++)
+    size_t outerDim = (GetFormat() == matrixFormatSparseCSC) ? m_numCols : m_numRows;
+    for (size_t max = c + 1; max < outerDim + 1; max++)
     {
         SecondaryIndexLocation()[max] = CPUSPARSE_INDEX_TYPE(nz + 1);
     }
@@ -659,8 +660,70 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+// Index structure of a CSC/CSR matrix as seen by a product: 'start' holds the compressed index
+// (nz range of each outer position), 'index' and 'value' are addressed by those ranges minus 'base'.
+template <class ElemType>
+struct CompressedIndexView
+{
+    const CPUSPARSE_INDEX_TYPE* start;
+    const CPUSPARSE_INDEX_TYPE* index;
+    const ElemType* value;
+    size_t base;
+};
+
+// Returns the structure of a CSC/CSR matrix compressed along its columns (byColumn) or its rows.
+// If that is not how the matrix is stored, the index is transposed into the given buffers with a counting sort,
+// which keeps the indices within each outer position sorted.
+template <class ElemType>
+static CompressedIndexView<ElemType> GetCompressedIndex(const CPUSparseMatrix<ElemType>& a, bool byColumn,
+                                                        vector<CPUSPARSE_INDEX_TYPE>& startBuffer, vector<CPUSPARSE_INDEX_TYPE>& indexBuffer, vector<ElemType>& valueBuffer)
+{
+    if (a.GetFormat() != matrixFormatSparseCSC && a.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
+    const bool isCSC = a.GetFormat() == matrixFormatSparseCSC;
+    const CPUSPARSE_INDEX_TYPE* start = a.SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* index = a.MajorIndexLocation();
+    const ElemType* value = a.Data();
+    // The compressed index holds positions in the whole buffer, index and value start at the first one of the view.
+    const size_t base = start[0];
+    if (isCSC == byColumn)
+        return CompressedIndexView<ElemType>{start, index, value, base};
+
+    const size_t outerDim = isCSC ? a.GetNumCols() : a.GetNumRows();
+    const size_t innerDim = isCSC ? a.GetNumRows() : a.GetNumCols();
+    const size_t nz = start[outerDim] - base;
+
+    startBuffer.assign(innerDim + 1, 0);
+    indexBuffer.resize(nz);
+    valueBuffer.resize(nz);
+    for (size_t p = 0; p < nz; p++)
+        startBuffer[index[p] + 1]++;
+    for (size_t i = 0; i < innerDim; i++)
+        startBuffer[i + 1] += startBuffer[i];
+
+    vector<CPUSPARSE_INDEX_TYPE> next(startBuffer.begin(), startBuffer.end() - 1);
+    for (size_t j = 0; j < outerDim; j++)
+    {
+        for (size_t p = start[j] - base; p < start[j + 1] - base; p++)
+        {
+            size_t q = next[index[p]]++;
+            indexBuffer[q] = (CPUSPARSE_INDEX_TYPE) j;
+            valueBuffer[q] = value[p];
+        }
+    }
+    return CompressedIndexView<ElemType>{startBuffer.data(), indexBuffer.data(), valueBuffer.data(), 0};
+}
+
+// Number of rows of the output updated by one task of the sparse products below; the block of an output column
+// stays in L1 while all nonzeros contributing to it are accumulated.
+static const size_t SparseProductRowBlock = 256;
+
 // c = alpha*op(lhs) * op(rhs) + beta*c
 // dense x sparse = dense
+// Works on op(rhs) compressed by columns (transposing the index if rhs is stored the other way), so every
+// output column is the weighted sum of the columns of op(lhs) selected by its nonzeros. The output is split
+// into (column, row block) tasks which do not share any element, so no synchronization is needed.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
@@ -685,66 +748,129 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
     else
         c.VerifySize(m, n); // Can't resize if beta != 0
 
-
-    if (beta == 0)
+    // Columns of op(rhs) are the columns of rhs, or its rows if transposed.
+    vector<CPUSPARSE_INDEX_TYPE> startBuffer, indexBuffer;
+    vector<ElemType> valueBuffer;
+    const auto b = GetCompressedIndex(rhs, !transposeB, startBuffer, indexBuffer, valueBuffer);
+
+    // op(lhs)(h, i) is at a[h * aRowStep + i * aColStep].
+    const ElemType* a = lhs.Data();
+    const size_t aRowStep = transposeA ? lhs.GetNumRows() : 1;
+    const size_t aColStep = transposeA ? 1 : lhs.GetNumRows();
+    ElemType* cData = c.Data();
+    const size_t ldc = c.GetNumRows();
+
+    const size_t rowBlocks = (m + SparseProductRowBlock - 1) / SparseProductRowBlock;
+#pragma omp parallel for schedule(dynamic, 4)
+    for (int64_t task = 0; task < (int64_t) n * (int64_t) rowBlocks; task++)
     {
-        memset(c.Buffer(), 0, sizeof(ElemType) * c.GetNumElements());
-    }
-    else if (beta != 1)
-    {
-#pragma omp parallel for
-        foreach_coord (i, j, c)
+        const size_t j = task / rowBlocks;
+        const size_t h0 = (task % rowBlocks) * SparseProductRowBlock;
+        const size_t h1 = min(h0 + SparseProductRowBlock, (size_t) m);
+        ElemType* cj = cData + j * ldc;
+
+        if (beta == 0)
+            memset(cj + h0, 0, sizeof(ElemType) * (h1 - h0));
+        else if (beta != 1)
         {
-            c(i, j) = beta * c(i, j);
+            for (size_t h = h0; h < h1; h++)
+                cj[h] *= beta;
         }
-    }
 
-    if (rhs.GetFormat() != matrixFormatSparseCSC)
-        NOT_IMPLEMENTED;
-
-    if (!transposeA && !transposeB)
-    {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        size_t p = b.start[j] - b.base;
+        const size_t end = b.start[j + 1] - b.base;
+        if (aRowStep == 1)
         {
-            size_t start = rhs.SecondaryIndexLocation()[j]; // ColLocation
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
-            for (size_t p = start; p < end; p++)
+            // Four nonzeros per pass over the output block to cut its loads and stores.
+            for (; p + 4 <= end; p += 4)
             {
-                size_t i = rhs.MajorIndexLocation()[p]; // RowLocation
-                ElemType val = rhs.Buffer()[p];
-
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, j) += alpha * lhs(h, i) * val;
-                }
+                const ElemType* a0 = a + b.index[p] * aColStep;
+                const ElemType* a1 = a + b.index[p + 1] * aColStep;
+                const ElemType* a2 = a + b.index[p + 2] * aColStep;
+                const ElemType* a3 = a + b.index[p + 3] * aColStep;
+                const ElemType v0 = alpha * b.value[p], v1 = alpha * b.value[p + 1], v2 = alpha * b.value[p + 2], v3 = alpha * b.value[p + 3];
+                for (size_t h = h0; h < h1; h++)
+                    cj[h] += v0 * a0[h] + v1 * a1[h] + v2 * a2[h] + v3 * a3[h];
+            }
+            for (; p < end; p++)
+            {
+                const ElemType* a0 = a + b.index[p] * aColStep;
+                const ElemType v0 = alpha * b.value[p];
+                for (size_t h = h0; h < h1; h++)
+                    cj[h] += v0 * a0[h];
             }
         }
-    }
-    else if (!transposeA && transposeB)
-    {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        else
         {
-            size_t start = rhs.SecondaryIndexLocation()[j];
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
-
-            for (size_t p = start; p < end; p++)
+            for (; p < end; p++)
             {
-                size_t i = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, i) += alpha * lhs(h, j) * val;
-                }
+                const ElemType* a0 = a + b.index[p] * aColStep;
+                const ElemType v0 = alpha * b.value[p];
+                for (size_t h = h0; h < h1; h++)
+                    cj[h] += v0 * a0[h * aRowStep];
             }
         }
     }
-    else if (transposeA && !transposeB)
+}
+
+// c = alpha*op(lhs) * op(rhs) + beta*c
+// sparse x dense = dense
+// Works on op(lhs) compressed by rows (transposing the index if lhs is stored the other way), so every output
+// element is a sparse dot product of a row of op(lhs) with a column of op(rhs). The output is split into
+// (column, row block) tasks.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
+
+    int m = transposeA ? (int) lhs.GetNumCols() : (int) lhs.GetNumRows();
+    int k = transposeA ? (int) lhs.GetNumRows() : (int) lhs.GetNumCols();
+    int l = transposeB ? (int) rhs.GetNumCols() : (int) rhs.GetNumRows();
+    int n = transposeB ? (int) rhs.GetNumRows() : (int) rhs.GetNumCols();
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
+    assert(k == l);
+    if (k != l)
     {
-        NOT_IMPLEMENTED;
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
     }
+
+    if (beta == 0)
+        c.RequireSize(m, n);
     else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    // Rows of op(lhs) are the rows of lhs, or its columns if transposed.
+    vector<CPUSPARSE_INDEX_TYPE> startBuffer, indexBuffer;
+    vector<ElemType> valueBuffer;
+    const auto a = GetCompressedIndex(lhs, transposeA, startBuffer, indexBuffer, valueBuffer);
+
+    // op(rhs)(i, j) is at b[i * bRowStep + j * bColStep].
+    const ElemType* b = rhs.Data();
+    const size_t bRowStep = transposeB ? rhs.GetNumRows() : 1;
+    const size_t bColStep = transposeB ? 1 : rhs.GetNumRows();
+    ElemType* cData = c.Data();
+    const size_t ldc = c.GetNumRows();
+
+    const size_t rowBlocks = (m + SparseProductRowBlock - 1) / SparseProductRowBlock;
+#pragma omp parallel for schedule(dynamic, 4)
+    for (int64_t task = 0; task < (int64_t) n * (int64_t) rowBlocks; task++)
     {
-        NOT_IMPLEMENTED;
+        const size_t j = task / rowBlocks;
+        const size_t h0 = (task % rowBlocks) * SparseProductRowBlock;
+        const size_t h1 = min(h0 + SparseProductRowBlock, (size_t) m);
+        ElemType* cj = cData + j * ldc;
+        const ElemType* bj = b + j * bColStep;
+
+        for (size_t h = h0; h < h1; h++)
+        {
+            ElemType sum = 0;
+            for (size_t p = a.start[h] - a.base; p < a.start[h + 1] - a.base; p++)
+                sum += a.value[p] * bj[a.index[p] * bRowStep];
+            cj[h] = (beta == 0 ? 0 : beta * cj[h]) + alpha * sum;
+        }
     }
 }
 
@@ -774,7 +900,12 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a and b must match.");
     }
 
-    c.Reset();
+    // A block-column c that already has blocks (e.g. the gradient of a parameter that is used more than once) is added to.
+    const bool accumulate = c.GetFormat() == matrixFormatSparseBlockCol && c.GetBlockSize() > 0;
+    if (!accumulate)
+        c.Reset();
+    else if (c.GetNumRows() != m || c.GetNumCols() != n)
+        InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The dimensions of c must match those of the product.");
 
     if (!transposeA && !transposeB)
     {
@@ -782,49 +913,57 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
     }
     else if (!transposeA && transposeB)
     {
-        if (rhs.GetFormat() != matrixFormatSparseCSC)
-            NOT_IMPLEMENTED;
-
-        // allocate enough memory
-        c.SetFormat(matrixFormatSparseBlockCol);
-        c.RequireSizeAndAllocate(m, n, m * min(n, rhs.NzCount()), true, false);
+        // The columns of op(rhs) are the rows of rhs (e.g. words), each nonempty one becomes a block of c.
+        // Going through the row-compressed index yields the block ids in increasing order.
+        vector<CPUSPARSE_INDEX_TYPE> startBuffer, indexBuffer;
+        vector<ElemType> valueBuffer;
+        const auto b = GetCompressedIndex(rhs, false, startBuffer, indexBuffer, valueBuffer);
+
+        // when accumulating, the columns c already has blocks for are kept, at their old block index
+        const size_t numOldBlocks = accumulate ? c.GetBlockSize() : 0;
+        vector<size_t> oldBlockIndex(accumulate ? n : 0, SIZE_MAX);
+        for (size_t j = 0; j < numOldBlocks; j++)
+            oldBlockIndex[c.GetBlockIds()[j]] = j;
+
+        vector<size_t> blockCols;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (b.start[i + 1] != b.start[i] || (accumulate && oldBlockIndex[i] != SIZE_MAX))
+                blockCols.push_back(i);
+        }
 
-        map<size_t, size_t> w2Id;
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        { // j ranges over batches
-            size_t start = rhs.SecondaryIndexLocation()[j];
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
+        // If columns are added, c is rebuilt with all block ids in increasing order, from a copy of its old blocks.
+        // Otherwise the blocks are added into where they are.
+        const bool inPlace = accumulate && blockCols.size() == numOldBlocks;
+        vector<ElemType> oldBlocks;
+        if (accumulate && !inPlace)
+            oldBlocks.assign(c.Buffer(), c.Buffer() + numOldBlocks * m);
+        if (!inPlace)
+        {
+            c.SetFormat(matrixFormatSparseBlockCol);
+            c.RequireSizeAndAllocate(m, n, m * blockCols.size(), true, false);
+            for (size_t j = 0; j < blockCols.size(); j++)
+                c.GetBlockIds()[j] = blockCols[j];
+            c.SetBlockSize(blockCols.size());
+        }
 
-            for (size_t p = start; p < end; p++)
+        const ElemType* a = lhs.Data();
+        const size_t lda = lhs.GetNumRows();
+#pragma omp parallel for
+        for (long j = 0; j < (long) blockCols.size(); j++)
+        {
+            const size_t oldBlock = accumulate ? oldBlockIndex[blockCols[j]] : SIZE_MAX;
+            ElemType* block = c.Buffer() + (inPlace ? oldBlock : j) * m;
+            if (oldBlock == SIZE_MAX)
+                memset(block, 0, sizeof(ElemType) * m);
+            else if (!inPlace)
+                memcpy(block, oldBlocks.data() + oldBlock * m, sizeof(ElemType) * m);
+            for (size_t p = b.start[blockCols[j]] - b.base; p < b.start[blockCols[j] + 1] - b.base; p++)
             {
-                size_t i = rhs.MajorIndexLocation()[p]; // i ranges over words
-                ElemType val = rhs.Buffer()[p];  // 1 for(i, j)
-
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
-                {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
-                    c.GetBlockIds()[c.GetBlockSize()] = i;
-                    c.SetBlockSize(c.GetBlockSize() + 1);
-                }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.Buffer()[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.Buffer()[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
+                const ElemType* aj = a + b.index[p] * lda;
+                const ElemType v = alpha * b.value[p];
+                for (size_t h = 0; h < m; h++)
+                    block[h] += v * aj[h];
             }
         }
         if (c.GetBlockSize() * m > c.GetSizeAllocated())
@@ -875,7 +1014,9 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
     }
     else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < lhs.GetBlockSize(); j++)
+        // blocks hold distinct columns (rows), so they can be added in parallel
+#pragma omp parallel for
+        for (long j = 0; j < lhs.GetBlockSize(); j++)
         {
             size_t i = lhs.GetBlockIds()[j] - lhs.GetBlockIdShift();
             size_t len = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
@@ -934,7 +1075,8 @@ void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemTyp
 
     if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < GetBlockSize(); j++)
+#pragma omp parallel for
+        for (long j = 0; j < GetBlockSize(); j++)
         {
             size_t i = GetBlockIds()[j] - GetBlockIdShift();
             size_t len = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
@@ -997,10 +1139,11 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
     else if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
         size_t len = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
-        size_t p = 0;
+#pragma omp parallel for reduction(+ : aveMultiplier)
         for (long j = 0; j < GetBlockSize(); j++)
         {
             size_t colOrRow = GetBlockIds()[j] - GetBlockIdShift();
+            size_t p = j * len;
             for (long i = 0; i < len; i++, p++)
             {
                 ElemType val = Buffer()[p];
@@ -1024,6 +1167,153 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// FSAdagrad update of the columns present in a block-column gradient (this); see CPUMatrix::FSAdagrad.
+// c holds the smoothed squared gradients followed by the smoothed gradients, each of the size of functionValues.
+// The smoothed state of the columns absent from the gradient is left as is instead of being decayed.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                          ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || c.GetNumCols() < numColsNeeded)
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for
+    for (long j = 0; j < GetBlockSize(); j++)
+    {
+        size_t offset = (GetBlockIds()[j] - GetBlockIdShift()) * len;
+        ElemType* grad = Buffer() + j * len;
+        for (size_t i = offset; i < offset + len; i++)
+        {
+            ElemType g = grad[i - offset];
+            ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+            smoothAda[i] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType ada = sqrt(adaSqr);
+                ElemType w = adaMul * ((ElemType) 1.0 / ada);
+
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[i] + (1.0f - momentum) * g;
+                smoothMom[i] = g;
+            }
+
+            val[i] -= learnRatePerSample * g;
+        }
+    }
+}
+
+// Applies to one column of parameters the regularization of 'steps' updates in which its gradient was zero:
+// each step shrinks it by the factor (1 - l2Decay) and soft-thresholds it by l1Threshold.
+// Exact for plain SGD; the L2 shrinking is applied before the L1 thresholding when both are used.
+template <class ElemType>
+static void CatchUpColumn(ElemType* w, size_t len, size_t steps, ElemType l2Decay, ElemType l1Threshold)
+{
+    if (steps == 0)
+        return;
+    if (l2Decay > 0)
+    {
+        ElemType scale = (ElemType) pow(1 - (double) l2Decay, (double) steps);
+        for (size_t i = 0; i < len; i++)
+            w[i] *= scale;
+    }
+    if (l1Threshold > 0)
+    {
+        ElemType threshold = l1Threshold * steps;
+        for (size_t i = 0; i < len; i++)
+        {
+            if (w[i] > threshold)
+                w[i] -= threshold;
+            else if (w[i] < -threshold)
+                w[i] += threshold;
+            else
+                w[i] = 0;
+        }
+    }
+}
+
+// Lazy regularization with a block-column gradient (this): only the columns present in the gradient are regularized.
+// lastUpdate[col] is the update step through which column col of functionValues has been regularized. The steps missed
+// since then are caught up with the given per-step decay and threshold, then the L2 term of the current step is added
+// to the gradient. The caller marks the columns as up to date with SoftThresholdBlocks() after the update.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::RegularizeBlocks(CPUMatrix<ElemType>& functionValues, const std::vector<size_t>& lastUpdate, size_t step,
+                                                 ElemType l2Decay, ElemType l1Threshold, ElemType l2Weight)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+    if (lastUpdate.size() != GetNumCols() || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("RegularizeBlocks: The dimensions of the gradient, the parameters and the update steps must match.");
+
+    size_t len = GetNumRows();
+#pragma omp parallel for
+    for (long j = 0; j < GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        ElemType* w = functionValues.Data() + col * len;
+        CatchUpColumn(w, len, step - 1 - min(lastUpdate[col], step - 1), l2Decay, l1Threshold);
+        if (l2Weight > 0)
+        {
+            ElemType* grad = Buffer() + j * len;
+            for (size_t i = 0; i < len; i++)
+                grad[i] += l2Weight * w[i];
+        }
+    }
+}
+
+// Proximal L1 step for the columns present in a block-column gradient (this), after the parameter update of the given step.
+// Also records these columns as regularized through that step, see RegularizeBlocks().
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SoftThresholdBlocks(CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step, ElemType l1Threshold) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t len = GetNumRows();
+#pragma omp parallel for
+    for (long j = 0; j < GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        CatchUpColumn<ElemType>(functionValues.Data() + col * len, len, 1, 0, l1Threshold);
+        lastUpdate[col] = step;
+    }
+}
+
+// Applies the regularization missed by all columns of functionValues since their last update, so that the parameters
+// are up to date through the given step (e.g. before they are saved or evaluated). See RegularizeBlocks().
+template <class ElemType>
+/*static*/ void CPUSparseMatrix<ElemType>::CatchUpRegularization(CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step,
+                                                              ElemType l2Decay, ElemType l1Threshold)
+{
+    if (lastUpdate.size() != functionValues.GetNumCols())
+        LogicError("CatchUpRegularization: The number of update steps must match the number of columns.");
+
+    size_t len = functionValues.GetNumRows();
+#pragma omp parallel for
+    for (long col = 0; col < (long) lastUpdate.size(); col++)
+    {
+        CatchUpColumn(functionValues.Data() + col * len, len, step - min(lastUpdate[col], step), l2Decay, l1Threshold);
+        lastUpdate[col] = step;
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -119,6 +119,9 @@ public:
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
 
+    static void MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
+
     static void MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c);
 
@@ -202,6 +205,14 @@ public:
 public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+
+    // lazy regularization of the parameter columns present in a block-column gradient
+    void RegularizeBlocks(CPUMatrix<ElemType>& functionValues, const std::vector<size_t>& lastUpdate, size_t step,
+                          ElemType l2Decay, ElemType l1Threshold, ElemType l2Weight);
+    void SoftThresholdBlocks(CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step, ElemType l1Threshold) const;
+    static void CatchUpRegularization(CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step,
+                                      ElemType l2Decay, ElemType l1Threshold);
 
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
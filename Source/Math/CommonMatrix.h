@@ -561,6 +561,19 @@ protected:
         *this = other;
     }
 
+    // re-target this object to a column range of 'other' (metadata only, like ShallowCopyFrom())
+    // The storage object is only re-assigned if it differs, so that moving a view within the same matrix
+    // does not touch its reference count.
+    void ShallowCopyColumnsFrom(const BaseMatrix& other, size_t numCols, size_t sliceViewOffset)
+    {
+        m_numRows         = other.m_numRows;
+        m_numCols         = numCols;
+        m_sliceViewOffset = sliceViewOffset;
+        m_colStride       = other.m_colStride;
+        if (m_sob != other.m_sob)
+            m_sob = other.m_sob;
+    }
+
 protected:
 
     size_t m_numRows;
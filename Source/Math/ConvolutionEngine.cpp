@@ -68,7 +68,7 @@ void ConvolutionEngine<ElemType>::BackwardKernel(const Mat& srcGrad, const Mat&
 }
 
 template <class ElemType>
-void ConvolutionEngine<ElemType>::ForwardPooling(const Mat& in, Mat& out)
+void ConvolutionEngine<ElemType>::ForwardPooling(const Mat& in, Mat& out, int* argmax)
 {
     const auto& g = *m_geometry;
     assert(g.InputShape().GetNumElements() == in.GetNumRows());
@@ -82,11 +82,11 @@ void ConvolutionEngine<ElemType>::ForwardPooling(const Mat& in, Mat& out)
 
     EnsureCompatible();
     EnsurePoolingInitialized();
-    ForwardPoolingCore(in, out);
+    ForwardPoolingCore(in, out, argmax);
 }
 
 template <class ElemType>
-void ConvolutionEngine<ElemType>::BackwardPooling(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad)
+void ConvolutionEngine<ElemType>::BackwardPooling(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* argmax)
 {
     const auto& g = *m_geometry;
     assert(g.InputShape().GetNumElements() == grad.GetNumRows());
@@ -104,7 +104,7 @@ void ConvolutionEngine<ElemType>::BackwardPooling(const Mat& out, const Mat& src
 
     EnsureCompatible();
     EnsurePoolingInitialized();
-    BackwardPoolingCore(out, srcGrad, in, grad);
+    BackwardPoolingCore(out, srcGrad, in, grad, argmax);
 }
 
 template <class ElemType>
@@ -201,7 +201,7 @@ protected:
         }
     }
 
-    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    void ForwardPoolingCore(const Mat& in, Mat& out, int* /*argmax*/) override
     {
         if (m_poolKind == PoolKind::Max)
         {
@@ -216,7 +216,7 @@ protected:
 
     }
 
-    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* /*argmax*/) override
     {
         if (m_poolKind == PoolKind::Max)
         {
@@ -488,7 +488,7 @@ protected:
     {
     }
 
-    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    void ForwardPoolingCore(const Mat& in, Mat& out, int* /*argmax*/) override
     {
         if (m_poolKind == PoolKind::Max)
         {
@@ -506,7 +506,7 @@ protected:
             InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
     }
 
-    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* /*argmax*/) override
     {
         if (m_poolKind == PoolKind::Max)
         {
@@ -550,7 +550,8 @@ private:
 // This engine supports arbitrary convolution configuration with full
 // sharing and implemented using unroll + GEMM technique 
 // (High performance convolutional neural networks for document processing; Chellapilla, Puri, Simard)
-// Uses reference engine for pooling operations.
+// Pooling with a 2D window applied to each channel independently (the common case in image networks)
+// uses channel-blocked CPU kernels, other pooling configurations use reference engine.
 //------------------------------------------------------------------
 template <class ElemType>
 class GemmConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
@@ -561,7 +562,8 @@ public:
 
 public:
     GemmConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
-        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind),
+        m_poolingChecked(false), m_poolWorkspace(deviceId), m_poolOutput(deviceId)
     {
     }
 
@@ -574,6 +576,7 @@ protected:
     using Base::m_deviceId;
     using Base::m_imageLayout;
     using Base::m_maxTempMemSizeInSamples;
+    using Base::m_poolKind;
 
     using Base::m_mpRowCol;
     using Base::m_mpRowIwht;
@@ -839,12 +842,133 @@ protected:
         }
 }
 
+    // Blocked pooling requires [W x H] or [W x H x C] input with a window that does not span channels.
+    // The window position is described by the input coordinates of the first window cell which are
+    // recovered from the reference maps: MpRowCol[0] is the input cell aligned with the center of the first window.
+    void EnsurePoolingInitialized() override
+    {
+        Base::EnsurePoolingInitialized();
+        if (m_poolingChecked)
+            return;
+        m_poolingChecked = true;
+
+        const auto& inT = m_geometry->InputShape();
+        const auto& outT = m_geometry->OutputShape();
+        const auto& kernT = m_geometry->KernelShape();
+        size_t dimCount = inT.GetRank();
+        if (dimCount != 2 && dimCount != 3)
+            return;
+        if (m_geometry->MapCount().GetNumElements() != 1)
+            return;
+        if (dimCount == 3 && (kernT[2] != 1 || m_geometry->GetStride(2) != 1 || outT[2] != inT[2]))
+            return;
+
+        auto dims = std::make_unique<BlockedPoolingDims>();
+        dims->channels = dimCount == 3 ? inT[2] : 1;
+        dims->inW = inT[0];
+        dims->inH = inT[1];
+        dims->outW = outT[0];
+        dims->outH = outT[1];
+        dims->kernelW = kernT[0];
+        dims->kernelH = kernT[1];
+        dims->strideW = m_geometry->GetStride(0);
+        dims->strideH = m_geometry->GetStride(1);
+        int col = m_geometry->MpRowCol()[0];
+        dims->startW = col % (int)dims->inW - ((int)dims->kernelW - 1) / 2;
+        dims->startH = (col / (int)dims->inW) % (int)dims->inH - ((int)dims->kernelH - 1) / 2;
+        m_blockedPooling = std::move(dims);
+    }
+
+    void ForwardPoolingCore(const Mat& in, Mat& out, int* argmax) override
+    {
+        if (m_blockedPooling == nullptr)
+        {
+            Base::ForwardPoolingCore(in, out, argmax);
+            return;
+        }
+
+        const auto& d = *m_blockedPooling;
+        if (m_poolKind == PoolKind::Max)
+        {
+            // Without the caller's storage, the positions are not kept (backward then finds them again).
+            if (argmax == nullptr)
+            {
+                m_argmax.resize(out.GetNumElements());
+                argmax = m_argmax.data();
+            }
+            Matrix<int> argmaxMat(out.GetNumRows(), out.GetNumCols(), argmax, m_deviceId, matrixFlagDontOwnBuffer);
+            in.MaxPoolingForwardBlocked(d.channels, d.inW, d.inH, d.outW, d.outH, d.kernelW, d.kernelH, d.strideW, d.strideH,
+                                        d.startW, d.startH, m_poolWorkspace, out, argmaxMat);
+        }
+        else if (m_poolKind == PoolKind::Average)
+        {
+            in.AveragePoolingForwardBlocked(d.channels, d.inW, d.inH, d.outW, d.outH, d.kernelW, d.kernelH, d.strideW, d.strideH,
+                                            d.startW, d.startH, m_poolWorkspace, out);
+        }
+        else
+            InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
+    }
+
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* argmax) override
+    {
+        if (m_blockedPooling == nullptr)
+        {
+            Base::BackwardPoolingCore(out, srcGrad, in, grad, argmax);
+            return;
+        }
+
+        const auto& d = *m_blockedPooling;
+        if (m_poolKind == PoolKind::Max)
+        {
+            // Unlike the reference engine, only the first maximum in a window receives the gradient (same as cuDNN).
+            // Without the positions recorded by the forward pass, they are found again from the input.
+            if (argmax == nullptr)
+            {
+                m_argmax.resize(out.GetNumElements());
+                m_poolOutput.Resize(out.GetNumRows(), out.GetNumCols());
+                Matrix<int> argmaxMat(out.GetNumRows(), out.GetNumCols(), m_argmax.data(), m_deviceId, matrixFlagDontOwnBuffer);
+                in.MaxPoolingForwardBlocked(d.channels, d.inW, d.inH, d.outW, d.outH, d.kernelW, d.kernelH, d.strideW, d.strideH,
+                                            d.startW, d.startH, m_poolWorkspace, m_poolOutput, argmaxMat);
+                argmax = m_argmax.data();
+            }
+            Matrix<int> argmaxMat(out.GetNumRows(), out.GetNumCols(), const_cast<int*>(argmax), m_deviceId, matrixFlagDontOwnBuffer);
+            srcGrad.MaxPoolingBackwardBlocked(argmaxMat, d.channels, grad);
+        }
+        else if (m_poolKind == PoolKind::Average)
+        {
+            srcGrad.AveragePoolingBackwardBlocked(d.channels, d.inW, d.inH, d.outW, d.outH, d.kernelW, d.kernelH, d.strideW, d.strideH,
+                                                  d.startW, d.startH, grad);
+        }
+        else
+            InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
+    }
+
 public:
     static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
     {
         return deviceId < 0 &&
                find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing());
     }
+
+private:
+    struct BlockedPoolingDims
+    {
+        size_t channels;
+        size_t inW, inH;
+        size_t outW, outH;
+        size_t kernelW, kernelH;
+        size_t strideW, strideH;
+        int startW, startH;
+    };
+
+    bool m_poolingChecked;
+    // Not null if the pooling geometry is supported by the blocked kernels.
+    std::unique_ptr<BlockedPoolingDims> m_blockedPooling;
+    // Channel-blocked copy of the pooling input.
+    Mat m_poolWorkspace;
+    // Positions of the maxima for max pooling without the caller's storage, and the outputs found with them.
+    std::vector<int> m_argmax;
+    Mat m_poolOutput;
 };
 
 template <class ElemType>
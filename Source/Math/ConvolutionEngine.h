@@ -51,14 +51,20 @@ public:
 
     void BackwardKernel(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool allowReuse, Mat& workspace);
 
-    void ForwardPooling(const Mat& in, Mat& out);
+    // 'argmax', if not null, is caller-owned storage of one int per element of 'out', in which max pooling forward
+    // may record the position of each maximum; backward of the same output then reads them from there, so the
+    // caller (e.g. a node, for the frames it pools) pairs each backward with its own forward. Engines that do not
+    // need the positions ignore it.
+    void ForwardPooling(const Mat& in, Mat& out, int* argmax = nullptr);
 
-    void BackwardPooling(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad);
+    void BackwardPooling(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* argmax = nullptr);
 
     void MaxUnpooling(const Mat& out, const Mat& poolIn, Mat& in);
 
     std::shared_ptr<const ConvolveGeometry> Geometry() const { return m_geometry; }
 
+    PoolKind GetPoolKind() const { return m_poolKind; }
+
     static std::unique_ptr<ConvolutionEngine<ElemType>> Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout,
                                                                size_t maxTempMemSizeInSamples, PoolKind poolKind = PoolKind::None, 
                                                                ConvolutionEngineKind enabledEngines = ConvolutionEngineKind::All,
@@ -91,9 +97,9 @@ protected:
 
     virtual void EnsurePoolingInitialized() = 0;
 
-    virtual void ForwardPoolingCore(const Mat& in, Mat& out) = 0;
+    virtual void ForwardPoolingCore(const Mat& in, Mat& out, int* argmax) = 0;
 
-    virtual void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) = 0;
+    virtual void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* argmax) = 0;
 
     virtual void MaxUnpoolingCore(const Mat& out, const Mat& poolIn, Mat& in) = 0;
 
@@ -289,7 +289,7 @@ protected:
             m_pool = std::make_unique<CuDnnPool>(*m_geometry, m_poolKind);
     }
 
-    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    void ForwardPoolingCore(const Mat& in, Mat& out, int* /*argmax*/) override
     {
         size_t batchSize = in.GetNumCols();
         m_inT.UpdateBatchSize(batchSize);
@@ -297,7 +297,7 @@ protected:
         CUDNN_CALL(cudnnPoolingForward(*m_cudnn, *(m_pool), &C::One, m_inT, ptr(in), &C::Zero, m_outT, ptr(out)));
     }
 
-    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, const int* /*argmax*/) override
     {
         size_t batchSize = in.GetNumCols();
         m_inT.UpdateBatchSize(batchSize);
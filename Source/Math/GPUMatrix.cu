@@ -564,6 +564,18 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignColumnSlice(const GPUMatrix<Elem
     return *this;
 }
 
+// same as AssignColumnSlice(), for re-targeting a view object without allocating (see CPUMatrix::AssignColumnSliceView())
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignColumnSliceView(const GPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
+{
+    if (startColumn + numCols > fromMatrix.GetNumCols())
+        InvalidArgument("The slice (%d+%d) is out of range of the source matrix (%d).", (int) startColumn, (int) numCols, (int) fromMatrix.GetNumCols());
+
+    ShallowCopyColumnsFrom(fromMatrix, numCols, fromMatrix.m_sliceViewOffset + startColumn * fromMatrix.GetNumRows());
+
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::SetColumnSlice(const GPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
 {
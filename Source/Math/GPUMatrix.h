@@ -112,6 +112,7 @@ class MATH_API GPUMatrix : public BaseMatrix<ElemType>
     using Base::ZeroValues;
     using Base::m_sob;
     using Base::ShallowCopyFrom;
+    using Base::ShallowCopyColumnsFrom;
     using Base::ReleaseStorageMemory;
     using Base::GetSizeAllocated;
     using Base::SetSizeAllocated;
@@ -182,6 +183,7 @@ public:
 public:
     GPUMatrix<ElemType> ColumnSlice(size_t startColumn, size_t numCols) const;
     GPUMatrix<ElemType>& AssignColumnSlice(const GPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols);
+    GPUMatrix<ElemType>& AssignColumnSliceView(const GPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols); // like AssignColumnSlice() but without reallocating the storage reference
     GPUMatrix<ElemType>& SetColumnSlice(const GPUMatrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols);
 
     void CopyColumnsStrided(const GPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride);
@@ -0,0 +1,255 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "HalfMatrix.h"
+#include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
+#include "CPUKernels.h"
+#include "HalfFloat.h"
+#include <cstring>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+HalfPrecisionFormat ParseHalfPrecisionFormat(const std::wstring& s)
+{
+    if (EqualCI(s, L"float") || EqualCI(s, L"none"))
+        return HalfPrecisionFormat::None;
+    else if (EqualCI(s, L"fp16") || EqualCI(s, L"float16"))
+        return HalfPrecisionFormat::Float16;
+    else if (EqualCI(s, L"bf16") || EqualCI(s, L"bfloat16"))
+        return HalfPrecisionFormat::BFloat16;
+    InvalidArgument("'%ls' is not a parameter storage format, expected 'float', 'fp16' or 'bf16'.", s.c_str());
+}
+
+const wchar_t* HalfPrecisionFormatName(HalfPrecisionFormat format)
+{
+    switch (format)
+    {
+    case HalfPrecisionFormat::Float16:
+        return L"fp16";
+    case HalfPrecisionFormat::BFloat16:
+        return L"bf16";
+    default:
+        return L"float";
+    }
+}
+
+template <class ElemType>
+HalfMatrix<ElemType>::HalfMatrix()
+    : m_numRows(0), m_numCols(0), m_format(HalfPrecisionFormat::Float16)
+{
+}
+
+template <class ElemType>
+void HalfMatrix<ElemType>::Assign(const Matrix<ElemType>& a, HalfPrecisionFormat format)
+{
+    if (format == HalfPrecisionFormat::None)
+        LogicError("HalfMatrix::Assign: A 16-bit format is required.");
+
+    std::unique_ptr<ElemType[]> values(a.CopyToArray()); // (works for any device)
+    const size_t n = a.GetNumElements();
+    auto data = std::make_shared<std::vector<unsigned short>>(n);
+    unsigned short* p = data->data();
+    if (format == HalfPrecisionFormat::Float16)
+    {
+#pragma omp parallel for
+        for (long i = 0; i < (long) n; i++)
+            p[i] = FloatToHalf((float) values[i]);
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long i = 0; i < (long) n; i++)
+            p[i] = FloatToBFloat16((float) values[i]);
+    }
+
+    m_numRows = a.GetNumRows();
+    m_numCols = a.GetNumCols();
+    m_format = format;
+    m_data = data;
+}
+
+template <class ElemType>
+void HalfMatrix<ElemType>::CopyTo(Matrix<ElemType>& a) const
+{
+    CPUMatrix<ElemType> values(m_numRows, m_numCols);
+    WidenColumns(0, m_numCols, values.Data());
+    a.SetValue(m_numRows, m_numCols, a.GetDeviceId(), values.Data(), matrixFlagNormal);
+}
+
+template <class ElemType>
+HalfMatrix<ElemType> HalfMatrix<ElemType>::Reshaped(size_t numRows, size_t numCols) const
+{
+    if (numRows * numCols != GetNumElements())
+        InvalidArgument("HalfMatrix::Reshaped: Cannot reshape a %d x %d matrix to %d x %d.", (int) m_numRows, (int) m_numCols, (int) numRows, (int) numCols);
+    HalfMatrix<ElemType> reshaped = *this;
+    reshaped.m_numRows = numRows;
+    reshaped.m_numCols = numCols;
+    return reshaped;
+}
+
+template <class ElemType>
+void HalfMatrix<ElemType>::WidenColumns(size_t firstCol, size_t numCols, ElemType* us) const
+{
+    const auto widenHalf = GetCPUKernels<ElemType>().widenHalf;
+    const bool bfloat16 = m_format == HalfPrecisionFormat::BFloat16;
+    const unsigned short* a = Data() + firstCol * m_numRows;
+    const size_t n = numCols * m_numRows;
+
+    // in pieces of 4096 elements, so that single columns of large matrices are still widened in parallel
+    const size_t pieceSize = 4096;
+#pragma omp parallel for
+    for (long piece = 0; piece < (long) ((n + pieceSize - 1) / pieceSize); piece++)
+    {
+        size_t begin = piece * pieceSize;
+        widenHalf(a + begin, us + begin, std::min(pieceSize, n - begin), bfloat16);
+    }
+}
+
+// Products with few columns are bound by reading this, and are done by a kernel that reads it only once.
+// Otherwise the product is computed for blocks of rows of us at a time: the part of this that contributes to
+// them is widened into a buffer of about 256K elements, which is then passed to the regular GEMM. So the widened
+// elements are used from cache right away, and the full-precision matrix never exists as a whole.
+template <class ElemType>
+void HalfMatrix<ElemType>::Times(const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& us, bool transpose) const
+{
+    const size_t m = transpose ? m_numCols : m_numRows;
+    const size_t k = transpose ? m_numRows : m_numCols;
+    const size_t n = b.GetNumCols();
+    if (b.GetNumRows() != k)
+        InvalidArgument("HalfMatrix::Times: The inner dimensions %d and %d do not match.", (int) k, (int) b.GetNumRows());
+
+    us.RequireSize(m, n);
+    if (m == 0 || n == 0)
+        return;
+
+    if (n <= 8)
+    {
+        GetCPUKernels<ElemType>().halfTimes(Data(), m_format == HalfPrecisionFormat::BFloat16, transpose, b.Data(), us.Data(), m, k, n);
+        return;
+    }
+
+    const size_t blockRows = std::min(m, std::max((size_t) 16, (size_t) 262144 / std::max(k, (size_t) 1)));
+    std::vector<ElemType> widened(blockRows * k);
+    CPUMatrix<ElemType> usBlock;
+    for (size_t i0 = 0; i0 < m; i0 += blockRows)
+    {
+        const size_t rows = std::min(blockRows, m - i0);
+
+        // widen the rows i0.. of this, or with 'transpose' its columns i0..
+        if (transpose)
+            WidenColumns(i0, rows, widened.data());
+        else
+        {
+            const auto widenHalf = GetCPUKernels<ElemType>().widenHalf;
+            const bool bfloat16 = m_format == HalfPrecisionFormat::BFloat16;
+#pragma omp parallel for
+            for (long c = 0; c < (long) k; c++)
+                widenHalf(Data() + c * m_numRows + i0, widened.data() + c * rows, rows, bfloat16);
+        }
+        CPUMatrix<ElemType> aBlock(transpose ? k : rows, transpose ? rows : k, widened.data(), matrixFlagDontOwnBuffer);
+
+        if (rows == m) // all of us at once
+        {
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, aBlock, transpose, b, false, 0, us);
+            break;
+        }
+        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, aBlock, transpose, b, false, 0, usBlock);
+        const ElemType* pBlock = usBlock.Data();
+        ElemType* pus = us.Data();
+#pragma omp parallel for
+        for (long j = 0; j < (long) n; j++)
+            memcpy(pus + j * m + i0, pBlock + j * rows, sizeof(ElemType) * rows);
+    }
+}
+
+template <class ElemType>
+void HalfMatrix<ElemType>::Times(const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& us) const
+{
+    if (b.GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+    if (b.GetNumRows() != m_numCols)
+        InvalidArgument("HalfMatrix::Times: The inner dimensions %d and %d do not match.", (int) m_numCols, (int) b.GetNumRows());
+
+    us.RequireSize(m_numRows, b.GetNumCols());
+    ElemType* pus = us.Data();
+    const auto widenHalf = GetCPUKernels<ElemType>().widenHalf;
+    const bool bfloat16 = m_format == HalfPrecisionFormat::BFloat16;
+
+    // the column starts are absolute, rows and values start at the first column of a slice
+    const CPUSPARSE_INDEX_TYPE* colStart = b.SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* rows = b.MajorIndexLocation();
+    const ElemType* values = b.Data();
+
+#pragma omp parallel
+    {
+        std::vector<ElemType> column(m_numRows);
+#pragma omp for
+        for (long j = 0; j < (long) b.GetNumCols(); j++)
+        {
+            ElemType* pu = pus + j * m_numRows;
+            const long begin = colStart[j] - colStart[0];
+            const long end = colStart[j + 1] - colStart[0];
+            if (begin == end)
+                memset(pu, 0, sizeof(ElemType) * m_numRows);
+            for (long p = begin; p < end; p++)
+            {
+                // the first column goes into us directly, one-hot input thus only widens the column looked up
+                ElemType* target = p == begin ? pu : column.data();
+                widenHalf(Data() + rows[p] * m_numRows, target, m_numRows, bfloat16);
+                ElemType w = values[p];
+                if (p == begin)
+                {
+                    if (w != 1)
+                        for (long r = 0; r < (long) m_numRows; r++)
+                            pu[r] *= w;
+                }
+                else
+                {
+                    for (long r = 0; r < (long) m_numRows; r++)
+                        pu[r] += w * target[r];
+                }
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void HalfMatrix<ElemType>::Write(File& stream) const
+{
+    stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BHMAT"));
+    stream << (int) m_format << m_numRows << m_numCols;
+    const unsigned short* p = Data();
+    for (size_t i = 0; i < GetNumElements(); i++)
+        stream << p[i];
+    stream.PutMarker(fileMarkerEndSection, std::wstring(L"EHMAT"));
+}
+
+template <class ElemType>
+void HalfMatrix<ElemType>::Read(File& stream)
+{
+    stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BHMAT"));
+    int format;
+    size_t numRows, numCols;
+    stream >> format >> numRows >> numCols;
+    if (format != (int) HalfPrecisionFormat::Float16 && format != (int) HalfPrecisionFormat::BFloat16)
+        RuntimeError("HalfMatrix::Read: Unknown element format %d.", format);
+
+    auto data = std::make_shared<std::vector<unsigned short>>(numRows * numCols);
+    for (auto& value : *data)
+        stream >> value;
+    stream.GetMarker(fileMarkerEndSection, std::wstring(L"EHMAT"));
+
+    m_format = (HalfPrecisionFormat) format;
+    m_numRows = numRows;
+    m_numCols = numCols;
+    m_data = data;
+}
+
+template class HalfMatrix<float>;
+template class HalfMatrix<double>;
+
+}}}
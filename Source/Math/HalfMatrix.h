@@ -0,0 +1,85 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HalfMatrix.h -- parameters stored in 16-bit floating point (fp16 or bf16), computed with in full precision
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// element format of parameters in memory and in the model file
+enum class HalfPrecisionFormat : int
+{
+    None = 0,    // ElemType itself
+    Float16 = 1, // IEEE 754 half precision: 5 exponent bits, 10 mantissa bits
+    BFloat16 = 2 // upper half of a float: 8 exponent bits, 7 mantissa bits
+};
+
+MATH_API HalfPrecisionFormat ParseHalfPrecisionFormat(const std::wstring& s); // "float", "fp16" or "bf16"
+MATH_API const wchar_t* HalfPrecisionFormatName(HalfPrecisionFormat format);
+
+// A HalfMatrix holds a matrix in 16 bits per element, column-major like a dense CPUMatrix. It is meant for
+// parameters that are only read in inference: products with it (Matrix::AssignHalfProductOf()) widen the
+// elements to ElemType block by block in cache, so that only half of the bytes are read from memory.
+// The data is always in CPU memory, and shared between reshaped copies.
+template <class ElemType>
+class MATH_API HalfMatrix
+{
+public:
+    HalfMatrix();
+
+    // narrows a (rounding to nearest even) into this
+    void Assign(const Matrix<ElemType>& a, HalfPrecisionFormat format);
+    // widens this into a, which keeps its device
+    void CopyTo(Matrix<ElemType>& a) const;
+
+    HalfMatrix<ElemType> Reshaped(size_t numRows, size_t numCols) const;
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+    size_t GetNumElements() const { return m_numRows * m_numCols; }
+    bool IsEmpty() const { return GetNumElements() == 0; }
+    size_t GetSizeInBytes() const { return GetNumElements() * sizeof(unsigned short); }
+    HalfPrecisionFormat GetFormat() const { return m_format; }
+
+    const unsigned short* Data() const { return m_data ? m_data->data() : nullptr; }
+
+    // us = this * b, or this^T * b if 'transpose'
+    void Times(const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& us, bool transpose) const;
+    // us = this * b, widening only the columns of this selected by nonzero elements of b (e.g. embedding lookup)
+    void Times(const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& us) const;
+
+    void Write(File& stream) const;
+    void Read(File& stream);
+
+private:
+    // widens the columns [firstCol, firstCol + numCols) into the contiguous buffer 'us'
+    void WidenColumns(size_t firstCol, size_t numCols, ElemType* us) const;
+
+    size_t m_numRows;
+    size_t m_numCols;
+    HalfPrecisionFormat m_format;
+    std::shared_ptr<std::vector<unsigned short>> m_data;
+};
+
+template <class ElemType>
+File& operator>>(File& stream, HalfMatrix<ElemType>& m)
+{
+    m.Read(stream);
+    return stream;
+}
+template <class ElemType>
+File& operator<<(File& stream, const HalfMatrix<ElemType>& m)
+{
+    m.Write(stream);
+    return stream;
+}
+
+}}}
@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "Int8Matrix.h"
+#include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
+#include "CPUKernels.h"
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+Int8Matrix<ElemType>::Int8Matrix()
+    : m_numRows(0), m_numCols(0)
+{
+}
+
+template <class ElemType>
+void Int8Matrix<ElemType>::Quantize(const Matrix<ElemType>& a, bool transpose)
+{
+    const size_t rows = a.GetNumRows();
+    const size_t cols = a.GetNumCols();
+    std::unique_ptr<ElemType[]> values(a.CopyToArray()); // (works for any device)
+
+    m_numRows = transpose ? cols : rows;
+    m_numCols = transpose ? rows : cols;
+    m_data.resize(m_numRows * m_numCols);
+    m_scales.resize(m_numCols);
+
+#pragma omp parallel for
+    for (long c = 0; c < (long) m_numCols; c++)
+    {
+        // element r of column c of what is stored
+        auto at = [&](size_t r) { return transpose ? values[r * rows + c] : values[c * rows + r]; };
+
+        ElemType range = 0;
+        for (size_t r = 0; r < m_numRows; r++)
+            range = std::max(range, fabs(at(r)));
+
+        signed char* pc = m_data.data() + c * m_numRows;
+        const ElemType invScale = range > 0 ? 127 / range : 0;
+        for (size_t r = 0; r < m_numRows; r++)
+        {
+            ElemType x = at(r) * invScale; // within [-127, 127] by construction
+            pc[r] = (signed char) (x < 0 ? x - (ElemType) 0.5 : x + (ElemType) 0.5);
+        }
+        m_scales[c] = range / 127;
+    }
+}
+
+template <class ElemType>
+void Int8Matrix<ElemType>::TransposeTimes(const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& us, ElemType bRange) const
+{
+    if (b.GetNumRows() != m_numRows)
+        InvalidArgument("Int8Matrix::TransposeTimes: The inner dimensions %d and %d do not match.", (int) m_numRows, (int) b.GetNumRows());
+
+    us.RequireSize(m_numCols, b.GetNumCols());
+    GetCPUKernels<ElemType>().int8TransposeTimes(Data(), Scales(), b.Data(), us.Data(), m_numRows, m_numCols, b.GetNumCols(), bRange);
+}
+
+template <class ElemType>
+void Int8Matrix<ElemType>::Times(const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& us) const
+{
+    if (b.GetNumRows() != m_numCols)
+        InvalidArgument("Int8Matrix::Times: The inner dimensions %d and %d do not match.", (int) m_numCols, (int) b.GetNumRows());
+
+    us.RequireSize(m_numRows, b.GetNumCols());
+    const ElemType* pb = b.Data();
+    ElemType* pus = us.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) b.GetNumCols(); j++)
+    {
+        ElemType* pu = pus + j * m_numRows;
+        memset(pu, 0, sizeof(ElemType) * m_numRows);
+        for (size_t c = 0; c < m_numCols; c++)
+        {
+            ElemType w = pb[j * m_numCols + c];
+            if (w == 0) // one-hot inputs select single columns
+                continue;
+            w *= m_scales[c];
+            const signed char* pc = m_data.data() + c * m_numRows;
+            for (long r = 0; r < (long) m_numRows; r++)
+                pu[r] += w * pc[r];
+        }
+    }
+}
+
+template <class ElemType>
+void Int8Matrix<ElemType>::Times(const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& us) const
+{
+    if (b.GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+    if (b.GetNumRows() != m_numCols)
+        InvalidArgument("Int8Matrix::Times: The inner dimensions %d and %d do not match.", (int) m_numCols, (int) b.GetNumRows());
+
+    us.RequireSize(m_numRows, b.GetNumCols());
+    ElemType* pus = us.Data();
+
+    // the column starts are absolute, rows and values start at the first column of a slice
+    const CPUSPARSE_INDEX_TYPE* colStart = b.SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* rows = b.MajorIndexLocation();
+    const ElemType* values = b.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) b.GetNumCols(); j++)
+    {
+        ElemType* pu = pus + j * m_numRows;
+        memset(pu, 0, sizeof(ElemType) * m_numRows);
+        for (long p = colStart[j] - colStart[0]; p < colStart[j + 1] - colStart[0]; p++)
+        {
+            size_t c = rows[p];
+            ElemType w = values[p] * m_scales[c];
+            const signed char* pc = m_data.data() + c * m_numRows;
+            for (long r = 0; r < (long) m_numRows; r++)
+                pu[r] += w * pc[r];
+        }
+    }
+}
+
+template class Int8Matrix<float>;
+template class Int8Matrix<double>;
+
+}}}
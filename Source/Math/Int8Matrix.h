@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Int8Matrix.h -- weights quantized to 8 bits for inference on the CPU
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// An Int8Matrix holds a weight matrix quantized to int8 with one scale per column:
+// column c is stored as round(a(:,c) / scale[c]) with scale[c] = max|a(:,c)| / 127 (symmetric, no zero point),
+// which makes it 4 times smaller than float weights. Products with it are computed by Matrix::AssignInt8ProductOf().
+// The data is always in CPU memory; this is meant for inference only.
+template <class ElemType>
+class MATH_API Int8Matrix
+{
+public:
+    Int8Matrix();
+
+    // Quantizes the columns of a, or with 'transpose' the rows of a (i.e. the columns of a^T, which is stored).
+    void Quantize(const Matrix<ElemType>& a, bool transpose);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+    bool IsEmpty() const { return m_numRows * m_numCols == 0; }
+    size_t GetSizeInBytes() const { return m_data.size() * sizeof(signed char) + m_scales.size() * sizeof(ElemType); }
+
+    const signed char* Data() const { return m_data.data(); }   // column-major [numRows x numCols]
+    const ElemType* Scales() const { return m_scales.data(); } // [numCols]
+
+    // us = this^T * b; b is quantized per column (with its own range, or the fixed 'bRange' if > 0),
+    // and the products are accumulated in int32
+    void TransposeTimes(const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& us, ElemType bRange) const;
+
+    // us = this * b, dequantizing the columns of this selected by nonzero elements of b (e.g. embedding lookup)
+    void Times(const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& us) const;
+    void Times(const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& us) const;
+
+private:
+    size_t m_numRows;
+    size_t m_numCols;
+    std::vector<signed char> m_data;
+    std::vector<ElemType> m_scales;
+};
+
+}}}
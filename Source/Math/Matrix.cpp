@@ -9,6 +9,8 @@
 #include "Matrix.h"
 #include "CPUMatrix.h"
 #include "CPUSparseMatrix.h"
+#include "Int8Matrix.h"
+#include "HalfMatrix.h"
 #include "GPUMatrix.h"
 #include "GPUSparseMatrix.h"
 #include "File.h"
@@ -794,6 +796,34 @@ Matrix<ElemType>& Matrix<ElemType>::AssignColumnSlice(const Matrix<ElemType>& fr
     return *this;
 }
 
+// Re-target this view object to a column range of 'fromMatrix'. Meant for view objects that are exclusively owned by the caller
+// and re-targeted over and over (see MatrixSliceView): If both are dense and live in the same single location, this only updates
+// the metadata of the existing CPU/GPUMatrix object, without heap allocation or reference-count traffic.
+// Otherwise (first use, sparse, BOTH, or moved to the other device) it falls back to ColumnSlice().
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignColumnSliceView(const Matrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
+{
+    const auto location = fromMatrix.GetCurrentMatrixLocation();
+    if (fromMatrix.GetMatrixType() == MatrixType::DENSE && m_matrixType == MatrixType::DENSE && m_currentDataLocation == location)
+    {
+        if (location == CurrentDataLocation::CPU)
+        {
+            m_CPUMatrix->AssignColumnSliceView(*fromMatrix.m_CPUMatrix, startColumn, numCols);
+            m_preferredDeviceId = fromMatrix.m_preferredDeviceId;
+            return *this;
+        }
+        else if (location == CurrentDataLocation::GPU)
+        {
+            m_GPUMatrix->AssignColumnSliceView(*fromMatrix.m_GPUMatrix, startColumn, numCols);
+            m_preferredDeviceId = fromMatrix.m_preferredDeviceId;
+            return *this;
+        }
+    }
+
+    *this = fromMatrix.ColumnSlice(startColumn, numCols);
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::SetColumnSlice(const Matrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
 {
@@ -1523,7 +1553,7 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { m_CPUMatrix->FSAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(CPU); },
         { m_GPUMatrix->FSAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(CPU); },
         { NOT_IMPLEMENTED; });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
@@ -1547,6 +1577,40 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+template <class ElemType>
+void Matrix<ElemType>::RegularizeSparseGradient(Matrix<ElemType>& functionValues, const std::vector<size_t>& lastUpdate, size_t step, ElemType l2Decay, ElemType l1Threshold, ElemType l2Weight)
+{
+    DecideAndMoveToRightDevice(*this, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->RegularizeBlocks(*functionValues.m_CPUMatrix, lastUpdate, step, l2Decay, l1Threshold, l2Weight); functionValues.SetDataLocation(CPU); },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SoftThresholdSparseGradientColumns(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step, ElemType l1Threshold) const
+{
+    DecideAndMoveToRightDevice(*this, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(this, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->SoftThresholdBlocks(*functionValues.m_CPUMatrix, lastUpdate, step, l1Threshold); functionValues.SetDataLocation(CPU); },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::CatchUpRegularization(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step, ElemType l2Decay, ElemType l1Threshold)
+{
+    DISPATCH_MATRIX_ON_FLAG(&functionValues, &functionValues,
+        { CPUSparseMatrix<ElemType>::CatchUpRegularization(*functionValues.m_CPUMatrix, lastUpdate, step, l2Decay, l1Threshold); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -2071,6 +2135,42 @@ Matrix<ElemType>& Matrix<ElemType>::AssignProductOf(const Matrix<ElemType>& a, c
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignInt8ProductOf(const Int8Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, ElemType bRange)
+{
+    if (GetDeviceId() != CPUDEVICE || b.GetDeviceId() != CPUDEVICE)
+        RuntimeError("AssignInt8ProductOf: Products with int8 weights are only implemented on the CPU.");
+    if (GetMatrixType() != MatrixType::DENSE || (transposeA && b.GetMatrixType() != MatrixType::DENSE))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&b,
+                            nullptr,
+                            if (transposeA) a.TransposeTimes(*b.m_CPUMatrix, *m_CPUMatrix, bRange); else a.Times(*b.m_CPUMatrix, *m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            a.Times(*b.m_CPUSparseMatrix, *m_CPUMatrix),
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignHalfProductOf(const HalfMatrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b)
+{
+    if (GetDeviceId() != CPUDEVICE || b.GetDeviceId() != CPUDEVICE)
+        RuntimeError("AssignHalfProductOf: Products with fp16/bf16 weights are only implemented on the CPU.");
+    if (GetMatrixType() != MatrixType::DENSE || (transposeA && b.GetMatrixType() != MatrixType::DENSE))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&b,
+                            nullptr,
+                            a.Times(*b.m_CPUMatrix, *m_CPUMatrix, transposeA),
+                            NOT_IMPLEMENTED,
+                            a.Times(*b.m_CPUSparseMatrix, *m_CPUMatrix),
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType> Matrix<ElemType>::operator*(const Matrix<ElemType>& a) const
 {
@@ -4261,6 +4361,67 @@ void Matrix<ElemType>::AveragePoolingBackward(const Matrix<int>& mpRowCol, const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::MaxPoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                                size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                                Matrix<ElemType>& workspace, Matrix<ElemType>& output, Matrix<int>& argmax) const
+{
+    DecideAndMoveToRightDevice(*this, workspace, output);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->MaxPoolingForwardBlocked(channels, inW, inH, outW, outH, kernelW, kernelH, strideW, strideH, startW, startH,
+                                                                  *(workspace.m_CPUMatrix), *(output.m_CPUMatrix), *(argmax.m_CPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::MaxPoolingBackwardBlocked(const Matrix<int>& argmax, size_t channels, Matrix<ElemType>& grad) const
+{
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->MaxPoolingBackwardBlocked(*(argmax.m_CPUMatrix), channels, *(grad.m_CPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AveragePoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                                    size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                                    Matrix<ElemType>& workspace, Matrix<ElemType>& output) const
+{
+    DecideAndMoveToRightDevice(*this, workspace, output);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AveragePoolingForwardBlocked(channels, inW, inH, outW, outH, kernelW, kernelH, strideW, strideH, startW, startH,
+                                                                      *(workspace.m_CPUMatrix), *(output.m_CPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AveragePoolingBackwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                                     size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                                     Matrix<ElemType>& grad) const
+{
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AveragePoolingBackwardBlocked(channels, inW, inH, outW, outH, kernelW, kernelH, strideW, strideH, startW, startH,
+                                                                       *(grad.m_CPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::BatchNormalizationForward(const Matrix<ElemType>& scale, const Matrix<ElemType>& bias, double expAvgFactor, double blendFactor, 
                                                  Matrix<ElemType>& runMean, Matrix<ElemType>& runInvStdDev, Matrix<ElemType>& out, double epsilon,
@@ -4349,8 +4510,14 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     if (c.GetDeviceId() < 0) // CPU
     {
         if (a.GetMatrixType() == MatrixType::SPARSE)
-            NOT_IMPLEMENTED;
-        if (b.GetMatrixType() == MatrixType::SPARSE)
+        {
+            if (b.GetMatrixType() == MatrixType::SPARSE)
+                NOT_IMPLEMENTED;
+            c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+            CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix);
+            c.SetDataLocation(CPU, DENSE);
+        }
+        else if (b.GetMatrixType() == MatrixType::SPARSE)
         {
             if (c.GetMatrixType() == MatrixType::DENSE)
             {
@@ -43,6 +43,8 @@ template <class ElemType> class CPUMatrix;
 template <class ElemType> class GPUSparseMatrix;
 template <class ElemType> class CPUSparseMatrix;
 template <class ElemType> class DeviceBoundNumber;
+template <class ElemType> class Int8Matrix;
+template <class ElemType> class HalfMatrix;
 
 // <ElemType>-agnostic base class
 struct /*interface*/ MATH_API MatrixBase
@@ -182,6 +184,7 @@ public:
     // SetColumnSlice    copies data
 
     Matrix<ElemType>& AssignColumnSlice(const Matrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols);
+    Matrix<ElemType>& AssignColumnSliceView(const Matrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols); // re-target a view without allocation; see MatrixSliceView
     Matrix<ElemType>& SetColumnSlice(const Matrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols);
 
     void CopyColumnsStrided(const Matrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride);
@@ -195,6 +198,11 @@ public:
     void FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
+    // Lazy regularization for sparse (block-column) gradients on CPU, 'this' being the gradient; see CPUSparseMatrix::RegularizeBlocks().
+    void RegularizeSparseGradient(Matrix<ElemType>& functionValues, const std::vector<size_t>& lastUpdate, size_t step, ElemType l2Decay, ElemType l1Threshold, ElemType l2Weight);
+    void SoftThresholdSparseGradientColumns(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step, ElemType l1Threshold) const;
+    static void CatchUpRegularization(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdate, size_t step, ElemType l2Decay, ElemType l1Threshold);
+
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
     {
@@ -306,6 +314,11 @@ public:
     Matrix<ElemType>  operator*(const Matrix<ElemType>& a) const;
     Matrix<ElemType>& AssignProductOf(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB); // this = a * b
     Matrix<ElemType>& Assign1x1ProductOf(const Matrix<ElemType>& a1x1, const Matrix<ElemType>& b);                                         // this = a * b, where a is 1x1
+    // products with int8 weights (CPU only), see Int8Matrix:
+    // this = a^T * b if 'transposeA', with b (dense) quantized per column, or with the fixed range 'bRange' if > 0; otherwise this = a * b
+    Matrix<ElemType>& AssignInt8ProductOf(const Int8Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, ElemType bRange = 0);
+    // products with fp16/bf16 weights (CPU only), see HalfMatrix: this = a * b, or a^T * b (b dense) if 'transposeA'
+    Matrix<ElemType>& AssignHalfProductOf(const HalfMatrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b);
 
     Matrix<ElemType>& operator/=(ElemType alpha);
     Matrix<ElemType>  operator/(ElemType alpha) const;
@@ -500,6 +513,18 @@ public:
     void AveragePoolingForward(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, Matrix<ElemType>& output) const;
     void AveragePoolingBackward(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, Matrix<ElemType>& grad) const;
 
+    // CPU-only 2D pooling kernels, see CPUMatrix for details.
+    void MaxPoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                  size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                  Matrix<ElemType>& workspace, Matrix<ElemType>& output, Matrix<int>& argmax) const;
+    void MaxPoolingBackwardBlocked(const Matrix<int>& argmax, size_t channels, Matrix<ElemType>& grad) const;
+    void AveragePoolingForwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                      size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                      Matrix<ElemType>& workspace, Matrix<ElemType>& output) const;
+    void AveragePoolingBackwardBlocked(size_t channels, size_t inW, size_t inH, size_t outW, size_t outH,
+                                       size_t kernelW, size_t kernelH, size_t strideW, size_t strideH, int startW, int startH,
+                                       Matrix<ElemType>& grad) const;
+
     void BatchNormalizationForward(const Matrix<ElemType>& scale, const Matrix<ElemType>& bias, double expAvgFactor, double blendFactor,
                                    Matrix<ElemType>& runMean, Matrix<ElemType>& runInvStdDev, Matrix<ElemType>& out, double epsilon,
                                    Matrix<ElemType>& saveMean, Matrix<ElemType>& saveInvStdDev) const;
@@ -612,6 +637,36 @@ File& operator<<(File& stream, const Matrix<ElemType>& M)
     return stream;
 }
 
+// A non-owning view onto a column range of another matrix, for code that slices the same matrices over and over,
+// e.g. once per time step inside recurrent loops. ColumnSlice() creates a new Matrix and CPU/GPUMatrix object each time
+// and copies the reference to the storage object; re-targeting a view only updates its metadata (for dense matrices,
+// after the first use). A view is owned by the code that uses it, e.g. a node member per slice that is used at the same time.
+// The slice it returns is valid until the next Assign() or Release(), or until the source matrix gets resized.
+// While a view points into a matrix, that matrix cannot be resized; Release() the view once it is no longer needed.
+template <class ElemType>
+class MatrixSliceView
+{
+public:
+    MatrixSliceView()
+        : m_view(CPUDEVICE)
+    {
+    }
+
+    Matrix<ElemType>& Assign(const Matrix<ElemType>& fromMatrix, size_t startColumn, size_t numCols)
+    {
+        return m_view.AssignColumnSliceView(fromMatrix, startColumn, numCols);
+    }
+
+    // drop the reference to the source matrix; the next Assign() starts over like the first one
+    void Release()
+    {
+        m_view = Matrix<ElemType>(CPUDEVICE);
+    }
+
+private:
+    Matrix<ElemType> m_view;
+};
+
 typedef Matrix<float> SingleMatrix;
 typedef Matrix<double> DoubleMatrix;
 
@@ -44,6 +44,11 @@ pair<size_t, size_t> ConfigHelper::GetContextWindow()
     return make_pair(left, right);
 }
 
+bool ConfigHelper::ShouldSpliceContext()
+{
+    return m_config(L"spliceContext", true);
+}
+
 void ConfigHelper::CheckFeatureType()
 {
     wstring type = m_config(L"type", L"real");
@@ -88,7 +93,7 @@ void ConfigHelper::GetDataNamesFromConfig(
             continue;
         const ConfigParameters& temp = m_config(id);
         // see if we have a config parameters that contains a "file" element, it's a sub key, use it
-        if (temp.ExistsCurrent(L"scpFile"))
+        if (temp.ExistsCurrent(L"scpFile") || temp.ExistsCurrent(L"packedArchive"))
         {
             features.push_back(id);
         }
@@ -217,6 +222,16 @@ wstring ConfigHelper::GetRandomizer()
     return randomizer;
 }
 
+wstring ConfigHelper::GetMlfCachePath() const
+{
+    return m_config(L"mlfCacheFile", L"");
+}
+
+wstring ConfigHelper::GetPackedArchivePath()
+{
+    return m_config(L"packedArchive", L"");
+}
+
 vector<wstring> ConfigHelper::GetSequencePaths()
 {
     wstring scriptPath = m_config(L"scpFile");
@@ -23,6 +23,10 @@ public:
     // Gets context window for augmentation.
     std::pair<size_t, size_t> GetContextWindow();
 
+    // Checks whether the context window is applied by the reader (default),
+    // or left to the network, in which case the reader delivers the frames as they are.
+    bool ShouldSpliceContext();
+
     // Gets feature dimension.
     size_t GetFeatureDimension();
 
@@ -52,6 +56,12 @@ public:
     // Gets utterance paths from the configuration.
     std::vector<std::wstring> GetSequencePaths();
 
+    // Gets the path of the binary cache of the parsed mlf files, or an empty string if no cache is used.
+    std::wstring GetMlfCachePath() const;
+
+    // Gets the path of the packed feature archive, or an empty string if utterances are given by a script file.
+    std::wstring GetPackedArchivePath();
+
     // Gets randomization window.
     size_t GetRandomizationWindow();
 
@@ -10,6 +10,7 @@
 #include "DataDeserializer.h"
 #include "../HTKMLFReader/htkfeatio.h"
 #include "UtteranceDescription.h"
+#include "PackedFeatureArchive.h"
 #include "ssematrix.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -36,12 +37,22 @@ class HTKChunkDescription
     // Chunk id.
     ChunkIdType m_chunkId;
 
+    // Packed archive and its chunk the data is read from, if any; otherwise each utterance is read from its own path.
+    PackedFeatureArchivePtr m_archive;
+    size_t m_archiveChunk = 0;
+
+    // For chunks from a packed archive, the first frame of each utterance inside the archive chunk.
+    std::vector<size_t> m_archiveFirstFrames;
+
 public:
 
     HTKChunkDescription() : m_chunkId(CHUNKID_MAX) { };
 
     HTKChunkDescription(ChunkIdType chunkId) : m_chunkId(chunkId) { };
 
+    HTKChunkDescription(ChunkIdType chunkId, PackedFeatureArchivePtr archive, size_t archiveChunk)
+        : m_chunkId(chunkId), m_archive(archive), m_archiveChunk(archiveChunk) { };
+
     // Gets number of utterances in the chunk.
     size_t GetNumberOfUtterances() const
     {
@@ -66,6 +77,14 @@ public:
         m_utterances.push_back(std::move(utterance));
     }
 
+    // Adds an utterance of the packed archive chunk, starting at the given frame of the archive chunk.
+    void Add(UtteranceDescription&& utterance, size_t archiveFirstFrame)
+    {
+        assert(m_archive);
+        m_archiveFirstFrames.push_back(archiveFirstFrame);
+        Add(std::move(utterance));
+    }
+
     // Gets total number of frames in the chunk.
     size_t GetTotalFrames() const
     {
@@ -126,17 +145,32 @@ public:
 
         try
         {
-            // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
-            // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
-            msra::asr::htkfeatreader reader;
-
-            // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
             m_frames.resize(featureDimension, m_totalFrames);
-            foreach_index(i, m_utterances)
+            if (m_archive)
+            {
+                // read the whole chunk at once, then pick the utterances that are used
+                std::vector<float> chunkFrames;
+                m_archive->ReadChunk(m_archiveChunk, chunkFrames);
+                foreach_index(i, m_utterances)
+                {
+                    const float* source = chunkFrames.data() + m_archiveFirstFrames[i] * featureDimension;
+                    for (size_t t = 0; t < m_utterances[i].GetNumberOfFrames(); t++, source += featureDimension)
+                        memcpy(&m_frames(0, m_firstFrames[i] + t), source, sizeof(float) * featureDimension);
+                }
+            }
+            else
             {
-                // read features for this file
-                auto framesWrapper = GetUtteranceFrames(i);
-                reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
+                // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
+                msra::asr::htkfeatreader reader;
+
+                // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
+                foreach_index(i, m_utterances)
+                {
+                    // read features for this file
+                    auto framesWrapper = GetUtteranceFrames(i);
+                    reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                }
             }
 
             if (verbosity)
@@ -11,15 +11,6 @@
 #include "Basics.h"
 #include <numeric>
 
-// TODO: This will be removed when dependency on old code is eliminated.
-// Currently this fixes the linking.
-namespace msra { namespace asr {
-
-std::unordered_map<std::wstring, unsigned int> htkfeatreader::parsedpath::archivePathStringMap;
-std::vector<std::wstring> htkfeatreader::parsedpath::archivePathStringVector;
-
-}}
-
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 using namespace std;
@@ -49,11 +40,9 @@ HTKDataDeserializer::HTKDataDeserializer(
     ConfigParameters streamConfig = input(inputName);
 
     ConfigHelper config(streamConfig);
-    auto context = config.GetContextWindow();
 
     m_elementType = config.GetElementType();
-    m_dimension = config.GetFeatureDimension();
-    m_dimension = m_dimension * (1 + context.first + context.second);
+    InitializeDimension(config);
 
     InitializeChunkDescriptions(config);
     InitializeStreams(inputName);
@@ -79,11 +68,8 @@ HTKDataDeserializer::HTKDataDeserializer(
 
     m_verbosity = feature(L"verbosity", 0);
 
-    auto context = config.GetContextWindow();
     m_elementType = config.GetElementType();
-
-    m_dimension = config.GetFeatureDimension();
-    m_dimension = m_dimension * (1 + context.first + context.second);
+    InitializeDimension(config);
 
     InitializeChunkDescriptions(config);
     InitializeStreams(featureName);
@@ -91,8 +77,34 @@ HTKDataDeserializer::HTKDataDeserializer(
     InitializeAugmentationWindow(config);
 }
 
+// Determines the dimension of the exposed samples, which includes the context window when it is applied by the reader.
+void HTKDataDeserializer::InitializeDimension(ConfigHelper& config)
+{
+    m_spliceContext = config.ShouldSpliceContext();
+    m_dimension = config.GetFeatureDimension();
+    if (m_spliceContext)
+    {
+        auto context = config.GetContextWindow();
+        m_dimension = m_dimension * (1 + context.first + context.second);
+    }
+    else if (m_frameMode)
+    {
+        // Each frame is a sequence of its own, the network would not see the neighbors.
+        InvalidArgument("HTKDataDeserializer: spliceContext=false requires frameMode=false.");
+    }
+}
+
 void HTKDataDeserializer::InitializeAugmentationWindow(ConfigHelper& config)
 {
+    if (!m_spliceContext)
+    {
+        // Frames are delivered as they are, e.g. to be spliced by a SpliceContext node.
+        if (m_ioFeatureDimension != m_dimension)
+            InvalidArgument("HTKDataDeserializer: The feature dimension %d does not match the dimension %d in the feature files.", (int)m_dimension, (int)m_ioFeatureDimension);
+        m_augmentationWindow.first = m_augmentationWindow.second = 0;
+        return;
+    }
+
     m_augmentationWindow = config.GetContextWindow();
 
     // If not given explicitly, we need to identify the required augmentation range from the expected dimension
@@ -106,6 +118,13 @@ void HTKDataDeserializer::InitializeAugmentationWindow(ConfigHelper& config)
 // Initializes chunks based on the configuration and utterance descriptions.
 void HTKDataDeserializer::InitializeChunkDescriptions(ConfigHelper& config)
 {
+    wstring archivePath = config.GetPackedArchivePath();
+    if (!archivePath.empty())
+    {
+        InitializeChunkDescriptionsFromArchive(archivePath);
+        return;
+    }
+
     // Read utterance descriptions.
     vector<wstring> paths = config.GetSequencePaths();
     vector<UtteranceDescription> utterances;
@@ -190,6 +209,76 @@ void HTKDataDeserializer::InitializeChunkDescriptions(ConfigHelper& config)
     }
 }
 
+// Initializes chunks from a packed feature archive, which already groups the utterances into chunks.
+void HTKDataDeserializer::InitializeChunkDescriptionsFromArchive(const wstring& archivePath)
+{
+    m_archive = make_shared<PackedFeatureArchive>(archivePath);
+    auto& stringRegistry = m_corpus->GetStringRegistry();
+    size_t numUtterances = 0;
+
+    m_chunks.reserve(m_archive->GetNumberOfChunks());
+    ChunkIdType chunkId = 0;
+    for (size_t archiveChunk = 0; archiveChunk < m_archive->GetNumberOfChunks(); ++archiveChunk)
+    {
+        m_chunks.push_back(HTKChunkDescription(chunkId, m_archive, archiveChunk));
+        HTKChunkDescription& currentChunk = m_chunks.back();
+
+        const auto& chunk = m_archive->GetChunk(archiveChunk);
+        for (size_t i = chunk.firstUtterance; i < chunk.firstUtterance + chunk.numUtterances; ++i)
+        {
+            const auto& utterance = m_archive->GetUtterance(i);
+
+            // The path of the utterance refers to its frames inside the archive chunk, as an archive entry of a script file.
+            UtteranceDescription description(msra::asr::htkfeatreader::parsedpath(m_archive->GetKey(i), archivePath,
+                utterance.firstFrame, utterance.firstFrame + utterance.numFrames - 1));
+
+            string key = description.GetKey();
+            if (!m_corpus->IsIncluded(key))
+            {
+                continue;
+            }
+
+            // No need to store key, releasing it.
+            description.ClearLogicalPath();
+
+            size_t id = stringRegistry[key];
+            description.SetId(id);
+            if (!m_primary)
+            {
+                m_keyToChunkLocation[id] = make_pair(currentChunk.GetChunkId(), currentChunk.GetNumberOfUtterances());
+            }
+
+            currentChunk.Add(move(description), utterance.firstFrame);
+            m_totalNumberOfFrames += utterance.numFrames;
+            numUtterances++;
+        }
+
+        if (currentChunk.GetNumberOfUtterances() == 0)
+        {
+            m_chunks.pop_back();
+        }
+        else
+        {
+            chunkId++;
+        }
+    }
+
+    fprintf(stderr,
+        "HTKDataDeserializer::HTKDataDeserializer: "
+        "selected %" PRIu64 " utterances grouped into %" PRIu64 " chunks from packed archive '%ls', "
+        "average chunk size: %.1f utterances, %.1f frames\n",
+        numUtterances,
+        m_chunks.size(),
+        archivePath.c_str(),
+        numUtterances / (double)m_chunks.size(),
+        m_totalNumberOfFrames / (double)m_chunks.size());
+
+    if (numUtterances == 0)
+    {
+        RuntimeError("HTKDataDeserializer: No utterances to process.");
+    }
+}
+
 // Describes exposed stream - a single stream of htk features.
 void HTKDataDeserializer::InitializeStreams(const wstring& featureName)
 {
@@ -206,6 +295,16 @@ void HTKDataDeserializer::InitializeStreams(const wstring& featureName)
 // This information is used later to check that all features among all files have the same properties.
 void HTKDataDeserializer::InitializeFeatureInformation()
 {
+    if (m_archive)
+    {
+        m_featureKind = m_archive->GetFeatureKind();
+        m_ioFeatureDimension = m_archive->GetFeatureDimension();
+        m_samplePeriod = m_archive->GetSamplePeriod();
+        fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n",
+            (int)m_ioFeatureDimension, m_featureKind.c_str(), m_samplePeriod / 1e4);
+        return;
+    }
+
     msra::util::attempt(5, [&]()
     {
         msra::asr::htkfeatreader reader;
@@ -439,7 +538,15 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
     MatrixAsVectorOfVectors utteranceFramesWrapper(utteranceFrames);
     FeatureMatrix features(m_dimension, m_frameMode ? 1 : utterance->GetNumberOfFrames());
 
-    if (m_frameMode)
+    if (!m_spliceContext)
+    {
+        // No augmentation, copy the frames of the utterance as they are.
+        for (size_t frameIndex = 0; frameIndex < utterance->GetNumberOfFrames(); ++frameIndex)
+        {
+            memcpy(features.GetData() + frameIndex * m_dimension, &utteranceFrames(0, frameIndex), sizeof(float) * m_dimension);
+        }
+    }
+    else if (m_frameMode)
     {
         // For frame mode augment a single frame.
         size_t frameIndex = id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex);
@@ -43,8 +43,10 @@ private:
 
     // Initialization functions.
     void InitializeChunkDescriptions(ConfigHelper& config);
+    void InitializeChunkDescriptionsFromArchive(const std::wstring& archivePath);
     void InitializeStreams(const std::wstring& featureName);
     void InitializeFeatureInformation();
+    void InitializeDimension(ConfigHelper& config);
     void InitializeAugmentationWindow(ConfigHelper& config);
 
     // Gets sequence by its chunk id and id inside the chunk.
@@ -59,9 +61,16 @@ private:
     // Chunk descriptions.
     std::vector<HTKChunkDescription> m_chunks;
 
+    // Packed feature archive the data is read from, if used instead of a script file.
+    PackedFeatureArchivePtr m_archive;
+
     // Augmentation window.
     std::pair<size_t, size_t> m_augmentationWindow;
 
+    // Flag that indicates whether frames are augmented with their context window,
+    // otherwise the context is expected to be spliced inside the network.
+    bool m_spliceContext;
+
     CorpusDescriptorPtr m_corpus;
 
     // General configuration
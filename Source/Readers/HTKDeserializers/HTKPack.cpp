@@ -0,0 +1,101 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// htkpack -- packs the HTK feature files listed in a script file into a packed feature archive,
+// see PackedFeatureArchive.h. The archive is then used instead of the script file by giving it
+// as 'packedArchive' to the feature stream of the HTK deserializer.
+//
+// Usage: htkpack <scpFile> <archiveFile> [<chunkFrames>]
+// Script file entries are the same as for the HTK deserializer (logical=physical[s,e] or plain paths),
+// chunkFrames defaults to the 15 minutes of speech the HTK deserializer uses per chunk.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "fileutil.h"
+#include "../HTKMLFReader/htkfeatio.h"
+#include "ssematrix.h"
+#include "PackedFeatureArchive.h"
+#include <fstream>
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+static void Pack(const string& scriptPath, const wstring& archivePath, size_t chunkFrames)
+{
+    ifstream scp(scriptPath.c_str());
+    if (!scp)
+        RuntimeError("Failed to open input file: %s", scriptPath.c_str());
+
+    unique_ptr<PackedFeatureArchiveWriter> writer;
+    string featureKind;
+    unsigned int samplePeriod = 0;
+    size_t featureDimension = 0;
+    size_t numUtterances = 0, numFrames = 0;
+
+    msra::asr::htkfeatreader reader;
+    msra::dbn::matrix utteranceFrames;
+    vector<float> frames;
+    string line;
+    while (getline(scp, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+
+        msra::asr::htkfeatreader::parsedpath path(msra::strfun::utf16(line));
+        string kind;
+        unsigned int period;
+        reader.read(path, kind, period, utteranceFrames);
+        if (!writer)
+        {
+            featureKind = kind;
+            samplePeriod = period;
+            featureDimension = utteranceFrames.rows();
+            writer.reset(new PackedFeatureArchiveWriter(archivePath, featureKind, featureDimension, samplePeriod, chunkFrames));
+            fprintf(stderr, "htkpack: %d-dimensional '%s' features with frame shift %.1f ms\n", (int)featureDimension, featureKind.c_str(), samplePeriod / 1e4);
+        }
+        else if (kind != featureKind || period != samplePeriod || utteranceFrames.rows() != featureDimension)
+            RuntimeError("htkpack: '%s' does not have the same feature kind, frame shift and dimension as the first file.", line.c_str());
+
+        // ssematrix columns may be padded, store the frames consecutively
+        frames.resize(featureDimension * utteranceFrames.cols());
+        for (size_t t = 0; t < utteranceFrames.cols(); t++)
+            memcpy(frames.data() + t * featureDimension, &utteranceFrames(0, t), sizeof(float) * featureDimension);
+
+        writer->AddUtterance(msra::strfun::utf8((wstring)path), frames.data(), utteranceFrames.cols());
+        numUtterances++;
+        numFrames += utteranceFrames.cols();
+    }
+    if (scp.bad())
+        RuntimeError("An error occurred while reading input file: %s", scriptPath.c_str());
+    if (!writer)
+        RuntimeError("htkpack: No utterances in '%s'.", scriptPath.c_str());
+
+    writer->Close();
+    fprintf(stderr, "htkpack: packed %d utterances, %d frames into '%ls'\n", (int)numUtterances, (int)numFrames, archivePath.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argc > 4)
+    {
+        fprintf(stderr, "Usage: htkpack <scpFile> <archiveFile> [<chunkFrames>]\n");
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        // 15 minutes of speech at 100 frames per second, as HTKDataDeserializer
+        size_t chunkFrames = argc > 3 ? (size_t)atoll(argv[3]) : 15 * 60 * 100;
+        Pack(argv[1], msra::strfun::utf16(argv[2]), chunkFrames);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "htkpack: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
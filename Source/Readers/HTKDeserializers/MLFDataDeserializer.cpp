@@ -9,9 +9,7 @@
 #include <limits>
 #include "MLFDataDeserializer.h"
 #include "ConfigHelper.h"
-#include "../HTKMLFReader/htkfeatio.h"
-#include "../HTKMLFReader/msra_mgram.h"
-#include "latticearchive.h"
+#include "MLFParser.h"
 
 #undef max // max is defined in minwindef.h
 
@@ -37,12 +35,6 @@ public:
     }
 };
 
-// Inner class for an utterance.
-struct MLFUtterance : SequenceDescription
-{
-    size_t m_sequenceStart;
-};
-
 MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
 {
     // TODO: This should be read in one place, potentially given by SGD.
@@ -100,94 +92,87 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
 void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension)
 {
     // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
-    // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
-
-    // TODO: currently we do not use symbol and word tables.
-    const msra::lm::CSymbolSet* wordTable = nullptr;
-    unordered_map<const char*, int>* symbolTable = nullptr;
     vector<wstring> mlfPaths = config.GetMlfPaths();
-
-    // TODO: Currently we still use the old IO module. This will be refactored later.
+    wstring cachePath = config.GetMlfCachePath();
     const double htkTimeToFrame = 100000.0; // default is 10ms
-    msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence> labels(mlfPaths, set<wstring>(), stateListPath, wordTable, symbolTable, htkTimeToFrame);
-
-    // Make sure 'msra::asr::htkmlfreader' type has a move constructor
-    static_assert(
-        is_move_constructible<
-        msra::asr::htkmlfreader<msra::asr::htkmlfentry,
-        msra::lattices::lattice::htkmlfwordsequence >> ::value,
-        "Type 'msra::asr::htkmlfreader' should be move constructible!");
 
     m_elementType = config.GetElementType();
 
-    MLFUtterance description;
     size_t numClasses = 0;
     size_t totalFrames = 0;
 
     const auto& stringRegistry = corpus->GetStringRegistry();
 
-    // TODO resize m_keyToSequence with number of IDs from string registry
-
-    for (const auto& l : labels)
+    // Labels are added block by block as they are parsed, straight into the run-length arrays.
+    auto addUtterances = [&](const MLFLabelBlock& block)
     {
-        // Currently the string registry contains only utterances described in scp.
-        // So here we skip all others.
-        size_t id = 0;
-        if (!stringRegistry.TryGet(msra::strfun::utf8(l.first), id))
-            continue;
-
-        description.m_key.m_sequence = id;
-
-        const auto& utterance = l.second;
-        description.m_sequenceStart = m_classIds.size();
-        uint32_t numberOfFrames = 0;
-
-        foreach_index(i, utterance)
+        for (size_t i = 0; i < block.NumberOfUtterances(); i++)
         {
-            const auto& timespan = utterance[i];
-            if ((i == 0 && timespan.firstframe != 0) ||
-                (i > 0 && utterance[i - 1].firstframe + utterance[i - 1].numframes != timespan.firstframe))
-            {
-                RuntimeError("Labels are not in the consecutive order MLF in label set: %ls", l.first.c_str());
-            }
+            // Currently the string registry contains only utterances described in scp.
+            // So here we skip all others.
+            size_t id = 0;
+            if (!stringRegistry.TryGet(block.m_keys[i], id))
+                continue;
 
-            if (timespan.classid >= dimension)
+            if (m_keyToSequence.size() <= id)
             {
-                RuntimeError("Class id %d exceeds the model output dimension %d.", (int)timespan.classid, (int)dimension);
+                m_keyToSequence.resize(id + 1, SIZE_MAX);
             }
-
-            if (timespan.classid != static_cast<msra::dbn::CLASSIDTYPE>(timespan.classid))
+            if (m_keyToSequence[id] != SIZE_MAX)
             {
-                RuntimeError("CLASSIDTYPE has too few bits");
+                RuntimeError("MLFDataDeserializer: duplicate entry '%s'", block.m_keys[i].c_str());
             }
+            m_keyToSequence[id] = m_utteranceIndex.size();
 
-            if (SEQUENCELEN_MAX < timespan.firstframe + timespan.numframes)
+            m_utteranceIndex.push_back(totalFrames);
+            m_utteranceFirstRun.push_back(m_runStarts.size());
+            for (size_t run = block.m_firstRun[i]; run < block.m_firstRun[i + 1]; run++)
             {
-                RuntimeError("Maximum number of sample per sequence exceeded.");
+                size_t classId = block.m_classIds[run];
+                if (classId >= dimension)
+                {
+                    RuntimeError("Class id %d exceeds the model output dimension %d.", (int)classId, (int)dimension);
+                }
+                numClasses = max(numClasses, classId + 1);
+
+                m_runStarts.push_back(block.m_runStarts[run]);
+                m_runClassIds.push_back(block.m_classIds[run]);
             }
 
-            numClasses = max(numClasses, (size_t)(1u + timespan.classid));
+            totalFrames += block.m_numberOfFrames[i];
+            m_numberOfSequences++;
+        }
+    };
 
-            for (size_t t = timespan.firstframe; t < timespan.firstframe + timespan.numframes; t++)
-            {
-                m_classIds.push_back(timespan.classid);
-                numberOfFrames++;
-            }
+    if (cachePath.empty() || !MLFLabelCache::Read(cachePath, mlfPaths, stateListPath, htkTimeToFrame, addUtterances))
+    {
+        MLFParser parser(stateListPath, htkTimeToFrame);
+        unique_ptr<MLFLabelCache> cache;
+        if (!cachePath.empty())
+        {
+            cache.reset(new MLFLabelCache(cachePath, mlfPaths, stateListPath, htkTimeToFrame));
         }
 
-        description.m_numberOfSamples = numberOfFrames;
-        m_utteranceIndex.push_back(totalFrames);
-        totalFrames += numberOfFrames;
+        for (const auto& path : mlfPaths)
+        {
+            parser.Parse(path, [&](const MLFLabelBlock& block)
+            {
+                if (cache)
+                {
+                    cache->Write(block);
+                }
+                addUtterances(block);
+            });
+        }
 
-        if (m_keyToSequence.size() <= description.m_key.m_sequence)
+        if (cache)
         {
-            m_keyToSequence.resize(description.m_key.m_sequence + 1, SIZE_MAX);
+            cache->Close();
         }
-        assert(m_keyToSequence[description.m_key.m_sequence] == SIZE_MAX);
-        m_keyToSequence[description.m_key.m_sequence] = m_utteranceIndex.size() - 1;
-        m_numberOfSequences++;
     }
+
     m_utteranceIndex.push_back(totalFrames);
+    m_utteranceFirstRun.push_back(m_runStarts.size());
 
     m_totalNumberOfFrames = totalFrames;
 
@@ -291,7 +276,8 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
 {
     if (m_frameMode)
     {
-        size_t label = m_classIds[sequenceId];
+        // In frame mode, sequence ids are ids of runs.
+        size_t label = m_runClassIds[sequenceId];
         assert(label < m_categories.size());
         result.push_back(m_categories[label]);
     }
@@ -311,11 +297,16 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
             s = make_shared<MLFSequenceData<double>>(numberOfSamples);
         }
 
-        for (size_t i = 0; i < numberOfSamples; i++)
+        const size_t firstRun = m_utteranceFirstRun[sequenceId];
+        const size_t endRun = m_utteranceFirstRun[sequenceId + 1];
+        for (size_t run = firstRun; run < endRun; run++)
         {
-            size_t frameIndex = startFrameIndex + i;
-            size_t label = m_classIds[frameIndex];
-            s->m_indices[i] = static_cast<IndexType>(label);
+            size_t runEnd = run + 1 < endRun ? m_runStarts[run + 1] : numberOfSamples;
+            IndexType label = static_cast<IndexType>(m_runClassIds[run]);
+            for (size_t i = m_runStarts[run]; i < runEnd; i++)
+            {
+                s->m_indices[i] = label;
+            }
         }
         result.push_back(s);
     }
@@ -336,8 +327,19 @@ bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, Sequen
 
     if (m_frameMode)
     {
-        size_t index = m_utteranceIndex[sequenceId] + key.m_sample;
-        result.m_id = index;
+        // The frame is identified by the run that contains it: the last run of the utterance that starts at or before the frame.
+        assert(key.m_sample < m_utteranceIndex[sequenceId + 1] - m_utteranceIndex[sequenceId]);
+        size_t first = m_utteranceFirstRun[sequenceId];
+        size_t end = m_utteranceFirstRun[sequenceId + 1];
+        while (end - first > 1)
+        {
+            size_t middle = first + (end - first) / 2;
+            if (m_runStarts[middle] <= key.m_sample)
+                first = middle;
+            else
+                end = middle;
+        }
+        result.m_id = first;
         result.m_numberOfSamples = 1;
     }
     else
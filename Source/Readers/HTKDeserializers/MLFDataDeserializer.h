@@ -54,10 +54,15 @@ private:
     // Number of sequences
     size_t m_numberOfSequences = 0;
 
-    // Array of all labels.
-    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_classIds;
+    // Labels of all utterances in run-length form: runs of frames with the same class id, each given by
+    // its first frame within the utterance; a run ends where the next run of the utterance starts.
+    msra::dbn::biggrowablevector<uint32_t> m_runStarts;
+    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_runClassIds;
 
-    // Index of utterances in the m_classIds.
+    // Index of the first run of each utterance, plus one element for the end.
+    msra::dbn::biggrowablevector<size_t> m_utteranceFirstRun;
+
+    // Index of the first frame of each utterance among all frames, plus one element for the end.
     msra::dbn::biggrowablevector<size_t> m_utteranceIndex;
 
     // Type of the data this serializer provides.
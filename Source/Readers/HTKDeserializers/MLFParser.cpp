@@ -0,0 +1,455 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <omp.h>
+#include "MLFParser.h"
+#include "DataDeserializer.h"
+#include "fileutil.h"
+
+#undef max // max is defined in minwindef.h
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+void MLFLabelBlock::Clear()
+{
+    m_keys.clear();
+    m_numberOfFrames.clear();
+    m_firstRun.assign(1, 0);
+    m_runStarts.clear();
+    m_classIds.clear();
+}
+
+// Lines are terminated by "\n" or "\r\n".
+static char* LineEnd(char* line, char* end)
+{
+    char* newline = (char*) memchr(line, '\n', end - line);
+    return newline ? newline : end;
+}
+
+static bool IsLine(const char* line, const char* lineEnd, const char* text)
+{
+    if (lineEnd > line && lineEnd[-1] == '\r')
+        lineEnd--;
+    const size_t length = strlen(text);
+    return (size_t)(lineEnd - line) == length && memcmp(line, text, length) == 0;
+}
+
+// Returns the position after the first utterance terminator (a line with a single '.') that starts at or after 'pos',
+// or nullptr if there is none before 'end'.
+static char* NextUtteranceEnd(char* begin, char* pos, char* end)
+{
+    // Start at the beginning of the next line, unless 'pos' already is at one.
+    if (pos > begin && pos[-1] != '\n')
+        pos = LineEnd(pos, end) + 1;
+    while (pos < end)
+    {
+        char* lineEnd = LineEnd(pos, end);
+        if (IsLine(pos, lineEnd, "."))
+            return lineEnd < end ? lineEnd + 1 : end;
+        pos = lineEnd + 1;
+    }
+    return nullptr;
+}
+
+// Returns the position after the last utterance terminator in [begin, end) that is followed by a newline, or nullptr if there is none.
+static char* LastUtteranceEnd(char* begin, char* end)
+{
+    char* next = end;
+    while (next > begin && next[-1] != '\n') // (an incomplete last line)
+        next--;
+    while (next > begin)
+    {
+        char* lineEnd = next - 1;
+        char* line = lineEnd;
+        while (line > begin && line[-1] != '\n')
+            line--;
+        if (IsLine(line, lineEnd, "."))
+            return next;
+        next = line;
+    }
+    return nullptr;
+}
+
+MLFParser::MLFParser(const wstring& stateListPath, double htkTimeToFrame)
+    : m_htkTimeToFrame(htkTimeToFrame)
+{
+    if (stateListPath.empty())
+        return;
+
+    vector<char> buffer;
+    vector<char*> lines = msra::files::fgetfilelines(stateListPath, buffer);
+    for (size_t i = 0; i < lines.size(); i++)
+        m_stateList[lines[i]] = i;
+    if (m_stateList.size() != lines.size())
+        RuntimeError("MLFParser: state list '%ls' contains duplicate states.", stateListPath.c_str());
+    fprintf(stderr, "total %" PRIu64 " state names in state list %ls\n", m_stateList.size(), stateListPath.c_str());
+}
+
+void MLFParser::Parse(const wstring& path, const function<void(const MLFLabelBlock&)>& consume) const
+{
+    fprintf(stderr, "MLFParser: reading MLF file %ls ...", path.c_str());
+    auto_file_ptr f(fopenOrDie(path, L"rb"));
+
+    // The file is read in blocks, each of which is cut after its last complete utterance; the rest of the block
+    // is moved to the front of the buffer and completed by the next read. An utterance that is longer than
+    // a block grows the buffer.
+    const size_t blockSize = 64 * 1024 * 1024;
+    vector<char> buffer;
+    size_t filled = 0;
+    bool first = true;
+    bool reachedEOF = false;
+
+    const int numParts = omp_get_max_threads();
+    vector<MLFLabelBlock> parts(numParts);
+    vector<exception_ptr> errors(numParts);
+    size_t numUtterances = 0;
+    while (!reachedEOF)
+    {
+        buffer.resize(filled + blockSize);
+        size_t bytesRead = fread(buffer.data() + filled, 1, blockSize, f);
+        if (ferror(f))
+            RuntimeError("MLFParser: error reading from file '%ls': %s", path.c_str(), strerror(errno));
+        reachedEOF = bytesRead != blockSize;
+        filled += bytesRead;
+
+        char* begin = buffer.data();
+        char* end = begin + filled;
+        if (first)
+        {
+            if (!IsLine(begin, LineEnd(begin, end), "#!MLF!#"))
+                RuntimeError("MLFParser: header missing in '%ls'", path.c_str());
+            first = false;
+        }
+
+        // Everything up to the last utterance terminator is parsed now.
+        char* cut = reachedEOF ? end : LastUtteranceEnd(begin, end);
+        if (!cut)
+            continue;
+
+        // Split [begin, cut) into parts at utterance boundaries and parse them in parallel.
+        vector<char*> bounds(numParts + 1, cut);
+        bounds[0] = begin;
+        for (int i = 1; i < numParts; i++)
+        {
+            char* bound = NextUtteranceEnd(begin, max(bounds[i - 1], begin + (cut - begin) * i / numParts), cut);
+            bounds[i] = bound ? bound : cut;
+        }
+
+#pragma omp parallel for schedule(static, 1)
+        for (int i = 0; i < numParts; i++)
+        {
+            parts[i].Clear();
+            try
+            {
+                ParseUtterances(bounds[i], bounds[i + 1], path, parts[i]);
+            }
+            catch (...)
+            {
+                errors[i] = current_exception();
+            }
+        }
+
+        for (int i = 0; i < numParts; i++)
+        {
+            if (errors[i])
+                rethrow_exception(errors[i]);
+            numUtterances += parts[i].NumberOfUtterances();
+            consume(parts[i]);
+        }
+
+        filled = end - cut;
+        memmove(begin, cut, filled);
+    }
+
+    fprintf(stderr, " total %" PRIu64 " entries\n", numUtterances);
+}
+
+void MLFParser::ParseUtterances(char* begin, char* end, const wstring& path, MLFLabelBlock& block) const
+{
+    enum { Header, Entries, Skipping } state = Header;
+    string key;
+    uint32_t numberOfFrames = 0;
+    vector<const char*> tokens;
+    for (char* line = begin; line < end;)
+    {
+        char* lineEnd = LineEnd(line, end);
+        char* next = lineEnd + 1;
+        if (lineEnd > line && lineEnd[-1] == '\r')
+            lineEnd--;
+        *lineEnd = 0; // (the buffer is ours, so tokens are terminated in place; there is always room behind the data)
+        if (lineEnd == line)
+        {
+            line = next;
+            continue;
+        }
+
+        if (IsLine(line, lineEnd, "."))
+        {
+            if (state == Entries)
+            {
+                block.m_keys.push_back(key);
+                block.m_numberOfFrames.push_back(numberOfFrames);
+                block.m_firstRun.push_back(block.m_runStarts.size());
+            }
+            state = Header;
+        }
+        else if (state == Header)
+        {
+            if (IsLine(line, lineEnd, "#!MLF!#")) // embedded duplicate MLF headers (so user can 'cat' MLFs)
+            {
+                line = next;
+                continue;
+            }
+
+            // Some MLF files have write errors, so malformed entries are skipped.
+            size_t length = lineEnd - line;
+            if (length < 3 || line[0] != '"' || line[length - 1] != '"')
+            {
+                fprintf(stderr, "warning: filename entry (%s)\n", line);
+                fprintf(stderr, "skip current mlf entry.\n");
+                state = Skipping;
+                line = next;
+                continue;
+            }
+
+            key.assign(line + 1, length - 2);
+            if (key.find("*/") == 0)
+                key.erase(0, 2);
+            size_t extension = key.find_last_of('.');
+            if (extension != string::npos && key.find_first_of("\\/:", extension) == string::npos)
+                key.erase(extension);
+
+            numberOfFrames = 0;
+            state = Entries;
+        }
+        else if (state == Entries)
+        {
+            tokens.clear();
+            char* context = nullptr;
+            for (char* token = strtok_s(line, " \t", &context); token; token = strtok_s(nullptr, " \t", &context))
+                tokens.push_back(token);
+            if (tokens.size() < 3)
+                RuntimeError("MLFParser: malformed entry for utterance '%s' in '%ls'", key.c_str(), path.c_str());
+
+            // The range is given in frames, or in HTK time units if the end is beyond the largest plausible frame number.
+            double start = msra::strfun::todouble(tokens[0]);
+            double finish = msra::strfun::todouble(tokens[1]);
+            if (finish > m_htkTimeToFrame / 2.0)
+            {
+                start = start / m_htkTimeToFrame + 0.5;
+                finish = finish / m_htkTimeToFrame + 0.5;
+            }
+            size_t firstFrame = (size_t)start;
+            size_t endFrame = (size_t)finish;
+
+            if (endFrame < firstFrame)
+                RuntimeError("MLFParser: end time below start time in utterance '%s'", key.c_str());
+            if (firstFrame != numberOfFrames)
+                RuntimeError("Labels are not in the consecutive order MLF in label set: %s", key.c_str());
+            if (SEQUENCELEN_MAX < endFrame)
+                RuntimeError("Maximum number of sample per sequence exceeded.");
+
+            size_t classId = ParseClassId(tokens);
+            if (classId != static_cast<msra::dbn::CLASSIDTYPE>(classId))
+                RuntimeError("CLASSIDTYPE has too few bits");
+
+            // Runs of the same class are merged.
+            const bool continuesRun = block.m_runStarts.size() > block.m_firstRun.back() && block.m_classIds.back() == classId;
+            if (endFrame > firstFrame && !continuesRun)
+            {
+                block.m_runStarts.push_back((uint32_t)firstFrame);
+                block.m_classIds.push_back(static_cast<msra::dbn::CLASSIDTYPE>(classId));
+            }
+            numberOfFrames = (uint32_t)endFrame;
+        }
+
+        line = next;
+    }
+
+    if (state != Header)
+        RuntimeError("MLFParser: unexpected end in mid-utterance in '%ls'", path.c_str());
+}
+
+size_t MLFParser::ParseClassId(const vector<const char*>& tokens) const
+{
+    if (m_stateList.empty())
+    {
+        if (tokens.size() != 4)
+            RuntimeError("htkmlfentry: currently we only support 4-column format");
+        return (size_t)msra::strfun::toint(tokens[3]);
+    }
+
+    auto state = m_stateList.find(tokens[2]);
+    if (state == m_stateList.end())
+        RuntimeError("htkmlfentry: state %s not found in statelist", tokens[2]);
+    return state->second;
+}
+
+// ---------------------------------------------------------------------------
+// MLFLabelCache
+// ---------------------------------------------------------------------------
+
+const char MLFCacheMagic[8] = { 'C', 'N', 'T', 'K', 'M', 'L', 'F', '\0' };
+const uint32_t MLFCacheVersion = 1;
+
+#pragma pack(push, 1)
+struct MLFCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t classIdSize;   // sizeof(CLASSIDTYPE)
+    uint64_t numUtterances; // UINT64_MAX until the cache is complete
+    uint64_t sourcesLength;
+};
+#pragma pack(pop)
+
+string MLFLabelCache::DescribeSources(const vector<wstring>& mlfPaths, const wstring& stateListPath, double htkTimeToFrame)
+{
+    string sources = msra::strfun::strprintf("htkTimeToFrame=%.17g\n", htkTimeToFrame);
+    auto describe = [&sources](const wstring& path)
+    {
+        sources += msra::strfun::strprintf("%s %" PRId64 "\n", msra::strfun::utf8(path).c_str(), filesize64(path.c_str()));
+    };
+    for (const auto& path : mlfPaths)
+        describe(path);
+    if (!stateListPath.empty())
+        describe(stateListPath);
+    return sources;
+}
+
+bool MLFLabelCache::Read(const wstring& cachePath, const vector<wstring>& mlfPaths, const wstring& stateListPath,
+                         double htkTimeToFrame, const function<void(const MLFLabelBlock&)>& consume)
+{
+    if (!fexists(cachePath))
+        return false;
+    for (const auto& path : mlfPaths)
+    {
+        if (!msra::files::fuptodate(cachePath, path))
+            return false;
+    }
+    if (!stateListPath.empty() && !msra::files::fuptodate(cachePath, stateListPath))
+        return false;
+
+    auto_file_ptr f(fopenOrDie(cachePath, L"rb"));
+    MLFCacheHeader header;
+    freadOrDie(&header, sizeof(header), 1, f);
+    if (memcmp(header.magic, MLFCacheMagic, sizeof(MLFCacheMagic)) != 0 || header.version != MLFCacheVersion ||
+        header.classIdSize != sizeof(msra::dbn::CLASSIDTYPE) || header.numUtterances == UINT64_MAX)
+        return false;
+    string sources(header.sourcesLength, '\0');
+    if (!sources.empty())
+        freadOrDie(&sources[0], 1, sources.size(), f);
+    if (sources != DescribeSources(mlfPaths, stateListPath, htkTimeToFrame))
+        return false;
+
+    fprintf(stderr, "MLFLabelCache: reading %" PRIu64 " utterances from cache %ls\n", header.numUtterances, cachePath.c_str());
+    const size_t utterancesPerBlock = 65536;
+    MLFLabelBlock block;
+    string key;
+    for (uint64_t i = 0; i < header.numUtterances; i++)
+    {
+        uint32_t keyLength, numberOfFrames, numRuns;
+        freadOrDie(&keyLength, sizeof(keyLength), 1, f);
+        key.resize(keyLength);
+        if (keyLength > 0)
+            freadOrDie(&key[0], 1, keyLength, f);
+        freadOrDie(&numberOfFrames, sizeof(numberOfFrames), 1, f);
+        freadOrDie(&numRuns, sizeof(numRuns), 1, f);
+
+        const size_t firstRun = block.m_runStarts.size();
+        block.m_runStarts.resize(firstRun + numRuns);
+        block.m_classIds.resize(firstRun + numRuns);
+        if (numRuns > 0)
+        {
+            freadOrDie(&block.m_runStarts[firstRun], sizeof(uint32_t), numRuns, f);
+            freadOrDie(&block.m_classIds[firstRun], sizeof(msra::dbn::CLASSIDTYPE), numRuns, f);
+        }
+        block.m_keys.push_back(key);
+        block.m_numberOfFrames.push_back(numberOfFrames);
+        block.m_firstRun.push_back(block.m_runStarts.size());
+
+        if (block.NumberOfUtterances() == utterancesPerBlock)
+        {
+            consume(block);
+            block.Clear();
+        }
+    }
+    consume(block);
+    return true;
+}
+
+MLFLabelCache::MLFLabelCache(const wstring& cachePath, const vector<wstring>& mlfPaths, const wstring& stateListPath, double htkTimeToFrame)
+    : m_path(cachePath), m_numUtterances(0)
+{
+    // Written under a name of its own and renamed when complete, since several workers may create the same cache at once.
+    m_temporaryPath = m_path + msra::strfun::wstrprintf(L".%d.tmp", (int)GetCurrentProcessId());
+    m_file = fopenOrDie(m_temporaryPath, L"wb");
+
+    string sources = DescribeSources(mlfPaths, stateListPath, htkTimeToFrame);
+    MLFCacheHeader header;
+    memcpy(header.magic, MLFCacheMagic, sizeof(MLFCacheMagic));
+    header.version = MLFCacheVersion;
+    header.classIdSize = sizeof(msra::dbn::CLASSIDTYPE);
+    header.numUtterances = UINT64_MAX;
+    header.sourcesLength = sources.size();
+    fwriteOrDie(&header, sizeof(header), 1, m_file);
+    if (!sources.empty())
+        fwriteOrDie(sources.data(), 1, sources.size(), m_file);
+}
+
+MLFLabelCache::~MLFLabelCache()
+{
+    if (m_file != nullptr)
+    {
+        fclose(m_file);
+        _wunlink(m_temporaryPath.c_str());
+    }
+}
+
+void MLFLabelCache::Write(const MLFLabelBlock& block)
+{
+    for (size_t i = 0; i < block.NumberOfUtterances(); i++)
+    {
+        const string& key = block.m_keys[i];
+        const size_t firstRun = block.m_firstRun[i];
+        const uint32_t keyLength = (uint32_t)key.size();
+        const uint32_t numRuns = (uint32_t)(block.m_firstRun[i + 1] - firstRun);
+        fwriteOrDie(&keyLength, sizeof(keyLength), 1, m_file);
+        if (keyLength > 0)
+            fwriteOrDie(key.data(), 1, keyLength, m_file);
+        fwriteOrDie(&block.m_numberOfFrames[i], sizeof(uint32_t), 1, m_file);
+        fwriteOrDie(&numRuns, sizeof(numRuns), 1, m_file);
+        if (numRuns > 0)
+        {
+            fwriteOrDie(&block.m_runStarts[firstRun], sizeof(uint32_t), numRuns, m_file);
+            fwriteOrDie(&block.m_classIds[firstRun], sizeof(msra::dbn::CLASSIDTYPE), numRuns, m_file);
+        }
+    }
+    m_numUtterances += block.NumberOfUtterances();
+}
+
+void MLFLabelCache::Close()
+{
+    fsetpos(m_file, offsetof(MLFCacheHeader, numUtterances));
+    fwriteOrDie(&m_numUtterances, sizeof(m_numUtterances), 1, m_file);
+    fcloseOrDie(m_file);
+    m_file = nullptr;
+
+    // (another worker may have finished first; both caches are the same)
+    if (fexists(m_path))
+        _wunlink(m_path.c_str());
+    renameOrDie(m_temporaryPath, m_path);
+    fprintf(stderr, "MLFLabelCache: wrote %" PRIu64 " utterances to cache %ls\n", m_numUtterances, m_path.c_str());
+}
+
+}}}
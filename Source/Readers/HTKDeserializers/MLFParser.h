@@ -0,0 +1,92 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../HTKMLFReader/htkfeatio.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Frame labels of consecutive utterances of an MLF in run-length form: an utterance is a sequence of runs
+// of frames with the same class id, and a run ends where the next one starts.
+struct MLFLabelBlock
+{
+    std::vector<std::string> m_keys;                // [utterance] logical path without "*/" and extension
+    std::vector<uint32_t> m_numberOfFrames;         // [utterance]
+    std::vector<size_t> m_firstRun;                 // [utterance] index of the first run, plus one element for the end
+    std::vector<uint32_t> m_runStarts;              // [run] first frame of the run within its utterance
+    std::vector<msra::dbn::CLASSIDTYPE> m_classIds; // [run]
+
+    MLFLabelBlock()
+        : m_firstRun(1, 0)
+    {
+    }
+
+    size_t NumberOfUtterances() const { return m_keys.size(); }
+
+    void Clear();
+};
+
+// Streaming MLF parser. The file is read in large blocks, and the utterances of each block are parsed in parallel
+// straight into run-length form, so neither the whole text nor per-entry objects are ever held in memory.
+// Accepts the same formats as msra::asr::htkmlfreader: "start end senone [...]" with a state list,
+// or "start end name classid" without one.
+class MLFParser
+{
+public:
+    MLFParser(const std::wstring& stateListPath, double htkTimeToFrame);
+
+    // Parses an MLF file and hands the utterances to 'consume' one block at a time, in file order.
+    void Parse(const std::wstring& path, const std::function<void(const MLFLabelBlock&)>& consume) const;
+
+private:
+    // Parses the complete utterances in [begin, end). The lines are terminated in place.
+    void ParseUtterances(char* begin, char* end, const std::wstring& path, MLFLabelBlock& block) const;
+    size_t ParseClassId(const std::vector<const char*>& tokens) const;
+
+    std::unordered_map<std::string, size_t> m_stateList;
+    double m_htkTimeToFrame;
+};
+
+// Binary cache of the parsed labels of a set of MLFs, so that later runs skip the parsing.
+// The cache records the paths and sizes of the MLFs and the state list, and is only used if they still match
+// and it is newer than all of them.
+//
+// Layout of the file (native byte order):
+//   MLFCacheHeader
+//   sources      header.sourcesLength characters
+//   utterances   per utterance: uint32 key length, key, uint32 number of frames, uint32 number of runs,
+//                run starts (uint32 each), class ids (CLASSIDTYPE each)
+class MLFLabelCache
+{
+public:
+    // Reads the cache and hands its utterances to 'consume'. Returns false if the cache is missing or outdated.
+    static bool Read(const std::wstring& cachePath, const std::vector<std::wstring>& mlfPaths, const std::wstring& stateListPath,
+                     double htkTimeToFrame, const std::function<void(const MLFLabelBlock&)>& consume);
+
+    MLFLabelCache(const std::wstring& cachePath, const std::vector<std::wstring>& mlfPaths, const std::wstring& stateListPath, double htkTimeToFrame);
+    ~MLFLabelCache();
+
+    void Write(const MLFLabelBlock& block);
+
+    // Marks the cache as complete. A cache that is not closed, e.g. because parsing failed, is deleted.
+    void Close();
+
+private:
+    static std::string DescribeSources(const std::vector<std::wstring>& mlfPaths, const std::wstring& stateListPath, double htkTimeToFrame);
+
+    std::wstring m_path;
+    std::wstring m_temporaryPath;
+    FILE* m_file;
+    uint64_t m_numUtterances;
+};
+
+}}}
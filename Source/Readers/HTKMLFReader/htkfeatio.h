@@ -339,9 +339,18 @@ public:
     // parser for complex a=b[s,e] syntax
     struct parsedpath
     {
+        // Physical paths of archives are stored once, and referred to by their index.
         // Note: This is not thread-safe
-        static std::unordered_map<std::wstring, unsigned int> archivePathStringMap;
-        static std::vector<std::wstring> archivePathStringVector;
+        static std::unordered_map<std::wstring, unsigned int>& archivePathStringMap()
+        {
+            static std::unordered_map<std::wstring, unsigned int> map;
+            return map;
+        }
+        static std::vector<std::wstring>& archivePathStringVector()
+        {
+            static std::vector<std::wstring> paths;
+            return paths;
+        }
 
     protected:
         friend class htkfeatreader;
@@ -354,7 +363,7 @@ public:
         // physical path of archive file
         wstring archivepath() const
         {
-            return archivePathStringVector[archivePathIdx];
+            return archivePathStringVector()[archivePathIdx];
         }
 
         bool isarchive;      // true if archive (range specified)
@@ -422,21 +431,35 @@ public:
                 }
             }
 
-            auto iter = archivePathStringMap.find(archivepath);
-            if (iter != archivePathStringMap.end())
+            setarchivepath(archivepath);
+            logicalpath = msra::strfun::utf8(localLogicalpath);
+        }
+
+        // constructor for frames [s,e] of an archive file, the same as parsing "logicalPath=archivePath[s,e]"
+        parsedpath(const std::string& logicalPath, const wstring& archivePath, size_t first, size_t last)
+            : logicalpath(logicalPath), isarchive(true), isidxformat(false), s(first), e(last)
+        {
+            setarchivepath(archivePath);
+        }
+
+    private:
+        void setarchivepath(const wstring& archivepath)
+        {
+            auto& map = archivePathStringMap();
+            auto iter = map.find(archivepath);
+            if (iter != map.end())
             {
                 archivePathIdx = iter->second;
             }
             else
             {
-                archivePathIdx = (unsigned int)archivePathStringMap.size();
-                archivePathStringMap[archivepath] = archivePathIdx;
-                archivePathStringVector.push_back(archivepath);
+                archivePathIdx = (unsigned int)map.size();
+                map[archivepath] = archivePathIdx;
+                archivePathStringVector().push_back(archivepath);
             }
-
-            logicalpath = msra::strfun::utf8(localLogicalpath);
         }
 
+    public:
         // get the physical path for 'make' test
         wstring physicallocation() const
         {
@@ -5,16 +5,23 @@
 
 #pragma once
 #include <opencv2/core/mat.hpp>
+#include <vector>
 #include "Config.h"
+#include "ConcPool.h"
 #ifdef USE_ZIP
 #include <zip.h>
 #include <unordered_map>
 #include <memory>
-#include "ConcStack.h"
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Decodes an image from its encoded bytes. If 'minShortSide' is not 0 and the image is a JPEG whose shorter side is at least
+// twice 'minShortSide', it is decoded at 1/2, 1/4 or 1/8 of its resolution (scaled inverse DCT in libjpeg), using the
+// strongest reduction that keeps the shorter side at least 'minShortSide' pixels long. This saves most of the decoding
+// work for large images that are cropped and scaled down to a small network input anyway.
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t minShortSide);
+
 class ByteReader
 {
 public:
@@ -22,7 +29,8 @@ public:
     virtual ~ByteReader() = default;
 
     virtual void Register(size_t seqId, const std::string& path) = 0;
-    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
+    // 'minShortSide' allows reduced-resolution decoding, see DecodeImage(); 0 always decodes the full image.
+    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t minShortSide) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
 };
@@ -31,7 +39,10 @@ class FileByteReader : public ByteReader
 {
 public:
     void Register(size_t, const std::string&) override {}
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t minShortSide) override;
+
+private:
+    conc_pool<std::vector<unsigned char>> m_workspace;
 };
 
 #ifdef USE_ZIP
@@ -39,18 +50,33 @@ class ZipByteReader : public ByteReader
 {
 public:
     ZipByteReader(const std::string& zipPath);
+    ~ZipByteReader();
 
     void Register(size_t seqId, const std::string& path) override;
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t minShortSide) override;
 
 private:
-    using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
+    struct ZipCloser
+    {
+        void operator()(zip_t* z) const;
+    };
+    using ZipPtr = std::unique_ptr<zip_t, ZipCloser>; // (a stateless deleter keeps ZipPtr default-constructible, as conc_pool requires)
     ZipPtr OpenZip();
 
+    // Stored (uncompressed) entries, which is how JPEGs are usually zipped, are decoded directly from a read-only
+    // memory mapping of the zip file, without opening a zip stream or copying the bytes. Compressed entries are
+    // inflated by libzip into pooled buffers.
+    struct MappedFile;
+    void IndexStoredEntries();
+
     std::string m_zipPath;
-    conc_stack<ZipPtr> m_zips;
+    conc_pool<ZipPtr> m_zips;
     std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
-    conc_stack<std::vector<unsigned char>> m_workspace;
+    conc_pool<std::vector<unsigned char>> m_workspace;
+
+    std::unique_ptr<MappedFile> m_mappedFile;
+    std::unordered_map<std::string, std::pair<size_t, size_t>> m_storedEntries; // entry name -> (data offset, size)
+    std::unordered_map<size_t, std::pair<size_t, size_t>> m_seqIdToStored;      // sequence id -> (data offset, size)
 };
 #endif
 
@@ -0,0 +1,135 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "ImageCache.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ImageCache::ImageCache(size_t memoryBudget, const std::wstring& spillPath, size_t spillBudget)
+    : m_memoryBudget(memoryBudget), m_memoryUsed(0),
+      m_spillPath(spillPath), m_spillFile(nullptr), m_spillBudget(spillBudget), m_spillSize(0)
+{
+    if (!m_spillPath.empty())
+    {
+        m_spillFile = fopenOrDie(m_spillPath, L"w+b");
+        fprintf(stderr, "ImageCache: spilling decoded images to '%ls'\n", m_spillPath.c_str());
+    }
+}
+
+ImageCache::~ImageCache()
+{
+    // The spill file is a temporary.
+    if (m_spillFile != nullptr)
+    {
+        fclose(m_spillFile);
+        if (_wunlink(m_spillPath.c_str()) != 0)
+            fprintf(stderr, "ImageCache: unable to delete the spill file '%ls'\n", m_spillPath.c_str());
+    }
+}
+
+cv::Mat ImageCache::Get(const std::string& key)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto cached = m_images.find(key);
+        if (cached != m_images.end())
+        {
+            // Move to the front of the LRU list.
+            m_lru.splice(m_lru.begin(), m_lru, cached->second.m_lruPosition);
+            return cached->second.m_image;
+        }
+    }
+
+    if (m_spillFile == nullptr)
+        return cv::Mat();
+
+    cv::Mat image = ReadSpilled(key);
+    if (!image.empty())
+        Put(key, image);
+    return image;
+}
+
+void ImageCache::Put(const std::string& key, const cv::Mat& image)
+{
+    if (SizeOf(image) > m_memoryBudget)
+        return;
+
+    std::vector<std::pair<std::string, cv::Mat>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        Insert(key, image, evicted);
+    }
+
+    // Spill outside of m_lock, so that lookups of in-memory images do not wait for the disk.
+    if (m_spillFile != nullptr && !evicted.empty())
+        Spill(evicted);
+}
+
+void ImageCache::Insert(const std::string& key, const cv::Mat& image, std::vector<std::pair<std::string, cv::Mat>>& evicted)
+{
+    // Another thread may have decoded the same image concurrently.
+    if (m_images.find(key) != m_images.end())
+        return;
+
+    m_lru.push_front(key);
+    CachedImage& cached = m_images[key];
+    cached.m_image = image;
+    cached.m_lruPosition = m_lru.begin();
+    m_memoryUsed += SizeOf(image);
+
+    while (m_memoryUsed > m_memoryBudget)
+    {
+        assert(!m_lru.empty());
+        auto victim = m_images.find(m_lru.back());
+        assert(victim != m_images.end());
+        m_memoryUsed -= SizeOf(victim->second.m_image);
+        evicted.push_back(std::make_pair(victim->first, victim->second.m_image));
+        m_images.erase(victim);
+        m_lru.pop_back();
+    }
+}
+
+cv::Mat ImageCache::ReadSpilled(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_spillLock);
+    auto spilled = m_spilled.find(key);
+    if (spilled == m_spilled.end())
+        return cv::Mat();
+
+    const SpilledImage& location = spilled->second;
+    cv::Mat image(location.m_rows, location.m_cols, location.m_type);
+    assert(image.isContinuous());
+    fsetpos(m_spillFile, location.m_offset);
+    freadOrDie(image.data, SizeOf(image), 1, m_spillFile);
+    return image;
+}
+
+void ImageCache::Spill(const std::vector<std::pair<std::string, cv::Mat>>& images)
+{
+    std::lock_guard<std::mutex> lock(m_spillLock);
+    for (const auto& evicted : images)
+    {
+        // Images that were read back from the spill file are still there.
+        const cv::Mat& image = evicted.second;
+        if (m_spilled.find(evicted.first) != m_spilled.end() || m_spillSize + SizeOf(image) > m_spillBudget)
+            continue;
+
+        assert(image.isContinuous());
+        fsetpos(m_spillFile, m_spillSize);
+        fwriteOrDie(image.data, SizeOf(image), 1, m_spillFile);
+
+        SpilledImage location;
+        location.m_offset = m_spillSize;
+        location.m_rows = image.rows;
+        location.m_cols = image.cols;
+        location.m_type = image.type();
+        m_spilled[evicted.first] = location;
+        m_spillSize += SizeOf(image);
+    }
+}
+
+}}}
@@ -0,0 +1,81 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Cache of decoded images that lives across epochs, so that an image is read and decoded only once as long as
+// the cache is large enough. Images are kept in memory up to a byte budget, the least recently used ones are
+// evicted first. Optionally, evicted images are spilled into a file in raw pixel format (e.g. on a local SSD),
+// from which they are read back instead of being decoded again; the spill file is deleted with the cache.
+// All methods are thread-safe. Cached images are shared with the callers and must not be modified.
+class ImageCache
+{
+public:
+    ImageCache(size_t memoryBudget, const std::wstring& spillPath, size_t spillBudget);
+    ~ImageCache();
+
+    // Returns the cached image, or an empty matrix if the image is not cached.
+    cv::Mat Get(const std::string& key);
+
+    // Adds a decoded image to the cache.
+    void Put(const std::string& key, const cv::Mat& image);
+
+private:
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    struct CachedImage
+    {
+        cv::Mat m_image;
+        std::list<std::string>::iterator m_lruPosition;
+    };
+
+    struct SpilledImage
+    {
+        uint64_t m_offset;
+        int m_rows;
+        int m_cols;
+        int m_type;
+    };
+
+    static size_t SizeOf(const cv::Mat& image)
+    {
+        return image.total() * image.elemSize();
+    }
+
+    // Adds the image and removes the least recently used images beyond the budget, which are returned in 'evicted'.
+    // Called under m_lock.
+    void Insert(const std::string& key, const cv::Mat& image, std::vector<std::pair<std::string, cv::Mat>>& evicted);
+
+    cv::Mat ReadSpilled(const std::string& key);
+    void Spill(const std::vector<std::pair<std::string, cv::Mat>>& images);
+
+    // In-memory images, guarded by m_lock.
+    std::mutex m_lock;
+    std::unordered_map<std::string, CachedImage> m_images;
+    std::list<std::string> m_lru; // most recently used first
+    size_t m_memoryBudget;
+    size_t m_memoryUsed;
+
+    // Spill file, guarded by m_spillLock. Spilled images stay in the file until the cache is destroyed.
+    std::mutex m_spillLock;
+    std::wstring m_spillPath;
+    FILE* m_spillFile;
+    std::unordered_map<std::string, SpilledImage> m_spilled;
+    size_t m_spillBudget;
+    uint64_t m_spillSize;
+};
+
+}}}
@@ -4,6 +4,8 @@
 //
 
 #include "stdafx.h"
+#include <algorithm>
+#include <cmath>
 #include "ImageConfigHelper.h"
 #include "StringUtil.h"
 #include "ConfigUtil.h"
@@ -95,6 +97,17 @@ ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
     m_cpuThreadCount = config(L"numCPUThreads", 0);
 
     m_cropType = ParseCropType(featureSection(L"cropType", ""));
+
+    m_fusedTransforms = featureSection(L"fusedTransforms", false);
+
+    // The smallest crop side is min(rows, cols) * cropRatioMin * sqrt(1 - aspectRatioRadius) (see CropTransformer),
+    // it must not be smaller than the network input.
+    floatargvector cropRatio = featureSection(L"cropRatio", "1.0");
+    doubleargvector aspectRatioRadius = featureSection(L"aspectRatioRadius", ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
+    double maxAspectRatioRadius = *std::max_element(aspectRatioRadius.begin(), aspectRatioRadius.end());
+    m_decodeMinShortSide = 0;
+    if (0 < cropRatio[0] && maxAspectRatioRadius < 1.0)
+        m_decodeMinShortSide = (size_t)std::ceil(std::max(w, h) / (cropRatio[0] * std::sqrt(1.0 - maxAspectRatioRadius)));
 }
 
 std::vector<StreamDescriptionPtr> ImageConfigHelper::GetStreams() const
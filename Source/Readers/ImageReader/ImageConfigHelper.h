@@ -68,6 +68,19 @@ public:
         return m_cropType == CropType::MultiView10;
     }
 
+    // Whether the image transformations are done by the single FusedImageTransformer.
+    bool UseFusedTransforms() const
+    {
+        return m_fusedTransforms;
+    }
+
+    // Minimal length of the shorter image side for which a crop of the configured ratio
+    // still covers the network input without upscaling, 0 if there is no such bound.
+    size_t GetDecodeMinShortSide() const
+    {
+        return m_decodeMinShortSide;
+    }
+
     static CropType ParseCropType(const std::string &src);
 
 private:
@@ -81,6 +94,8 @@ private:
     bool m_randomize;
     bool m_grayscale;
     CropType m_cropType;
+    bool m_fusedTransforms;
+    size_t m_decodeMinShortSide;
 };
 
 typedef std::shared_ptr<ImageConfigHelper> ImageConfigHelperPtr;
@@ -56,12 +56,6 @@ private:
     vector<IndexType> m_indices;
 };
 
-// Used to keep track of the image. Accessed only using DenseSequenceData interface.
-struct DeserializedImage : DenseSequenceData
-{
-    cv::Mat m_image;
-};
-
 // For image, chunks correspond to a single image.
 class ImageDataDeserializer::ImageChunk : public Chunk, public std::enable_shared_from_this<ImageChunk>
 {
@@ -79,8 +73,22 @@ public:
         assert(sequenceId == m_description.m_id);
         const auto& imageSequence = m_description;
 
+        // Cached images are shared: they are either converted into a new buffer below,
+        // or passed to the FusedImageTransformer, which does not modify its input.
         auto image = std::make_shared<DeserializedImage>();
-        image->m_image = std::move(m_parent.ReadImage(m_description.m_id, imageSequence.m_path, m_parent.m_grayscale));
+        auto& cache = m_parent.m_imageCache;
+        if (cache)
+        {
+            image->m_image = cache->Get(imageSequence.m_path);
+        }
+        if (image->m_image.empty())
+        {
+            image->m_image = std::move(m_parent.ReadImage(m_description.m_id, imageSequence.m_path, m_parent.m_grayscale, m_parent.m_decodeMinShortSide));
+            if (cache && image->m_image.data)
+            {
+                cache->Put(imageSequence.m_path, image->m_image);
+            }
+        }
         auto& cvImage = image->m_image;
 
         if (!cvImage.data)
@@ -88,9 +96,9 @@ public:
             RuntimeError("Cannot open file '%s'", imageSequence.m_path.c_str());
         }
 
-        // Convert element type.
+        // Convert element type, unless the fused transformer does that on the cropped and scaled image.
         int dataType = m_parent.m_featureElementType == ElementType::tfloat ? CV_32F : CV_64F;
-        if (cvImage.type() != CV_MAKETYPE(dataType, cvImage.channels()))
+        if (!m_parent.m_keepDecodedElementType && cvImage.type() != CV_MAKETYPE(dataType, cvImage.channels()))
         {
             cvImage.convertTo(cvImage, dataType);
         }
@@ -120,6 +128,7 @@ public:
 // A new constructor to support new compositional configuration,
 // that allows composition of deserializers and transforms on inputs.
 ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config)
+    : m_keepDecodedElementType(false), m_decodeMinShortSide(0)
 {
     ConfigParameters inputs = config("input");
     std::vector<std::string> featureNames = GetSectionsWithParameter("ImageDataDeserializer", inputs, "transforms");
@@ -166,6 +175,7 @@ ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const C
     // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
     bool multiViewCrop = config(L"multiViewCrop", false);
     CreateSequenceDescriptions(corpus, config(L"file"), labelDimension, multiViewCrop);
+    CreateImageCache(config);
 }
 
 // TODO: Should be removed at some point.
@@ -176,6 +186,8 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     m_streams = configHelper.GetStreams();
     assert(m_streams.size() == 2);
     m_grayscale = configHelper.UseGrayscale();
+    m_keepDecodedElementType = configHelper.UseFusedTransforms();
+    m_decodeMinShortSide = configHelper.UseFusedTransforms() ? configHelper.GetDecodeMinShortSide() : 0;
     const auto& label = m_streams[configHelper.GetLabelStreamId()];
     const auto& feature = m_streams[configHelper.GetFeatureStreamId()];
 
@@ -203,6 +215,21 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     }
 
     CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(), configHelper.GetMapPath(), labelDimension, configHelper.IsMultiViewCrop());
+    CreateImageCache(config);
+}
+
+void ImageDataDeserializer::CreateImageCache(const ConfigParameters& config)
+{
+    size_t cacheSizeMB = config(L"imageCacheSizeMB", (size_t)0);
+    if (cacheSizeMB == 0)
+    {
+        return;
+    }
+
+    std::wstring spillPath = config(L"imageCacheSpillFile", L"");
+    size_t spillSizeMB = config(L"imageCacheSpillSizeMB", (size_t)0);
+    size_t spillBudget = spillSizeMB == 0 ? std::numeric_limits<size_t>::max() : spillSizeMB << 20;
+    m_imageCache = std::make_unique<ImageCache>(cacheSizeMB << 20, spillPath, spillBudget);
 }
 
 // Descriptions of chunks exposed by the image reader.
@@ -344,21 +371,105 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
 #endif
 }
 
-cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale)
+cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale, size_t minShortSide)
 {
     assert(!path.empty());
 
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader.Read(seqId, path, grayscale);
-    return (*r).second->Read(seqId, path, grayscale);
+        return m_defaultReader.Read(seqId, path, grayscale, minShortSide);
+    return (*r).second->Read(seqId, path, grayscale, minShortSide);
 }
 
-cv::Mat FileByteReader::Read(size_t, const std::string& path, bool grayscale)
+cv::Mat FileByteReader::Read(size_t, const std::string& path, bool grayscale, size_t minShortSide)
 {
     assert(!path.empty());
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (minShortSide == 0)
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+
+    // Read the encoded image ourselves, so that DecodeImage() can look at its header before decoding.
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return cv::Mat(); // (reported by the caller)
+    size_t size = (size_t)file.tellg();
+    file.seekg(0);
+
+    auto contents = m_workspace.pop_or_create([size]() { return std::vector<unsigned char>(size); });
+    if (contents.size() < size)
+        contents.resize(size);
+    cv::Mat image;
+    if (file.read(reinterpret_cast<char*>(contents.data()), size))
+        image = DecodeImage(contents.data(), size, grayscale, minShortSide);
+    m_workspace.push(std::move(contents));
+    return image;
+}
+
+// Reads the dimensions of a JPEG image from its frame header (SOFn segment) without decoding it.
+// Returns false if the data is not a JPEG image or the frame header could not be found.
+static bool GetJpegDimensions(const unsigned char* data, size_t size, size_t& width, size_t& height)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) // start of image
+        return false;
+
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+            return false;
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) // fill byte
+        {
+            pos++;
+            continue;
+        }
+        if (marker == 0x01 || (0xD0 <= marker && marker <= 0xD7)) // markers without a segment
+        {
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) // end of image or start of scan before any frame header
+            return false;
+
+        // SOF0..SOF15, except for DHT (0xC4), JPG (0xC8) and DAC (0xCC) which share the range:
+        // length (2 bytes), sample precision (1 byte), height (2 bytes), width (2 bytes), ...
+        if (0xC0 <= marker && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (pos + 9 > size)
+                return false;
+            height = ((size_t)data[pos + 5] << 8) | data[pos + 6];
+            width = ((size_t)data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+
+        size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+        pos += 2 + length;
+    }
+    return false;
+}
+
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t minShortSide)
+{
+    int flags = grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+
+    // The reduced-resolution modes of imdecode are available since OpenCV 3.1.
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1)
+    size_t width, height;
+    if (minShortSide > 0 && GetJpegDimensions(data, size, width, height))
+    {
+        size_t shortSide = std::min(width, height);
+        if (shortSide >= 8 * minShortSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        else if (shortSide >= 4 * minShortSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        else if (shortSide >= 2 * minShortSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    }
+#else
+    UNUSED(minShortSide);
+#endif
+
+    return cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, const_cast<unsigned char*>(data)), flags);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
@@ -8,11 +8,19 @@
 #include "DataDeserializerBase.h"
 #include "Config.h"
 #include "ByteReader.h"
+#include "ImageCache.h"
 #include <unordered_map>
 #include "CorpusDescriptor.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Used to keep track of the image. Transformers access it using the DenseSequenceData interface,
+// except for the FusedImageTransformer, which also accepts the image in its decoded 8-bit form.
+struct DeserializedImage : DenseSequenceData
+{
+    cv::Mat m_image;
+};
+
 // Image data deserializer based on the OpenCV library.
 // The deserializer currently supports two output streams only: a feature and a label stream.
 // All sequences consist only of a single sample (image/label).
@@ -70,10 +78,22 @@ private:
     // whether images shall be loaded in grayscale 
     bool m_grayscale;
 
+    // Whether images are passed on in their decoded element type (8-bit) instead of being converted to the feature element type.
+    // Only used together with the FusedImageTransformer, which converts after cropping and scaling.
+    bool m_keepDecodedElementType;
+
+    // Minimal length of the shorter image side when decoding at reduced resolution, 0 to always decode at full resolution.
+    size_t m_decodeMinShortSide;
+
     // Not using nocase_compare here as it's not correct on Linux.
     using PathReaderMap = std::unordered_map<std::string, std::shared_ptr<ByteReader>>;
     void RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders);
-    cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale);
+    cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale, size_t minShortSide);
+
+    // Creates the cache of decoded images if the configuration asks for one: 'imageCacheSizeMB' is the memory budget,
+    // 'imageCacheSpillFile' an optional file for images evicted from memory, 'imageCacheSpillSizeMB' its budget (0 for no limit).
+    void CreateImageCache(const ConfigParameters& config);
+    std::unique_ptr<ImageCache> m_imageCache;
 
     // REVIEW alexeyk: can potentially use vector instead of map. Need to handle default reader and resizing though.
     using SeqReaderMap = std::unordered_map<size_t, std::shared_ptr<ByteReader>>;
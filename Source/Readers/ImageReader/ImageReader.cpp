@@ -60,18 +60,29 @@ ImageReader::ImageReader(MemoryProviderPtr provider,
     ConfigParameters featureStream = config(featureName);
 
     std::vector<Transformation> transformations;
-    transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
-
-    if (configHelper.GetDataFormat() == CHW)
+    if (configHelper.UseFusedTransforms())
+    {
+        // The deserializer passes the decoded images as they are, the fused transformer does all the work in one go.
+        transformations.push_back(Transformation{ std::make_shared<FusedImageTransformer>(featureStream, configHelper.GetDataFormat()), featureName });
+    }
+    else
     {
-        transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+
+        if (configHelper.GetDataFormat() == CHW)
+        {
+            transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        }
     }
 
-    m_sequenceEnumerator = std::make_shared<TransformController>(transformations, randomizer);
+    // Sequences of the next minibatch(es) are transformed ahead, so that the image transformations
+    // keep all threads busy across minibatch boundaries.
+    size_t transformLookAhead = config(L"transformLookAhead", (size_t)1);
+    m_sequenceEnumerator = std::make_shared<TransformController>(transformations, randomizer, transformLookAhead);
 
     m_packer = std::make_shared<FramePacker>(
         m_provider,
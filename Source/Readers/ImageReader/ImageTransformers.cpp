@@ -8,8 +8,9 @@
 #include <unordered_map>
 #include <random>
 #include "ImageTransformers.h"
+#include "ImageDataDeserializer.h"
 #include "Config.h"
-#include "ConcStack.h"
+#include "ConcPool.h"
 #include "StringUtil.h"
 #include "ElementTypeUtils.h"
 
@@ -128,6 +129,16 @@ void CropTransformer::StartEpoch(const EpochConfiguration &config)
 }
 
 void CropTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    bool flip;
+    mat = mat(DrawCrop(id, mat.rows, mat.cols, flip));
+    if (flip)
+    {
+        cv::flip(mat, mat, 1);
+    }
+}
+
+cv::Rect CropTransformer::DrawCrop(size_t id, int rows, int cols, bool& flip)
 {
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
@@ -155,14 +166,12 @@ void CropTransformer::Apply(size_t id, cv::Mat &mat)
 
     int viewIndex = m_cropType == CropType::MultiView10 ? (int)(id % 10) : 0;
 
-    mat = mat(GetCropRect(m_cropType, viewIndex, mat.rows, mat.cols, ratio, *rng));
-    if ((m_hFlip && std::bernoulli_distribution()(*rng)) ||
-        viewIndex >= 5)
-    {
-        cv::flip(mat, mat, 1);
-    }
+    cv::Rect crop = GetCropRect(m_cropType, viewIndex, rows, cols, ratio, *rng);
+    flip = (m_hFlip && std::bernoulli_distribution()(*rng)) ||
+           viewIndex >= 5;
 
     m_rngs.push(std::move(rng));
+    return crop;
 }
 
 CropTransformer::RatioJitterType
@@ -334,14 +343,19 @@ void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
         mat.convertTo(mat, m_imageElementType);
     }
 
+    cv::resize(mat, mat, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, DrawInterpolation());
+}
+
+int ScaleTransformer::DrawInterpolation()
+{
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
 
     auto index = UniIntT(0, static_cast<int>(m_interp.size()) - 1)(*rng);
     assert(m_interp.size() > 0);
-    cv::resize(mat, mat, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, m_interp[index]);
 
     m_rngs.push(std::move(rng));
+    return m_interp[index];
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -512,6 +526,28 @@ void IntensityTransformer::Apply(size_t id, cv::Mat &mat)
 template <typename ElemType>
 void IntensityTransformer::Apply(cv::Mat &mat)
 {
+    cv::Mat shifts;
+    DrawShifts(shifts);
+
+    // For multi-channel images data is in BGR format.
+    size_t cdst = mat.rows * mat.cols * mat.channels();
+    ElemType* pdstBase = reinterpret_cast<ElemType*>(mat.data);
+    for (ElemType* pdst = pdstBase; pdst < pdstBase + cdst;)
+    {
+        for (int c = 0; c < mat.channels(); c++)
+        {
+            float shift = shifts.at<float>(mat.channels() - c - 1);
+            *pdst = std::min(std::max(*pdst + shift, (ElemType)0), (ElemType)255);
+            pdst++;
+        }
+    }
+}
+
+bool IntensityTransformer::DrawShifts(cv::Mat& shifts)
+{
+    if (m_eigVal.empty() || m_eigVec.empty() || m_curStdDev == 0)
+        return false;
+
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); } );
 
@@ -526,20 +562,8 @@ void IntensityTransformer::Apply(cv::Mat &mat)
 
     assert(m_eigVec.rows == 3 && m_eigVec.cols == 3);
 
-    cv::Mat shifts = m_eigVec * alphas.t();
-
-    // For multi-channel images data is in BGR format.
-    size_t cdst = mat.rows * mat.cols * mat.channels();
-    ElemType* pdstBase = reinterpret_cast<ElemType*>(mat.data);
-    for (ElemType* pdst = pdstBase; pdst < pdstBase + cdst;)
-    {
-        for (int c = 0; c < mat.channels(); c++)
-        {
-            float shift = shifts.at<float>(mat.channels() - c - 1);
-            *pdst = std::min(std::max(*pdst + shift, (ElemType)0), (ElemType)255);
-            pdst++;
-        }
-    }
+    shifts = m_eigVec * alphas.t();
+    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -591,61 +615,269 @@ void ColorTransformer::Apply(cv::Mat &mat)
 
     if (m_curBrightnessRadius > 0 || m_curContrastRadius > 0)
     {
-        // To change brightness and/or contrast the following standard transformation is used:
-        // Xij = alpha * Xij + beta, where
-        // alpha is a contrast adjustment and beta - brightness adjustment.
-        ElemType beta = 0;
-        if (m_curBrightnessRadius > 0)
-        {
-            UniRealT d(-m_curBrightnessRadius, m_curBrightnessRadius);
-            // Compute mean value of the image.
-            cv::Scalar imgMean = cv::sum(cv::sum(mat));
-            // Compute beta as a fraction of the mean.
-            beta = (ElemType)(d(*rng) * imgMean[0] / (mat.rows * mat.cols * mat.channels()));
-        }
+        double alpha, beta;
+        DrawContrastAndBrightness(mat, *rng, alpha, beta);
+        ApplyContrastAndBrightness(mat, (ElemType)alpha, (ElemType)beta);
+    }
+
+    if (m_curSaturationRadius > 0 && mat.channels() == 3)
+    {
+        ApplySaturation<ElemType>(mat, DrawSaturationRatio(*rng));
+    }
+
+    m_rngs.push(std::move(rng));
+}
+
+void ColorTransformer::DrawContrastAndBrightness(const cv::Mat& mat, std::mt19937& rng, double& alpha, double& beta)
+{
+    // To change brightness and/or contrast the following standard transformation is used:
+    // Xij = alpha * Xij + beta, where
+    // alpha is a contrast adjustment and beta - brightness adjustment.
+    beta = 0;
+    if (m_curBrightnessRadius > 0)
+    {
+        UniRealT d(-m_curBrightnessRadius, m_curBrightnessRadius);
+        // Compute mean value of the image.
+        cv::Scalar imgMean = cv::sum(cv::sum(mat));
+        // Compute beta as a fraction of the mean.
+        beta = d(rng) * imgMean[0] / (mat.rows * mat.cols * mat.channels());
+    }
+
+    alpha = 1;
+    if (m_curContrastRadius > 0)
+    {
+        UniRealT d(-m_curContrastRadius, m_curContrastRadius);
+        alpha = 1 + d(rng);
+    }
+}
+
+template <typename ElemType>
+void ColorTransformer::ApplyContrastAndBrightness(cv::Mat& mat, ElemType alpha, ElemType beta)
+{
+    // Could potentially use mat.convertTo(mat, -1, alpha, beta) 
+    // but it does not do range checking for single/double precision matrix. saturate_cast won't work either.
+    size_t count = mat.rows * mat.cols * mat.channels();
+    ElemType* pbase = reinterpret_cast<ElemType*>(mat.data);
+    for (ElemType* p = pbase; p < pbase + count; p++)
+    {
+        *p = std::min(std::max(*p * alpha + beta, (ElemType)0), (ElemType)255);
+    }
+}
+
+double ColorTransformer::DrawSaturationRatio(std::mt19937& rng)
+{
+    UniRealT d(-m_curSaturationRadius, m_curSaturationRadius);
+    double ratio = 1.0 + d(rng);
+    assert(0 <= ratio && ratio <= 2);
+    return ratio;
+}
+
+template <typename ElemType>
+void ColorTransformer::ApplySaturation(cv::Mat& mat, double ratio)
+{
+    auto hsv = m_hsvTemp.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
+
+    // To change saturation, we need to convert the image to HSV format first,
+    // the change S channgel and convert the image back to BGR format.
+    cv::cvtColor(mat, *hsv, CV_BGR2HSV);
+    assert(hsv->rows == mat.rows && hsv->cols == mat.cols);
+    size_t count = hsv->rows * hsv->cols * mat.channels();
+    ElemType* phsvBase = reinterpret_cast<ElemType*>(hsv->data);
+    for (ElemType* phsv = phsvBase; phsv < phsvBase + count; phsv += 3)
+    {
+        const int HsvIndex = 1;
+        phsv[HsvIndex] = std::min((ElemType)(phsv[HsvIndex] * ratio), (ElemType)1);
+    }
+    cv::cvtColor(*hsv, mat, CV_HSV2BGR);
+
+    m_hsvTemp.push(std::move(hsv));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FusedImageTransformer::FusedImageTransformer(const ConfigParameters& config, ImageLayoutKind outputLayout)
+    : m_crop(config), m_scale(config), m_color(config), m_intensity(config), m_mean(config),
+      m_outputLayout(outputLayout), m_imageElementType(0)
+{
+}
+
+void FusedImageTransformer::StartEpoch(const EpochConfiguration& config)
+{
+    m_crop.StartEpoch(config);
+    m_scale.StartEpoch(config);
+    m_color.StartEpoch(config);
+    m_intensity.StartEpoch(config);
+    m_mean.StartEpoch(config);
+}
+
+// The method describes how input stream is transformed to the output stream. Called once per applied stream.
+// The output stream has the dimensions requested by the network, in the requested layout.
+StreamDescription FusedImageTransformer::Transform(const StreamDescription& inputStream)
+{
+    m_inputStream = inputStream;
+    m_crop.Transform(inputStream);
+    m_outputStream = m_scale.Transform(inputStream);
+    m_imageElementType = m_scale.m_imageElementType;
+
+    ImageDimensions dimensions(m_scale.m_imgWidth, m_scale.m_imgHeight, m_scale.m_imgChannels);
+    m_outputStream.m_sampleLayout = std::make_shared<TensorShape>(dimensions.AsTensorShape(m_outputLayout));
+
+    // As in MeanTransformer, the mean is only subtracted if its dimensions match the scaled image.
+    const cv::Mat& mean = m_mean.m_meanImg;
+    if (mean.cols == (int)dimensions.m_width && mean.rows == (int)dimensions.m_height && mean.channels() == (int)dimensions.m_numChannels)
+    {
+        mean.convertTo(m_meanImg, m_imageElementType);
+    }
+    else
+    {
+        m_meanImg.release();
+    }
+    return m_outputStream;
+}
+
+// Transformation of the sequence.
+SequenceDataPtr FusedImageTransformer::Transform(SequenceDataPtr sequence)
+{
+    // The ImageDataDeserializer passes the image in its decoded element type,
+    // other sequences are dense HWC images of the stream element type.
+    cv::Mat image;
+    auto decodedImage = dynamic_cast<DeserializedImage*>(sequence.get());
+    if (decodedImage != nullptr)
+    {
+        image = decodedImage->m_image;
+    }
+    else
+    {
+        auto& inputSequence = static_cast<DenseSequenceData&>(*sequence);
+        ImageDimensions dimensions(*inputSequence.m_sampleLayout, HWC);
+        int type = CV_MAKETYPE(m_imageElementType, (int)dimensions.m_numChannels);
+        image = cv::Mat((int)dimensions.m_height, (int)dimensions.m_width, type, inputSequence.m_data);
+    }
+
+    if (image.channels() != (int)m_scale.m_imgChannels)
+    {
+        RuntimeError("Image with %d channels cannot be transformed into an image with %d channels.", image.channels(), (int)m_scale.m_imgChannels);
+    }
+
+    // Crop and scale. The crop is a view of the image, the flip is done when writing the output.
+    bool flip;
+    cv::Rect crop = m_crop.DrawCrop(sequence->m_id, image.rows, image.cols, flip);
+    auto scaled = m_scaledTemp.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
+    cv::resize(image(crop), *scaled, cv::Size((int)m_scale.m_imgWidth, (int)m_scale.m_imgHeight), 0, 0, m_scale.DrawInterpolation());
+
+    auto result = std::make_shared<DenseSequenceWithBuffer>();
+    result->m_buffer.resize(m_outputStream.m_sampleLayout->GetNumElements() * GetSizeByType(m_outputStream.m_elementType));
+    if (m_imageElementType == CV_32F)
+    {
+        Apply(*scaled, flip, reinterpret_cast<float*>(result->m_buffer.data()));
+    }
+    else
+    {
+        assert(m_imageElementType == CV_64F);
+        Apply(*scaled, flip, reinterpret_cast<double*>(result->m_buffer.data()));
+    }
+    m_scaledTemp.push(std::move(scaled));
+
+    result->m_sampleLayout = m_outputStream.m_sampleLayout;
+    result->m_data = result->m_buffer.data();
+    result->m_numberOfSamples = sequence->m_numberOfSamples;
+    return result;
+}
+
+template <class TElement>
+void FusedImageTransformer::Apply(cv::Mat& scaled, bool flip, TElement* output)
+{
+    // Random draws of the color transformation, as in ColorTransformer::Apply.
+    double alpha = 1, beta = 0;
+    ColorTransformer& color = m_color;
+    if (color.m_curBrightnessRadius > 0 || color.m_curContrastRadius > 0 || color.m_curSaturationRadius > 0)
+    {
+        auto seed = color.GetSeed();
+        auto rng = color.m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
 
-        ElemType alpha = 1;
-        if (m_curContrastRadius > 0)
+        if (color.m_curBrightnessRadius > 0 || color.m_curContrastRadius > 0)
         {
-            UniRealT d(-m_curContrastRadius, m_curContrastRadius);
-            alpha = (ElemType)(1 + d(*rng));
+            color.DrawContrastAndBrightness(scaled, *rng, alpha, beta);
         }
 
-        // Could potentially use mat.convertTo(mat, -1, alpha, beta) 
-        // but it does not do range checking for single/double precision matrix. saturate_cast won't work either.
-        size_t count = mat.rows * mat.cols * mat.channels();
-        ElemType* pbase = reinterpret_cast<ElemType*>(mat.data);
-        for (ElemType* p = pbase; p < pbase + count; p++)
+        // The saturation change works on the whole image in HSV, so here the image is converted and adjusted up front.
+        if (color.m_curSaturationRadius > 0 && scaled.channels() == 3)
         {
-            *p = std::min(std::max(*p * alpha + beta, (ElemType)0), (ElemType)255);
+            scaled.convertTo(scaled, CV_MAKETYPE(m_imageElementType, 3));
+            ColorTransformer::ApplyContrastAndBrightness(scaled, (TElement)alpha, (TElement)beta);
+            color.ApplySaturation<TElement>(scaled, color.DrawSaturationRatio(*rng));
+            alpha = 1;
+            beta = 0;
         }
+
+        color.m_rngs.push(std::move(rng));
     }
 
-    if (m_curSaturationRadius > 0 && mat.channels() == 3)
+    cv::Mat shifts;
+    m_intensity.DrawShifts(shifts);
+
+    switch (scaled.depth())
     {
-        UniRealT d(-m_curSaturationRadius, m_curSaturationRadius);
-        double ratio = 1.0 + d(*rng);
-        assert(0 <= ratio && ratio <= 2);
+    case CV_8U:
+        Write<unsigned char>(scaled, flip, (TElement)alpha, (TElement)beta, shifts, output);
+        break;
+    case CV_32F:
+        Write<float>(scaled, flip, (TElement)alpha, (TElement)beta, shifts, output);
+        break;
+    case CV_64F:
+        Write<double>(scaled, flip, (TElement)alpha, (TElement)beta, shifts, output);
+        break;
+    default:
+        scaled.convertTo(scaled, m_imageElementType);
+        Write<TElement>(scaled, flip, (TElement)alpha, (TElement)beta, shifts, output);
+    }
+}
 
-        auto hsv = m_hsvTemp.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
+// Single pass over the scaled image, with the same per-element operations as the Color, Intensity, Mean and Transpose transformers.
+template <class TSource, class TElement>
+void FusedImageTransformer::Write(const cv::Mat& image, bool flip, TElement alpha, TElement beta, const cv::Mat& shifts, TElement* output)
+{
+    int rows = image.rows;
+    int cols = image.cols;
+    int channels = image.channels();
+    size_t planeSize = (size_t)rows * cols;
+
+    bool adjustColor = alpha != 1 || beta != 0;
+    // For multi-channel images data is in BGR format.
+    TElement channelShifts[3] = {};
+    if (!shifts.empty())
+    {
+        if (channels > 3)
+            RuntimeError("Intensity jittering supports at most 3 channels.");
+        for (int c = 0; c < channels; c++)
+            channelShifts[c] = (TElement)shifts.at<float>(channels - c - 1);
+    }
+    const TElement* mean = m_meanImg.empty() ? nullptr : m_meanImg.ptr<TElement>();
 
-        // To change saturation, we need to convert the image to HSV format first,
-        // the change S channgel and convert the image back to BGR format.
-        cv::cvtColor(mat, *hsv, CV_BGR2HSV);
-        assert(hsv->rows == mat.rows && hsv->cols == mat.cols);
-        size_t count = hsv->rows * hsv->cols * mat.channels();
-        ElemType* phsvBase = reinterpret_cast<ElemType*>(hsv->data);
-        for (ElemType* phsv = phsvBase; phsv < phsvBase + count; phsv += 3)
+    for (int row = 0; row < rows; row++)
+    {
+        const TSource* src = image.ptr<TSource>(row);
+        for (int col = 0; col < cols; col++)
         {
-            const int HsvIndex = 1;
-            phsv[HsvIndex] = std::min((ElemType)(phsv[HsvIndex] * ratio), (ElemType)1);
+            const TSource* pixel = src + (flip ? cols - 1 - col : col) * channels;
+            size_t index = (size_t)row * cols + col;
+            for (int c = 0; c < channels; c++)
+            {
+                TElement value = (TElement)pixel[c];
+                if (adjustColor)
+                    value = std::min(std::max(value * alpha + beta, (TElement)0), (TElement)255);
+                if (!shifts.empty())
+                    value = std::min(std::max(value + channelShifts[c], (TElement)0), (TElement)255);
+                if (mean != nullptr)
+                    value -= mean[index * channels + c];
+
+                if (m_outputLayout == CHW)
+                    output[c * planeSize + index] = value;
+                else
+                    output[index * channels + c] = value;
+            }
         }
-        cv::cvtColor(*hsv, mat, CV_HSV2BGR);
-
-        m_hsvTemp.push(std::move(hsv));
     }
-
-    m_rngs.push(std::move(rng));
 }
 
 }}}
@@ -10,7 +10,7 @@
 #include <opencv2/opencv.hpp>
 
 #include "Transformer.h"
-#include "ConcStack.h"
+#include "ConcPool.h"
 #include "Config.h"
 #include "ImageConfigHelper.h"
 
@@ -52,7 +52,7 @@ protected:
     StreamDescription m_outputStream;
     unsigned int m_seed;
     int m_imageElementType;
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
+    conc_pool<std::unique_ptr<std::mt19937>> m_rngs;
 };
 
 // Crop transformation of the image.
@@ -63,8 +63,13 @@ public:
     explicit CropTransformer(const ConfigParameters& config);
 
 private:
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
+    // Draws the crop of an image of the given size, and whether the crop is to be flipped horizontally.
+    cv::Rect DrawCrop(size_t id, int rows, int cols, bool& flip);
+
 private:
     enum class RatioJitterType
     {
@@ -79,7 +84,7 @@ private:
     RatioJitterType ParseJitterType(const std::string &src);
     cv::Rect GetCropRect(CropType type, int viewIndex, int crow, int ccol, double cropRatio, std::mt19937 &rng);
 
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
+    conc_pool<std::unique_ptr<std::mt19937>> m_rngs;
     CropType m_cropType;
     double m_cropRatioMin;
     double m_cropRatioMax;
@@ -99,13 +104,18 @@ public:
     StreamDescription Transform(const StreamDescription& inputStream) override;
 
 private:
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
+    // Draws one of the configured interpolation methods.
+    int DrawInterpolation();
+
     using StrToIntMapT = std::unordered_map<std::string, int>;
     StrToIntMapT m_interpMap;
     std::vector<int> m_interp;
 
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
+    conc_pool<std::unique_ptr<std::mt19937>> m_rngs;
     size_t m_imgWidth;
     size_t m_imgHeight;
     size_t m_imgChannels;
@@ -118,6 +128,8 @@ public:
     explicit MeanTransformer(const ConfigParameters& config);
 
 private:
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
     cv::Mat m_meanImg;
@@ -156,19 +168,25 @@ public:
     explicit IntensityTransformer(const ConfigParameters& config);
 
 private:
+    friend class FusedImageTransformer;
+
     void StartEpoch(const EpochConfiguration &config) override;
 
     void Apply(size_t id, cv::Mat &mat) override;
     template <typename ElemType>
     void Apply(cv::Mat &mat);
 
+    // Draws the per-channel intensity shifts (in BGR order, as a 3 x 1 matrix).
+    // Returns false if intensity jittering is disabled.
+    bool DrawShifts(cv::Mat& shifts);
+
     doubleargvector m_stdDev;
     double m_curStdDev;
 
     cv::Mat m_eigVal;
     cv::Mat m_eigVec;
 
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
+    conc_pool<std::unique_ptr<std::mt19937>> m_rngs;
 };
 
 // Color jittering transform based on the paper: http://arxiv.org/abs/1312.5402
@@ -179,12 +197,24 @@ public:
     explicit ColorTransformer(const ConfigParameters& config);
 
 private:
+    friend class FusedImageTransformer;
+
     void StartEpoch(const EpochConfiguration &config) override;
 
     void Apply(size_t id, cv::Mat &mat) override;
     template <typename ElemType>
     void Apply(cv::Mat &mat);
 
+    // Draws the contrast (alpha) and brightness (beta) adjustment Xij = alpha * Xij + beta of the image.
+    void DrawContrastAndBrightness(const cv::Mat& mat, std::mt19937& rng, double& alpha, double& beta);
+    template <typename ElemType>
+    static void ApplyContrastAndBrightness(cv::Mat& mat, ElemType alpha, ElemType beta);
+
+    // Draws the saturation ratio, and scales the saturation of a 3-channel floating point image by it.
+    double DrawSaturationRatio(std::mt19937& rng);
+    template <typename ElemType>
+    void ApplySaturation(cv::Mat& mat, double ratio);
+
     doubleargvector m_brightnessRadius;
     double m_curBrightnessRadius;
     doubleargvector m_contrastRadius;
@@ -192,8 +222,48 @@ private:
     doubleargvector m_saturationRadius;
     double m_curSaturationRadius;
 
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
-    conc_stack<std::unique_ptr<cv::Mat>> m_hsvTemp;
+    conc_pool<std::unique_ptr<std::mt19937>> m_rngs;
+    conc_pool<std::unique_ptr<cv::Mat>> m_hsvTemp;
+};
+
+// Crop, scale, color and intensity jittering, mean subtraction and, for the CHW output layout, the transposition
+// in a single transformer. It uses the same configuration and random draws as the chain of the transformers above,
+// but avoids their intermediate full-size images: the crop is only a view of the input image, it is scaled while still
+// in the decoded element type (8-bit when used with the ImageDataDeserializer), and the conversion to float/double,
+// the jittering, the mean subtraction, the horizontal flip and the change of layout are done in one pass that writes
+// the output sequence.
+class FusedImageTransformer : public Transformer
+{
+public:
+    FusedImageTransformer(const ConfigParameters& config, ImageLayoutKind outputLayout);
+
+    void StartEpoch(const EpochConfiguration& config) override;
+
+    // Transformation of the stream.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    // Transformation of the sequence.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
+private:
+    template <class TElement>
+    void Apply(cv::Mat& scaled, bool flip, TElement* output);
+
+    template <class TSource, class TElement>
+    void Write(const cv::Mat& image, bool flip, TElement alpha, TElement beta, const cv::Mat& shifts, TElement* output);
+
+    CropTransformer m_crop;
+    ScaleTransformer m_scale;
+    ColorTransformer m_color;
+    IntensityTransformer m_intensity;
+    MeanTransformer m_mean;
+
+    ImageLayoutKind m_outputLayout;
+    StreamDescription m_inputStream;
+    StreamDescription m_outputStream;
+    int m_imageElementType;
+    cv::Mat m_meanImg; // mean image in the output element type, empty if no mean is subtracted
+    conc_pool<std::unique_ptr<cv::Mat>> m_scaledTemp;
 };
 
 }}}
@@ -9,8 +9,87 @@
 
 #ifdef USE_ZIP
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Read-only memory mapping of the whole zip file. If the file cannot be mapped (e.g. in a 32-bit process),
+// m_data stays null and all entries are read through libzip.
+struct ZipByteReader::MappedFile
+{
+    const unsigned char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_file;
+#endif
+
+    explicit MappedFile(const std::string& path)
+        : m_data(nullptr), m_size(0)
+    {
+#ifdef _WIN32
+        m_mapping = NULL;
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL);
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX)
+            return;
+        m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping == NULL)
+            return;
+        m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (m_data != nullptr)
+            m_size = (size_t)size.QuadPart;
+#else
+        m_file = open(path.c_str(), O_RDONLY);
+        struct stat sb;
+        if (m_file == -1 || fstat(m_file, &sb) == -1 || sb.st_size == 0 || (uint64_t)sb.st_size > SIZE_MAX)
+            return;
+        void* data = mmap(nullptr, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+        if (data == MAP_FAILED)
+            return;
+        m_data = (const unsigned char*)data;
+        m_size = (size_t)sb.st_size;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != NULL)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+#else
+        if (m_data != nullptr)
+            munmap((void*)m_data, m_size);
+        if (m_file != -1)
+            close(m_file);
+#endif
+    }
+
+    DISABLE_COPY_AND_MOVE(MappedFile);
+};
+
+// Zip fields are little-endian.
+static uint16_t ReadZipUInt16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadZipUInt32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
 std::string GetZipError(int err)
 {
     zip_error_t error;
@@ -24,6 +103,79 @@ ZipByteReader::ZipByteReader(const std::string& zipPath)
     : m_zipPath(zipPath)
 {
     assert(!m_zipPath.empty());
+    m_mappedFile.reset(new MappedFile(m_zipPath));
+    IndexStoredEntries();
+}
+
+ZipByteReader::~ZipByteReader()
+{
+}
+
+// Finds the data of all stored (uncompressed and unencrypted) entries by walking the central directory of the
+// mapped file. Anything the walk does not understand, e.g. a zip64 archive, is left to libzip.
+void ZipByteReader::IndexStoredEntries()
+{
+    const unsigned char* data = m_mappedFile->m_data;
+    const size_t fileSize = m_mappedFile->m_size;
+    const size_t endRecordSize = 22;
+    if (data == nullptr || fileSize < endRecordSize)
+        return;
+
+    // The end of central directory record is at the end of the file, followed only by a comment of at most 64K.
+    size_t endRecord = fileSize - endRecordSize;
+    const size_t lowest = fileSize - std::min(fileSize, endRecordSize + 0xFFFF);
+    while (ReadZipUInt32(data + endRecord) != 0x06054b50)
+    {
+        if (endRecord == lowest)
+            return;
+        endRecord--;
+    }
+
+    const size_t numEntries = ReadZipUInt16(data + endRecord + 10);
+    const size_t directorySize = ReadZipUInt32(data + endRecord + 12);
+    const size_t directoryOffset = ReadZipUInt32(data + endRecord + 16);
+    if (numEntries == 0xFFFF || directoryOffset == 0xFFFFFFFF || directoryOffset + directorySize > endRecord)
+        return;
+
+    const size_t headerSize = 46, localHeaderSize = 30;
+    size_t pos = directoryOffset;
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        if (pos + headerSize > endRecord || ReadZipUInt32(data + pos) != 0x02014b50)
+            return;
+        const uint16_t flags = ReadZipUInt16(data + pos + 8);
+        const uint16_t method = ReadZipUInt16(data + pos + 10);
+        const uint32_t compressedSize = ReadZipUInt32(data + pos + 20);
+        const uint32_t size = ReadZipUInt32(data + pos + 24);
+        const size_t nameLength = ReadZipUInt16(data + pos + 28);
+        const size_t entryLength = headerSize + nameLength + ReadZipUInt16(data + pos + 30) + ReadZipUInt16(data + pos + 32);
+        const size_t localHeader = ReadZipUInt32(data + pos + 42);
+        if (pos + headerSize + nameLength > endRecord)
+            return;
+        std::string name((const char*)data + pos + headerSize, nameLength);
+        pos += entryLength;
+
+        if (method != ZIP_CM_STORE || (flags & 1) != 0 || compressedSize != size || size == 0xFFFFFFFF || localHeader == 0xFFFFFFFF)
+            continue;
+
+        // The data follows the local header, whose extra field can differ from the one in the central directory.
+        if (localHeader + localHeaderSize > fileSize || ReadZipUInt32(data + localHeader) != 0x04034b50)
+            continue;
+        const size_t dataOffset = localHeader + localHeaderSize + ReadZipUInt16(data + localHeader + 26) + ReadZipUInt16(data + localHeader + 28);
+        if (dataOffset + size > fileSize)
+            continue;
+        m_storedEntries[name] = std::make_pair(dataOffset, (size_t)size);
+    }
+}
+
+void ZipByteReader::ZipCloser::operator()(zip_t* z) const
+{
+    assert(z != nullptr);
+    int err = zip_close(z);
+    assert(ZIP_ER_OK == err);
+#ifdef NDEBUG
+    UNUSED(err);
+#endif
 }
 
 ZipByteReader::ZipPtr ZipByteReader::OpenZip()
@@ -33,19 +185,18 @@ ZipByteReader::ZipPtr ZipByteReader::OpenZip()
     if (ZIP_ER_OK != err)
         RuntimeError("Failed to open %s, zip library error: %s", m_zipPath.c_str(), GetZipError(err).c_str());
 
-    return ZipPtr(zip, [](zip_t* z)
-    {
-        assert(z != nullptr);
-        int err = zip_close(z);
-        assert(ZIP_ER_OK == err);
-#ifdef NDEBUG
-        UNUSED(err);
-#endif
-    });
+    return ZipPtr(zip);
 }
 
 void ZipByteReader::Register(size_t seqId, const std::string& path)
 {
+    auto stored = m_storedEntries.find(path);
+    if (stored != m_storedEntries.end())
+    {
+        m_seqIdToStored[seqId] = stored->second;
+        return;
+    }
+
     auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
     zip_stat_t stat;
     zip_stat_init(&stat);
@@ -56,8 +207,16 @@ void ZipByteReader::Register(size_t seqId, const std::string& path)
     m_zips.push(std::move(zipFile));
 }
 
-cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale)
+cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale, size_t minShortSide)
 {
+    auto stored = m_seqIdToStored.find(seqId);
+    if (stored != m_seqIdToStored.end())
+    {
+        cv::Mat img = DecodeImage(m_mappedFile->m_data + stored->second.first, stored->second.second, grayscale, minShortSide);
+        assert(nullptr != img.data);
+        return img;
+    }
+
     // Find index of the file in .zip file.
     auto r = m_seqIdToIndex.find(seqId);
     if (r == m_seqIdToIndex.end())
@@ -99,8 +258,7 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
     }
     m_zips.push(std::move(zipFile));
 
-    cv::Mat img; 
-    img = cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, contents.data()), grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    cv::Mat img = DecodeImage(contents.data(), (size_t)size, grayscale, minShortSide);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
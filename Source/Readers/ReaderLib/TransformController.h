@@ -6,6 +6,12 @@
 #pragma once
 
 #include <set>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <omp.h>
 
 #include "Transformer.h"
 #include "SequenceEnumerator.h"
@@ -22,11 +28,15 @@ struct Transformation
 // A class responsible for applying a list of transformers to sequences and stream descriptions.
 // Delegates retrieving of sequences to another sequence provider(such as randomizer) and applies transformations after retrieving.
 // Usually used by the packer to get next set of sequences.
+// With a look-ahead, the sequences of the next 'lookAhead' requests are retrieved in advance and transformed by a pool of
+// worker threads, so that the workers stay busy across requests (minibatches) instead of waiting for the slowest sequence
+// of each request. Requests are still answered in order. Transforming ahead assumes that all requests of an epoch
+// ask for the same number of samples, as the packers do.
 class TransformController : public SequenceEnumerator
 {
 public:
-    TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider)
-        : m_sequenceProvider(sequenceProvider)
+    TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider, size_t lookAhead = 0)
+        : m_sequenceProvider(sequenceProvider), m_lookAhead(lookAhead), m_endOfEpochRetrieved(false), m_stopping(false)
     {
         // Applying transformations to stream descriptions,
         // i.e. a transformation can change a stream from dense to sparse.
@@ -38,6 +48,27 @@ public:
             transformedStreams[streamId] = std::make_shared<StreamDescription>(t.m_transformer->Transform(*transformedStreams[streamId]));
         }
         m_outputStreams = transformedStreams;
+
+        if (m_lookAhead > 0)
+        {
+            for (int i = 0; i < omp_get_max_threads(); i++)
+            {
+                m_workers.push_back(std::thread([this]() { TransformLoop(); }));
+            }
+        }
+    }
+
+    ~TransformController()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
     }
 
     // Sets configuration for the current epoch.
@@ -45,6 +76,15 @@ public:
     virtual void StartEpoch(const EpochConfiguration &config) override
     {
         assert(m_sequenceProvider != nullptr);
+
+        // Requests retrieved ahead of time belong to the previous epoch.
+        for (auto& request : m_pendingRequests)
+        {
+            WaitForRequest(*request);
+        }
+        m_pendingRequests.clear();
+        m_endOfEpochRetrieved = false;
+
         for (auto& t : m_transformations)
         {
             t.first.m_transformer->StartEpoch(config);
@@ -64,6 +104,11 @@ public:
     virtual Sequences GetNextSequences(size_t sampleCount) override
     {
         assert(m_sequenceProvider != nullptr);
+        if (m_lookAhead > 0)
+        {
+            return GetNextTransformedAhead(sampleCount);
+        }
+
         Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
         if (sequences.m_data.empty())
         {
@@ -73,16 +118,126 @@ public:
 #pragma omp parallel for schedule(dynamic)
         for (int j = 0; j < sequences.m_data.front().size(); ++j)
         {
-            for (auto& t : m_transformations)
-            {
-                sequences.m_data[t.second][j] = t.first.m_transformer->Transform(sequences.m_data[t.second][j]);
-            }
+            Transform(sequences, j);
         }
 
         return sequences;
     }
 
 private:
+    // Sequences of a request whose transformation has been handed to the workers.
+    struct PendingRequest
+    {
+        size_t m_sampleCount;
+        Sequences m_sequences;
+        size_t m_remaining;         // number of sequences not transformed yet, guarded by m_lock
+        std::exception_ptr m_error; // first exception thrown by a transformer, guarded by m_lock
+    };
+    typedef std::shared_ptr<PendingRequest> PendingRequestPtr;
+
+    void Transform(Sequences& sequences, size_t j)
+    {
+        for (auto& t : m_transformations)
+        {
+            sequences.m_data[t.second][j] = t.first.m_transformer->Transform(sequences.m_data[t.second][j]);
+        }
+    }
+
+    Sequences GetNextTransformedAhead(size_t sampleCount)
+    {
+        if (!m_pendingRequests.empty() && m_pendingRequests.front()->m_sampleCount != sampleCount)
+        {
+            LogicError("TransformController: the number of requested samples cannot change within an epoch when transforming ahead.");
+        }
+
+        // Retrieve the current request if it has not been retrieved ahead, and top up the look-ahead.
+        // Retrieving runs on this thread (the sequence provider is not thread-safe), in parallel with the workers.
+        if (m_pendingRequests.empty())
+        {
+            RetrieveRequest(sampleCount);
+        }
+        while (m_pendingRequests.size() <= m_lookAhead && !m_endOfEpochRetrieved)
+        {
+            RetrieveRequest(sampleCount);
+        }
+
+        PendingRequestPtr request = m_pendingRequests.front();
+        m_pendingRequests.pop_front();
+        WaitForRequest(*request);
+        if (request->m_error)
+        {
+            std::rethrow_exception(request->m_error);
+        }
+        return std::move(request->m_sequences);
+    }
+
+    void RetrieveRequest(size_t sampleCount)
+    {
+        auto request = std::make_shared<PendingRequest>();
+        request->m_sampleCount = sampleCount;
+        request->m_sequences = m_sequenceProvider->GetNextSequences(sampleCount);
+        m_endOfEpochRetrieved = request->m_sequences.m_endOfEpoch;
+        size_t count = request->m_sequences.m_data.empty() ? 0 : request->m_sequences.m_data.front().size();
+        request->m_remaining = count;
+        m_pendingRequests.push_back(request);
+
+        if (count > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                for (size_t j = 0; j < count; j++)
+                {
+                    m_work.push_back(std::make_pair(request, j));
+                }
+            }
+            m_workAvailable.notify_all();
+        }
+    }
+
+    void WaitForRequest(PendingRequest& request)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_requestDone.wait(lock, [&request]() { return request.m_remaining == 0; });
+    }
+
+    // Body of the worker threads: transforms single sequences of the pending requests in the order of retrieval.
+    void TransformLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        for (;;)
+        {
+            m_workAvailable.wait(lock, [this]() { return m_stopping || !m_work.empty(); });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            auto work = std::move(m_work.front());
+            m_work.pop_front();
+            lock.unlock();
+
+            std::exception_ptr error;
+            try
+            {
+                Transform(work.first->m_sequences, work.second);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            if (error && !work.first->m_error)
+            {
+                work.first->m_error = error;
+            }
+            if (--work.first->m_remaining == 0)
+            {
+                m_requestDone.notify_all();
+            }
+        }
+    }
+
     size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
     {
         for (const auto& s : streams)
@@ -100,6 +255,18 @@ private:
     SequenceEnumeratorPtr m_sequenceProvider;
     std::vector<StreamDescriptionPtr> m_outputStreams;
     std::vector<std::pair<Transformation, size_t>> m_transformations;
+
+    // Transforming ahead. The pending requests are only accessed by the thread calling GetNextSequences.
+    size_t m_lookAhead;
+    std::deque<PendingRequestPtr> m_pendingRequests;
+    bool m_endOfEpochRetrieved;
+
+    std::mutex m_lock;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_requestDone;
+    std::deque<std::pair<PendingRequestPtr, size_t>> m_work;
+    std::vector<std::thread> m_workers;
+    bool m_stopping;
 };
 
 }}}
@@ -0,0 +1,339 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BeamSearchDecoder.h -- batched beam-search decoding of a network that predicts the next token of a sequence
+//
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "File.h"
+#include "fileutil.h"
+#include "ProgressTracing.h"
+#include "TimerUtility.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The decoder reads prefix sequences (e.g. a sentence start, a prompt, or a source sentence followed by a
+// separator) of the token input node from the reader, and extends each of them token by token with the
+// highest-scoring continuations of the output node, whose column t must score the token at t+1.
+//
+// All hypotheses of all sequences of a minibatch are advanced together as one minibatch of one frame per
+// hypothesis. The recurrent state is not recomputed from the start of the hypotheses: every PastValue node
+// carries its input over from one step to the next, and is told which column each new hypothesis continues
+// from (ICarriedOverStateNode). Hypotheses that emit the end symbol leave the minibatch immediately, as does
+// the whole beam of a sequence once no live hypothesis can outscore its finished ones.
+template <class ElemType>
+class BeamSearchDecoder
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    struct Hypothesis
+    {
+        vector<size_t> tokens; // generated so far, excluding the prefix
+        double score;          // sum of log probabilities of 'tokens'
+        size_t column;         // column of the output node (and of the carried-over state) that scores its next token
+    };
+
+    struct Beam
+    {
+        UniqueSequenceId seqId;
+        vector<Hypothesis> live;
+        vector<Hypothesis> finished;
+    };
+
+public:
+    BeamSearchDecoder(ComputationNetworkPtr net, const wstring& inputNodeName, const wstring& outputNodeName,
+                      size_t beamWidth, size_t endSymbolId, size_t maxLength, bool outputIsProbability, int verbosity = 0)
+        : m_net(net), m_beamWidth(beamWidth), m_endSymbolId(endSymbolId), m_maxLength(maxLength), m_outputIsProbability(outputIsProbability), m_verbosity(verbosity)
+    {
+        if (m_beamWidth == 0)
+            InvalidArgument("BeamSearchDecoder: beamWidth must be at least 1.");
+        if (m_maxLength == 0)
+            InvalidArgument("BeamSearchDecoder: maxLength must be at least 1.");
+
+        m_inputNode = dynamic_pointer_cast<ComputationNode<ElemType>>(m_net->GetNodeFromName(inputNodeName));
+        m_outputNode = dynamic_pointer_cast<ComputationNode<ElemType>>(m_net->GetNodeFromName(outputNodeName));
+        if (!m_inputNode || !m_outputNode)
+            LogicError("BeamSearchDecoder: Input and output nodes must have the network's element type.");
+
+        // the token input is the only thing that can be fed for the generated frames (it is listed once for each
+        // path it is reached through)
+        const auto& inputNodes = m_net->InputNodes(m_outputNode);
+        if (inputNodes.empty() || any_of(inputNodes.begin(), inputNodes.end(), [this](const ComputationNodeBasePtr& node) { return node != m_inputNode; }))
+            InvalidArgument("BeamSearchDecoder: Output node '%ls' must depend on input node '%ls' and no other input.", outputNodeName.c_str(), inputNodeName.c_str());
+        if (!m_outputNode->HasMBLayout() || m_outputNode->GetMBLayout() != m_inputNode->GetMBLayout())
+            InvalidArgument("BeamSearchDecoder: Output node '%ls' must be a sequence with the same dynamic axis as input node '%ls'.", outputNodeName.c_str(), inputNodeName.c_str());
+    }
+
+    // Decodes all sequences of the reader, and writes the 'numBest' best hypotheses of each to 'outputPath'
+    // as one line of tokens each (with their scores if numBest > 1), in the order of the reader's sequence ids.
+    void Decode(IDataReader& dataReader, size_t mbSize, const wstring& outputPath, size_t numBest, const vector<string>& labelMapping, size_t numSamples = requestDataSize)
+    {
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+        vector<ComputationNodeBasePtr> outputNodes = {m_outputNode};
+        vector<ComputationNodeBasePtr> inputNodes = {m_inputNode};
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+
+        m_statefulNodes.clear();
+        for (auto& node : m_net->GetEvalOrder(m_outputNode))
+        {
+            auto statefulNode = dynamic_pointer_cast<ICarriedOverStateNode>(node);
+            if (statefulNode)
+                m_statefulNodes.push_back(statefulNode);
+            else if (dynamic_pointer_cast<IStatefulNode>(node))
+                InvalidArgument("BeamSearchDecoder: Node '%ls' (%ls operation) cannot continue from selected hypotheses.", node->NodeName().c_str(), node->OperationName().c_str());
+        }
+
+        StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
+
+        File::MakeIntermediateDirs(outputPath);
+        File outputStream(outputPath, fileOptionsWrite | fileOptionsText);
+
+        dataReader.StartMinibatchLoop(mbSize, 0, numSamples);
+        m_net->StartEvaluateMinibatchLoop(outputNodes);
+
+        size_t totalSequences = 0, totalSteps = 0, totalHypothesisFrames = 0;
+        Timer timer;
+        timer.Start();
+
+        size_t actualMBSize;
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr); numMBsRun++)
+        {
+            // compute the output over the prefixes; the last frame of each scores its first generated token
+            ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+            m_net->ForwardProp(outputNodes);
+
+            vector<Beam> beams = StartBeams(*m_inputNode->GetMBLayout());
+
+            for (size_t length = 0; ; length++)
+            {
+                size_t numLive = Advance(beams, length + 1 == m_maxLength);
+                if (numLive == 0)
+                    break;
+
+                ForwardNextFrame(beams, numLive, inputNodes, outputNodes);
+                totalSteps++;
+                totalHypothesisFrames += numLive;
+            }
+
+            for (auto& beam : beams)
+                WriteBest(outputStream, beam, numBest, labelMapping);
+            totalSequences += beams.size();
+
+            if (m_verbosity > 0)
+                fprintf(stderr, "Minibatch[%lu]: %lu sequences decoded.\n", numMBsRun, beams.size());
+            numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+
+            dataReader.DataEnd();
+        }
+        outputStream.Flush();
+        timer.Stop();
+
+        fprintf(stderr, "Written to %ls\nBeam search: %lu sequences in %.2f seconds, %lu steps, %.1f hypotheses per step on average.\n",
+                outputPath.c_str(), totalSequences, timer.ElapsedSeconds(), totalSteps, totalSteps > 0 ? (double) totalHypothesisFrames / totalSteps : 0.0);
+    }
+
+private:
+    // one beam per sequence of the prefix minibatch, with a single empty hypothesis at the sequence's last frame
+    vector<Beam> StartBeams(const MBLayout& layout) const
+    {
+        vector<Beam> beams;
+        for (const auto& seq : layout.GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > layout.GetNumTimeSteps())
+                RuntimeError("BeamSearchDecoder: The reader must deliver whole sequences (no truncation).");
+            Beam beam;
+            beam.seqId = seq.seqId;
+            beam.live.push_back(Hypothesis{vector<size_t>(), 0, layout.GetColumnIndex(seq, seq.tEnd - 1 - seq.tBegin)});
+            beams.push_back(move(beam));
+        }
+        sort(beams.begin(), beams.end(), [](const Beam& a, const Beam& b) { return a.seqId < b.seqId; });
+        return beams;
+    }
+
+    // Scores the continuations of all live hypotheses, and replaces them by the best ones of each beam.
+    // Returns the number of hypotheses that are still live.
+    size_t Advance(vector<Beam>& beams, bool lastStep)
+    {
+        // log probabilities of the columns of the live hypotheses only (the prefix minibatch has many more)
+        vector<ElemType> liveColumns;
+        for (const auto& beam : beams)
+            for (const auto& h : beam.live)
+                liveColumns.push_back((ElemType) h.column);
+        if (liveColumns.empty())
+            return 0;
+
+        const auto& output = m_outputNode->Value();
+        Matrix<ElemType> columnIndices(1, liveColumns.size(), liveColumns.data(), output.GetDeviceId());
+        Matrix<ElemType> logProbs(output.GetDeviceId());
+        logProbs.DoGatherColumnsOf(0, columnIndices, output, 1);
+        if (m_outputIsProbability)
+            logProbs.InplaceLog();
+        else
+            logProbs.InplaceLogSoftmax(true);
+        const size_t vocabSize = logProbs.GetNumRows();
+        unique_ptr<ElemType[]> scores(logProbs.CopyToArray());
+
+        const size_t numCandidatesPerHypothesis = min(m_beamWidth, vocabSize);
+        vector<size_t> tokens(vocabSize);
+        vector<Hypothesis> candidates;
+        size_t col = 0, numLive = 0;
+        for (auto& beam : beams)
+        {
+            // the best continuations of each hypothesis; together these contain the best ones of the beam
+            candidates.clear();
+            for (const auto& h : beam.live)
+            {
+                const ElemType* p = scores.get() + col++ * vocabSize;
+                for (size_t i = 0; i < vocabSize; i++)
+                    tokens[i] = i;
+                partial_sort(tokens.begin(), tokens.begin() + numCandidatesPerHypothesis, tokens.end(), [p](size_t a, size_t b) { return p[a] > p[b]; });
+                for (size_t i = 0; i < numCandidatesPerHypothesis; i++)
+                {
+                    Hypothesis c{h.tokens, h.score + p[tokens[i]], h.column};
+                    c.tokens.push_back(tokens[i]);
+                    candidates.push_back(move(c));
+                }
+            }
+            const size_t numKept = min(m_beamWidth - beam.finished.size(), candidates.size());
+            partial_sort(candidates.begin(), candidates.begin() + numKept, candidates.end(), [](const Hypothesis& a, const Hypothesis& b) { return a.score > b.score; });
+            candidates.resize(numKept);
+
+            beam.live.clear();
+            for (auto& c : candidates)
+            {
+                if (c.tokens.back() == m_endSymbolId)
+                {
+                    c.tokens.pop_back();
+                    beam.finished.push_back(move(c));
+                }
+                else if (lastStep)
+                    beam.finished.push_back(move(c));
+                else
+                    beam.live.push_back(move(c));
+            }
+
+            // scores only decrease as hypotheses grow, so none of the live ones can beat the best finished one anymore
+            if (!beam.finished.empty() && !beam.live.empty())
+            {
+                double bestFinished = max_element(beam.finished.begin(), beam.finished.end(), [](const Hypothesis& a, const Hypothesis& b) { return a.score < b.score; })->score;
+                if (beam.live.front().score <= bestFinished)
+                    beam.live.clear();
+            }
+            numLive += beam.live.size();
+        }
+        return numLive;
+    }
+
+    // Computes the output for the last token of each live hypothesis, continuing the recurrent state from the
+    // hypothesis it extends. Each live hypothesis then refers to its column of this one-frame minibatch.
+    void ForwardNextFrame(vector<Beam>& beams, size_t numLive, const vector<ComputationNodeBasePtr>& inputNodes, const vector<ComputationNodeBasePtr>& outputNodes)
+    {
+        vector<size_t> parentColumns;
+        vector<CPUSPARSE_INDEX_TYPE> tokens;
+        parentColumns.reserve(numLive);
+        tokens.reserve(numLive);
+        for (auto& beam : beams)
+        {
+            for (auto& h : beam.live)
+            {
+                parentColumns.push_back(h.column);
+                tokens.push_back((CPUSPARSE_INDEX_TYPE) h.tokens.back());
+                h.column = parentColumns.size() - 1;
+            }
+        }
+
+        for (auto& node : m_statefulNodes)
+            node->SelectCarriedOverState(parentColumns);
+
+        // one frame per hypothesis; its sequence began in an earlier minibatch and continues into the next
+        auto& layout = m_inputNode->GetMBLayout();
+        layout->Init(numLive, 1);
+        for (size_t s = 0; s < numLive; s++)
+            layout->AddSequence(NEW_SEQUENCE_ID, s, -1, 2);
+
+        SetOneHotInput(tokens);
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+        m_net->ForwardProp(outputNodes);
+    }
+
+    void SetOneHotInput(const vector<CPUSPARSE_INDEX_TYPE>& tokens)
+    {
+        auto& value = m_inputNode->Value();
+        const size_t vocabSize = m_inputNode->GetSampleMatrixNumRows();
+        for (auto token : tokens)
+            if ((size_t) token >= vocabSize)
+                RuntimeError("BeamSearchDecoder: Token %d does not fit into input node '%ls' of dimension %d.", (int) token, m_inputNode->NodeName().c_str(), (int) vocabSize);
+
+        if (value.GetMatrixType() == MatrixType::SPARSE)
+        {
+            vector<CPUSPARSE_INDEX_TYPE> colStarts(tokens.size() + 1);
+            for (size_t j = 0; j <= tokens.size(); j++)
+                colStarts[j] = (CPUSPARSE_INDEX_TYPE) j;
+            vector<ElemType> ones(tokens.size(), 1);
+            value.SetMatrixFromCSCFormat(colStarts.data(), tokens.data(), ones.data(), tokens.size(), vocabSize, tokens.size());
+        }
+        else
+        {
+            vector<ElemType> oneHot(vocabSize * tokens.size(), 0);
+            for (size_t j = 0; j < tokens.size(); j++)
+                oneHot[j * vocabSize + tokens[j]] = 1;
+            value.SetValue(vocabSize, tokens.size(), value.GetDeviceId(), oneHot.data(), matrixFlagNormal);
+        }
+    }
+
+    void WriteBest(File& outputStream, Beam& beam, size_t numBest, const vector<string>& labelMapping) const
+    {
+        sort(beam.finished.begin(), beam.finished.end(), [](const Hypothesis& a, const Hypothesis& b) { return a.score > b.score; });
+        FILE* f = outputStream;
+        for (size_t i = 0; i < min(numBest, beam.finished.size()); i++)
+        {
+            const auto& h = beam.finished[i];
+            if (numBest > 1)
+                fprintfOrDie(f, "%.6f\t", h.score);
+            for (size_t k = 0; k < h.tokens.size(); k++)
+            {
+                if (k > 0)
+                    fprintfOrDie(f, " ");
+                if (labelMapping.empty())
+                    fprintfOrDie(f, "%lu", (unsigned long) h.tokens[k]);
+                else if (h.tokens[k] < labelMapping.size())
+                    fprintfOrDie(f, "%s", labelMapping[h.tokens[k]].c_str());
+                else
+                    RuntimeError("BeamSearchDecoder: Token %d is not in the label mapping.", (int) h.tokens[k]);
+            }
+            fprintfOrDie(f, "\n");
+        }
+        if (numBest > 1)
+            fprintfOrDie(f, "\n");
+    }
+
+private:
+    ComputationNetworkPtr m_net;
+    ComputationNodePtr m_inputNode;
+    ComputationNodePtr m_outputNode;
+    vector<shared_ptr<ICarriedOverStateNode>> m_statefulNodes;
+    size_t m_beamWidth;
+    size_t m_endSymbolId;
+    size_t m_maxLength;
+    bool m_outputIsProbability;
+    int m_verbosity;
+    void operator=(const BeamSearchDecoder&); // (not assignable)
+};
+
+}}}
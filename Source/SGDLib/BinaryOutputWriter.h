@@ -0,0 +1,157 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BinaryOutputWriter.h -- writes output sequences into a packed feature archive on a background thread
+//
+#pragma once
+
+#include "Basics.h"
+#include "PackedFeatureArchive.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdio>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Sequences are collected in one buffer while the previous buffer is being written by the writer thread;
+// Flush() hands the collected sequences over, waiting only if the thread has not finished the previous ones.
+// The archive (see PackedFeatureArchive.h) can be read back by the HTK deserializer as a feature stream.
+class BinaryOutputWriter
+{
+    struct Buffer
+    {
+        std::vector<float> frames;
+        std::vector<std::pair<std::string, size_t>> sequences; // key and number of frames
+
+        void Clear()
+        {
+            frames.clear();
+            sequences.clear();
+        }
+    };
+
+public:
+    BinaryOutputWriter(const std::wstring& path, const std::string& featureKind, size_t dimension, unsigned int samplePeriod, PackedArchiveElementType elementType, size_t chunkFrames)
+        : m_archive(path, featureKind, dimension, samplePeriod, chunkFrames, elementType), m_dimension(dimension), m_pending(false), m_stopping(false), m_closed(false)
+    {
+        m_thread = std::thread([this]() { WriterThread(); });
+    }
+
+    // Without Close(), e.g. when the computation of the outputs failed, the sequences added so far are still
+    // completed into a valid archive. Errors can only be reported here.
+    ~BinaryOutputWriter()
+    {
+        if (!m_closed)
+        {
+            try
+            {
+                Close();
+            }
+            catch (const std::exception& e)
+            {
+                fprintf(stderr, "BinaryOutputWriter: The archive could not be completed: %s\n", e.what());
+            }
+        }
+        StopThread();
+    }
+
+    size_t GetDimension() const { return m_dimension; }
+
+    // Returns space for a sequence of numFrames frames in the current buffer, to be filled in by the caller
+    // before the next Flush().
+    float* AddSequence(const std::string& key, size_t numFrames)
+    {
+        m_current.sequences.push_back(make_pair(key, numFrames));
+        m_current.frames.resize(m_current.frames.size() + numFrames * m_dimension);
+        return m_current.frames.data() + m_current.frames.size() - numFrames * m_dimension;
+    }
+
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return !m_pending; });
+        if (m_error)
+            std::rethrow_exception(m_error);
+        std::swap(m_current, m_writing);
+        m_pending = true;
+        m_work.notify_one();
+    }
+
+    // Writes all remaining sequences and the index of the archive.
+    void Close()
+    {
+        m_closed = true;
+        Flush();
+        StopThread();
+        if (m_error)
+            std::rethrow_exception(m_error);
+        m_archive.Close();
+    }
+
+private:
+    void WriterThread()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_work.wait(lock, [this]() { return m_pending || m_stopping; });
+            if (!m_pending)
+                return;
+
+            lock.unlock();
+            try
+            {
+                const float* frames = m_writing.frames.data();
+                for (const auto& sequence : m_writing.sequences)
+                {
+                    m_archive.AddUtterance(sequence.first, frames, sequence.second);
+                    frames += sequence.second * m_dimension;
+                }
+            }
+            catch (...) // (reported by the next Flush() or Close())
+            {
+                m_error = std::current_exception();
+            }
+            m_writing.Clear();
+            lock.lock();
+
+            m_pending = false;
+            m_idle.notify_all();
+        }
+    }
+
+    void StopThread()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]() { return !m_pending; });
+            m_stopping = true;
+            m_work.notify_one();
+        }
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    PackedFeatureArchiveWriter m_archive; // (used by the writer thread only until it is stopped)
+    size_t m_dimension;
+
+    Buffer m_current; // being filled by the caller
+    Buffer m_writing; // being written by the writer thread while m_pending
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_work; // signals m_pending or m_stopping to the writer thread
+    std::condition_variable m_idle; // signals !m_pending to the caller
+    bool m_pending;
+    bool m_stopping;
+    bool m_closed;
+    std::exception_ptr m_error;
+};
+
+}}}
@@ -0,0 +1,178 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MultiModelEvaluator.h -- evaluation of several models (e.g. the checkpoints of a training run) in a single pass over the data
+//
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "SimpleEvaluator.h"
+#include "Criterion.h"
+#include "ProgressTracing.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <exception>
+#include <omp.h>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Each minibatch is read from the reader once, into the input nodes of the first model, and copied from there
+// into the input nodes of the others, which must have the same names. All models are held in memory for the
+// whole pass, so the caller bounds the memory by the number of models it passes at a time.
+// On the CPU, if there are at least as many models as threads, the models are evaluated concurrently, one model
+// per thread, each doing its math single-threaded (nested OpenMP regions do not fork). With fewer models, that would
+// leave threads idle, so the models are evaluated one after another, each using all threads.
+// Models on a GPU share its stream, and are always evaluated one after another (still reading the data only once).
+template <class ElemType>
+class MultiModelEvaluator : public SimpleEvaluator<ElemType>
+{
+    typedef SimpleEvaluator<ElemType> Base;
+
+    struct Model
+    {
+        ComputationNetworkPtr net;
+        std::vector<ComputationNodeBasePtr> evalNodes;
+        StreamMinibatchInputs inputMatrices;
+        shared_ptr<CriterionAccumulator<ElemType>> localEvalErrors;
+        std::vector<EpochCriterion> evalResults;
+        std::exception_ptr error;
+    };
+
+public:
+    MultiModelEvaluator(const std::vector<ComputationNetworkPtr>& nets, const int traceLevel = 0)
+        : Base(nets.empty() ? nullptr : nets[0], nullptr, false, 0, 0, traceLevel), m_nets(nets)
+    {
+        if (m_nets.empty())
+            InvalidArgument("MultiModelEvaluator: At least one model is required.");
+    }
+
+    // returns the evaluation node values per sample of each model, in the order of the models
+    std::vector<std::vector<EpochCriterion>> Evaluate(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const size_t mbSize, const size_t testSize = requestDataSize)
+    {
+        std::vector<Model> models(m_nets.size());
+        std::vector<shared_ptr<ScopedNetworkOperationMode>> modeGuards;
+        for (size_t k = 0; k < models.size(); k++)
+        {
+            auto& model = models[k];
+            model.net = m_nets[k];
+            modeGuards.push_back(make_shared<ScopedNetworkOperationMode>(model.net, NetworkOperationMode::inferring));
+
+            model.evalNodes = Base::DetermineEvalNodes(model.net, evalNodeNames);
+            model.net->AllocateAllMatrices(model.evalNodes, {}, nullptr);
+
+            for (auto& node : model.net->FeatureNodes())
+                model.inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+            for (auto& node : model.net->LabelNodes())
+                model.inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+            for (const auto& input : models[0].inputMatrices)
+            {
+                if (!model.inputMatrices.HasInput(input.first))
+                    InvalidArgument("MultiModelEvaluator: Model %d has no input '%ls' (all models must have the same inputs).", (int) k, input.first.c_str());
+            }
+
+            model.localEvalErrors = make_shared<CriterionAccumulator<ElemType>>(model.evalNodes.size(), model.net->GetDeviceId());
+            model.evalResults.assign(model.evalNodes.size(), EpochCriterion(0));
+            model.net->StartEvaluateMinibatchLoop(model.evalNodes);
+        }
+
+        bool onCPU = true;
+        for (const auto& model : models)
+            onCPU &= model.net->GetDeviceId() == CPUDEVICE;
+        const int maxThreads = omp_get_max_threads();
+        const int numThreads = onCPU && (int) models.size() >= maxThreads ? maxThreads : 1;
+        if (numThreads > 1)
+            fprintf(stderr, "MultiModelEvaluator: Evaluating %d models concurrently on %d threads.\n", (int) models.size(), numThreads);
+        else if (models.size() > 1 && onCPU && maxThreads > 1)
+            fprintf(stderr, "MultiModelEvaluator: Evaluating %d models one after another on %d threads each (fewer models than threads).\n", (int) models.size(), maxThreads);
+
+        dataReader->StartMinibatchLoop(mbSize, 0, testSize);
+
+        size_t totalEpochSamples = 0;
+        size_t numMBsRun = 0;
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        for (;;)
+        {
+            size_t actualMBSize = 0;
+            bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, models[0].net, nullptr, false, false, models[0].inputMatrices, actualMBSize, nullptr);
+            if (!wasDataRead)
+                break;
+
+            if (actualMBSize > 0)
+            {
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+                for (long k = 0; k < (long) models.size(); k++)
+                {
+                    try
+                    {
+                        EvaluateMinibatch(models[k], models[0], k > 0, actualMBSize);
+                    }
+                    catch (...) // (exceptions must not leave the parallel region)
+                    {
+                        models[k].error = std::current_exception();
+                    }
+                }
+                for (const auto& model : models)
+                {
+                    if (model.error)
+                        std::rethrow_exception(model.error);
+                }
+
+                totalEpochSamples += models[0].net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
+            }
+            numMBsRun++;
+
+            numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+
+            dataReader->DataEnd();
+        }
+
+        // final statistics
+        std::vector<std::vector<EpochCriterion>> results;
+        for (const auto& model : models)
+        {
+            if (m_nets.size() > 1)
+                fprintf(stderr, "Model %d: ", (int) results.size());
+            std::vector<EpochCriterion> evalResultsLastLogged(model.evalResults.size(), EpochCriterion(0));
+            Base::DisplayEvalStatistics(1, numMBsRun, totalEpochSamples, model.evalNodes, model.evalResults, evalResultsLastLogged, true, /*isFinal=*/true);
+            results.push_back(model.evalResults);
+        }
+        return results;
+    }
+
+private:
+    // evaluates one model on the current minibatch, which is first copied from the input nodes of 'source' if 'copyInputs'
+    static void EvaluateMinibatch(Model& model, const Model& source, bool copyInputs, size_t actualMBSize)
+    {
+        if (copyInputs)
+        {
+            for (const auto& input : source.inputMatrices)
+            {
+                const auto& target = model.inputMatrices.GetInput(input.first);
+                target.template GetMatrix<ElemType>(input.first.c_str()).SetValue(input.second.template GetMatrix<ElemType>(input.first.c_str()));
+                target.pMBLayout->CopyFrom(input.second.pMBLayout);
+            }
+            DataReaderHelpers::NotifyChangedNodes<ElemType>(model.net, model.inputMatrices);
+            model.net->DetermineActualMBSizeFromFeatures();
+        }
+
+        ComputationNetwork::BumpEvalTimeStamp(model.net->FeatureNodes());
+        ComputationNetwork::BumpEvalTimeStamp(model.net->LabelNodes());
+        model.net->ForwardProp(model.evalNodes);
+
+        size_t numSamplesWithLabel = model.net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
+        for (size_t i = 0; i < model.evalNodes.size(); i++)
+            model.evalResults[i] += model.localEvalErrors->Assign(model.evalNodes, i, numSamplesWithLabel).GetCriterion(i);
+    }
+
+    std::vector<ComputationNetworkPtr> m_nets;
+};
+
+}}}
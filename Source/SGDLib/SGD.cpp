@@ -6,6 +6,7 @@
 #include "SGD.h"
 #include "NonlinearityNodes.h"          // for DropoutNode
 #include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
+#include "PreComputeNodes.h"            // for PreComputedNodeBase
 #include "DataReaderHelpers.h"
 #include "MatrixQuantizerImpl.h"
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
@@ -1194,6 +1195,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     // --- END MAIN MINIBATCH LOOP
 
+    CatchUpLazyRegularization();
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1311,14 +1314,35 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     // compute
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
 
+    // use the results of an earlier run on the same data if all workers have them
+    wstring cacheKey = GetPreComputeCacheKey(nodes);
+    if (!cacheKey.empty())
+    {
+        std::vector<size_t> numWorkersWithCache(1, TryLoadPreComputeCache(nodes, cacheKey) ? 1 : 0);
+        if (m_mpi != nullptr)
+            m_mpi->AllReduce(numWorkersWithCache);
+        if (numWorkersWithCache[0] == (m_mpi != nullptr ? m_mpi->NumNodesInUse() : 1))
+        {
+            LOGPRINTF(stderr, "Precomputing --> Loaded from cache %ls.\n\n", m_preComputeCache.c_str());
+            return true;
+        }
+    }
+
+    // With several workers, each accumulates over its share of the data, and the accumulators are merged at the end.
+    // Readers that support distributed reading read only that share; for the others, each minibatch is decimated.
+    const bool distributed = m_distributedPreCompute && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1;
+    const bool useDistributedMBReading = distributed && trainSetDataReader->SupportsDistributedMBRead();
+
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // To support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0);
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, m_epochSize);
+    // (Using only one epoch: Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.)
+    const size_t epochSize = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize;
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), epochSize);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, epochSize);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
@@ -1327,9 +1351,12 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
 
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    size_t actualMBSize;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, distributed, *inputMatrices, actualMBSize, m_mpi))
     {
+        if (actualMBSize == 0)
+            continue; // (decimation may leave nothing for this worker)
+
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
         ComputationNetwork::BumpEvalTimeStamp(labelNodes);
@@ -1339,16 +1366,96 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
     }
 
+    // merge the accumulators of all workers
+    if (distributed)
+    {
+        for (auto & node : nodes)
+            dynamic_pointer_cast<IPreComputeNode>(node)->AggregateAccumulators([this](std::vector<double>& sums) { m_mpi->AllReduce(sums); });
+    }
+
     // finalize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
 
+    if (!cacheKey.empty() && (m_mpi == nullptr || m_mpi->IsMainNode()))
+        SavePreComputeCache(nodes, cacheKey);
+
     fprintf(stderr, "\n");
     LOGPRINTF(stderr, "Precomputing --> Completed.\n\n");
 
     return true;
 }
 
+// The cache is valid for the same data, the same nodes with the same input dimensions, and the same amount of data used.
+// The data is identified by the caller's key (the reader configuration, with the size and modification time of each
+// file it names), or by the user's preComputeCacheKey. Returns an empty key if it is not, i.e. caching is off.
+template <class ElemType>
+wstring SGD<ElemType>::GetPreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes) const
+{
+    if (m_preComputeCache.empty())
+        return wstring();
+    if (m_dataConfigurationKey.empty() && m_preComputeCacheKey.empty())
+    {
+        LOGPRINTF(stderr, "Warning: preComputeCache is ignored, since the data cannot be identified. Set preComputeCacheKey to a string that identifies the training data.\n");
+        return wstring();
+    }
+
+    wstring key = m_dataConfigurationKey + L"\n" + m_preComputeCacheKey + L"\n";
+    key += m_useAllDataForPreComputedNode ? L"allData\n" : msra::strfun::wstrprintf(L"epochSize=%d\n", (int) m_epochSize);
+    for (const auto& node : nodes)
+        key += node->NodeName() + L"=" + node->OperationName() + L"(" + node->Input(0)->NodeName() + L" : " + msra::strfun::utf16(string(node->Input(0)->GetSampleLayout())) + L")\n";
+    return key;
+}
+
+template <class ElemType>
+bool SGD<ElemType>::TryLoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key)
+{
+    if (!fexists(m_preComputeCache.c_str()))
+        return false;
+
+    File fstream(m_preComputeCache, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+    wstring cachedKey;
+    fstream >> cachedKey;
+    if (cachedKey != key)
+    {
+        LOGPRINTF(stderr, "PreCompute cache %ls is for different data or nodes, recomputing.\n", m_preComputeCache.c_str());
+        return false;
+    }
+
+    // the values are in the order of 'nodes' (their order is deterministic for a given network)
+    std::vector<Matrix<ElemType>> values;
+    for (const auto& node : nodes)
+    {
+        values.emplace_back(node->GetDeviceId());
+        fstream >> values.back();
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+
+    auto value = values.begin();
+    for (const auto& node : nodes)
+        dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node)->SetPrecomputedValue(*value++);
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key)
+{
+    // saving into a temporary file and then renaming, as for checkpoints
+    wstring tempFileName = m_preComputeCache + L".tmp";
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+        fstream << key;
+        for (const auto& node : nodes)
+            fstream << dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+        fstream.Flush();
+    }
+    _wunlink(m_preComputeCache.c_str());
+    renameOrDie(tempFileName, m_preComputeCache);
+}
+
 // return a reasonable initial learning rate based on the initial mbsize
 template <class ElemType>
 double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -1854,7 +1961,8 @@ template <class ElemType>
                                               const double L2RegWeight,
                                               const double L1RegWeight,
                                               const bool needAveMultiplier,
-                                              const bool useNesterovMomentum)
+                                              const bool useNesterovMomentum,
+                                              LazyRegularizationState* lazyRegularization)
 {
     // we use simple linear (instead of log linear) scaling here
     const double momentum = MomentumPerMB(momentumPerSample, actualMBSize);
@@ -1885,8 +1993,22 @@ template <class ElemType>
         sgdUpdateNoise.SetGaussianRandomValue(0, (ElemType) noiseStd);
     }
 
+    // sparse gradients on the CPU only carry the columns touched by the minibatch, only those get regularized and updated
+    const bool useLazyRegularization = lazyRegularization && gradientValues.GetMatrixType() == MatrixType::SPARSE && gradientValues.GetDeviceId() == CPUDEVICE;
+    if (useLazyRegularization)
+    {
+        auto& state = *lazyRegularization;
+        if (state.lastUpdate.size() != functionValues.GetNumCols())
+            state.lastUpdate.assign(functionValues.GetNumCols(), state.step);
+        state.step++;
+        // catch up with the regularization per step of the previous updates, then add the L2 term of this one
+        gradientValues.RegularizeSparseGradient(functionValues, state.lastUpdate, state.step,
+                                                (ElemType) state.l2Decay, (ElemType) state.l1Threshold, (ElemType)(L2RegWeight * actualMBSize));
+        state.l2Decay = learnRatePerSample * L2RegWeight * actualMBSize;
+        state.l1Threshold = learnRatePerSample * L1RegWeight * actualMBSize;
+    }
     // L2 regularizer
-    if (L2RegWeight > 0)
+    else if (L2RegWeight > 0)
     {
         // multiply by actualMBSize so that it's invariant to minibatch size since learning rate is per sample
         Matrix<ElemType>::ScaleAndAdd((ElemType)(L2RegWeight * actualMBSize), functionValues, gradientValues);
@@ -1899,9 +2021,9 @@ template <class ElemType>
     }
     else if (adpType == GradientsUpdateType::AdaGrad ||
              (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE && gradientValues.GetDeviceId() != CPUDEVICE))
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
+        // rmsprop for sparse and fsadagrad for GPU sparse are not implemented yet, delegate it with adagrad
 
         double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
@@ -1924,7 +2046,13 @@ template <class ElemType>
     }
 
     // L1 regularizer with proximal gradient descent method
-    if (L1RegWeight > 0)
+    if (useLazyRegularization)
+    {
+        // also marks the touched columns as regularized through this step
+        gradientValues.SoftThresholdSparseGradientColumns(functionValues, lazyRegularization->lastUpdate, lazyRegularization->step,
+                                                          (ElemType)(learnRatePerSample * L1RegWeight * actualMBSize));
+    }
+    else if (L1RegWeight > 0)
     {
         // multiply by actualMBSize so that it's invariant to minibatch size since learning rate is per sample
         functionValues.InplaceSoftThreshold((ElemType)(learnRatePerSample * L1RegWeight * actualMBSize));
@@ -1955,13 +2083,28 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
         LogicError("UpdateWeights() called for a learnable ComputationNode which has m_learningRateMultiplier == 0!");
 
     double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
-    UpdateWeightsS(this, dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
+    auto& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+    LazyRegularizationState* lazyRegularization = nullptr;
+    if ((L2RegWeight > 0 || L1RegWeight > 0) && gradient.GetMatrixType() == MatrixType::SPARSE && gradient.GetDeviceId() == CPUDEVICE)
+        lazyRegularization = &m_lazyRegularization[node];
+    UpdateWeightsS(this, dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), gradient,
                    smoothedGradient, nodeDependentLearningRatePerSample, momentumPerSample,
                    actualMBSize, L2RegWeight, L1RegWeight,
-                   needAveMultiplier, m_useNesterovMomentum);
+                   needAveMultiplier, m_useNesterovMomentum, lazyRegularization);
     node->BumpEvalTimeStamp();
 }
 
+template <class ElemType>
+void SGD<ElemType>::CatchUpLazyRegularization()
+{
+    for (auto& iter : m_lazyRegularization)
+    {
+        auto& state = iter.second;
+        Matrix<ElemType>::CatchUpRegularization(dynamic_pointer_cast<ComputationNode<ElemType>>(iter.first)->Value(), state.lastUpdate, state.step,
+                                                (ElemType) state.l2Decay, (ElemType) state.l1Threshold);
+    }
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
@@ -2455,6 +2598,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_distributedPreCompute = configSGD(L"distributedPreCompute", true);
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -247,6 +247,7 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    bool m_distributedPreCompute; // split the PreCompute pass across the MPI workers
 
     // Parallel training
     MPIWrapperPtr m_mpi;
@@ -314,6 +315,8 @@ public:
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
+          m_preComputeCache   ((const wstring&) configSGD(L"preComputeCache", L"")),
+          m_preComputeCacheKey((const wstring&) configSGD(L"preComputeCacheKey", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesCategory(configSGD(L"traceNodeNamesCategory", ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesSparse  (configSGD(L"traceNodeNamesSparse",   ConfigRecordType::Array(stringargvector()))),
@@ -332,6 +335,12 @@ public:
     {
     }
 
+    // text that identifies the training data, e.g. the reader configuration; used as the key of the PreCompute cache
+    void SetDataConfigurationKey(const wstring& key)
+    {
+        m_dataConfigurationKey = key;
+    }
+
     void InitMPI(const MPIWrapperPtr& mpi)
     {
         m_mpi = mpi;
@@ -370,6 +379,11 @@ protected:
                     const std::vector<ComputationNodeBasePtr>& labelNodes,
                     StreamMinibatchInputs* inputMatrices);
 
+    // PreCompute cache: a sidecar file with the precomputed values, valid for the same data and nodes
+    wstring GetPreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes) const;
+    bool TryLoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key);
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key);
+
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
                                   ComputationNetworkPtr refNet,
@@ -470,6 +484,16 @@ protected:
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
     void InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID);
 public:
+    // Lazy regularization of a parameter with a sparse (block-column) gradient on the CPU, e.g. an embedding:
+    // only the columns present in the gradient are regularized, the steps a column missed are caught up when it is touched again.
+    struct LazyRegularizationState
+    {
+        size_t step = 0;                // number of updates of the parameter
+        std::vector<size_t> lastUpdate; // for each column, the step through which it has been regularized
+        double l2Decay = 0;             // regularization per step of the last update, used for catching up
+        double l1Threshold = 0;
+    };
+
     // UpdateWeightsS - static version of UpdateWeights()
     static void UpdateWeightsS(const SGD* sgd, Matrix<ElemType>& functionValues,
                                Matrix<ElemType>& gradientValues,
@@ -480,7 +504,8 @@ public:
                                const double L2RegWeight,
                                const double L1RegWeight,
                                const bool needAveMultiplier,
-                               const bool useNesterovMomentum);
+                               const bool useNesterovMomentum,
+                               LazyRegularizationState* lazyRegularization = nullptr);
 
 protected:
     // UpdateWeights - update the weights in
@@ -495,6 +520,9 @@ protected:
 
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
 
+    // apply the pending lazy regularization to all columns, e.g. before the model is evaluated or saved
+    void CatchUpLazyRegularization();
+
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
@@ -544,6 +572,10 @@ protected:
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
 
+    std::wstring m_preComputeCache;      // path of the PreCompute cache; empty if none
+    std::wstring m_preComputeCacheKey;   // identifies the data if the reader configuration is not known (BrainScript)
+    std::wstring m_dataConfigurationKey; // set by the caller, see SetDataConfigurationKey()
+
     // enable tracing. Nodes listed here get their m_traceNodeValueXXX flags set
     std::vector<std::wstring> m_traceNodeNamesReal;
     std::vector<std::wstring> m_traceNodeNamesCategory;
@@ -557,6 +589,8 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    mutable std::map<ComputationNodeBasePtr, LazyRegularizationState> m_lazyRegularization;
+
 private:
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
 
@@ -18,6 +18,8 @@
 #include <cstdio>
 #include "ProgressTracing.h"
 #include "ComputationNetworkBuilder.h"
+#include "BinaryOutputWriter.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -268,7 +270,6 @@ public:
             }
             totalEpochSamples += actualMBSize;
 
-            fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", numMBsRun, actualMBSize);
             if (outputPath == L"-") // if we mush all nodes together on stdout, add some visual separator
                 fprintf(stdout, "\n");
 
@@ -292,6 +293,109 @@ public:
             iter.second->Flush();
     }
 
+    // Writes the outputs as packed feature archives (see PackedFeatureArchive.h), one per output node, to outputPath.<nodeName>.
+    // Each sequence becomes an utterance, keyed by the next line of 'sequenceKeys', or by its running number if none are given.
+    // The archives are written (and rounded to fp16 if requested) on background threads while the next minibatch is computed.
+    // featureKind and samplePeriod (in units of 100ns) are recorded in the archives, as they would be for HTK features.
+    void WriteBinaryOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames,
+                           PackedArchiveElementType elementType, size_t chunkFrames, const std::string& featureKind, unsigned int samplePeriod,
+                           const std::vector<std::string>& sequenceKeys, size_t numOutputSamples = requestDataSize)
+    {
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+        std::vector<ComputationNodeBasePtr> outputNodes = m_net->OutputNodesByName(outputNodeNames);
+        std::vector<ComputationNodeBasePtr> inputNodes = m_net->InputNodesForOutputs(outputNodeNames);
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+
+        StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
+
+        if (outputPath == L"-")
+            InvalidArgument("WriteBinaryOutput: Binary output cannot be written to stdout.");
+        File::MakeIntermediateDirs(outputPath);
+        std::vector<shared_ptr<BinaryOutputWriter>> writers;
+        std::vector<size_t> numSequencesWritten(outputNodes.size(), 0);
+        for (auto& onode : outputNodes)
+            writers.push_back(make_shared<BinaryOutputWriter>(outputPath + L"." + onode->NodeName(), featureKind, onode->GetSampleMatrixNumRows(), samplePeriod, elementType, chunkFrames));
+
+        dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
+        m_net->StartEvaluateMinibatchLoop(outputNodes);
+
+        size_t totalEpochSamples = 0;
+        size_t actualMBSize;
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        ElemType* values = nullptr; // values of the current output in CPU memory
+        size_t valuesSize = 0;
+        auto freeValues = MakeScopeExit([&values]() { delete[] values; });
+        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr); numMBsRun++)
+        {
+            ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+
+            for (size_t i = 0; i < outputNodes.size(); i++)
+            {
+                m_net->ForwardProp(outputNodes[i]);
+                auto onode = dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i]);
+
+                const Matrix<ElemType>& value = onode->Value();
+                if (value.GetMatrixType() != MatrixType::DENSE)
+                    InvalidArgument("WriteBinaryOutput: Output '%ls' is sparse, binary output supports dense outputs only.", onode->NodeName().c_str());
+                value.CopyToArray(values, valuesSize);
+
+                // the sequences in reader order, each with its frames consecutively
+                std::vector<MBLayout::SequenceInfo> sequences;
+                if (onode->HasMBLayout())
+                {
+                    for (const auto& seq : onode->GetMBLayout()->GetAllSequences())
+                    {
+                        if (seq.seqId == GAP_SEQUENCE_ID)
+                            continue;
+                        if (seq.tBegin < 0 || seq.tEnd > onode->GetMBLayout()->GetNumTimeSteps())
+                            RuntimeError("WriteBinaryOutput: Sequences must lie within a minibatch (truncated BPTT is not supported).");
+                        sequences.push_back(seq);
+                    }
+                    sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b) { return a.seqId < b.seqId; });
+                }
+                else // a single sequence of all columns
+                    sequences.push_back(MBLayout::SequenceInfo{ 0, 0, 0, value.GetNumCols() });
+
+                auto& writer = *writers[i];
+                const size_t dim = writer.GetDimension();
+                const size_t numParallelSequences = onode->HasMBLayout() ? onode->GetMBLayout()->GetNumParallelSequences() : 1;
+                for (const auto& seq : sequences)
+                {
+                    size_t& sequenceIndex = numSequencesWritten[i];
+                    if (!sequenceKeys.empty() && sequenceIndex >= sequenceKeys.size())
+                        RuntimeError("WriteBinaryOutput: There are more sequences than the %d sequence keys.", (int) sequenceKeys.size());
+                    const std::string key = sequenceKeys.empty() ? std::to_string(sequenceIndex) : sequenceKeys[sequenceIndex];
+                    sequenceIndex++;
+
+                    const size_t numFrames = seq.GetNumTimeSteps();
+                    float* frames = writer.AddSequence(key, numFrames);
+#pragma omp parallel for
+                    for (long t = 0; t < (long) numFrames; t++)
+                    {
+                        const ElemType* pValue = values + ((seq.tBegin + t) * numParallelSequences + seq.s) * dim;
+                        for (size_t k = 0; k < dim; k++)
+                            frames[t * dim + k] = (float) pValue[k];
+                    }
+                }
+                writer.Flush();
+            }
+
+            totalEpochSamples += actualMBSize;
+
+            numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+
+            dataReader.DataEnd();
+        }
+
+        for (auto& writer : writers)
+            writer->Close();
+
+        fprintf(stderr, "Written to %ls* (%ls)\nTotal Samples Evaluated = %lu\n", outputPath.c_str(),
+                elementType == PackedArchiveElementType::Float16 ? L"fp16" : L"float", totalEpochSamples);
+    }
+
 private:
     ComputationNetworkPtr m_net;
     int m_verbosity;
@@ -19,7 +19,7 @@ typedef std::map<std::wstring, std::vector<float>*> Variables;
 
 BOOST_FIXTURE_TEST_SUITE(EvalTestSuite, EvalFixture)
 
-IEvaluateModelExtended<float>* SetupNetworkAndGetLayouts(std::string modelDefinition, VariableSchema& inputLayouts, VariableSchema& outputLayouts)
+IEvaluateModelExtended<float>* SetupNetworkAndGetLayouts(std::string modelDefinition, VariableSchema& inputLayouts, VariableSchema& outputLayouts, std::string config = "")
 {
     // Load the eval library
     auto hModule = LoadLibrary(L"evaldll.dll");
@@ -37,6 +37,8 @@ IEvaluateModelExtended<float>* SetupNetworkAndGetLayouts(std::string modelDefini
     // Native model evaluation instance
     IEvaluateModelExtended<float> *eval;
     getEvalProc(&eval);
+    if (!config.empty())
+        eval->Init(config);
 
     try
     {
@@ -294,5 +296,114 @@ BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalStreamingRunningSumTest)
+{
+    // Running sum over the frames of a sequence, which needs the state of the previous chunk
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Plus(i1, PastValue(1, o1, defaultHiddenActivity=0), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    IStreamingSession<float>* session = eval->StartStreamingSession({outputLayouts[0].m_name});
+    size_t a = session->OpenStream();
+    size_t b = session->OpenStream();
+
+    // two streams with chunks of different lengths, evaluated together
+    std::vector<Values<float>> inputs(2, Values<float>(1));
+    std::vector<Values<float>> outputs(2, outputLayouts.CreateBuffers<float>({ 2 }));
+    inputs[0][0].m_buffer = { 1, 2 };
+    inputs[1][0].m_buffer = { 10 };
+    session->ForwardChunks({ a, b }, inputs, outputs);
+    std::vector<float> expectedA{ 1, 3 }, expectedB{ 10 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputs[0][0].m_buffer.begin(), outputs[0][0].m_buffer.end(), expectedA.begin(), expectedA.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputs[1][0].m_buffer.begin(), outputs[1][0].m_buffer.end(), expectedB.begin(), expectedB.end());
+
+    // the next chunks continue from there, also in a different order
+    inputs[0][0].m_buffer = { 20, 30 };
+    inputs[1][0].m_buffer = { 3 };
+    session->ForwardChunks({ b, a }, inputs, outputs);
+    expectedB = { 30, 60 };
+    expectedA = { 6 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputs[0][0].m_buffer.begin(), outputs[0][0].m_buffer.end(), expectedB.begin(), expectedB.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputs[1][0].m_buffer.begin(), outputs[1][0].m_buffer.end(), expectedA.begin(), expectedA.end());
+
+    // a new stream starts without history
+    session->CloseStream(a);
+    size_t c = session->OpenStream();
+    inputs[0][0].m_buffer = { 5 };
+    inputs[1][0].m_buffer = { 1 };
+    session->ForwardChunks({ c, b }, inputs, outputs);
+    std::vector<float> expectedC{ 5 };
+    expectedB = { 61 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputs[0][0].m_buffer.begin(), outputs[0][0].m_buffer.end(), expectedC.begin(), expectedC.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputs[1][0].m_buffer.begin(), outputs[1][0].m_buffer.end(), expectedB.begin(), expectedB.end());
+
+    std::vector<Values<float>> inputsA(1, inputs[0]), outputsA(1, outputs[0]);
+    BOOST_REQUIRE_THROW(session->ForwardChunks({ a }, inputsA, outputsA), std::exception); // closed stream
+
+    session->Destroy();
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalInt8QuantizationTest)
+{
+    // two layers with random weights (fixed seeds), evaluated with float weights and with 'quantization=int8'
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(40) \n"
+        "W1 = Parameter(32, 40, init=\"uniform\", randomSeed=1) \n"
+        "W2 = Parameter(8, 32, init=\"uniform\", randomSeed=2) \n"
+        "h1 = Sigmoid(Times(W1, i1)) \n"
+        "o1 = Times(W2, h1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    const size_t numSamples = 5;
+    Values<float> inputBuffer(1);
+    for (size_t i = 0; i < 40 * numSamples; i++)
+        inputBuffer[0].m_buffer.push_back((float) ((i * 37) % 101) / 50 - 1);
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+    Values<float> expected = outputLayouts.CreateBuffers<float>({ numSamples });
+    eval->ForwardPass(inputBuffer, expected);
+    eval->Destroy();
+
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts, "quantization=int8");
+    Values<float> actual = outputLayouts.CreateBuffers<float>({ numSamples });
+    eval->ForwardPass(inputBuffer, actual);
+    eval->Destroy();
+
+    // the outputs differ by the quantization of the weights and of the inputs of both layers
+    const auto& e = expected[0].m_buffer;
+    const auto& a = actual[0].m_buffer;
+    BOOST_REQUIRE_EQUAL(a.size(), 8 * numSamples);
+    BOOST_REQUIRE_EQUAL(e.size(), a.size());
+    double sumSqrDiff = 0, sumSqr = 0;
+    for (size_t i = 0; i < e.size(); i++)
+    {
+        sumSqrDiff += ((double) a[i] - e[i]) * ((double) a[i] - e[i]);
+        sumSqr += (double) e[i] * e[i];
+    }
+    BOOST_CHECK_GT(sumSqrDiff, 0); // (int8 weights were used at all)
+    BOOST_CHECK_LT(sqrt(sumSqrDiff / sumSqr), 0.02);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
\ No newline at end of file
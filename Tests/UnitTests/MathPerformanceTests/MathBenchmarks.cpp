@@ -0,0 +1,428 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.cpp -- portable micro-benchmarks of the math library, with results in JSON
+//
+// Built by the Makefile as bin/mathbenchmarks. Each benchmark is run repeatedly for at least --minTime seconds
+// after a warm-up run; the time per run and the resulting GFLOP/s and GB/s (based on the minimal number of
+// operations and of bytes read and written) are written as a JSON document, so that the results of different
+// builds and machines can be compared by a script.
+//
+//   mathbenchmarks [--double] [--device <id>] [--filter <substring>] [--minTime <seconds>] [--output <file>]
+//
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "TensorView.h"
+#include "ConvolutionEngine.h"
+#include "ConvolveGeometry.h"
+#include "CPUKernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+struct BenchmarkOptions
+{
+    bool useDouble = false;
+    DEVICEID_TYPE deviceId = CPUDEVICE;
+    string filter;
+    double minTime = 0.5;
+    string outputPath;
+};
+
+struct BenchmarkResult
+{
+    string name;
+    string group;
+    size_t runs;
+    double seconds; // per run
+    double flops;   // per run
+    double bytes;   // per run
+};
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(const BenchmarkOptions& options)
+        : m_options(options)
+    {
+    }
+
+    // Runs 'body' (one run of the operation, 'flops' floating-point operations touching 'bytes' bytes) if it matches the filter.
+    // 'sync' waits for the device to finish; it is called before the clock is read.
+    void Run(const string& group, const string& name, double flops, double bytes, const function<void()>& body, const function<void()>& sync)
+    {
+        string fullName = group + "/" + name;
+        if (!m_options.filter.empty() && fullName.find(m_options.filter) == string::npos)
+            return;
+
+        body(); // warm-up (allocations, engine selection, caches)
+        sync();
+
+        size_t runs = 0;
+        auto start = chrono::steady_clock::now();
+        double elapsed = 0;
+        do
+        {
+            body();
+            runs++;
+            if (runs % RunsPerClockCheck(runs) == 0)
+            {
+                sync();
+                elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+        } while (elapsed < m_options.minTime || runs < 3);
+
+        BenchmarkResult result = { name, group, runs, elapsed / runs, flops, bytes };
+        fprintf(stderr, "%-40s %10.3f ms %10.2f GFLOP/s %10.2f GB/s\n", fullName.c_str(), result.seconds * 1e3,
+                flops / result.seconds * 1e-9, bytes / result.seconds * 1e-9);
+        m_results.push_back(result);
+    }
+
+    void WriteJson(FILE* f, const char* precision) const
+    {
+        int numThreads = 1;
+#ifdef _OPENMP
+        numThreads = omp_get_max_threads();
+#endif
+        fprintf(f, "{\n");
+        fprintf(f, "  \"precision\": \"%s\",\n", precision);
+        fprintf(f, "  \"device\": %d,\n", (int) m_options.deviceId);
+        fprintf(f, "  \"cpuInstructionSet\": \"%s\",\n", GetCPUInstructionSetName(GetCPUInstructionSet()));
+        fprintf(f, "  \"threads\": %d,\n", numThreads);
+        fprintf(f, "  \"results\": [");
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const auto& r = m_results[i];
+            fprintf(f, "%s\n    { \"group\": \"%s\", \"name\": \"%s\", \"runs\": %d, \"seconds\": %.9g, \"gflops\": %.6g, \"gbytesPerSecond\": %.6g }",
+                    i > 0 ? "," : "", r.group.c_str(), r.name.c_str(), (int) r.runs, r.seconds, r.flops / r.seconds * 1e-9, r.bytes / r.seconds * 1e-9);
+        }
+        fprintf(f, "\n  ]\n}\n");
+    }
+
+private:
+    // check the clock rarely for short operations, but after every run for long ones
+    static size_t RunsPerClockCheck(size_t runs)
+    {
+        return runs < 16 ? 1 : 8;
+    }
+
+    BenchmarkOptions m_options;
+    vector<BenchmarkResult> m_results;
+};
+
+template <class ElemType>
+class MathBenchmarks
+{
+    typedef Matrix<ElemType> Mat;
+    typedef shared_ptr<Mat> MatPtr;
+
+public:
+    MathBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+        : m_runner(runner), m_deviceId(deviceId)
+    {
+    }
+
+    void RunAll()
+    {
+        Gemm();
+        TensorOps();
+        Softmax();
+        SparseProducts();
+        Convolution();
+        Pooling();
+        OptimizerUpdates();
+    }
+
+private:
+    MatPtr Random(size_t rows, size_t cols)
+    {
+        return make_shared<Mat>(Mat::RandomUniform(rows, cols, m_deviceId, -1, 1, m_seed++));
+    }
+
+    // waits for the device by reading back an element, which is queued behind the benchmarked operations
+    void Sync()
+    {
+        if (m_deviceId == CPUDEVICE)
+            return;
+        if (!m_syncMatrix)
+            m_syncMatrix = make_shared<Mat>(1, 1, m_deviceId);
+        m_syncMatrix->SetValue(0);
+        m_syncMatrix->Get00Element();
+    }
+
+    void Run(const string& group, const string& name, double flops, double bytes, const function<void()>& body)
+    {
+        m_runner.Run(group, name, flops, bytes, body, [this]() { Sync(); });
+    }
+
+    // shapes of the products in the forward and backward pass of typical layers
+    void Gemm()
+    {
+        struct Shape
+        {
+            const char* name;
+            size_t m, k, n;
+            bool transA, transB;
+        };
+        const Shape shapes[] =
+        {
+            { "dnn_hidden_2048x2048x256", 2048, 2048, 256, false, false },     // speech DNN hidden layer, minibatch of 256 frames
+            { "dnn_hidden_backprop_data", 2048, 2048, 256, true, false },      // W^T * dY
+            { "dnn_hidden_backprop_weights", 2048, 256, 2048, false, true },   // dY * X^T
+            { "dnn_output_9304x2048x256", 9304, 2048, 256, false, false },     // senone output layer
+            { "lstm_gates_4096x1024x64", 4096, 1024, 64, false, false },       // 4 gates of 1024 cells, 64 parallel sequences, one time step
+            { "lstm_recurrence_4096x1024x16", 4096, 1024, 16, false, false },  // few sequences: bound by reading the weights
+            { "embedding_out_300x10000x128", 10000, 300, 128, false, false },  // output layer of a small language model
+            { "conv3x3_64ch_56x56_im2col", 64, 576, 3136, false, false },      // ResNet 3x3 convolution as unrolled GEMM, per image
+        };
+        for (const auto& s : shapes)
+        {
+            auto a = s.transA ? Random(s.k, s.m) : Random(s.m, s.k);
+            auto b = s.transB ? Random(s.n, s.k) : Random(s.k, s.n);
+            auto c = make_shared<Mat>(s.m, s.n, m_deviceId);
+            double bytes = sizeof(ElemType) * (double) (s.m * s.k + s.k * s.n + s.m * s.n);
+            Run("gemm", s.name, 2.0 * s.m * s.k * s.n, bytes, [&]() { Mat::MultiplyAndWeightedAdd(1, *a, s.transA, *b, s.transB, 0, *c); });
+        }
+    }
+
+    // elementwise operations with broadcasting, and reductions, on a [4096 x 256] tensor
+    void TensorOps()
+    {
+        const size_t rows = 4096, cols = 256, n = rows * cols;
+        auto x = Random(rows, cols);
+        auto y = Random(rows, cols);
+        auto z = make_shared<Mat>(rows, cols, m_deviceId);
+        auto bias = Random(rows, 1);
+        auto rowSums = make_shared<Mat>(rows, 1, m_deviceId);
+        auto colSums = make_shared<Mat>(1, cols, m_deviceId);
+
+        TensorShape shape(rows, cols);
+        TensorView<ElemType> tx(x, shape), ty(y, shape), tz(z, shape);
+        TensorView<ElemType> tBias(bias, TensorShape(rows, 1));
+        TensorView<ElemType> tRowSums(rowSums, TensorShape(rows, 1));
+        TensorView<ElemType> tColSums(colSums, TensorShape(1, cols));
+
+        const double e = sizeof(ElemType);
+        Run("tensor", "copy", 0, 2 * e * n, [&]() { tz.AssignCopyOf(tx); });
+        Run("tensor", "sigmoid", n, 2 * e * n, [&]() { tz.AssignSigmoidOf(tx); });
+        Run("tensor", "tanh", n, 2 * e * n, [&]() { tz.AssignTanhOf(tx); });
+        Run("tensor", "sum", n, 3 * e * n, [&]() { tz.AssignSumOf(tx, ty); });
+        Run("tensor", "sum_bias_broadcast", n, 2 * e * n, [&]() { tz.AssignSumOf(tx, tBias); });
+        Run("tensor", "elementwise_product", n, 3 * e * n, [&]() { tz.AssignElementwiseProductOf(tx, ty); });
+        Run("tensor", "sigmoid_derivative_product", 3.0 * n, 3 * e * n, [&]() { tz.AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(tx, ty); });
+        Run("tensor", "reduce_columns", n, e * n, [&]() { tRowSums.AssignCopyOf(tx); }); // bias gradient: sum over the minibatch
+        Run("tensor", "reduce_rows", n, e * n, [&]() { tColSums.AssignCopyOf(tx); });
+    }
+
+    void Softmax()
+    {
+        const size_t rows = 9304, cols = 256, n = rows * cols;
+        auto x = Random(rows, cols);
+        auto y = make_shared<Mat>(rows, cols, m_deviceId);
+        // per element: max, exp, sum, log and subtraction
+        Run("softmax", "log_softmax_9304x256", 5.0 * n, 2.0 * sizeof(ElemType) * n, [&]() { y->AssignLogSoftmaxOf(*x, true); });
+    }
+
+    // sparse input times dense weights, as in text models on bag-of-words or one-hot input
+    void SparseProducts()
+    {
+        struct Shape
+        {
+            const char* name;
+            size_t vocabSize, hiddenSize, batchSize, nzPerCol;
+        };
+        const Shape shapes[] =
+        {
+            { "bag_of_words_100000x512x256_nz50", 100000, 512, 256, 50 },
+            { "one_hot_500000x300x1024_nz1", 500000, 300, 1024, 1 },
+        };
+        for (const auto& s : shapes)
+        {
+            vector<CPUSPARSE_INDEX_TYPE> colStart(s.batchSize + 1);
+            vector<CPUSPARSE_INDEX_TYPE> rowIndex(s.batchSize * s.nzPerCol);
+            vector<ElemType> values(s.batchSize * s.nzPerCol, 1);
+            mt19937 rng(m_seed++);
+            const size_t step = s.vocabSize / s.nzPerCol;
+            for (size_t j = 0; j < s.batchSize; j++)
+            {
+                colStart[j] = (CPUSPARSE_INDEX_TYPE) (j * s.nzPerCol);
+                for (size_t p = 0; p < s.nzPerCol; p++) // ascending row indices within a column
+                    rowIndex[j * s.nzPerCol + p] = (CPUSPARSE_INDEX_TYPE) (p * step + rng() % step);
+            }
+            colStart[s.batchSize] = (CPUSPARSE_INDEX_TYPE) (s.batchSize * s.nzPerCol);
+
+            Mat x(s.vocabSize, s.batchSize, m_deviceId, MatrixType::SPARSE, matrixFormatSparseCSC);
+            x.SetMatrixFromCSCFormat(colStart.data(), rowIndex.data(), values.data(), values.size(), s.vocabSize, s.batchSize);
+            auto w = Random(s.hiddenSize, s.vocabSize);
+            auto dY = Random(s.hiddenSize, s.batchSize);
+            Mat y(s.hiddenSize, s.batchSize, m_deviceId);
+            Mat dW(s.hiddenSize, s.vocabSize, m_deviceId);
+            dW.SetValue(0);
+
+            // only the weight columns selected by nonzeros are touched
+            const double nz = (double) values.size();
+            const double e = sizeof(ElemType);
+            const double bytes = e * (nz * s.hiddenSize + 2.0 * s.hiddenSize * s.batchSize) + nz * (e + sizeof(CPUSPARSE_INDEX_TYPE));
+            Run("sparse", string(s.name) + "_forward", 2 * nz * s.hiddenSize, bytes, [&]() { Mat::MultiplyAndWeightedAdd(1, *w, false, x, false, 0, y); });
+            Run("sparse", string(s.name) + "_weight_gradient", 2 * nz * s.hiddenSize, bytes, [&]() { Mat::MultiplyAndWeightedAdd(1, *dY, false, x, true, 1, dW); });
+        }
+    }
+
+    void Convolution()
+    {
+        struct Shape
+        {
+            const char* name;
+            size_t width, height, inChannels, kernel, outChannels, stride, batchSize;
+            bool firstLayer; // (its input needs no gradient)
+        };
+        const Shape shapes[] =
+        {
+            { "resnet_3x3_64ch_56x56", 56, 56, 64, 3, 64, 1, 16, false },
+            { "resnet_1x1_256to64_56x56", 56, 56, 256, 1, 64, 1, 16, false },
+            { "resnet_3x3_256ch_14x14", 14, 14, 256, 3, 256, 1, 32, false },
+            { "alexnet_11x11_stride4_224x224", 224, 224, 3, 11, 96, 4, 16, true },
+        };
+        for (const auto& s : shapes)
+        {
+            auto geometry = make_shared<ConvolveGeometry>(TensorShape(s.width, s.height, s.inChannels), TensorShape(s.kernel, s.kernel, s.inChannels),
+                                                          TensorShape(s.outChannels), TensorShape(s.stride, s.stride, s.inChannels),
+                                                          ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{(s.kernel & 1) != 0, (s.kernel & 1) != 0, false},
+                                                          TensorShape(0), TensorShape(0));
+            auto engine = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, ImageLayoutKind::CHW, 0, PoolKind::None);
+
+            const size_t inSize = geometry->InputShape().GetNumElements();
+            const size_t outSize = geometry->OutputShape().GetNumElements();
+            const size_t kernelSize = geometry->KernelShape().GetNumElements();
+            auto in = Random(inSize, s.batchSize);
+            auto kernel = Random(s.outChannels, kernelSize);
+            auto out = make_shared<Mat>(outSize, s.batchSize, m_deviceId);
+            auto srcGrad = Random(outSize, s.batchSize);
+            auto grad = make_shared<Mat>(inSize, s.batchSize, m_deviceId);
+            auto kernelGrad = make_shared<Mat>(s.outChannels, kernelSize, m_deviceId);
+            Mat workspace(m_deviceId);
+
+            const double flops = 2.0 * outSize * kernelSize * s.batchSize;
+            const double bytes = sizeof(ElemType) * ((double) (inSize + outSize) * s.batchSize + s.outChannels * kernelSize);
+            Run("convolution", string(s.name) + "_forward", flops, bytes, [&]() { engine->Forward(*in, *kernel, *out, workspace); });
+            if (!s.firstLayer)
+                Run("convolution", string(s.name) + "_backward_data", flops, bytes, [&]() { engine->BackwardData(*srcGrad, *kernel, *grad, workspace); });
+            Run("convolution", string(s.name) + "_backward_kernel", flops, bytes, [&]() { engine->BackwardKernel(*srcGrad, *in, *kernelGrad, false, workspace); });
+        }
+    }
+
+    void Pooling()
+    {
+        const size_t width = 112, height = 112, channels = 64, batchSize = 16;
+        for (auto kind : { PoolKind::Max, PoolKind::Average })
+        {
+            auto geometry = make_shared<ConvolveGeometry>(TensorShape(width, height, channels), TensorShape(3, 3, 1), TensorShape(1), TensorShape(2, 2, 1),
+                                                          ConvolveGeometry::BoolVec{false}, ConvolveGeometry::BoolVec{true, true, false},
+                                                          TensorShape(0), TensorShape(0));
+            auto engine = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, ImageLayoutKind::CHW, 0, kind);
+
+            const size_t inSize = geometry->InputShape().GetNumElements();
+            const size_t outSize = geometry->OutputShape().GetNumElements();
+            auto in = Random(inSize, batchSize);
+            auto out = make_shared<Mat>(outSize, batchSize, m_deviceId);
+            auto srcGrad = Random(outSize, batchSize);
+            auto grad = make_shared<Mat>(inSize, batchSize, m_deviceId);
+            engine->ForwardPooling(*in, *out);
+
+            string name = kind == PoolKind::Max ? "max_3x3_stride2_64ch_112x112" : "average_3x3_stride2_64ch_112x112";
+            const double flops = 9.0 * outSize * batchSize;
+            const double bytes = sizeof(ElemType) * (double) (inSize + outSize) * batchSize;
+            Run("pooling", name + "_forward", flops, bytes, [&]() { engine->ForwardPooling(*in, *out); });
+            Run("pooling", name + "_backward", flops, bytes + sizeof(ElemType) * (double) (inSize + outSize) * batchSize,
+                [&]() { engine->BackwardPooling(*out, *srcGrad, *in, *grad); });
+        }
+    }
+
+    // the updates of all parameters of a 20M-parameter model after a minibatch
+    void OptimizerUpdates()
+    {
+        const size_t rows = 2048, cols = 10240, n = rows * cols;
+        const double e = sizeof(ElemType);
+        auto gradients = Random(rows, cols);
+        auto parameters = Random(rows, cols);
+        Mat momentumState(rows, cols, m_deviceId); // (the other optimizers size their state themselves)
+        Mat adagradState(m_deviceId), fsAdagradState(m_deviceId), rmsPropState(m_deviceId);
+        momentumState.SetValue(0);
+
+        // operations and bytes as read and written by the CPU kernels per element
+        Run("optimizer", "momentum_sgd", 4.0 * n, 5 * e * n, [&]() { momentumState.NormalGrad(*gradients, *parameters, (ElemType) 1e-6, (ElemType) 0.9, false); });
+        Run("optimizer", "adagrad", 4.0 * n, 4 * e * n, [&]() { adagradState.Adagrad(*gradients, false); });
+        Run("optimizer", "fsadagrad", 12.0 * n, 7 * e * n, [&]() { fsAdagradState.FSAdagrad(256, *gradients, *parameters, (ElemType) 1e-6, (ElemType) 0.9); });
+        Run("optimizer", "rmsprop", 12.0 * n, 8 * e * n, [&]() { rmsPropState.RmsProp(*gradients, (ElemType) 0.99, (ElemType) 1.2, (ElemType) 10, (ElemType) 0.75, (ElemType) 0.1, false); });
+    }
+
+    BenchmarkRunner& m_runner;
+    DEVICEID_TYPE m_deviceId;
+    unsigned long m_seed = 1;
+    MatPtr m_syncMatrix;
+};
+
+static void Usage()
+{
+    fprintf(stderr, "Usage: mathbenchmarks [--double] [--device <id>] [--filter <substring>] [--minTime <seconds>] [--output <file>]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--double")
+            options.useDouble = true;
+        else if (arg == "--device" && hasValue)
+            options.deviceId = (DEVICEID_TYPE) atoi(argv[++i]);
+        else if (arg == "--filter" && hasValue)
+            options.filter = argv[++i];
+        else if (arg == "--minTime" && hasValue)
+            options.minTime = atof(argv[++i]);
+        else if (arg == "--output" && hasValue)
+            options.outputPath = argv[++i];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    try
+    {
+        BenchmarkRunner runner(options);
+        if (options.useDouble)
+            MathBenchmarks<double>(runner, options.deviceId).RunAll();
+        else
+            MathBenchmarks<float>(runner, options.deviceId).RunAll();
+
+        FILE* f = options.outputPath.empty() ? stdout : fopen(options.outputPath.c_str(), "w");
+        if (!f)
+            RuntimeError("Failed to open output file: %s", options.outputPath.c_str());
+        runner.WriteJson(f, options.useDouble ? "double" : "float");
+        if (f != stdout)
+            fclose(f);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "mathbenchmarks: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
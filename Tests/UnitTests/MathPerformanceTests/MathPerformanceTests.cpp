@@ -435,6 +435,49 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+/**
+Sparse input times dense weights, as in text models on bag-of-words input: forward W * x and the weight gradient dY * x^T.
+x is a CSC matrix (vocabSize x batchSize) with nzPerCol ones per column.
+*/
+template <class ElemType>
+void SparseTimesDenseTest(size_t vocabSize = 100000, size_t hiddenSize = 512, size_t batchSize = 256, size_t nzPerCol = 50, int count = 10, DEVICEID_TYPE deviceID = CPUDEVICE)
+{
+    cout << "Testing W(" << hiddenSize << "x" << vocabSize << ") * x(" << vocabSize << "x" << batchSize << ", " << nzPerCol << " nz/col)" << endl;
+
+    vector<CPUSPARSE_INDEX_TYPE> colStart(batchSize + 1);
+    vector<CPUSPARSE_INDEX_TYPE> rowIndex(batchSize * nzPerCol);
+    vector<ElemType> values(batchSize * nzPerCol, 1);
+    for (size_t j = 0; j < batchSize; j++)
+    {
+        colStart[j] = (CPUSPARSE_INDEX_TYPE) (j * nzPerCol);
+        // ascending row ids within a column
+        size_t step = vocabSize / nzPerCol;
+        for (size_t p = 0; p < nzPerCol; p++)
+            rowIndex[j * nzPerCol + p] = (CPUSPARSE_INDEX_TYPE) (p * step + rand() % step);
+    }
+    colStart[batchSize] = (CPUSPARSE_INDEX_TYPE) (batchSize * nzPerCol);
+
+    Matrix<ElemType> x(vocabSize, batchSize, deviceID, MatrixType::SPARSE, matrixFormatSparseCSC);
+    x.SetMatrixFromCSCFormat(colStart.data(), rowIndex.data(), values.data(), values.size(), vocabSize, batchSize);
+    Matrix<ElemType> W = Matrix<ElemType>::RandomUniform(hiddenSize, vocabSize, deviceID, -1, 1);
+    Matrix<ElemType> dY = Matrix<ElemType>::RandomUniform(hiddenSize, batchSize, deviceID, -1, 1);
+    Matrix<ElemType> Y(hiddenSize, batchSize, deviceID);
+    Matrix<ElemType> dW(hiddenSize, vocabSize, deviceID);
+    dW.SetValue(0);
+
+    auto t_start = clock();
+    for (int i = 0; i < count; ++i)
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, W, false, x, false, 0, Y);
+    auto t_end = clock();
+    std::cout << "W * x in: " << 1.0 * (t_end - t_start) / (CLOCKS_PER_SEC * count) << " seconds" << endl;
+
+    t_start = clock();
+    for (int i = 0; i < count; ++i)
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, dY, false, x, true, 1, dW);
+    t_end = clock();
+    std::cout << "dW += dY * x^T in: " << 1.0 * (t_end - t_start) / (CLOCKS_PER_SEC * count) << " seconds" << endl;
+}
+
 int wmain()
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
@@ -443,6 +486,9 @@ int wmain()
 
     TestOldRnnForwardPropSRP<float>();
 
+    SparseTimesDenseTest<float>(100000, 512, 256, 50);
+    SparseTimesDenseTest<float>(500000, 300, 1024, 20);
+
     // MandSTest<float>(100, 2);
 
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
@@ -0,0 +1,276 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Runs the kernels of every instruction set the processor supports on the same input and compares the results.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CPUKernels.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+template <class ElemType>
+struct KernelVariant
+{
+    const char* name;
+    CPUKernels<ElemType> kernels;
+};
+
+// the SSE3 kernels first, as the reference
+template <class ElemType>
+static std::vector<KernelVariant<ElemType>> GetKernelVariants()
+{
+    std::vector<KernelVariant<ElemType>> variants(1);
+    variants[0].name = "SSE3";
+    InitializeCPUKernelsSSE3(variants[0].kernels);
+
+    KernelVariant<ElemType> variant;
+    if (GetCPUInstructionSet() >= CPUInstructionSet::AVX2 && InitializeCPUKernelsAVX2(variant.kernels))
+    {
+        variant.name = "AVX2";
+        variants.push_back(variant);
+    }
+    if (GetCPUInstructionSet() >= CPUInstructionSet::AVX512 && InitializeCPUKernelsAVX512(variant.kernels))
+    {
+        variant.name = "AVX-512";
+        variants.push_back(variant);
+    }
+    BOOST_TEST_MESSAGE("Comparing " << variants.size() << " kernel variants up to " << variants.back().name);
+    return variants;
+}
+
+template <class ElemType>
+static std::vector<ElemType> RandomVector(size_t n, ElemType low, ElemType high, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(low, high);
+    std::vector<ElemType> v(n);
+    for (auto& x : v)
+        x = (ElemType) dist(rng);
+    return v;
+}
+
+// The variants may use FMA and sum in a different order, so the results are compared relative to their magnitude.
+template <class ElemType>
+static void CheckClose(const std::vector<ElemType>& expected, const std::vector<ElemType>& actual, double tolerance, const char* kernel, const char* variant)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        if (fabs((double) expected[i] - actual[i]) > tolerance * (1 + fabs((double) expected[i])))
+        {
+            BOOST_ERROR(kernel << " (" << variant << "): element " << i << " is " << actual[i] << ", expected " << expected[i]);
+            return;
+        }
+    }
+}
+
+template <class ElemType>
+static void CheckClose(ElemType expected, ElemType actual, double tolerance, const char* kernel, const char* variant)
+{
+    CheckClose(std::vector<ElemType>(1, expected), std::vector<ElemType>(1, actual), tolerance, kernel, variant);
+}
+
+template <class ElemType>
+static void TestTensorOps(double tolerance)
+{
+    // a [rows x cols], b [rows x cols], c [rows x 1] broadcast along the columns
+    const size_t rows = 67, cols = 45; // (not multiples of the vector widths, so that the tails are run as well)
+    const auto a = RandomVector<ElemType>(rows * cols, -3, 3, 1);
+    const auto b = RandomVector<ElemType>(rows * cols, -3, 3, 2);
+    const auto c = RandomVector<ElemType>(rows, -3, 3, 3);
+
+    SmallVector<size_t> elementwiseDims;
+    elementwiseDims.push_back(rows);
+    elementwiseDims.push_back(cols);
+    SmallVector<size_t> noReduction;
+    SmallVector<size_t> columnReduction;
+    columnReduction.push_back(cols);
+    SmallVector<size_t> rowsOnly;
+    rowsOnly.push_back(rows);
+
+    auto variants = GetKernelVariants<ElemType>();
+    std::vector<std::vector<ElemType>> unaryResults, reductionResults, binaryResults, ternaryResults;
+    for (const auto& variant : variants)
+    {
+        // us = 2 * sigmoid(a) + 0.5 * us
+        std::vector<ElemType> us = b;
+        std::array<SmallVector<ptrdiff_t>, 2> strides2, noStrides2;
+        for (auto& strides : strides2)
+        {
+            strides.push_back(1);
+            strides.push_back(rows);
+        }
+        variant.kernels.unaryTensorOp(0.5, { const_cast<ElemType*>(a.data()), us.data() }, 2, ElementWiseOperator::opSigmoid, { 0, 0 },
+                                      elementwiseDims, strides2, noReduction, noStrides2);
+        unaryResults.push_back(us);
+
+        // us = sum over the columns of exp(a)
+        std::vector<ElemType> sums(rows);
+        std::array<SmallVector<ptrdiff_t>, 2> rowStrides, columnStrides;
+        rowStrides[0].push_back(1);
+        rowStrides[1].push_back(1);
+        columnStrides[0].push_back(rows);
+        columnStrides[1].push_back(0);
+        variant.kernels.unaryTensorOp(0, { const_cast<ElemType*>(a.data()), sums.data() }, 1, ElementWiseOperator::opExp, { 0, 0 },
+                                      rowsOnly, rowStrides, columnReduction, columnStrides);
+        reductionResults.push_back(sums);
+
+        // us = a .* c (c broadcast)
+        std::vector<ElemType> product(rows * cols);
+        std::array<SmallVector<ptrdiff_t>, 3> strides3, noStrides3;
+        for (size_t i = 0; i < 3; i++)
+        {
+            strides3[i].push_back(1);
+            strides3[i].push_back(i == 1 ? 0 : rows);
+        }
+        variant.kernels.binaryTensorOp(0, { const_cast<ElemType*>(a.data()), const_cast<ElemType*>(c.data()), product.data() }, 1, ElementWiseOperator::opElementwiseProduct, { 0, 0, 0 },
+                                       elementwiseDims, strides3, noReduction, noStrides3);
+        binaryResults.push_back(product);
+
+        // us = a > 0 ? b : c (c broadcast)
+        std::vector<ElemType> cond(rows * cols);
+        std::array<SmallVector<ptrdiff_t>, 4> strides4, noStrides4;
+        for (size_t i = 0; i < 4; i++)
+        {
+            strides4[i].push_back(1);
+            strides4[i].push_back(i == 2 ? 0 : rows);
+        }
+        variant.kernels.ternaryTensorOp(0, { const_cast<ElemType*>(a.data()), const_cast<ElemType*>(b.data()), const_cast<ElemType*>(c.data()), cond.data() }, 1, ElementWiseOperator::opCond, { 0, 0, 0, 0 },
+                                        elementwiseDims, strides4, noReduction, noStrides4);
+        ternaryResults.push_back(cond);
+    }
+    for (size_t v = 1; v < variants.size(); v++)
+    {
+        CheckClose(unaryResults[0], unaryResults[v], tolerance, "unaryTensorOp", variants[v].name);
+        CheckClose(reductionResults[0], reductionResults[v], tolerance, "unaryTensorOp (reduction)", variants[v].name);
+        CheckClose(binaryResults[0], binaryResults[v], tolerance, "binaryTensorOp", variants[v].name);
+        CheckClose(ternaryResults[0], ternaryResults[v], tolerance, "ternaryTensorOp", variants[v].name);
+    }
+}
+
+template <class ElemType>
+static void TestLogSoftmaxAndOptimizers(double tolerance)
+{
+    const size_t rows = 131, cols = 7, n = rows * cols;
+    const auto a = RandomVector<ElemType>(n, -5, 5, 4);
+    const auto gradients = RandomVector<ElemType>(n, -1, 1, 5);
+    const auto state = RandomVector<ElemType>(n, (ElemType) 0.1, 1, 6);
+
+    auto variants = GetKernelVariants<ElemType>();
+    std::vector<std::vector<ElemType>> logSoftmax, adagradGradients, fsAdagradValues, rmsPropGradients;
+    std::vector<ElemType> adagradMultipliers, rmsPropMultipliers;
+    for (const auto& variant : variants)
+    {
+        std::vector<ElemType> us(n);
+        variant.kernels.logSoftmaxColumns(a.data(), us.data(), rows, cols);
+        logSoftmax.push_back(us);
+
+        std::vector<ElemType> accumulator = state, g = gradients;
+        adagradMultipliers.push_back(variant.kernels.adagrad(accumulator.data(), g.data(), n, true));
+        adagradGradients.push_back(g);
+
+        std::vector<ElemType> smoothAda = state, smoothMom(n, 0), values = a;
+        variant.kernels.fsAdagrad(gradients.data(), smoothAda.data(), smoothMom.data(), values.data(), n, (ElemType) 0.01, (ElemType) 0.9, (ElemType) 0.99, (ElemType) 0.5);
+        fsAdagradValues.push_back(values);
+
+        std::vector<ElemType> avars = state, signs(n, 0), steps(n, (ElemType) 0.02);
+        g = gradients;
+        rmsPropMultipliers.push_back(variant.kernels.rmsProp(g.data(), avars.data(), signs.data(), steps.data(), n,
+                                                             (ElemType) 0.99, (ElemType) 1.2, 10, (ElemType) 0.75, (ElemType) 0.1, true));
+        rmsPropGradients.push_back(g);
+    }
+    for (size_t v = 1; v < variants.size(); v++)
+    {
+        CheckClose(logSoftmax[0], logSoftmax[v], tolerance, "logSoftmaxColumns", variants[v].name);
+        CheckClose(adagradGradients[0], adagradGradients[v], tolerance, "adagrad", variants[v].name);
+        CheckClose(adagradMultipliers[0], adagradMultipliers[v], tolerance, "adagrad (multiplier)", variants[v].name);
+        CheckClose(fsAdagradValues[0], fsAdagradValues[v], tolerance, "fsAdagrad", variants[v].name);
+        CheckClose(rmsPropGradients[0], rmsPropGradients[v], tolerance, "rmsProp", variants[v].name);
+        CheckClose(rmsPropMultipliers[0], rmsPropMultipliers[v], tolerance, "rmsProp (multiplier)", variants[v].name);
+    }
+}
+
+template <class ElemType>
+static void TestInt8AndHalfKernels(double tolerance)
+{
+    const size_t k = 77, m = 19, n = 6;
+
+    std::mt19937 rng(7);
+    std::vector<signed char> a8(k * m);
+    for (auto& x : a8)
+        x = (signed char) ((int) (rng() % 255) - 127);
+    const auto aScales = RandomVector<ElemType>(m, (ElemType) 0.001, (ElemType) 0.01, 8);
+    const auto b = RandomVector<ElemType>(k * n, -2, 2, 9);
+
+    // fp16 values of moderate magnitude, and bf16 values (the upper halves of floats)
+    std::vector<unsigned short> half(k * m), bfloat(k * m);
+    for (size_t i = 0; i < half.size(); i++)
+    {
+        half[i] = (unsigned short) ((rng() % 2) << 15 | (8 + rng() % 14) << 10 | rng() % 1024);
+        bfloat[i] = (unsigned short) ((rng() % 2) << 15 | (120 + rng() % 14) << 7 | rng() % 128);
+    }
+    const auto bTransposed = RandomVector<ElemType>(m * n, -2, 2, 10);
+
+    auto variants = GetKernelVariants<ElemType>();
+    std::vector<std::vector<ElemType>> int8Results, int8RangeResults, widened, halfTimes, halfTransposeTimes, bfloatTimes;
+    for (const auto& variant : variants)
+    {
+        std::vector<ElemType> us(m * n);
+        variant.kernels.int8TransposeTimes(a8.data(), aScales.data(), b.data(), us.data(), k, m, n, 0);
+        int8Results.push_back(us);
+        variant.kernels.int8TransposeTimes(a8.data(), aScales.data(), b.data(), us.data(), k, m, n, 1);
+        int8RangeResults.push_back(us);
+
+        std::vector<ElemType> wide(half.size());
+        variant.kernels.widenHalf(half.data(), wide.data(), half.size(), false);
+        widened.push_back(wide);
+        variant.kernels.widenHalf(bfloat.data(), wide.data(), bfloat.size(), true);
+        widened.back().insert(widened.back().end(), wide.begin(), wide.end());
+
+        // a [k x m]: us [k x n] = a * bTransposed [m x n], and us [m x n] = a^T * b [k x n]
+        std::vector<ElemType> product(k * n);
+        variant.kernels.halfTimes(half.data(), false, false, bTransposed.data(), product.data(), k, m, n);
+        halfTimes.push_back(product);
+        variant.kernels.halfTimes(bfloat.data(), true, false, bTransposed.data(), product.data(), k, m, n);
+        bfloatTimes.push_back(product);
+        std::vector<ElemType> transposeProduct(m * n);
+        variant.kernels.halfTimes(half.data(), false, true, b.data(), transposeProduct.data(), m, k, n);
+        halfTransposeTimes.push_back(transposeProduct);
+    }
+    for (size_t v = 1; v < variants.size(); v++)
+    {
+        CheckClose(int8Results[0], int8Results[v], tolerance, "int8TransposeTimes", variants[v].name);
+        CheckClose(int8RangeResults[0], int8RangeResults[v], tolerance, "int8TransposeTimes (fixed range)", variants[v].name);
+        CheckClose(widened[0], widened[v], 0, "widenHalf", variants[v].name); // (exact)
+        CheckClose(halfTimes[0], halfTimes[v], tolerance, "halfTimes", variants[v].name);
+        CheckClose(bfloatTimes[0], bfloatTimes[v], tolerance, "halfTimes (bf16)", variants[v].name);
+        CheckClose(halfTransposeTimes[0], halfTransposeTimes[v], tolerance, "halfTimes (transposed)", variants[v].name);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(CPUKernelsSuite)
+
+BOOST_AUTO_TEST_CASE(CPUKernelsTensorOps)
+{
+    TestTensorOps<float>(1e-5);
+    TestTensorOps<double>(1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(CPUKernelsLogSoftmaxAndOptimizers)
+{
+    TestLogSoftmaxAndOptimizers<float>(1e-5);
+    TestLogSoftmaxAndOptimizers<double>(1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(CPUKernelsInt8AndHalf)
+{
+    TestInt8AndHalfKernels<float>(1e-5);
+    TestInt8AndHalfKernels<double>(1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
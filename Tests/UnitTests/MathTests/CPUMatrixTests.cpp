@@ -61,6 +61,21 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixConstructorFormatRowMajor, RandomSeedFixture)
     BOOST_CHECK_EQUAL(m(1, 2), 12);
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixResizeExternalBufferAndView, RandomSeedFixture)
+{
+    // an external buffer can only be "resized" to its dimensions, a view not at all
+    std::array<double, 6> array = {1, 2, 3, 4, 5, 6};
+    DMatrix m(2, 3, array.data(), matrixFlagDontOwnBuffer);
+    m.Resize(2, 3);
+    BOOST_CHECK_EQUAL(m.Data(), array.data());
+    BOOST_CHECK_THROW(m.Resize(3, 3), std::logic_error);
+
+    DMatrix m1(2, 3);
+    DMatrix view = m1.ColumnSlice(0, 3);
+    BOOST_CHECK_THROW(view.Resize(2, 3), std::logic_error);
+    BOOST_CHECK_THROW(view.Resize(2, 2), std::logic_error);
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixAddAndSub, RandomSeedFixture)
 {
     DMatrix m0(2, 3);
@@ -898,6 +913,37 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixScatterColumnsRepeatedTargets, RandomSeedFixture)
+{
+    // context windows of 3 frames over 10 frames: boundary frames are the target of several columns
+    const size_t numFrames = 10;
+    const size_t windowSize = 3;
+    DMatrix index(1, numFrames * windowSize);
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        for (size_t k = 0; k < windowSize; k++)
+            index(0, t * windowSize + k) = (double) std::min(std::max((int) (t + k) - 1, 0), (int) numFrames - 1);
+    }
+
+    // With two threads, 300 rows are split into row blocks, and 3 rows (fewer row blocks than threads) into columns.
+    int previousNumThreads = CPUMatrix<double>::SetNumThreadsForCurrentThread(2);
+    for (size_t numRows : { 300, 3 })
+    {
+        DMatrix frames = DMatrix::RandomUniform(numRows, numFrames, -1, 1, IncrementCounter());
+        DMatrix windows(numRows, numFrames * windowSize);
+        windows.DoGatherColumnsOf(0, index, frames, 1);
+
+        // scattering back accumulates every copy of a frame
+        DMatrix sums(numRows, numFrames);
+        sums.SetValue(0);
+        sums.DoScatterColumnsOf(1, index, windows, 1);
+        DMatrix expected(frames);
+        DMatrix::Scale(3, expected);
+        BOOST_CHECK(sums.IsEqualTo(expected, c_epsilonFloatE4));
+    }
+    CPUMatrix<double>::SetNumThreadsForCurrentThread(previousNumThreads);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -59,6 +59,151 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    const size_t m = 300; // more than one row block
+    const size_t k = 40;
+    const size_t n = 9;
+    const double alpha = 0.5;
+
+    for (auto format : {MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR})
+    {
+        for (bool transposeA : {false, true})
+        {
+            for (bool transposeB : {false, true})
+            {
+                for (double beta : {0.0, 1.0, 0.7})
+                {
+                    // dense x sparse
+                    DenseMatrix a(transposeA ? k : m, transposeA ? m : k);
+                    a.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    DenseMatrix bDense(transposeB ? n : k, transposeB ? k : n);
+                    bDense.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    foreach_coord (row, col, bDense)
+                    {
+                        if (fabs(bDense(row, col)) < 0.6)
+                            bDense(row, col) = 0;
+                    }
+
+                    // SetValue() must be called in storage order.
+                    SparseMatrix bSparse(format, bDense.GetNumRows(), bDense.GetNumCols(), 0);
+                    size_t outer = format == MatrixFormat::matrixFormatSparseCSC ? bDense.GetNumCols() : bDense.GetNumRows();
+                    size_t inner = format == MatrixFormat::matrixFormatSparseCSC ? bDense.GetNumRows() : bDense.GetNumCols();
+                    for (size_t j = 0; j < outer; j++)
+                    {
+                        for (size_t i = 0; i < inner; i++)
+                        {
+                            size_t row = format == MatrixFormat::matrixFormatSparseCSC ? i : j;
+                            size_t col = format == MatrixFormat::matrixFormatSparseCSC ? j : i;
+                            if (bDense(row, col) != 0)
+                                bSparse.SetValue(row, col, bDense(row, col));
+                        }
+                    }
+
+                    DenseMatrix c0(m, n);
+                    c0.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    DenseMatrix c1(c0);
+                    DenseMatrix::MultiplyAndWeightedAdd(alpha, a, transposeA, bDense, transposeB, beta, c0);
+                    SparseMatrix::MultiplyAndWeightedAdd(alpha, a, transposeA, bSparse, transposeB, beta, c1);
+                    BOOST_CHECK(c1.IsEqualTo(c0, c_epsilonFloatE4));
+
+                    // sparse x dense, the sparse matrix used as the left operand
+                    size_t rows = transposeA ? bDense.GetNumCols() : bDense.GetNumRows();
+                    size_t cols = transposeA ? bDense.GetNumRows() : bDense.GetNumCols();
+                    DenseMatrix d(transposeB ? m : cols, transposeB ? cols : m);
+                    d.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    DenseMatrix e0(rows, m);
+                    e0.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    DenseMatrix e1(e0);
+                    DenseMatrix::MultiplyAndWeightedAdd(alpha, bDense, transposeA, d, transposeB, beta, e0);
+                    SparseMatrix::MultiplyAndWeightedAdd(alpha, bSparse, transposeA, d, transposeB, beta, e1);
+                    BOOST_CHECK(e1.IsEqualTo(e0, c_epsilonFloatE4));
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAddSharedParameter, RandomSeedFixture)
+{
+    // a parameter used by several nodes gets the sum of their block-column gradients
+    const size_t m = 6;
+    const size_t vocabSize = 30;
+    const size_t batchSize = 4;
+    // words per use: the second adds columns before, between and after those of the first, the third only has existing ones
+    const std::vector<std::vector<size_t>> words = { { 10, 12, 12, 20 }, { 3, 11, 20, 25 }, { 12, 3, 25, 10 } };
+
+    DenseMatrix gradientDense(m, vocabSize);
+    gradientDense.SetValue(0);
+    SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol);
+    for (const auto& useWords : words)
+    {
+        DenseMatrix inputDense(vocabSize, batchSize);
+        inputDense.SetValue(0);
+        SparseMatrix input(MatrixFormat::matrixFormatSparseCSC, vocabSize, batchSize, 0);
+        for (size_t j = 0; j < batchSize; j++)
+        {
+            inputDense(useWords[j], j) = 1;
+            input.SetValue(useWords[j], j, 1);
+        }
+        DenseMatrix outputGradient(m, batchSize);
+        outputGradient.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+        DenseMatrix::MultiplyAndWeightedAdd(1, outputGradient, false, inputDense, true, 1, gradientDense);
+        SparseMatrix::MultiplyAndAdd(1, outputGradient, false, input, true, gradient);
+    }
+    BOOST_CHECK_EQUAL(gradient.NzCount(), 6 * m); // one block per distinct word
+
+    DenseMatrix gradientSum(m, vocabSize);
+    gradientSum.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, gradient, gradientSum);
+    BOOST_CHECK(gradientSum.IsEqualTo(gradientDense, c_epsilonFloatE4));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixLazyRegularization, RandomSeedFixture)
+{
+    // SGD with L2 on a block-column gradient, regularizing only the columns present in it, must match dense SGD
+    const size_t m = 8;
+    const size_t vocabSize = 40;
+    const size_t batchSize = 5;
+    const float learnRate = 0.1f;
+    const float l2Weight = 0.05f;
+
+    DenseMatrix w0(m, vocabSize);
+    w0.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix w1(w0);
+    std::vector<size_t> lastUpdate(vocabSize, 0);
+    size_t step = 0;
+    for (size_t iter = 0; iter < 10; iter++)
+    {
+        DenseMatrix inputDense(vocabSize, batchSize);
+        inputDense.SetValue(0);
+        SparseMatrix input(MatrixFormat::matrixFormatSparseCSC, vocabSize, batchSize, 0);
+        for (size_t j = 0; j < batchSize; j++)
+        {
+            size_t word = (iter * 7 + j * (iter % 3 + 1)) % (vocabSize / 2);
+            inputDense(word, j) = 1;
+            input.SetValue(word, j, 1);
+        }
+        DenseMatrix outputGradient(m, batchSize);
+        outputGradient.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+        DenseMatrix gradientDense(m, vocabSize);
+        DenseMatrix::MultiplyAndWeightedAdd(1, outputGradient, false, inputDense, true, 0, gradientDense);
+        DenseMatrix::ScaleAndAdd(l2Weight, w0, gradientDense);
+        DenseMatrix::ScaleAndAdd(-learnRate, gradientDense, w0);
+
+        SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol);
+        SparseMatrix::MultiplyAndAdd(1, outputGradient, false, input, true, gradient);
+        step++;
+        gradient.RegularizeBlocks(w1, lastUpdate, step, learnRate * l2Weight, 0, l2Weight);
+        SparseMatrix::ScaleAndAdd(-learnRate, gradient, w1);
+        gradient.SoftThresholdBlocks(w1, lastUpdate, step, 0);
+    }
+    SparseMatrix::CatchUpRegularization(w1, lastUpdate, step, learnRate * l2Weight, 0);
+    BOOST_CHECK(w1.IsEqualTo(w0, c_epsilonFloatE4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -499,6 +499,138 @@ BOOST_AUTO_TEST_CASE(PoolingBackward)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PoolingGemmCpu)
+{
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<> batchSizeG(1, 8);
+    std::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    for (auto kind : {PoolKind::Max, PoolKind::Average})
+    {
+        for (const auto& g : GeneratePoolTestConfigs())
+        {
+            auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Reference);
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Gemm);
+
+            size_t n = batchSizeG(rng);
+            vec buf;
+            size_t crowIn = g->InputShape().GetNumElements();
+            buf.resize(crowIn * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix in(crowIn, n, buf.data(), deviceId, matrixFlagNormal);
+
+            size_t crowOut = g->OutputShape().GetNumElements();
+            buf.resize(crowOut * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix srcGrad(crowOut, n, buf.data(), deviceId, matrixFlagNormal);
+            SingleMatrix out(crowOut, n, buf.data(), deviceId, matrixFlagNormal);
+            SingleMatrix outB(crowOut, n, buf.data(), deviceId, matrixFlagNormal);
+
+            std::vector<int> argmax(crowOut * n);
+            testEng->ForwardPooling(in, out, argmax.data());
+            baseEng->ForwardPooling(in, outB);
+
+            buf.resize(crowIn * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix grad(crowIn, n, buf.data(), deviceId, matrixFlagNormal);
+            SingleMatrix gradB(crowIn, n, buf.data(), deviceId, matrixFlagNormal);
+
+            testEng->BackwardPooling(out, srcGrad, in, grad, argmax.data());
+            baseEng->BackwardPooling(outB, srcGrad, in, gradB);
+
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", Batch: " << n;
+            std::string msg = " are not equal, " + tmsg.str();
+
+            float relErr = Err<float>::Rel;
+            float absErr = Err<float>::Abs;
+            std::string emsg;
+
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr, absErr), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, relErr, absErr * 8), "grad" << msg << ". " << emsg);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MaxPoolingGemmCpuTies)
+{
+    // 2x2 windows with stride 2 over a 4x4 image with 3 channels, whose maxima are tied: only the first maximum of
+    // each window (scanning rows, then columns) receives the gradient, as with cuDNN.
+    const size_t w = 4, h = 4, c = 3, n = 2;
+    auto g = std::make_shared<ConvolveGeometry>(TensorShape(w, h, c), TensorShape(2, 2, 1), TensorShape(1), TensorShape(2, 2, 1),
+                                                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+                                                TensorShape(0), TensorShape(0));
+    int deviceId = -1;
+    auto eng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::Max, ConvolutionEngineKind::Gemm);
+    const size_t crowIn = w * h * c;
+    const size_t crowOut = g->OutputShape().GetNumElements();
+    BOOST_REQUIRE_EQUAL(crowOut, 2 * 2 * c);
+
+    // The input pixels of window cells (dx, dy), and the cell of the first maximum, per channel: channel 0 is tied
+    // but for the first cell, channel 1 is all tied, and channel 2 is tied in the second row.
+    auto value = [](size_t ch, size_t dx, size_t dy, size_t sample) -> float
+    {
+        float v = ch == 0 ? (dx == 0 && dy == 0 ? 0.0f : 5.0f) : ch == 1 ? 2.0f : (dy == 1 ? 7.0f : 1.0f);
+        return v + sample; // (other values in the second sample, with the same maxima)
+    };
+    const size_t firstMaxDx[c] = { 1, 0, 0 };
+    const size_t firstMaxDy[c] = { 0, 0, 1 };
+    vec buf(crowIn * n);
+    for (size_t sample = 0; sample < n; sample++)
+        for (size_t ch = 0; ch < c; ch++)
+            for (size_t y = 0; y < h; y++)
+                for (size_t x = 0; x < w; x++)
+                    buf[sample * crowIn + (ch * h + y) * w + x] = value(ch, x % 2, y % 2, sample);
+    SingleMatrix in(crowIn, n, buf.data(), deviceId, matrixFlagNormal);
+
+    vec srcGradBuf(crowOut * n);
+    std::iota(begin(srcGradBuf), end(srcGradBuf), 1.0f);
+    SingleMatrix srcGrad(crowOut, n, srcGradBuf.data(), deviceId, matrixFlagNormal);
+
+    SingleMatrix expected(crowIn, n, deviceId);
+    expected.SetValue(0);
+    for (size_t sample = 0; sample < n; sample++)
+        for (size_t ch = 0; ch < c; ch++)
+            for (size_t oy = 0; oy < 2; oy++)
+                for (size_t ox = 0; ox < 2; ox++)
+                {
+                    size_t x = 2 * ox + firstMaxDx[ch], y = 2 * oy + firstMaxDy[ch];
+                    expected((ch * h + y) * w + x, sample) = srcGrad((ch * 2 + oy) * 2 + ox, sample);
+                }
+
+    std::string emsg;
+    // with the positions recorded by forward, and without (found again in backward)
+    std::vector<int> argmax(crowOut * n);
+    for (int* pArgmax : { argmax.data(), (int*) nullptr })
+    {
+        SingleMatrix out(crowOut, n, deviceId);
+        eng->ForwardPooling(in, out, pArgmax);
+        for (size_t sample = 0; sample < n; sample++)
+            for (size_t i = 0; i < crowOut; i++)
+                BOOST_REQUIRE_EQUAL(out(i, sample), value(i / 4, firstMaxDx[i / 4], firstMaxDy[i / 4], sample));
+
+        SingleMatrix grad(crowIn, n, deviceId);
+        grad.SetValue(0);
+        eng->BackwardPooling(out, srcGrad, in, grad, pArgmax);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, expected, emsg, 0.0f, 0.0f), "grad are not equal. " << emsg);
+    }
+
+    // The positions belong to the forward pass that recorded them, not to the buffers: after a forward of other
+    // values in the same buffers, backward with the first positions still scatters to them.
+    SingleMatrix out(crowOut, n, deviceId);
+    eng->ForwardPooling(in, out, argmax.data());
+    SingleMatrix other(in.DeepClone());
+    std::vector<int> otherArgmax(crowOut * n);
+    in.SetValue(0);
+    eng->ForwardPooling(in, out, otherArgmax.data()); // (all tied: the first cell of each window)
+    in.SetValue(other);
+    SingleMatrix grad(crowIn, n, deviceId);
+    grad.SetValue(0);
+    eng->BackwardPooling(out, srcGrad, in, grad, argmax.data());
+    BOOST_REQUIRE_MESSAGE(CheckEqual(grad, expected, emsg, 0.0f, 0.0f), "grad are not equal. " << emsg);
+}
+
 BOOST_AUTO_TEST_CASE(MaxUnpooling)
 {
     using IntMatrix = Matrix<int>;
@@ -0,0 +1,160 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the fp16/bf16 weights used for inference (HalfMatrix and Matrix::AssignHalfProductOf()) against products
+// with the widened weights.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/HalfMatrix.h"
+#include <limits>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+template <class ElemType>
+static std::vector<ElemType> ToVector(const Matrix<ElemType>& m)
+{
+    std::unique_ptr<ElemType[]> data(m.CopyToArray());
+    return std::vector<ElemType>(data.get(), data.get() + m.GetNumElements());
+}
+
+template <class ElemType>
+static Matrix<ElemType> Widened(const HalfMatrix<ElemType>& a)
+{
+    Matrix<ElemType> widened(CPUDEVICE);
+    a.CopyTo(widened);
+    return widened;
+}
+
+BOOST_AUTO_TEST_SUITE(HalfMatrixSuite)
+
+// narrowing rounds to the nearest value, ties to even, and saturates to infinity like a conversion to IEEE fp16
+BOOST_FIXTURE_TEST_CASE(HalfMatrixRounding, RandomSeedFixture)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    const std::vector<float> values = { 0, -0.5f, 1 + 1.0f / 2048, 1 + 3.0f / 2048, 65504, 70000, 1.0f / (1 << 24), -inf, 1 + 1.0f / 256, 1 + 3.0f / 256, 1e30f };
+    const std::vector<float> fp16 = { 0, -0.5f, 1, 1 + 4.0f / 2048, 65504, inf, 1.0f / (1 << 24), -inf, 1 + 1.0f / 256, 1 + 3.0f / 256, inf };
+    const std::vector<float> bf16 = { 0, -0.5f, 1, 1, 65536, 70144, 1.0f / (1 << 24), -inf, 1, 1 + 4.0f / 256, 1.00025555e30f };
+    Matrix<float> m(1, values.size(), const_cast<float*>(values.data()), CPUDEVICE);
+
+    HalfMatrix<float> half;
+    half.Assign(m, HalfPrecisionFormat::Float16);
+    BOOST_CHECK(half.GetFormat() == HalfPrecisionFormat::Float16);
+    BOOST_CHECK_EQUAL(half.GetSizeInBytes(), values.size() * 2);
+    BOOST_CHECK(ToVector(Widened(half)) == fp16);
+    half.Assign(m, HalfPrecisionFormat::BFloat16);
+    BOOST_CHECK(ToVector(Widened(half)) == bf16);
+
+    // random values within the relative precision of the formats (11 and 8 significant bits)
+    Matrix<float> r = Matrix<float>::RandomUniform(17, 23, CPUDEVICE, -100, 100, IncrementCounter());
+    for (auto format : { HalfPrecisionFormat::Float16, HalfPrecisionFormat::BFloat16 })
+    {
+        half.Assign(r, format);
+        auto expected = ToVector(r), actual = ToVector(Widened(half));
+        const float eps = format == HalfPrecisionFormat::Float16 ? 1.0f / 2048 : 1.0f / 256;
+        for (size_t i = 0; i < expected.size(); i++)
+            BOOST_CHECK_LE(fabs(actual[i] - expected[i]), fabs(expected[i]) * eps + 1e-7f); // (+ the fp16 subnormal step)
+
+        // narrowing the widened values again is exact
+        HalfMatrix<float> again;
+        again.Assign(Widened(half), format);
+        BOOST_CHECK(ToVector(Widened(again)) == actual);
+    }
+}
+
+// a * b or a^T * b against the product with the widened a: n <= 8 goes through the kernel that widens a while
+// reading it, larger n through blocks of widened rows and the regular GEMM
+template <class ElemType>
+static void TestHalfTimes(size_t m, size_t k, size_t n, bool transpose, HalfPrecisionFormat format)
+{
+    Matrix<ElemType> a = Matrix<ElemType>::RandomUniform(transpose ? k : m, transpose ? m : k, CPUDEVICE, -1, 1, 1);
+    Matrix<ElemType> b = Matrix<ElemType>::RandomUniform(k, n, CPUDEVICE, -2, 2, 2);
+    HalfMatrix<ElemType> half;
+    half.Assign(a, format);
+
+    Matrix<ElemType> expected(CPUDEVICE);
+    expected.AssignProductOf(Widened(half), transpose, b, false);
+    Matrix<ElemType> actual(CPUDEVICE);
+    actual.AssignHalfProductOf(half, transpose, b);
+    BOOST_REQUIRE_EQUAL(actual.GetNumRows(), m);
+    BOOST_REQUIRE_EQUAL(actual.GetNumCols(), n);
+
+    // only the order of the additions differs
+    auto ev = ToVector(expected), av = ToVector(actual);
+    const double eps = sizeof(ElemType) == sizeof(float) ? 1e-5 : 1e-12;
+    for (size_t i = 0; i < ev.size(); i++)
+        BOOST_CHECK_SMALL((double) av[i] - ev[i], eps * 2 * k);
+
+    // and against the product with the original a, the error is that of the rounded elements (|a| <= 1, |b| <= 2)
+    Matrix<ElemType> full(CPUDEVICE);
+    full.AssignProductOf(a, transpose, b, false);
+    auto fv = ToVector(full);
+    const double roundingEps = format == HalfPrecisionFormat::Float16 ? 1.0 / 2048 : 1.0 / 256;
+    for (size_t i = 0; i < fv.size(); i++)
+        BOOST_CHECK_SMALL((double) av[i] - fv[i], (roundingEps + eps) * 2 * k);
+}
+
+BOOST_FIXTURE_TEST_CASE(HalfMatrixTimes, RandomSeedFixture)
+{
+    for (auto format : { HalfPrecisionFormat::Float16, HalfPrecisionFormat::BFloat16 })
+    {
+        for (bool transpose : { false, true })
+        {
+            for (size_t n : { 1, 3, 8, 9, 40 })
+                TestHalfTimes<float>(37, 101, n, transpose, format);
+            TestHalfTimes<float>(150, 4096, 12, transpose, format); // (blocks of 64 rows)
+            TestHalfTimes<double>(37, 101, 4, transpose, format);
+            TestHalfTimes<double>(37, 101, 20, transpose, format);
+        }
+    }
+}
+
+// embedding lookup: only the selected columns are widened
+BOOST_FIXTURE_TEST_CASE(HalfMatrixSparseTimes, RandomSeedFixture)
+{
+    const size_t m = 13, V = 50, n = 4;
+    Matrix<float> w = Matrix<float>::RandomUniform(m, V, CPUDEVICE, -2, 2, IncrementCounter());
+    HalfMatrix<float> half;
+    half.Assign(w, HalfPrecisionFormat::Float16);
+
+    // columns: one-hot 3, one-hot 49, 0.5 * e7 + 2 * e8, empty
+    std::vector<CPUSPARSE_INDEX_TYPE> colStarts = { 0, 1, 2, 4, 4 };
+    std::vector<CPUSPARSE_INDEX_TYPE> rowIndices = { 3, 49, 7, 8 };
+    std::vector<float> values = { 1, 1, 0.5f, 2 };
+    Matrix<float> sparse(V, n, CPUDEVICE, MatrixType::SPARSE, matrixFormatSparseCSC);
+    sparse.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), V, n);
+    Matrix<float> dense(V, n, CPUDEVICE);
+    dense.SetValue(0);
+    for (size_t j = 0; j < n; j++)
+        for (CPUSPARSE_INDEX_TYPE p = colStarts[j]; p < colStarts[j + 1]; p++)
+            dense(rowIndices[p], j) = values[p];
+
+    Matrix<float> expected(CPUDEVICE);
+    expected.AssignProductOf(Widened(half), false, dense, false);
+    auto ev = ToVector(expected);
+    for (const auto* b : { &sparse, &dense })
+    {
+        Matrix<float> actual(CPUDEVICE);
+        actual.AssignHalfProductOf(half, false, *b);
+        BOOST_REQUIRE_EQUAL(actual.GetNumRows(), m);
+        BOOST_REQUIRE_EQUAL(actual.GetNumCols(), n);
+        auto av = ToVector(actual);
+        for (size_t i = 0; i < ev.size(); i++)
+            BOOST_CHECK_SMALL(av[i] - ev[i], 1e-5f);
+    }
+
+    // a slice of the sparse columns (the column starts do not begin at 0)
+    Matrix<float> slice = sparse.ColumnSlice(2, 2);
+    Matrix<float> actual(CPUDEVICE);
+    actual.AssignHalfProductOf(half, false, slice);
+    auto av = ToVector(actual);
+    for (size_t i = 0; i < 2 * m; i++)
+        BOOST_CHECK_SMALL(av[i] - ev[2 * m + i], 1e-5f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
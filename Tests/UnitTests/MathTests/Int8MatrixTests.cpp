@@ -0,0 +1,171 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the int8 weights used for inference (Int8Matrix and Matrix::AssignInt8ProductOf()) against float products.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/Int8Matrix.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef Matrix<float> SingleMatrix;
+
+static std::vector<float> ToVector(const SingleMatrix& m)
+{
+    std::unique_ptr<float[]> data(m.CopyToArray());
+    return std::vector<float>(data.get(), data.get() + m.GetNumElements());
+}
+
+// checks that each column of q, dequantized, is within half a quantization step of 'expected' [rows x cols], and that
+// the largest magnitude of each column is mapped to +-127
+static void CheckQuantized(const Int8Matrix<float>& q, const std::vector<float>& expected, size_t rows, size_t cols)
+{
+    BOOST_REQUIRE_EQUAL(q.GetNumRows(), rows);
+    BOOST_REQUIRE_EQUAL(q.GetNumCols(), cols);
+    for (size_t c = 0; c < cols; c++)
+    {
+        const float scale = q.Scales()[c];
+        int maxAbs = 0;
+        for (size_t r = 0; r < rows; r++)
+        {
+            int v = q.Data()[c * rows + r];
+            maxAbs = std::max(maxAbs, abs(v));
+            BOOST_CHECK_LE(fabs(v * scale - expected[c * rows + r]), scale * 0.5f * (1 + 1e-5f));
+        }
+        BOOST_CHECK_EQUAL(maxAbs, 127);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(Int8MatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(Int8MatrixQuantize, RandomSeedFixture)
+{
+    const size_t rows = 37, cols = 11;
+    SingleMatrix a = SingleMatrix::RandomUniform(rows, cols, CPUDEVICE, -3, 2, IncrementCounter());
+    auto values = ToVector(a);
+
+    Int8Matrix<float> q;
+    q.Quantize(a, false);
+    CheckQuantized(q, values, rows, cols);
+
+    // with 'transpose' the rows of a are stored as columns
+    std::vector<float> transposed(rows * cols);
+    for (size_t r = 0; r < rows; r++)
+        for (size_t c = 0; c < cols; c++)
+            transposed[r * cols + c] = values[c * rows + r];
+    q.Quantize(a, true);
+    CheckQuantized(q, transposed, cols, rows);
+
+    // an all-zero column stays zero
+    a.SetValue(0);
+    q.Quantize(a, false);
+    for (size_t i = 0; i < rows * cols; i++)
+        BOOST_CHECK_EQUAL(q.Data()[i], 0);
+}
+
+// W * b with W [m x k] stored transposed in int8, as TimesNode does, against the float product. Each product
+// W(i,c) * b(c,j) is off by at most |W(i,c)| eb + |b(c,j)| ea + ea eb with the quantization errors ea and eb (half
+// the scales of row i of W and column j of b); the result must be within the sum of these bounds.
+static void TestInt8TransposeTimes(size_t m, size_t k, size_t n, float bRange)
+{
+    SingleMatrix w = SingleMatrix::RandomUniform(m, k, CPUDEVICE, -1, 1, 1);
+    SingleMatrix b = SingleMatrix::RandomUniform(k, n, CPUDEVICE, bRange > 0 ? -bRange : -5, bRange > 0 ? bRange : 5, 2);
+    SingleMatrix expected(CPUDEVICE);
+    expected.AssignProductOf(w, false, b, false);
+
+    Int8Matrix<float> q;
+    q.Quantize(w, true);
+    SingleMatrix actual(CPUDEVICE);
+    actual.AssignInt8ProductOf(q, true, b, bRange);
+    BOOST_REQUIRE_EQUAL(actual.GetNumRows(), m);
+    BOOST_REQUIRE_EQUAL(actual.GetNumCols(), n);
+
+    auto wv = ToVector(w), bv = ToVector(b), ev = ToVector(expected), av = ToVector(actual);
+    double sumSqrDiff = 0, sumSqr = 0;
+    for (size_t j = 0; j < n; j++)
+    {
+        float bMax = bRange;
+        if (bRange <= 0)
+            for (size_t c = 0; c < k; c++)
+                bMax = std::max(bMax, fabs(bv[j * k + c]));
+        const float eb = bMax / 127 / 2;
+        for (size_t i = 0; i < m; i++)
+        {
+            const float ea = q.Scales()[i] / 2;
+            double bound = 0;
+            for (size_t c = 0; c < k; c++)
+                bound += fabs(wv[c * m + i]) * eb + fabs(bv[j * k + c]) * ea + ea * eb;
+            const double diff = av[j * m + i] - ev[j * m + i];
+            BOOST_CHECK_LE(fabs(diff), bound * (1 + 1e-4) + 1e-5);
+            sumSqrDiff += diff * diff;
+            sumSqr += (double) ev[j * m + i] * ev[j * m + i];
+        }
+    }
+    // and on average, far less than the bound
+    BOOST_CHECK_LT(sqrt(sumSqrDiff / sumSqr), 0.02);
+}
+
+BOOST_FIXTURE_TEST_CASE(Int8MatrixTransposeTimes, RandomSeedFixture)
+{
+    TestInt8TransposeTimes(30, 100, 7, 0); // (k and n not multiples of the vector width and the 4 columns done at a time)
+    TestInt8TransposeTimes(64, 256, 16, 0);
+    TestInt8TransposeTimes(5, 3, 1, 0);
+    TestInt8TransposeTimes(30, 100, 7, 1); // fixed range of b, as recorded by calibration
+}
+
+// embedding lookup: W [m x V] stored in int8 by columns, times one-hot (or weighted) columns, sparse or dense
+BOOST_FIXTURE_TEST_CASE(Int8MatrixTimes, RandomSeedFixture)
+{
+    const size_t m = 13, V = 50, n = 4;
+    SingleMatrix w = SingleMatrix::RandomUniform(m, V, CPUDEVICE, -2, 2, IncrementCounter());
+    Int8Matrix<float> q;
+    q.Quantize(w, false);
+
+    // columns: one-hot 3, one-hot 49, 0.5 * e7 + 2 * e8, empty
+    std::vector<CPUSPARSE_INDEX_TYPE> colStarts = { 0, 1, 2, 4, 4 };
+    std::vector<CPUSPARSE_INDEX_TYPE> rowIndices = { 3, 49, 7, 8 };
+    std::vector<float> values = { 1, 1, 0.5f, 2 };
+    SingleMatrix sparse(V, n, CPUDEVICE, MatrixType::SPARSE, matrixFormatSparseCSC);
+    sparse.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), V, n);
+    SingleMatrix dense(V, n, CPUDEVICE);
+    dense.SetValue(0);
+    for (size_t j = 0; j < n; j++)
+        for (CPUSPARSE_INDEX_TYPE p = colStarts[j]; p < colStarts[j + 1]; p++)
+            dense(rowIndices[p], j) = values[p];
+
+    SingleMatrix expected(CPUDEVICE);
+    expected.AssignProductOf(w, false, dense, false);
+    auto ev = ToVector(expected);
+    for (const auto* b : { &sparse, &dense })
+    {
+        SingleMatrix actual(CPUDEVICE);
+        actual.AssignInt8ProductOf(q, false, *b, 0);
+        BOOST_REQUIRE_EQUAL(actual.GetNumRows(), m);
+        BOOST_REQUIRE_EQUAL(actual.GetNumCols(), n);
+        auto av = ToVector(actual);
+        for (size_t j = 0; j < n; j++)
+        {
+            float bound = 0; // half a step of each selected column, weighted
+            for (CPUSPARSE_INDEX_TYPE p = colStarts[j]; p < colStarts[j + 1]; p++)
+                bound += fabs(values[p]) * q.Scales()[rowIndices[p]] / 2;
+            for (size_t i = 0; i < m; i++)
+                BOOST_CHECK_LE(fabs(av[j * m + i] - ev[j * m + i]), bound * (1 + 1e-5f) + 1e-6f);
+        }
+    }
+
+    // a slice of the sparse columns (the column starts do not begin at 0)
+    SingleMatrix slice = sparse.ColumnSlice(2, 2);
+    SingleMatrix actual(CPUDEVICE);
+    actual.AssignInt8ProductOf(q, false, slice, 0);
+    auto av = ToVector(actual);
+    for (size_t i = 0; i < m; i++)
+        BOOST_CHECK_LE(fabs(av[i] - ev[2 * m + i]), (0.5f * q.Scales()[7] + 2 * q.Scales()[8]) / 2 * (1 + 1e-5f) + 1e-6f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -897,6 +897,49 @@ BOOST_FIXTURE_TEST_CASE(MatrixColumnSlice, RandomSeedFixture)
     BOOST_CHECK(cg.IsEqualTo(dg, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixSliceViewReuse, RandomSeedFixture)
+{
+    size_t k = 100, n = 20, m = 50;
+
+    Matrix<float> ag(k, n, c_deviceIdZero);
+    ag.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    Matrix<float> bg(n, m, c_deviceIdZero);
+    bg.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    Matrix<float> cg(k, m, c_deviceIdZero);
+    cg.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    Matrix<float> dg(k, m, c_deviceIdZero);
+    dg.AssignValuesOf(cg);
+
+    Matrix<float>::MultiplyAndAdd(ag, false, bg, false, dg);
+
+    // the same two views are re-targeted for every column, each always to the same source matrix
+    MatrixSliceView<float> viewB, viewC;
+    for (int i = 0; i < m; i++)
+    {
+        auto& colBg = viewB.Assign(bg, i, 1);
+        auto& colCg = viewC.Assign(cg, i, 1);
+        BOOST_CHECK_EQUAL(colBg.Data(), bg.ColumnSlice(i, 1).Data());
+        BOOST_CHECK_EQUAL(colCg.GetNumRows(), k);
+        Matrix<float>::MultiplyAndAdd(ag, false, colBg, false, colCg);
+    }
+    BOOST_CHECK(cg.IsEqualTo(dg, c_epsilonFloatE4));
+
+    auto& slice = viewC.Assign(cg, 2, 3);
+    BOOST_CHECK_EQUAL(slice.GetNumCols(), 3);
+    BOOST_CHECK(slice.IsEqualTo(cg.ColumnSlice(2, 3), c_epsilonFloatE4));
+
+    // a view keeps its source from being resized until it is released
+    BOOST_CHECK_THROW(cg.Resize(k, m + 1), std::logic_error);
+    viewB.Release();
+    viewC.Release();
+    cg.Resize(k, m + 1);
+    BOOST_CHECK_EQUAL(cg.GetNumCols(), m + 1);
+    BOOST_CHECK_EQUAL(viewC.Assign(cg, m, 1).Data(), cg.ColumnSlice(m, 1).Data());
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixKhatriRaoProduct, RandomSeedFixture)
 {
     std::array<float, 24> arr =
@@ -0,0 +1,41 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the parsing of the lists of NUMA nodes and processors that Linux sysfs reports (numahelpers.h).
+//
+#include "stdafx.h"
+#include "numahelpers.h"
+
+using namespace msra::numa;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static void CheckList(const std::string& list, const std::vector<size_t>& expected)
+{
+    auto actual = parsesyslist(list);
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_SUITE(NumaHelpersSuite)
+
+BOOST_AUTO_TEST_CASE(ParseSysListRanges)
+{
+    CheckList("0-3,8-11", { 0, 1, 2, 3, 8, 9, 10, 11 });
+    CheckList("2,4-5", { 2, 4, 5 });
+    CheckList("0", { 0 });
+    CheckList("7-7", { 7 });
+}
+
+// as read from sysfs, with a trailing newline; a node without processors has an empty list
+BOOST_AUTO_TEST_CASE(ParseSysListFileContents)
+{
+    CheckList("0-1\n", { 0, 1 });
+    CheckList("0,2\n", { 0, 2 });
+    CheckList("\n", {});
+    CheckList("", {});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
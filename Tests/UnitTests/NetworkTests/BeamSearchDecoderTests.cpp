@@ -0,0 +1,268 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of beam-search decoding (BeamSearchDecoder, and the "beamSearch" command) with a small model whose
+// best continuations are known: beam width 1 must decode greedily, and a wider beam must find a better sequence
+// that greedy decoding misses.
+//
+#include "stdafx.h"
+#include "Common/NetworkTestHelper.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "../../../Source/SGDLib/BeamSearchDecoder.h"
+#include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
+#include <sstream>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Tokens: 0 = <s>, 1 = a, 2 = b, 3 = </s>. The output scores the next token from the current and the previous one:
+// z(t) = W x(t) + U x(t-1). After <s>, a is more likely than b, but continues poorly (a, b and </s> are equally
+// likely, and after 'a a' </s> even less so), while b is almost always followed by </s>. Greedy decoding thus
+// produces 'a a a a a' (up to maxLength), but 'b' scores better.
+const size_t vocabSize = 4;
+const size_t endSymbolId = 3;
+const size_t maxLength = 5;
+const double W[vocabSize][vocabSize] = { // (row: next token, column: current token)
+    { -9, -9, -9, 0 },
+    { 0.2, 0, -9, 0 },
+    { 0, 0, -9, 0 },
+    { -9, 0, 3, 0 } };
+const double U[vocabSize][vocabSize] = { // (row: next token, column: previous token)
+    { 0, 0, 0, 0 },
+    { 0, 1.5, 0, 0 },
+    { 0, 0, 0, 0 },
+    { 0, -1, 0, 0 } };
+
+// the prefixes to continue: '<s>', '<s> a' and '<s> a a', of different lengths in one minibatch
+const vector<vector<size_t>> prefixes = { { 0 }, { 0, 1 }, { 0, 1, 1 } };
+
+// log softmax of z for the token 'current' preceded by 'previous' (SIZE_MAX at the start of a sequence)
+static vector<double> LogProbs(size_t previous, size_t current)
+{
+    vector<double> z(vocabSize);
+    double sum = 0;
+    for (size_t i = 0; i < vocabSize; i++)
+    {
+        z[i] = W[i][current] + (previous != SIZE_MAX ? U[i][previous] : 0);
+        sum += exp(z[i]);
+    }
+    for (auto& zi : z)
+        zi -= log(sum);
+    return z;
+}
+
+// log probability of the continuation 'tokens' of 'prefix'
+static double Score(const vector<size_t>& prefix, const vector<size_t>& tokens)
+{
+    vector<size_t> sequence = prefix;
+    sequence.insert(sequence.end(), tokens.begin(), tokens.end());
+    double score = 0;
+    for (size_t t = prefix.size(); t < sequence.size(); t++)
+        score += LogProbs(t >= 2 ? sequence[t - 2] : SIZE_MAX, sequence[t - 1])[sequence[t]];
+    return score;
+}
+
+// the most likely token at each step; like the decoder's output, without the end symbol
+static vector<size_t> GreedyContinuation(const vector<size_t>& prefix)
+{
+    vector<size_t> sequence = prefix, tokens;
+    while (tokens.size() < maxLength)
+    {
+        auto logProbs = LogProbs(sequence.size() >= 2 ? sequence[sequence.size() - 2] : SIZE_MAX, sequence.back());
+        size_t token = max_element(logProbs.begin(), logProbs.end()) - logProbs.begin();
+        if (token == endSymbolId)
+            break;
+        tokens.push_back(token);
+        sequence.push_back(token);
+    }
+    return tokens;
+}
+
+// the best of all continuations that end with the end symbol, or reach maxLength without it
+static vector<size_t> BestContinuation(const vector<size_t>& prefix)
+{
+    vector<size_t> best;
+    double bestScore = -numeric_limits<double>::infinity();
+    vector<size_t> tokens;
+    function<void()> search = [&]()
+    {
+        for (size_t token = 0; token < vocabSize; token++)
+        {
+            tokens.push_back(token);
+            bool finished = token == endSymbolId || tokens.size() == maxLength;
+            if (finished && Score(prefix, tokens) > bestScore)
+            {
+                bestScore = Score(prefix, tokens);
+                best.assign(tokens.begin(), token == endSymbolId ? tokens.end() - 1 : tokens.end());
+            }
+            else if (!finished)
+                search();
+            tokens.pop_back();
+        }
+    };
+    search();
+    return best;
+}
+
+// delivers all prefixes as one minibatch of one-hot columns
+class PrefixReader : public IDataReader
+{
+public:
+    virtual void Init(const ConfigParameters&) override { }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override { }
+    virtual void Destroy() override { }
+    virtual void StartMinibatchLoop(size_t, size_t, size_t) override { m_delivered = false; }
+    virtual size_t GetNumParallelSequencesForFixingBPTTMode() override { return prefixes.size(); }
+    virtual bool DataEnd() override { return true; }
+
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        if (m_delivered)
+            return false;
+        m_delivered = true;
+
+        size_t T = 0;
+        for (const auto& prefix : prefixes)
+            T = max(T, prefix.size());
+        auto& layout = matrices.GetInput(L"x").pMBLayout;
+        layout->Init(prefixes.size(), T);
+        Matrix<double> x(vocabSize, prefixes.size() * T, CPUDEVICE);
+        x.SetValue(0);
+        for (size_t s = 0; s < prefixes.size(); s++)
+        {
+            layout->AddSequence(s, s, 0, prefixes[s].size());
+            if (prefixes[s].size() < T)
+                layout->AddGap(s, prefixes[s].size(), T);
+            for (size_t t = 0; t < prefixes[s].size(); t++)
+                x(prefixes[s][t], t * prefixes.size() + s) = 1;
+        }
+        matrices.GetInputMatrix<double>(L"x").SetValue(x);
+        return true;
+    }
+
+private:
+    bool m_delivered = false;
+};
+
+static vector<vector<size_t>> ReadTokenLines(const boost::filesystem::path& path)
+{
+    vector<vector<size_t>> lines;
+    boost::filesystem::ifstream in(path);
+    string line;
+    while (getline(in, line))
+    {
+        istringstream tokens(line);
+        lines.push_back(vector<size_t>(istream_iterator<size_t>(tokens), istream_iterator<size_t>()));
+    }
+    return lines;
+}
+
+struct BeamSearchFixture
+{
+    BeamSearchFixture()
+        : m_outputPath(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("BeamSearch-%%%%-%%%%.txt"))
+    {
+    }
+    ~BeamSearchFixture()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(m_outputPath, ec);
+    }
+
+    // the best continuation of each prefix found with the given beam width
+    vector<vector<size_t>> Decode(size_t beamWidth)
+    {
+        auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+        ComputationNetworkBuilder<double> builder(*net);
+        auto x = builder.CreateInputNode(L"x", vocabSize);
+        auto w = builder.CreateLearnableParameter(L"W", vocabSize, vocabSize);
+        auto u = builder.CreateLearnableParameter(L"U", vocabSize, vocabSize);
+        for (size_t i = 0; i < vocabSize; i++)
+            for (size_t j = 0; j < vocabSize; j++)
+            {
+                w->Value()(i, j) = W[i][j];
+                u->Value()(i, j) = U[i][j];
+            }
+        auto z = builder.Plus(builder.Times(w, x), builder.Times(u, builder.PastValue(x, 0, vocabSize, 1)), L"z");
+        net->AddToNodeGroup(L"feature", x);
+        net->AddToNodeGroup(L"output", z);
+        net->CompileNetwork();
+
+        BeamSearchDecoder<double> decoder(net, L"x", L"z", beamWidth, endSymbolId, maxLength, false);
+        PrefixReader reader;
+        decoder.Decode(reader, 1024, m_outputPath.wstring(), 1, vector<string>());
+        return ReadTokenLines(m_outputPath);
+    }
+
+    boost::filesystem::path m_outputPath;
+};
+
+BOOST_FIXTURE_TEST_SUITE(BeamSearchDecoderSuite, BeamSearchFixture)
+
+BOOST_AUTO_TEST_CASE(BeamSearchWidthOneIsGreedy)
+{
+    auto decoded = Decode(1);
+    BOOST_REQUIRE_EQUAL(decoded.size(), prefixes.size());
+    for (size_t s = 0; s < prefixes.size(); s++)
+    {
+        auto expected = GreedyContinuation(prefixes[s]);
+        BOOST_CHECK_EQUAL_COLLECTIONS(decoded[s].begin(), decoded[s].end(), expected.begin(), expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BeamSearchFindsBetterThanGreedy)
+{
+    // (the model is as described above)
+    BOOST_REQUIRE(GreedyContinuation(prefixes[0]) == vector<size_t>(maxLength, 1));
+    BOOST_REQUIRE(BestContinuation(prefixes[0]) == vector<size_t>{ 2 });
+    BOOST_REQUIRE_GT(Score(prefixes[0], { 2, endSymbolId }), Score(prefixes[0], vector<size_t>(maxLength, 1)));
+
+    for (size_t beamWidth : { 3, 4 })
+    {
+        auto decoded = Decode(beamWidth);
+        BOOST_REQUIRE_EQUAL(decoded.size(), prefixes.size());
+        for (size_t s = 0; s < prefixes.size(); s++)
+        {
+            auto expected = BestContinuation(prefixes[s]);
+            BOOST_CHECK_EQUAL_COLLECTIONS(decoded[s].begin(), decoded[s].end(), expected.begin(), expected.end());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// the "beamSearch" command with the same model, defined in BrainScript (Config/BeamSearch.cntk)
+struct BeamSearchConfigFixture : DataFixture
+{
+    BeamSearchConfigFixture()
+        : DataFixture("/Data")
+    {
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(BeamSearchCommandSuite, BeamSearchConfigFixture)
+
+BOOST_AUTO_TEST_CASE(BeamSearchCommand)
+{
+    const string outputPath = "../Output/BeamSearch_Output.txt";
+    boost::filesystem::remove(outputPath);
+
+    ConfigParameters config;
+    config.LoadConfigFile(L"../Config/BeamSearch.cntk");
+    ConfigArray command = config(L"command");
+    DoBeamSearch<double>(ConfigParameters(config(command[0])));
+
+    auto decoded = ReadTokenLines(outputPath);
+    auto expected = ReadTokenLines("../Control/BeamSearch_Control.txt");
+    BOOST_REQUIRE_EQUAL(decoded.size(), expected.size());
+    for (size_t s = 0; s < expected.size(); s++)
+        BOOST_CHECK_EQUAL_COLLECTIONS(decoded[s].begin(), decoded[s].end(), expected[s].begin(), expected[s].end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,177 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(ClassBasedCrossEntropySuite)
+
+typedef shared_ptr<ComputationNode<double>> NodePtr;
+
+const size_t inputDim = 4;
+const size_t hiddenDim = 3;
+const size_t T = 5;
+const size_t numClasses = 3;
+const size_t classBegin[numClasses + 1] = { 0, 3, 5, 7 }; // words of the classes: [0, 3), [3, 5) and [5, 7)
+
+// Two sequences, the second of which ends early. The tokens of a class are spread over both, and several of them
+// are the same word. The labels in the gap are 0, which would be an empty class if they were read.
+const size_t gap = SIZE_MAX;
+const size_t sequenceWords[2][T] = { { 1, 4, 1, 6, 3 }, { 5, 2, 0, gap, gap } };
+
+static vector<double> ToVector(const Matrix<double>& m)
+{
+    unique_ptr<double[]> data(m.CopyToArray());
+    return vector<double>(data.get(), data.get() + m.GetNumElements());
+}
+
+static size_t ClassOf(size_t word)
+{
+    size_t c = 0;
+    while (word >= classBegin[c + 1])
+        c++;
+    return c;
+}
+
+// criterion = ClassBasedCrossEntropyWithSoftmax(labels, h = tanh(U x), W, C x)
+struct ClassBasedCrossEntropyFixture
+{
+    ClassBasedCrossEntropyFixture()
+        : m_net(make_shared<ComputationNetwork>(CPUDEVICE))
+    {
+        ComputationNetworkBuilder<double> builder(*m_net);
+        m_x = builder.CreateInputNode(L"x", inputDim);
+        m_labels = builder.CreateInputNode(L"labels", 4);
+        m_U = builder.CreateLearnableParameter(L"U", hiddenDim, inputDim);
+        m_W = builder.CreateLearnableParameter(L"W", hiddenDim, classBegin[numClasses]);
+        m_C = builder.CreateLearnableParameter(L"C", numClasses, inputDim);
+        m_net->InitLearnableParameters(m_U, true, 1, 1.0);
+        m_net->InitLearnableParameters(m_W, true, 2, 1.0);
+        m_net->InitLearnableParameters(m_C, true, 3, 1.0);
+        m_h = builder.Tanh(builder.Times(m_U, m_x), L"h");
+        m_cls = builder.Times(m_C, m_x, 1, L"cls");
+        m_criterion = builder.ClassCrossEntropyWithSoftmax(m_labels, m_h, m_W, m_cls, L"criterion");
+        m_net->AddToNodeGroup(L"feature", m_x);
+        m_net->AddToNodeGroup(L"label", m_labels);
+        m_net->AddToNodeGroup(L"criterion", m_criterion);
+        m_net->CompileNetwork();
+        m_net->AllocateAllMatrices({}, {}, ComputationNodeBasePtr(m_criterion));
+
+        auto layout = m_net->GetMBLayoutPtrOfNetwork();
+        layout->Init(2, T);
+        layout->AddSequence(0, 0, 0, T);
+        layout->AddSequence(1, 1, 0, 3);
+        layout->AddGap(1, 3, T);
+
+        Matrix<double> labels(4, 2 * T, CPUDEVICE);
+        labels.SetValue(0);
+        for (size_t t = 0; t < T; t++)
+            for (size_t s = 0; s < 2; s++)
+            {
+                size_t word = sequenceWords[s][t];
+                if (word == gap)
+                    continue;
+                labels(0, t * 2 + s) = (double) word;
+                labels(1, t * 2 + s) = (double) ClassOf(word);
+                labels(2, t * 2 + s) = (double) classBegin[ClassOf(word)];
+                labels(3, t * 2 + s) = (double) classBegin[ClassOf(word) + 1];
+            }
+        m_labels->Value().SetValue(labels);
+        m_x->Value().SetValue(Matrix<double>::RandomUniform(inputDim, 2 * T, CPUDEVICE, -1, 1, 4));
+    }
+
+    // recomputes all nodes: values of parameters are changed in place, and after Backprop() the memory of values
+    // may have been reused for gradients
+    double Forward()
+    {
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ m_x, m_labels, m_U, m_W, m_C });
+        m_net->ForwardProp(ComputationNodeBasePtr(m_criterion));
+        return m_criterion->Value()(0, 0);
+    }
+
+    // the criterion computed directly from its definition: for each token, minus the log softmax of the class scores
+    // at its class, and minus the log softmax of the scores W^T h of the class's words at its word
+    double ExpectedCriterion()
+    {
+        auto h = ToVector(m_h->Value()), cls = ToVector(m_cls->Value()), W = ToVector(m_W->Value());
+        double criterion = 0;
+        for (size_t t = 0; t < T; t++)
+            for (size_t s = 0; s < 2; s++)
+            {
+                size_t word = sequenceWords[s][t], j = t * 2 + s;
+                if (word == gap)
+                    continue;
+                auto logSoftmax = [](const vector<double>& z, size_t i)
+                {
+                    double sum = 0;
+                    for (double zk : z)
+                        sum += exp(zk);
+                    return z[i] - log(sum);
+                };
+                size_t c = ClassOf(word);
+                criterion -= logSoftmax(vector<double>(cls.begin() + j * numClasses, cls.begin() + (j + 1) * numClasses), c);
+                vector<double> scores;
+                for (size_t w = classBegin[c]; w < classBegin[c + 1]; w++)
+                {
+                    double score = 0;
+                    for (size_t i = 0; i < hiddenDim; i++)
+                        score += W[w * hiddenDim + i] * h[j * hiddenDim + i];
+                    scores.push_back(score);
+                }
+                criterion -= logSoftmax(scores, word - classBegin[c]);
+            }
+        return criterion;
+    }
+
+    ComputationNetworkPtr m_net;
+    NodePtr m_x, m_labels, m_U, m_W, m_C, m_h, m_cls, m_criterion;
+};
+
+BOOST_FIXTURE_TEST_CASE(ClassBasedCrossEntropyWithSoftmaxValue, ClassBasedCrossEntropyFixture)
+{
+    ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+    m_net->StartEvaluateMinibatchLoop(ComputationNodeBasePtr(m_criterion));
+    double criterion = Forward();
+    BOOST_CHECK_CLOSE(criterion, ExpectedCriterion(), 1e-10);
+}
+
+// the gradients to the hidden activations (through U), to the word weights W, and to the class scores (through C)
+// against central differences of the criterion
+BOOST_FIXTURE_TEST_CASE(ClassBasedCrossEntropyWithSoftmaxGradient, ClassBasedCrossEntropyFixture)
+{
+    ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::training);
+    m_net->StartEvaluateMinibatchLoop(ComputationNodeBasePtr(m_criterion));
+    Forward();
+    m_net->Backprop(ComputationNodeBasePtr(m_criterion));
+
+    for (const auto& parameter : { m_U, m_W, m_C })
+    {
+        auto gradient = ToVector(parameter->Gradient());
+        auto& value = parameter->Value();
+        BOOST_REQUIRE_EQUAL(gradient.size(), value.GetNumElements());
+        const double eps = 1e-5;
+        for (size_t i = 0; i < gradient.size(); i++)
+        {
+            const double original = value.Data()[i];
+            value.Data()[i] = original + eps;
+            double plus = Forward();
+            value.Data()[i] = original - eps;
+            double minus = Forward();
+            value.Data()[i] = original;
+
+            double numeric = (plus - minus) / (2 * eps);
+            BOOST_CHECK_SMALL(gradient[i] - numeric, 1e-7 * (1 + fabs(numeric)));
+            BOOST_CHECK_GT(fabs(gradient[i]), 0); // (every parameter contributes)
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
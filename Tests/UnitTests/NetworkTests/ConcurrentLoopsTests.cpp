@@ -0,0 +1,297 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of running recurrent loops concurrently (ComputationNetwork::SetLoopConcurrency()): which loops are grouped,
+// and that outputs and gradients are the same as when the loops run one by one.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <functional>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef shared_ptr<ComputationNode<float>> NodePtr;
+
+const size_t inputDim = 4;
+const size_t hiddenDim = 5;
+
+// builds the test networks: a body on top of the input 'x', with a square-error criterion against the labels 'labels'
+class LoopNetworkBuilder
+{
+public:
+    LoopNetworkBuilder()
+        : m_net(make_shared<ComputationNetwork>(CPUDEVICE)), m_builder(*m_net), m_seed(1)
+    {
+        m_input = m_builder.CreateInputNode(L"x", inputDim);
+        m_labels = m_builder.CreateInputNode(L"labels", hiddenDim);
+    }
+
+    ComputationNetworkBuilder<float>& Nodes()
+    {
+        return m_builder;
+    }
+
+    NodePtr Input() const
+    {
+        return m_input;
+    }
+
+    NodePtr Parameter(size_t rows, size_t cols)
+    {
+        auto parameter = m_builder.CreateLearnableParameter(msra::strfun::wstrprintf(L"W%d", (int) m_seed), rows, cols);
+        m_net->InitLearnableParameters(parameter, true, m_seed++, 1.0f);
+        m_parameters.push_back(parameter);
+        return parameter;
+    }
+
+    NodePtr Delay(int direction, const wstring& name)
+    {
+        return direction > 0 ? m_builder.PastValue(nullptr, 0.1f, hiddenDim, 1, name) : m_builder.FutureValue(nullptr, 0.1f, hiddenDim, 1, name);
+    }
+
+    // h = tanh(W input + R h(t -/+ 1)); the projection W input is outside of the loop
+    NodePtr SimpleLoop(NodePtr input, size_t dim, int direction, const wstring& name)
+    {
+        auto delay = Delay(direction, name + L".delay");
+        auto h = m_builder.Tanh(m_builder.Plus(m_builder.Times(Parameter(hiddenDim, dim), input), m_builder.Times(Parameter(hiddenDim, hiddenDim), delay)), name);
+        delay->AttachInputs({ h });
+        return h;
+    }
+
+    NodePtr LSTM(NodePtr input, size_t dim, int direction, const wstring& name)
+    {
+        auto prevH = Delay(direction, name + L".prevH");
+        auto prevC = Delay(direction, name + L".prevC");
+        auto gate = [&](bool tanh)
+        {
+            auto z = m_builder.Plus(m_builder.Times(Parameter(hiddenDim, dim), input), m_builder.Times(Parameter(hiddenDim, hiddenDim), prevH));
+            return tanh ? m_builder.Tanh(z) : m_builder.Sigmoid(z);
+        };
+        auto i = gate(false);
+        auto f = gate(false);
+        auto o = gate(false);
+        auto g = gate(true);
+        auto c = m_builder.Plus(m_builder.ElementTimes(f, prevC), m_builder.ElementTimes(i, g), name + L".c");
+        auto h = m_builder.ElementTimes(o, m_builder.Tanh(c), name);
+        prevH->AttachInputs({ h });
+        prevC->AttachInputs({ c });
+        return h;
+    }
+
+    ComputationNetworkPtr Compile(NodePtr output)
+    {
+        auto criterion = m_builder.SquareError(output, m_labels, L"criterion");
+        m_net->AddToNodeGroup(L"feature", m_input);
+        m_net->AddToNodeGroup(L"label", m_labels);
+        m_net->AddToNodeGroup(L"criterion", criterion);
+        m_net->AddToNodeGroup(L"output", output);
+        m_net->CompileNetwork();
+        m_net->AllocateAllMatrices({ output }, {}, criterion);
+        return m_net;
+    }
+
+    const vector<NodePtr>& Parameters() const
+    {
+        return m_parameters;
+    }
+
+private:
+    ComputationNetworkPtr m_net;
+    ComputationNetworkBuilder<float> m_builder;
+    unsigned long m_seed;
+    NodePtr m_input;
+    NodePtr m_labels;
+    vector<NodePtr> m_parameters;
+};
+
+typedef function<NodePtr(LoopNetworkBuilder&)> NetworkBody;
+
+// loop concurrency applies to networks compiled while it is set; reset for the tests that follow
+struct LoopConcurrencyFixture
+{
+    ~LoopConcurrencyFixture()
+    {
+        ComputationNetwork::SetLoopConcurrency(false, false);
+    }
+};
+
+static ComputationNetworkPtr CompileNetwork(const NetworkBody& body, bool concurrentLoops, bool wavefrontLoops, vector<NodePtr>* parameters = nullptr)
+{
+    ComputationNetwork::SetLoopConcurrency(concurrentLoops, wavefrontLoops);
+    LoopNetworkBuilder builder;
+    auto net = builder.Compile(body(builder));
+    if (parameters)
+        *parameters = builder.Parameters();
+    return net;
+}
+
+static vector<float> ToVector(const Matrix<float>& matrix)
+{
+    float* data = matrix.CopyToArray();
+    vector<float> result(data, data + matrix.GetNumElements());
+    delete[] data;
+    return result;
+}
+
+// Runs two minibatches of two sequences, one of which ends early, forward and backward, and returns the
+// criterion, the output and the gradients of all parameters.
+static vector<vector<float>> TrainTwoMinibatches(const NetworkBody& body, bool concurrentLoops, bool wavefrontLoops)
+{
+    vector<NodePtr> parameters;
+    auto net = CompileNetwork(body, concurrentLoops, wavefrontLoops, &parameters);
+    auto x = net->GetNodeFromName(L"x");
+    auto labels = net->GetNodeFromName(L"labels");
+    auto criterion = net->GetNodeFromName(L"criterion");
+    auto output = net->OutputNodes().front();
+
+    const size_t T = 9;
+    auto layout = net->GetMBLayoutPtrOfNetwork();
+    layout->Init(2, T);
+    layout->AddSequence(0, 0, 0, T);
+    layout->AddSequence(1, 1, 0, T - 3);
+    layout->AddGap(1, T - 3, T);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    vector<vector<float>> results;
+    for (int minibatch = 0; minibatch < 2; minibatch++)
+    {
+        dynamic_pointer_cast<ComputationNode<float>>(x)->Value().SetValue(Matrix<float>::RandomUniform(inputDim, 2 * T, CPUDEVICE, -1, 1, 7 + minibatch));
+        dynamic_pointer_cast<ComputationNode<float>>(labels)->Value().SetValue(Matrix<float>::RandomUniform(hiddenDim, 2 * T, CPUDEVICE, -1, 1, 17 + minibatch));
+        net->StartEvaluateMinibatchLoop(criterion);
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x, labels });
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<float>>(criterion)->Value()));
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<float>>(output)->Value()));
+        for (const auto& parameter : parameters)
+            results.push_back(ToVector(parameter->Gradient()));
+    }
+    return results;
+}
+
+// The loops compute the same operations on the same data in either mode. Only reductions may round differently,
+// since their order can depend on the alignment of the matrices, which share memory differently in either mode.
+static void CheckSameResultsAsSequential(const NetworkBody& body)
+{
+    auto expected = TrainTwoMinibatches(body, false, false);
+    for (bool wavefrontLoops : { false, true })
+    {
+        auto actual = TrainTwoMinibatches(body, true, wavefrontLoops);
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            BOOST_REQUIRE_EQUAL(actual[i].size(), expected[i].size());
+            for (size_t j = 0; j < expected[i].size(); j++)
+                BOOST_CHECK_SMALL(actual[i][j] - expected[i][j], 1e-6f * (1 + fabs(expected[i][j])));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(ConcurrentLoopsSuite, LoopConcurrencyFixture)
+
+BOOST_AUTO_TEST_CASE(BidirectionalLSTM)
+{
+    NetworkBody body = [](LoopNetworkBuilder& b)
+    {
+        auto forward = b.LSTM(b.Input(), inputDim, +1, L"fwd");
+        auto backward = b.LSTM(b.Input(), inputDim, -1, L"bwd");
+        return b.Nodes().Plus(forward, backward);
+    };
+    auto net = CompileNetwork(body, true, false);
+    int group = net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"fwd"));
+    BOOST_CHECK_GE(group, 0);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"bwd")), group);
+    BOOST_CHECK(!net->IsWavefrontFollowerOf(net->GetNodeFromName(L"bwd"), net->GetNodeFromName(L"fwd")));
+
+    CheckSameResultsAsSequential(body);
+}
+
+BOOST_AUTO_TEST_CASE(StackedLSTMs)
+{
+    // the second layer reads the first through frame-local projections, so it can follow it as a wavefront
+    NetworkBody body = [](LoopNetworkBuilder& b)
+    {
+        auto layer1 = b.LSTM(b.Input(), inputDim, +1, L"layer1");
+        return b.LSTM(layer1, hiddenDim, +1, L"layer2");
+    };
+    auto net = CompileNetwork(body, true, false);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"layer1")), -1);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"layer2")), -1);
+
+    net = CompileNetwork(body, true, true);
+    int group = net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"layer1"));
+    BOOST_CHECK_GE(group, 0);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"layer2")), group);
+    BOOST_CHECK(net->IsWavefrontFollowerOf(net->GetNodeFromName(L"layer2"), net->GetNodeFromName(L"layer1")));
+
+    CheckSameResultsAsSequential(body);
+}
+
+BOOST_AUTO_TEST_CASE(IndependentLoopsFormOneGroup)
+{
+    NetworkBody body = [](LoopNetworkBuilder& b)
+    {
+        auto& n = b.Nodes();
+        auto a = b.SimpleLoop(b.Input(), inputDim, +1, L"a");
+        auto c = b.SimpleLoop(b.Input(), inputDim, -1, L"c");
+        auto d = b.SimpleLoop(b.Input(), inputDim, +1, L"d");
+        return n.Plus(n.Plus(a, c), d);
+    };
+    auto net = CompileNetwork(body, true, false);
+    int group = net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"a"));
+    BOOST_CHECK_GE(group, 0);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"c")), group);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"d")), group);
+    BOOST_CHECK(!net->IsWavefrontFollowerOf(net->GetNodeFromName(L"d"), net->GetNodeFromName(L"a")));
+
+    CheckSameResultsAsSequential(body);
+}
+
+BOOST_AUTO_TEST_CASE(WavefrontFollowerBehindFrameLocalNodes)
+{
+    // a -> sigmoid(W a) .* a -> b joins a's group; c, stacked in the other direction, cannot follow b and starts a new group
+    NetworkBody body = [](LoopNetworkBuilder& b)
+    {
+        auto& n = b.Nodes();
+        auto a = b.SimpleLoop(b.Input(), inputDim, +1, L"a");
+        auto between = n.ElementTimes(n.Sigmoid(n.Times(b.Parameter(hiddenDim, hiddenDim), a)), a);
+        auto b2 = b.SimpleLoop(between, hiddenDim, +1, L"b");
+        auto c = b.SimpleLoop(b2, hiddenDim, -1, L"c");
+        return n.Plus(b2, c);
+    };
+    auto net = CompileNetwork(body, true, true);
+    int group = net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"a"));
+    BOOST_CHECK_GE(group, 0);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"b")), group);
+    BOOST_CHECK(net->IsWavefrontFollowerOf(net->GetNodeFromName(L"b"), net->GetNodeFromName(L"a")));
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"c")), -1);
+
+    CheckSameResultsAsSequential(body);
+}
+
+BOOST_AUTO_TEST_CASE(NonFrameLocalNodeBreaksGroup)
+{
+    // b reads a one step ahead, which a following b step by step would not have computed yet
+    NetworkBody body = [](LoopNetworkBuilder& b)
+    {
+        auto& n = b.Nodes();
+        auto a = b.SimpleLoop(b.Input(), inputDim, +1, L"a");
+        auto between = n.Tanh(n.FutureValue(a, 0.1f, hiddenDim, 1, L"aNext"));
+        auto b2 = b.SimpleLoop(between, hiddenDim, +1, L"b");
+        return n.Plus(a, b2);
+    };
+    auto net = CompileNetwork(body, true, true);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"a")), -1);
+    BOOST_CHECK_EQUAL(net->GetConcurrentLoopGroupId(net->GetNodeFromName(L"b")), -1);
+
+    CheckSameResultsAsSequential(body);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of parameters stored in fp16/bf16 (LearnableParameter::SetStorageFormat()): saving and loading them, loading
+// models from before they existed, and inference with the 16-bit copies (CreateHalfPrecisionParameterValues()).
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "InputAndParamNodes.h"
+#include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
+#include <iterator>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// o = W2 * Sigmoid(W1 * x + b): W1 and W2 can be read in 16 bits, b (an input to Plus) cannot
+template <class ElemType>
+static ComputationNetworkPtr BuildHalfPrecisionTestNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto x = builder.CreateInputNode(L"x", 40);
+    auto W1 = builder.CreateLearnableParameter(L"W1", 32, 40);
+    auto b = builder.CreateLearnableParameter(L"b", 32, 1);
+    auto W2 = builder.CreateLearnableParameter(L"W2", 8, 32);
+    net->InitLearnableParameters(W1, true, 1, (ElemType) 1);
+    net->InitLearnableParameters(b, true, 2, (ElemType) 1);
+    net->InitLearnableParameters(W2, true, 3, (ElemType) 1);
+    auto o = builder.Times(W2, builder.Sigmoid(builder.Plus(builder.Times(W1, x), b)), 1, L"o");
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"output", o);
+    net->CompileNetwork();
+    return net;
+}
+
+template <class ElemType>
+static shared_ptr<LearnableParameter<ElemType>> Parameter(ComputationNetworkPtr net, const wstring& name)
+{
+    return dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(name));
+}
+
+template <class ElemType>
+static vector<ElemType> ToVector(const Matrix<ElemType>& m)
+{
+    unique_ptr<ElemType[]> data(m.CopyToArray());
+    return vector<ElemType>(data.get(), data.get() + m.GetNumElements());
+}
+
+// output of the network for N frames of a fixed input
+template <class ElemType>
+static vector<ElemType> Evaluate(ComputationNetworkPtr net, size_t N)
+{
+    auto x = net->GetNodeFromName(L"x");
+    auto o = net->GetNodeFromName(L"o");
+    net->AllocateAllMatrices({ o }, {}, nullptr);
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(N);
+    Matrix<ElemType> input(40, N, CPUDEVICE);
+    for (size_t i = 0; i < 40 * N; i++)
+        input.Data()[i] = (ElemType) ((i * 37) % 101) / 50 - 1;
+    x->As<ComputationNode<ElemType>>()->Value().SetValue(input);
+    net->StartEvaluateMinibatchLoop(o);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x });
+    net->ForwardProp(o);
+    return ToVector(o->As<ComputationNode<ElemType>>()->Value());
+}
+
+template <class ElemType>
+static void CheckClose(const vector<ElemType>& actual, const vector<ElemType>& expected, double tolerance)
+{
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); i++)
+        BOOST_CHECK_SMALL((double) actual[i] - expected[i], tolerance * (1 + fabs(expected[i])));
+}
+
+struct HalfPrecisionFixture
+{
+    HalfPrecisionFixture()
+        : m_modelPath(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("HalfPrecision-%%%%-%%%%.dnn"))
+    {
+    }
+    ~HalfPrecisionFixture()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(m_modelPath, ec);
+    }
+    wstring ModelPath() const { return m_modelPath.wstring(); }
+
+    boost::filesystem::path m_modelPath;
+};
+
+BOOST_FIXTURE_TEST_SUITE(HalfPrecisionParameterSuite, HalfPrecisionFixture)
+
+// the values are rounded when the format is set, so they load back unchanged
+template <class ElemType>
+static void TestHalfPrecisionSaveAndLoad(const wstring& modelPath)
+{
+    auto net = BuildHalfPrecisionTestNetwork<ElemType>();
+    Parameter<ElemType>(net, L"W1")->SetStorageFormat(HalfPrecisionFormat::Float16);
+    Parameter<ElemType>(net, L"W2")->SetStorageFormat(HalfPrecisionFormat::BFloat16);
+    auto expected = Evaluate<ElemType>(net, 5);
+    net->Save(modelPath);
+
+    auto loaded = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, modelPath);
+    for (const wstring& name : { L"W1", L"b", L"W2" })
+    {
+        BOOST_CHECK(ToVector(Parameter<ElemType>(loaded, name)->Value()) == ToVector(Parameter<ElemType>(net, name)->Value()));
+        BOOST_CHECK(Parameter<ElemType>(loaded, name)->GetStorageFormat() == Parameter<ElemType>(net, name)->GetStorageFormat());
+    }
+    BOOST_CHECK(Evaluate<ElemType>(loaded, 5) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(HalfPrecisionSaveAndLoad)
+{
+    TestHalfPrecisionSaveAndLoad<float>(ModelPath());
+    TestHalfPrecisionSaveAndLoad<double>(ModelPath());
+}
+
+BOOST_AUTO_TEST_CASE(HalfPrecisionCopiesForInference)
+{
+    auto net = BuildHalfPrecisionTestNetwork<float>();
+    Parameter<float>(net, L"W1")->SetStorageFormat(HalfPrecisionFormat::Float16);
+    Parameter<float>(net, L"W2")->SetStorageFormat(HalfPrecisionFormat::BFloat16);
+    Parameter<float>(net, L"b")->SetStorageFormat(HalfPrecisionFormat::Float16);
+    net->Save(ModelPath());
+    vector<vector<float>> expected;
+    for (size_t N : { 5, 1, 7 })
+        expected.push_back(Evaluate<float>(net, N));
+
+    auto halfNet = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, ModelPath());
+    BOOST_CHECK_EQUAL(halfNet->CreateHalfPrecisionParameterValues<float>(), (32 * 40 + 8 * 32) * (sizeof(float) - 2));
+    BOOST_CHECK(Parameter<float>(halfNet, L"W1")->GetHalfPrecisionValue() != nullptr);
+    BOOST_CHECK(Parameter<float>(halfNet, L"W2")->GetHalfPrecisionValue() != nullptr);
+    BOOST_CHECK(Parameter<float>(halfNet, L"b")->GetHalfPrecisionValue() == nullptr); // (read by Plus)
+
+    // the parameters keep their values and dimensions
+    for (const wstring& name : { L"W1", L"b", L"W2" })
+        BOOST_CHECK(ToVector(Parameter<float>(halfNet, name)->Value()) == ToVector(Parameter<float>(net, name)->Value()));
+    BOOST_CHECK_EQUAL(Parameter<float>(halfNet, L"W1")->Value().GetNumRows(), 32);
+    BOOST_CHECK_EQUAL(Parameter<float>(halfNet, L"W1")->Value().GetNumCols(), 40);
+
+    // the products read the 16-bit copies (which is checked by clearing the full-precision values of W1 and W2), and
+    // match those with the widened values
+    Parameter<float>(halfNet, L"W1")->Value().SetValue(0);
+    Parameter<float>(halfNet, L"W2")->Value().SetValue(0);
+    size_t i = 0;
+    for (size_t N : { 5, 1, 7 }) // (changing minibatch sizes)
+        CheckClose(Evaluate<float>(halfNet, N), expected[i++], 1e-5);
+
+    // and are saved from their 16-bit copy
+    halfNet->Save(ModelPath());
+    auto reloaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, ModelPath());
+    for (const wstring& name : { L"W1", L"b", L"W2" })
+        BOOST_CHECK(ToVector(Parameter<float>(reloaded, name)->Value()) == ToVector(Parameter<float>(net, name)->Value()));
+}
+
+// Model version 9, the last one before 16-bit storage, has no storage format in front of a parameter's matrix. A file
+// of it is made from a version 10 one with float parameters by patching the version and removing the format fields.
+static void ConvertToModelVersion9(const boost::filesystem::path& path)
+{
+    string file;
+    {
+        boost::filesystem::ifstream in(path, ios::binary);
+        file.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    auto marker = [](const wchar_t* s) // as written by File: UTF-16 with a terminating 0
+    {
+        string bytes;
+        for (; *s; s++)
+            bytes += string{ (char) *s, 0 };
+        return bytes + string(2, '\0');
+    };
+
+    size_t version = file.find(marker(L"BVersion"));
+    BOOST_REQUIRE(version != string::npos);
+    version += marker(L"BVersion").size();
+    BOOST_REQUIRE_EQUAL(file[version], (char) CNTK_MODEL_VERSION_10);
+    file[version] = (char) CNTK_MODEL_VERSION_9;
+
+    size_t numParameters = 0;
+    const string matrix = 'd' + marker(L"BMAT"); // (a dense Matrix)
+    for (size_t pos = file.find(matrix); pos != string::npos; pos = file.find(matrix, pos))
+    {
+        BOOST_REQUIRE_EQUAL(file.substr(pos - sizeof(int), sizeof(int)), string(sizeof(int), '\0')); // (HalfPrecisionFormat::None)
+        file.erase(pos - sizeof(int), sizeof(int));
+        numParameters++;
+    }
+    BOOST_REQUIRE_EQUAL(numParameters, 3);
+
+    boost::filesystem::ofstream out(path, ios::binary);
+    out.write(file.data(), file.size());
+}
+
+BOOST_AUTO_TEST_CASE(LoadModelVersion9)
+{
+    auto net = BuildHalfPrecisionTestNetwork<float>();
+    auto expected = Evaluate<float>(net, 5);
+    net->Save(ModelPath());
+    ConvertToModelVersion9(m_modelPath);
+
+    auto loaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, ModelPath());
+    for (const wstring& name : { L"W1", L"b", L"W2" })
+    {
+        BOOST_CHECK(ToVector(Parameter<float>(loaded, name)->Value()) == ToVector(Parameter<float>(net, name)->Value()));
+        BOOST_CHECK(Parameter<float>(loaded, name)->GetStorageFormat() == HalfPrecisionFormat::None);
+    }
+    BOOST_CHECK(Evaluate<float>(loaded, 5) == expected);
+    BOOST_CHECK_EQUAL(loaded->CreateHalfPrecisionParameterValues<float>(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
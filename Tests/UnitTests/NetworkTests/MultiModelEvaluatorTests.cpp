@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the evaluation of several models in one pass over the data (MultiModelEvaluator): models evaluated
+// concurrently must give the same criteria as each of them evaluated on its own.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "CPUMatrix.h"
+#include "../../../Source/SGDLib/MultiModelEvaluator.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const size_t inputDim = 4;
+const size_t numClasses = 3;
+const size_t mbSize = 10;
+const size_t numMinibatches = 3;
+
+// delivers the same minibatches of features and one-hot labels in every pass
+class FixedMinibatchReader : public IDataReader
+{
+public:
+    FixedMinibatchReader()
+    {
+        for (size_t mb = 0; mb < numMinibatches; mb++)
+        {
+            m_features.push_back(Matrix<double>::RandomUniform(inputDim, mbSize, CPUDEVICE, -1, 1, 10 + mb));
+            Matrix<double> labels(numClasses, mbSize, CPUDEVICE);
+            labels.SetValue(0);
+            for (size_t j = 0; j < mbSize; j++)
+                labels((j * 7 + mb) % numClasses, j) = 1;
+            m_labels.push_back(labels.DeepClone());
+        }
+    }
+
+    virtual void Init(const ConfigParameters&) override { }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override { }
+    virtual void Destroy() override { }
+    virtual void StartMinibatchLoop(size_t, size_t, size_t) override { m_next = 0; }
+    virtual size_t GetNumParallelSequencesForFixingBPTTMode() override { return 1; }
+    virtual bool DataEnd() override { return m_next == numMinibatches; }
+
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        if (m_next == numMinibatches)
+            return false;
+        matrices.GetInputMatrix<double>(L"features").SetValue(m_features[m_next]);
+        matrices.GetInputMatrix<double>(L"labels").SetValue(m_labels[m_next]);
+        matrices.GetInput(L"features").pMBLayout->InitAsFrameMode(mbSize);
+        m_next++;
+        return true;
+    }
+
+private:
+    vector<Matrix<double>> m_features, m_labels;
+    size_t m_next = 0;
+};
+
+// a softmax regression with its own random parameters: CrossEntropyWithSoftmax and ErrorPrediction of W x + b
+static ComputationNetworkPtr Model(int seed)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<double> builder(*net);
+    auto x = builder.CreateInputNode(L"features", inputDim);
+    auto labels = builder.CreateInputNode(L"labels", numClasses);
+    auto W = builder.CreateLearnableParameter(L"W", numClasses, inputDim);
+    auto b = builder.CreateLearnableParameter(L"b", numClasses, 1);
+    net->InitLearnableParameters(W, true, seed, 1.0);
+    net->InitLearnableParameters(b, true, seed + 100, 1.0);
+    auto z = builder.Plus(builder.Times(W, x), b, L"z");
+    auto ce = builder.CrossEntropyWithSoftmax(labels, z, L"ce");
+    auto errs = builder.ErrorPrediction(labels, z, L"errs");
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", ce);
+    net->AddToNodeGroup(L"evaluation", errs);
+    net->CompileNetwork();
+    return net;
+}
+
+BOOST_AUTO_TEST_SUITE(MultiModelEvaluatorSuite)
+
+BOOST_AUTO_TEST_CASE(MultiModelEvaluatorConcurrentEqualsSequential)
+{
+    const vector<wstring> evalNodeNames = { L"ce", L"errs" };
+    FixedMinibatchReader reader;
+
+    // each model on its own
+    vector<vector<EpochCriterion>> expected;
+    for (int k = 0; k < 3; k++)
+    {
+        SimpleEvaluator<double> eval(Model(k + 1), nullptr, false);
+        expected.push_back(eval.Evaluate(&reader, evalNodeNames, mbSize));
+        BOOST_REQUIRE_EQUAL(expected.back().size(), evalNodeNames.size());
+        BOOST_REQUIRE_EQUAL(expected.back()[0].second, numMinibatches * mbSize);
+    }
+    // (the models differ)
+    BOOST_REQUIRE_NE(expected[0][0].first, expected[1][0].first);
+
+    // With two threads, two and three models are evaluated concurrently, one per thread (models >= threads).
+    int previousNumThreads = CPUMatrix<double>::SetNumThreadsForCurrentThread(2);
+    for (int numModels : { 2, 3 })
+    {
+        vector<ComputationNetworkPtr> nets;
+        for (int k = 0; k < numModels; k++)
+            nets.push_back(Model(k + 1));
+        MultiModelEvaluator<double> eval(nets);
+        auto results = eval.Evaluate(&reader, evalNodeNames, mbSize);
+
+        BOOST_REQUIRE_EQUAL(results.size(), numModels);
+        for (int k = 0; k < numModels; k++)
+        {
+            BOOST_REQUIRE_EQUAL(results[k].size(), evalNodeNames.size());
+            for (size_t i = 0; i < evalNodeNames.size(); i++)
+            {
+                BOOST_CHECK_CLOSE(results[k][i].first, expected[k][i].first, 1e-10);
+                BOOST_CHECK_EQUAL(results[k][i].second, expected[k][i].second);
+            }
+        }
+    }
+    CPUMatrix<double>::SetNumThreadsForCurrentThread(previousNumThreads);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of distributed precomputation (IPreComputeNode::AggregateAccumulators()): the means and variances that the
+// Mean and InvStdDev nodes of several workers accumulate over their parts of the data, merged, must equal those
+// accumulated over all of the data in one pass.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef shared_ptr<ComputationNode<double>> NodePtr;
+
+const size_t dim = 3;
+const size_t numSamples = 60;
+const size_t mbSize = 10;
+
+// Features with a large mean (the precision of sums of squares would not do), which drifts over the samples, so
+// that the parts of the workers have different means.
+static Matrix<double> Features()
+{
+    Matrix<double> features(dim, numSamples, CPUDEVICE);
+    for (size_t j = 0; j < numSamples; j++)
+        for (size_t i = 0; i < dim; i++)
+            features(i, j) = 1e6 * (i + 1) + 0.5 * j + ((j * 7 + i * 3) % 11) - 5;
+    return features;
+}
+
+// a worker's network x -> Mean(x), InvStdDev(x)
+struct PreComputeWorker
+{
+    PreComputeWorker()
+        : net(make_shared<ComputationNetwork>(CPUDEVICE))
+    {
+        ComputationNetworkBuilder<double> builder(*net);
+        x = builder.CreateInputNode(L"x", dim);
+        mean = builder.Mean(x, L"mean");
+        invStdDev = builder.InvStdDev(x, L"invStdDev");
+        net->AddToNodeGroup(L"feature", x);
+        net->AddToNodeGroup(L"output", mean);
+        net->AddToNodeGroup(L"output", invStdDev);
+        net->CompileNetwork();
+        net->AllocateAllMatrices({ mean, invStdDev }, {}, nullptr);
+    }
+
+    vector<ComputationNodeBasePtr> Nodes() const
+    {
+        return { mean, invStdDev };
+    }
+
+    // accumulates over the samples [begin, end), in minibatches of up to mbSize
+    void Accumulate(const Matrix<double>& features, size_t begin, size_t end)
+    {
+        net->StartEvaluateMinibatchLoop(Nodes());
+        for (const auto& node : Nodes())
+            dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(false);
+        for (size_t j = begin; j < end; j += mbSize)
+        {
+            size_t n = min(mbSize, end - j);
+            net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(n);
+            x->Value().SetValue(features.ColumnSlice(j, n));
+            ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x });
+            net->ForwardProp(Nodes());
+        }
+    }
+
+    void Finish()
+    {
+        for (const auto& node : Nodes())
+            dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true);
+    }
+
+    ComputationNetworkPtr net;
+    NodePtr x, mean, invStdDev;
+};
+
+// the sum over the workers, which call it at the same time from their threads (like MPI AllReduce)
+class AllReduceSum
+{
+public:
+    AllReduceSum(size_t numWorkers)
+        : m_vectors(numWorkers), m_numWaiting(0), m_generation(0)
+    {
+    }
+
+    void operator()(size_t rank, vector<double>& v)
+    {
+        m_vectors[rank] = &v;
+        Barrier();
+        vector<double> sum(v.size(), 0);
+        for (const auto* w : m_vectors)
+            for (size_t i = 0; i < sum.size(); i++)
+                sum[i] += (*w)[i];
+        Barrier(); // (all have read the others' vectors)
+        v = sum;
+    }
+
+private:
+    void Barrier()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        size_t generation = m_generation;
+        if (++m_numWaiting == m_vectors.size())
+        {
+            m_numWaiting = 0;
+            m_generation++;
+            m_generationChanged.notify_all();
+        }
+        else
+            m_generationChanged.wait(lock, [&]() { return m_generation != generation; });
+    }
+
+    vector<vector<double>*> m_vectors;
+    mutex m_mutex;
+    condition_variable m_generationChanged;
+    size_t m_numWaiting;
+    size_t m_generation;
+};
+
+// 'tolerance' in percent, as for BOOST_CHECK_CLOSE
+static void CheckSameValues(const NodePtr& actual, const NodePtr& expected, double tolerance)
+{
+    BOOST_REQUIRE_EQUAL(actual->Value().GetNumElements(), expected->Value().GetNumElements());
+    for (size_t i = 0; i < dim; i++)
+        BOOST_CHECK_CLOSE(actual->Value()(i, 0), expected->Value()(i, 0), tolerance);
+}
+
+BOOST_AUTO_TEST_SUITE(PreComputeAggregationSuite)
+
+BOOST_AUTO_TEST_CASE(PreComputeAggregationEqualsSinglePass)
+{
+    auto features = Features();
+
+    PreComputeWorker single;
+    ScopedNetworkOperationMode singleModeGuard(single.net, NetworkOperationMode::preComputing);
+    single.Accumulate(features, 0, numSamples);
+    single.Finish();
+
+    // the single pass against the definitions
+    for (size_t i = 0; i < dim; i++)
+    {
+        double sum = 0, sumOfSquares = 0;
+        for (size_t j = 0; j < numSamples; j++)
+            sum += features(i, j);
+        for (size_t j = 0; j < numSamples; j++)
+            sumOfSquares += (features(i, j) - sum / numSamples) * (features(i, j) - sum / numSamples);
+        BOOST_CHECK_CLOSE(single.mean->Value()(i, 0), sum / numSamples, 1e-9);
+        BOOST_CHECK_CLOSE(single.invStdDev->Value()(i, 0), 1 / sqrt(sumOfSquares / numSamples), 1e-7);
+    }
+
+    // splits at the sample where the next worker begins; a worker may get no data (e.g. after decimation)
+    const vector<vector<size_t>> splits = { { 0, 30, 60 }, { 0, 25, 60 }, { 0, 7, 33, 41, 60 }, { 0, 0, 60 }, { 0, 60, 60 } };
+    for (const auto& split : splits)
+    {
+        const size_t numWorkers = split.size() - 1;
+        vector<PreComputeWorker> workers(numWorkers);
+        AllReduceSum sum(numWorkers);
+        vector<thread> threads;
+        for (size_t rank = 0; rank < numWorkers; rank++)
+        {
+            threads.emplace_back([&, rank]()
+            {
+                auto& worker = workers[rank];
+                ScopedNetworkOperationMode modeGuard(worker.net, NetworkOperationMode::preComputing);
+                worker.Accumulate(features, split[rank], split[rank + 1]);
+                for (const auto& node : worker.Nodes())
+                    dynamic_pointer_cast<IPreComputeNode>(node)->AggregateAccumulators([&](vector<double>& v) { sum(rank, v); });
+                worker.Finish();
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+
+        for (const auto& worker : workers)
+        {
+            CheckSameValues(worker.mean, single.mean, 1e-9);
+            CheckSameValues(worker.invStdDev, single.invStdDev, 1e-7); // (differences of values around 1e6 in the variance)
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(RecurrentNodeSuite)
+
+// sets a one-sequence layout of T steps, which started 'begin' steps before this minibatch and does not end in it
+static void SetContinuingSequenceLayout(ComputationNetworkPtr net, size_t T, ptrdiff_t begin)
+{
+    auto layout = net->GetMBLayoutPtrOfNetwork();
+    layout->Init(1, T);
+    layout->AddSequence(0, 0, begin, T + 100);
+}
+
+BOOST_AUTO_TEST_CASE(PastValueAcrossMinibatchesOfChangingSize)
+{
+    // With T <= timeStep, all steps of a minibatch read the previous one's values (through a slice view of the node),
+    // which then must still be replaced by this minibatch's values, of a different size.
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto x = builder.CreateInputNode(L"x", 1);
+    auto delayed = builder.PastValue(x, 0.5f, 1, 2, L"delayed");
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"output", delayed);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({ delayed }, {}, nullptr);
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+
+    size_t begin = 0;
+    for (size_t T : { 3, 2, 2, 5 }) // (the delay reaches back one minibatch only, so none is shorter than it)
+    {
+        SetContinuingSequenceLayout(net, T, -(ptrdiff_t) begin);
+        Matrix<float> input(1, T, CPUDEVICE);
+        for (size_t t = 0; t < T; t++)
+            input(0, t) = (float) (begin + t);
+        x->Value().SetValue(input);
+
+        net->StartEvaluateMinibatchLoop(ComputationNodeBasePtr(delayed));
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x });
+        net->ForwardProp(ComputationNodeBasePtr(delayed));
+
+        BOOST_REQUIRE_EQUAL(delayed->Value().GetNumCols(), T);
+        for (size_t t = 0; t < T; t++)
+            BOOST_CHECK_EQUAL(delayed->Value()(0, t), begin + t >= 2 ? (float) (begin + t - 2) : 0.5f);
+        begin += T;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(RecurrenceAfterFailedForwardProp)
+{
+    // A recurrence that fails half-way must not keep its matrices from being resized for the next minibatch.
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto x = builder.CreateInputNode(L"x", 1);
+    auto delayed = builder.PastValue(nullptr, 0.5f, 1, 1, L"delayed");
+    auto h = builder.Plus(x, delayed, L"h");
+    delayed->AttachInputs({ h });
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"output", h);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({ h }, {}, nullptr);
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+
+    // a sequence that started before the first minibatch has no previous value
+    SetContinuingSequenceLayout(net, 3, -1);
+    x->Value().SetValue(Matrix<float>::Ones(1, 3, CPUDEVICE));
+    net->StartEvaluateMinibatchLoop(ComputationNodeBasePtr(h));
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x });
+    BOOST_CHECK_THROW(net->ForwardProp(ComputationNodeBasePtr(h)), std::exception);
+
+    // the network can still be used, with another minibatch size
+    const size_t T = 5;
+    auto layout = net->GetMBLayoutPtrOfNetwork();
+    layout->Init(1, T);
+    layout->AddSequence(0, 0, 0, T);
+    x->Value().SetValue(Matrix<float>::Ones(1, T, CPUDEVICE));
+    net->StartEvaluateMinibatchLoop(ComputationNodeBasePtr(h));
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x });
+    net->ForwardProp(ComputationNodeBasePtr(h));
+
+    BOOST_REQUIRE_EQUAL(h->Value().GetNumCols(), T);
+    for (size_t t = 0; t < T; t++)
+        BOOST_CHECK_EQUAL(h->Value()(0, t), 0.5f + t + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,103 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the context window node (SpliceContextNode): each output frame stacks the frames around it of the same
+// sequence, with the first and last available frames repeated beyond the sequence boundaries, and the gradient of
+// a repeated frame is the sum over all of its copies.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "ReshapingNodes.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const size_t dim = 2;
+const size_t leftContext = 1;
+const size_t rightContext = 2;
+const size_t windowSize = 1 + leftContext + rightContext;
+const size_t numParallelSequences = 2;
+const size_t T = 4;
+
+// The layout: sequence 0 started 2 steps before this minibatch and fills its row, sequence 1 has 2 steps and is
+// followed by a gap. 'first' and 'last' are the time steps of a sequence's frames present in the minibatch.
+static void SetLayout(MBLayout& layout)
+{
+    layout.Init(numParallelSequences, T);
+    layout.AddSequence(0, 0, -2, T);
+    layout.AddSequence(1, 1, 0, 2);
+    layout.AddGap(1, 2, T);
+}
+static const size_t first[numParallelSequences] = { 0, 0 };
+static const size_t last[numParallelSequences] = { T - 1, 1 };
+
+// the input column that frame k of the window of time step t of sequence s is copied from
+static size_t SourceColumn(size_t s, size_t t, size_t k)
+{
+    ptrdiff_t tSource = (ptrdiff_t) t + (ptrdiff_t) k - (ptrdiff_t) leftContext;
+    tSource = min(max(tSource, (ptrdiff_t) first[s]), (ptrdiff_t) last[s]);
+    return tSource * numParallelSequences + s;
+}
+
+BOOST_AUTO_TEST_SUITE(SpliceContextNodeSuite)
+
+BOOST_AUTO_TEST_CASE(SpliceContextValuesAndGradient)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<double> builder(*net);
+    auto x = builder.CreateInputNode(L"x", dim);
+    auto spliceNode = net->AddNodeToNetAndAttachInputs(New<SpliceContextNode<double>>(CPUDEVICE, L"splice", leftContext, rightContext), { x });
+    shared_ptr<ComputationNode<double>> splice = spliceNode; // (the node's members are accessed through the base)
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"output", splice);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({ splice }, {}, nullptr);
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+
+    SetLayout(*net->GetMBLayoutPtrOfNetwork());
+    const size_t numCols = numParallelSequences * T;
+    Matrix<double> input(dim, numCols, CPUDEVICE);
+    for (size_t j = 0; j < numCols; j++)
+        for (size_t i = 0; i < dim; i++)
+            input(i, j) = 10.0 * j + i;
+    x->Value().SetValue(input);
+
+    net->StartEvaluateMinibatchLoop(ComputationNodeBasePtr(splice));
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ x });
+    net->ForwardProp(ComputationNodeBasePtr(splice));
+
+    BOOST_REQUIRE_EQUAL(splice->Value().GetNumRows(), dim * windowSize);
+    BOOST_REQUIRE_EQUAL(splice->Value().GetNumCols(), numCols);
+    for (size_t s = 0; s < numParallelSequences; s++)
+        for (size_t t = first[s]; t <= last[s]; t++)
+            for (size_t k = 0; k < windowSize; k++)
+                for (size_t i = 0; i < dim; i++)
+                    BOOST_CHECK_EQUAL(splice->Value()(k * dim + i, t * numParallelSequences + s), input(i, SourceColumn(s, t, k)));
+
+    // the gradient, accumulated into that of the input, against a direct sum over the windows
+    Matrix<double> outputGradient = Matrix<double>::RandomUniform(dim * windowSize, numCols, CPUDEVICE, -1, 1, 1);
+    splice->CreateGradientMatrixIfNull();
+    splice->Gradient().SetValue(outputGradient);
+    x->CreateGradientMatrixIfNull();
+    x->Gradient().Resize(dim, numCols);
+    x->Gradient().SetValue(1);
+    spliceNode->BackpropToNonLooping(0);
+
+    Matrix<double> expected(dim, numCols, CPUDEVICE);
+    expected.SetValue(1);
+    for (size_t s = 0; s < numParallelSequences; s++)
+        for (size_t t = first[s]; t <= last[s]; t++)
+            for (size_t k = 0; k < windowSize; k++)
+                for (size_t i = 0; i < dim; i++)
+                    expected(i, SourceColumn(s, t, k)) += outputGradient(k * dim + i, t * numParallelSequences + s);
+    for (size_t j = 0; j < numCols; j++)
+        for (size_t i = 0; i < dim; i++)
+            BOOST_CHECK_CLOSE(x->Gradient()(i, j), expected(i, j), 1e-10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
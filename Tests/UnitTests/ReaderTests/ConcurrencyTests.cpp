@@ -0,0 +1,171 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "ConcQueue.h"
+#include "ConcPool.h"
+#include "ConcStack.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <omp.h>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(ConcurrencyTests)
+
+BOOST_AUTO_TEST_CASE(BoundedQueueFifoAndCapacity)
+{
+    conc_bounded_queue<int> queue(5);
+    BOOST_CHECK_EQUAL(queue.capacity(), 8); // rounded up to a power of two
+
+    int item = -1;
+    BOOST_CHECK(!queue.try_pop(item));
+
+    // two laps around the ring, to also cover the wrap-around of the sequence numbers
+    for (int lap = 0; lap < 2; lap++)
+    {
+        for (int i = 0; i < 8; i++)
+            BOOST_CHECK(queue.try_push(lap * 100 + i));
+        BOOST_CHECK(!queue.try_push(-1));
+
+        for (int i = 0; i < 8; i++)
+        {
+            BOOST_CHECK(queue.try_pop(item));
+            BOOST_CHECK_EQUAL(item, lap * 100 + i);
+        }
+        BOOST_CHECK(!queue.try_pop(item));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BoundedQueueMultipleProducersAndConsumers)
+{
+    const size_t numProducers = 4, numConsumers = 4, itemsPerProducer = 100000;
+    conc_bounded_queue<size_t> queue(64);
+
+    atomic<size_t> consumed(0), sum(0);
+    vector<thread> threads;
+    for (size_t p = 0; p < numProducers; p++)
+    {
+        threads.push_back(thread([&queue, p, itemsPerProducer]()
+        {
+            for (size_t i = 0; i < itemsPerProducer; i++)
+            {
+                while (!queue.try_push(p * itemsPerProducer + i + 1))
+                    this_thread::yield();
+            }
+        }));
+    }
+    const size_t total = numProducers * itemsPerProducer;
+    for (size_t c = 0; c < numConsumers; c++)
+    {
+        threads.push_back(thread([&queue, &consumed, &sum, total]()
+        {
+            size_t item;
+            while (consumed.load() < total)
+            {
+                if (queue.try_pop(item))
+                {
+                    sum += item;
+                    consumed++;
+                }
+                else
+                    this_thread::yield();
+            }
+        }));
+    }
+    for (auto& t : threads)
+        t.join();
+
+    // every item was received exactly once
+    BOOST_CHECK_EQUAL(consumed.load(), total);
+    BOOST_CHECK_EQUAL(sum.load(), total * (total + 1) / 2);
+}
+
+BOOST_AUTO_TEST_CASE(PoolReusesAndBoundsItems)
+{
+    conc_pool<unique_ptr<int>> pool(2);
+    size_t created = 0;
+    auto factory = [&created]() { created++; return unique_ptr<int>(new int(42)); };
+
+    auto a = pool.pop_or_create(factory);
+    int* address = a.get();
+    pool.push(move(a));
+    auto b = pool.pop_or_create(factory);
+    BOOST_CHECK_EQUAL(b.get(), address);
+    BOOST_CHECK_EQUAL(created, 1);
+
+    // pushing more items than the capacity drops the surplus
+    auto c = pool.pop_or_create(factory);
+    auto d = pool.pop_or_create(factory);
+    pool.push(move(b));
+    pool.push(move(c));
+    pool.push(move(d));
+    BOOST_CHECK_EQUAL(created, 3);
+    for (int i = 0; i < 3; i++)
+        pool.pop_or_create(factory);
+    BOOST_CHECK_EQUAL(created, 4);
+}
+
+// Contention benchmark: all threads of a dynamically scheduled parallel loop take a scratch buffer
+// from a shared pool and return it, as the image transformers do per sequence.
+template <class Pool>
+static double MeasurePoolNanosecondsPerOperation(Pool& pool, int numIterations)
+{
+    auto start = chrono::steady_clock::now();
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < numIterations; i++)
+    {
+        auto buffer = pool.pop_or_create([]() { return vector<unsigned char>(1024); });
+        buffer[i % buffer.size()]++;
+        pool.push(move(buffer));
+    }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / numIterations;
+}
+
+BOOST_AUTO_TEST_CASE(PoolContentionBenchmark)
+{
+    const int numIterations = 1000000;
+    conc_stack<vector<unsigned char>> lockedStack;
+    conc_pool<vector<unsigned char>> lockFreePool;
+    MeasurePoolNanosecondsPerOperation(lockedStack, numIterations / 10); // warm up both
+    MeasurePoolNanosecondsPerOperation(lockFreePool, numIterations / 10);
+
+    double lockedTime = MeasurePoolNanosecondsPerOperation(lockedStack, numIterations);
+    double lockFreeTime = MeasurePoolNanosecondsPerOperation(lockFreePool, numIterations);
+    BOOST_TEST_MESSAGE("pool contention with " << omp_get_max_threads() << " threads: conc_stack " << lockedTime << " ns/op, conc_pool " << lockFreeTime << " ns/op");
+    BOOST_CHECK(lockFreeTime > 0);
+}
+
+BOOST_AUTO_TEST_CASE(QueueContentionBenchmark)
+{
+    const int numIterations = 1000000;
+    conc_bounded_queue<size_t> queue(1024);
+    atomic<size_t> failedPushes(0);
+
+    auto start = chrono::steady_clock::now();
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < numIterations; i++)
+    {
+        size_t item;
+        if (!queue.try_push(i))
+            failedPushes++;
+        while (!queue.try_pop(item)) // (can fail while another thread's push is still being published)
+            ;
+    }
+    double time = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / numIterations;
+    BOOST_TEST_MESSAGE("queue contention with " << omp_get_max_threads() << " threads: " << time << " ns per push/pop pair");
+    BOOST_CHECK_EQUAL(failedPushes.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -4,11 +4,47 @@
 //
 #include "stdafx.h"
 #include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/HTKMLFReader/htkfeatio.h"
+#include "ssematrix.h"
+#include "PackedFeatureArchive.h"
 
 using namespace Microsoft::MSR::CNTK;
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
 
+// Packs the features listed in a script file into a packed feature archive, as htkpack does.
+static void PackFeatures(const string& scriptPath, const wstring& archivePath, size_t chunkFrames)
+{
+    ifstream scp(scriptPath);
+    BOOST_REQUIRE(scp);
+    unique_ptr<PackedFeatureArchiveWriter> writer;
+    msra::asr::htkfeatreader reader;
+    msra::dbn::matrix utteranceFrames;
+    vector<float> frames;
+    string line;
+    while (getline(scp, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+
+        msra::asr::htkfeatreader::parsedpath path(msra::strfun::utf16(line));
+        string kind;
+        unsigned int period;
+        reader.read(path, kind, period, utteranceFrames);
+        if (!writer)
+            writer.reset(new PackedFeatureArchiveWriter(archivePath, kind, utteranceFrames.rows(), period, chunkFrames));
+
+        frames.resize(utteranceFrames.rows() * utteranceFrames.cols());
+        for (size_t t = 0; t < utteranceFrames.cols(); t++)
+            memcpy(frames.data() + t * utteranceFrames.rows(), &utteranceFrames(0, t), sizeof(float) * utteranceFrames.rows());
+        writer->AddUtterance(msra::strfun::utf8((wstring) path), frames.data(), utteranceFrames.cols());
+    }
+    BOOST_REQUIRE(writer);
+    writer->Close();
+}
+
 // Fixture specific to the AN4 data
 struct AN4ReaderFixture : ReaderFixture
 {
@@ -373,6 +409,110 @@ BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop1)
         1);
 };
 
+BOOST_AUTO_TEST_CASE(HTKDeserializersPackedArchive)
+{
+    // The features of the script file are packed into chunks of 2000 frames, so that the archive has several of them,
+    // and read through the archive must give the same minibatches as through the script file.
+    const string archivePath = "HTKDeserializersPackedArchive.pfa";
+    PackFeatures("glob_0000.scp", msra::strfun::utf16(archivePath), 2000);
+    PackedFeatureArchive archive(msra::strfun::utf16(archivePath));
+    BOOST_CHECK_GT(archive.GetNumberOfChunks(), 1);
+
+    const string configPath = testDataPath() + "/Config/HTKDeserializersPackedArchive_Config.cntk";
+    for (const char* section : { "Script_Test", "Archive_Test" })
+    {
+        HelperReadInAndWriteOut<float>(configPath, testDataPath() + "/Control/HTKDeserializersPackedArchive_" + section + "_Output.txt",
+            section, "reader", 2000, 250, 2, 1, 1, 0, 1);
+    }
+    CheckFilesEquivalent(testDataPath() + "/Control/HTKDeserializersPackedArchive_Script_Test_Output.txt",
+                         testDataPath() + "/Control/HTKDeserializersPackedArchive_Archive_Test_Output.txt");
+    boost::filesystem::remove(archivePath);
+};
+
+BOOST_AUTO_TEST_CASE(HTKDeserializersMlfCache)
+{
+    // The first run parses the MLF and writes the cache, the second one reads the labels from the cache.
+    boost::filesystem::remove("HTKDeserializersMlfCache.cache");
+    for (int run = 0; run < 2; run++)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/HTKDeserializersMlfCache_Config.cntk",
+            testDataPath() + "/Control/HTKMLFReaderSimpleDataLoop1_5_11_Control.txt",
+            testDataPath() + "/Control/HTKMLFReaderSimpleDataLoop1_Output.txt",
+            "Simple_Test",
+            "reader",
+            500,
+            250,
+            2,
+            1,
+            1,
+            0,
+            1);
+        BOOST_CHECK(boost::filesystem::exists("HTKDeserializersMlfCache.cache"));
+    }
+    boost::filesystem::remove("HTKDeserializersMlfCache.cache");
+};
+
+BOOST_AUTO_TEST_CASE(HTKDeserializersRawFramesForSpliceContext)
+{
+    // With spliceContext=false the reader delivers the frames of the utterances as they are. Spliced in the same way
+    // as the reader does (5 frames on either side, repeating the first and last frame of an utterance), they must
+    // give the reader's own context windows.
+    const string configPath = testDataPath() + "/Config/HTKDeserializersSpliceContext_Config.cntk";
+    const size_t frameDim = 33;
+    const size_t context = 5;
+    const size_t windowSize = 2 * context + 1;
+    const size_t epochSize = 5000;
+    const size_t mbSize = 1000;
+
+    auto splicedInputs = CreateStreamMinibatchInputs<float>(1, 1);
+    auto rawInputs = CreateStreamMinibatchInputs<float>(1, 1);
+    auto splicedReader = GetDataReader(configPath, "Spliced_Test", "reader");
+    auto rawReader = GetDataReader(configPath, "Raw_Test", "reader");
+    splicedReader->StartMinibatchLoop(mbSize, 0, epochSize);
+    rawReader->StartMinibatchLoop(mbSize, 0, epochSize);
+
+    size_t numFrames = 0, numMismatches = 0;
+    while (splicedReader->GetMinibatch(*splicedInputs))
+    {
+        BOOST_REQUIRE(rawReader->GetMinibatch(*rawInputs));
+        auto& spliced = splicedInputs->GetInputMatrix<float>(L"features");
+        auto& raw = rawInputs->GetInputMatrix<float>(L"features");
+        BOOST_REQUIRE_EQUAL(spliced.GetNumRows(), frameDim * windowSize);
+        BOOST_REQUIRE_EQUAL(raw.GetNumRows(), frameDim);
+        BOOST_REQUIRE_EQUAL(raw.GetNumCols(), spliced.GetNumCols());
+        // (the labels are the same, and so are the layouts)
+        auto& rawLabels = rawInputs->GetInputMatrix<float>(L"labels");
+        BOOST_CHECK(rawLabels.IsEqualTo(splicedInputs->GetInputMatrix<float>(L"labels")));
+
+        const auto& layout = rawInputs->GetInput(L"features").pMBLayout;
+        BOOST_REQUIRE(*layout == *splicedInputs->GetInput(L"features").pMBLayout);
+        const size_t numParallelSequences = layout->GetNumParallelSequences();
+        for (const auto& seq : layout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            BOOST_REQUIRE(seq.tBegin >= 0 && seq.tEnd <= layout->GetNumTimeSteps()); // (whole utterances)
+            for (ptrdiff_t t = seq.tBegin; t < (ptrdiff_t) seq.tEnd; t++)
+            {
+                for (size_t k = 0; k < windowSize; k++)
+                {
+                    ptrdiff_t tSource = min(max(t + (ptrdiff_t) k - (ptrdiff_t) context, seq.tBegin), (ptrdiff_t) seq.tEnd - 1);
+                    for (size_t i = 0; i < frameDim; i++)
+                    {
+                        if (spliced(k * frameDim + i, t * numParallelSequences + seq.s) != raw(i, tSource * numParallelSequences + seq.s))
+                            numMismatches++;
+                    }
+                }
+                numFrames++;
+            }
+        }
+    }
+    BOOST_CHECK(!rawReader->GetMinibatch(*rawInputs));
+    BOOST_CHECK_GE(numFrames, epochSize); // (the epoch ends with a whole utterance)
+    BOOST_CHECK_EQUAL(numMismatches, 0);
+};
+
 BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop5)
 {
     HelperRunReaderTest<float>(
@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the cache of decoded images of the ImageReader (ImageCache.h): hits, eviction of the least recently used
+// images at the memory budget, and images spilled to a file on eviction and read back from it.
+//
+#include "stdafx.h"
+#include "../../../Source/Readers/ImageReader/ImageCache.h"
+#include <opencv2/core/core.hpp>
+#include <boost/filesystem.hpp>
+#include <cstring>
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const int imageRows = 6;
+const int imageCols = 5;
+const size_t imageSize = imageRows * imageCols * 3; // (bytes)
+
+// images of the same size with different pixels
+static cv::Mat Image(int value)
+{
+    cv::Mat image(imageRows, imageCols, CV_8UC3);
+    for (size_t i = 0; i < imageSize; i++)
+        image.data[i] = (unsigned char) (value * 31 + i);
+    return image;
+}
+
+static bool SameImage(const cv::Mat& actual, const cv::Mat& expected)
+{
+    return actual.rows == expected.rows && actual.cols == expected.cols && actual.type() == expected.type() &&
+           memcmp(actual.data, expected.data, actual.total() * actual.elemSize()) == 0;
+}
+
+struct ImageCacheFixture
+{
+    ImageCacheFixture()
+        : m_spillPath(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ImageCache-%%%%-%%%%.bin"))
+    {
+    }
+    ~ImageCacheFixture()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(m_spillPath, ec);
+    }
+
+    boost::filesystem::path m_spillPath;
+};
+
+BOOST_FIXTURE_TEST_SUITE(ImageCacheSuite, ImageCacheFixture)
+
+BOOST_AUTO_TEST_CASE(ImageCacheHits)
+{
+    ImageCache cache(3 * imageSize, L"", 0);
+    auto a = Image(0), b = Image(1);
+    cache.Put("a", a);
+    cache.Put("b", b);
+
+    // cached images are shared, not copied
+    BOOST_CHECK(cache.Get("a").data == a.data);
+    BOOST_CHECK(cache.Get("b").data == b.data);
+    BOOST_CHECK(cache.Get("c").empty());
+
+    // an image that was put again (e.g. decoded concurrently) does not replace the cached one
+    cache.Put("a", Image(0));
+    BOOST_CHECK(cache.Get("a").data == a.data);
+}
+
+BOOST_AUTO_TEST_CASE(ImageCacheEvictsLeastRecentlyUsed)
+{
+    ImageCache cache(3 * imageSize, L"", 0);
+    cache.Put("a", Image(0));
+    cache.Put("b", Image(1));
+    cache.Put("c", Image(2));
+
+    // the budget is reached, but not exceeded
+    BOOST_CHECK(!cache.Get("c").empty());
+    BOOST_CHECK(!cache.Get("b").empty());
+    BOOST_CHECK(!cache.Get("a").empty());
+
+    // 'c' is now the least recently used
+    cache.Put("d", Image(3));
+    BOOST_CHECK(cache.Get("c").empty());
+    BOOST_CHECK(SameImage(cache.Get("a"), Image(0)));
+    BOOST_CHECK(SameImage(cache.Get("d"), Image(3)));
+
+    // and then 'b'
+    cache.Put("e", Image(4));
+    BOOST_CHECK(cache.Get("b").empty());
+    BOOST_CHECK(SameImage(cache.Get("a"), Image(0)));
+    BOOST_CHECK(SameImage(cache.Get("d"), Image(3)));
+    BOOST_CHECK(SameImage(cache.Get("e"), Image(4)));
+
+    // an image larger than the budget is not cached, and does not evict any
+    cv::Mat large(imageRows * 4, imageCols, CV_8UC3, cv::Scalar(1, 2, 3));
+    cache.Put("large", large);
+    BOOST_CHECK(cache.Get("large").empty());
+    BOOST_CHECK(!cache.Get("a").empty());
+    BOOST_CHECK(!cache.Get("d").empty());
+    BOOST_CHECK(!cache.Get("e").empty());
+}
+
+BOOST_AUTO_TEST_CASE(ImageCacheSpill)
+{
+    {
+        ImageCache cache(2 * imageSize, m_spillPath.wstring(), 2 * imageSize);
+        BOOST_CHECK(boost::filesystem::exists(m_spillPath));
+        cache.Put("a", Image(0));
+        cache.Put("b", Image(1));
+        cache.Put("c", Image(2)); // evicts 'a' into the spill file
+
+        // read back from the spill file, and cached in memory again, which evicts 'b' into the spill file
+        auto a = cache.Get("a");
+        BOOST_CHECK(SameImage(a, Image(0)));
+        BOOST_CHECK(cache.Get("a").data == a.data);
+
+        // 'a' and 'b' fill the spill budget, so 'c', evicted now, is lost
+        cache.Put("d", Image(3));
+        BOOST_CHECK(cache.Get("c").empty());
+
+        // images stay in the spill file after they were read back (this evicts 'a' again, then 'd')
+        BOOST_CHECK(SameImage(cache.Get("b"), Image(1)));
+        BOOST_CHECK(SameImage(cache.Get("a"), Image(0)));
+        BOOST_CHECK(cache.Get("d").empty());
+    }
+
+    // the spill file is deleted with the cache
+    BOOST_CHECK(!boost::filesystem::exists(m_spillPath));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -36,6 +36,80 @@ BOOST_AUTO_TEST_CASE(ImageReaderSimple)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderFused)
+{
+    // Same images as the simple test, the fused transformer must produce the same output.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderFused_Config.cntk",
+        testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+        testDataPath() + "/Control/ImageReaderFused_Output.txt",
+        "Simple_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1);
+}
+
+static vector<float> ToVector(Matrix<float>& matrix)
+{
+    if (matrix.GetMatrixType() == MatrixType::SPARSE)
+        matrix.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+    std::unique_ptr<float[]> data(matrix.CopyToArray());
+    return vector<float>(data.get(), data.get() + matrix.GetNumElements());
+}
+
+BOOST_AUTO_TEST_CASE(ImageReaderFusedReducedDecoding)
+{
+    // Larger images, which the fused reader decodes at reduced resolution, then crops with jittered ratio and aspect
+    // ratio, scales, adjusts color, flips and subtracts the mean (see the config). The separate transformers work on
+    // the full images, so the crops differ by up to a pixel of the reduced image, and the outputs are close rather
+    // than equal: on these smooth images, a missing flip or mean would differ by much more than the tolerance.
+    const string configFileName = testDataPath() + "/Config/ImageReaderFusedReduced_Config.cntk";
+    const size_t epochSize = 12; // (each image four times, with different random draws)
+    const size_t mbSize = 4;
+    const size_t sampleSize = 16 * 12 * 3;
+
+    auto read = [&](const string& testSectionName, vector<float>& features, vector<float>& labels)
+    {
+        auto inputs = CreateStreamMinibatchInputs<float>(1, 1);
+        auto reader = GetDataReader(configFileName, testSectionName, "reader");
+        reader->StartMinibatchLoop(mbSize, 0, epochSize);
+        while (reader->GetMinibatch(*inputs))
+        {
+            auto minibatchFeatures = ToVector(inputs->GetInputMatrix<float>(L"features"));
+            auto minibatchLabels = ToVector(inputs->GetInputMatrix<float>(L"labels"));
+            features.insert(features.end(), minibatchFeatures.begin(), minibatchFeatures.end());
+            labels.insert(labels.end(), minibatchLabels.begin(), minibatchLabels.end());
+        }
+    };
+    vector<float> fusedFeatures, fusedLabels, features, labels;
+    read("Fused_Test", fusedFeatures, fusedLabels);
+    read("Unfused_Test", features, labels);
+
+    BOOST_REQUIRE_EQUAL(features.size(), epochSize * sampleSize);
+    BOOST_REQUIRE_EQUAL(fusedFeatures.size(), features.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(fusedLabels.begin(), fusedLabels.end(), labels.begin(), labels.end());
+
+    // (values are in [0, 255] before the mean is subtracted)
+    for (size_t sample = 0; sample < epochSize; sample++)
+    {
+        float maxDifference = 0;
+        double sumOfDifferences = 0;
+        for (size_t i = sample * sampleSize; i < (sample + 1) * sampleSize; i++)
+        {
+            float difference = fabs(fusedFeatures[i] - features[i]);
+            maxDifference = max(maxDifference, difference);
+            sumOfDifferences += difference;
+        }
+        BOOST_CHECK_LE(maxDifference, 32);
+        BOOST_CHECK_LE(sumOfDifferences / sampleSize, 8);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ImageAndTextReaderSimple)
 {
     HelperRunReaderTest<float>(
@@ -168,6 +242,24 @@ BOOST_AUTO_TEST_CASE(ImageReaderMultiView)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderImageCache)
+{
+    // Same as the multi view test, but the views are cropped from cached decoded images.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderImageCache_Config.cntk",
+        testDataPath() + "/Control/ImageReaderMultiView_Control.txt",
+        testDataPath() + "/Control/ImageReaderImageCache_Output.txt",
+        "MultiView_Test",
+        "reader",
+        10,
+        10,
+        1,
+        1,
+        0,
+        0,
+        1);
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderIntensityTransform)
 {
     HelperRunReaderTest<float>(
@@ -0,0 +1,208 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the packed feature archive (PackedFeatureArchive.h): archives written by PackedFeatureArchiveWriter, and
+// by the BinaryOutputWriter of the write action, read back by PackedFeatureArchive, with float and fp16 frames.
+//
+#include "stdafx.h"
+#include "PackedFeatureArchive.h"
+#include "../../../Source/SGDLib/BinaryOutputWriter.h"
+#include <boost/filesystem.hpp>
+#include <limits>
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct PackedFeatureArchiveFixture
+{
+    PackedFeatureArchiveFixture()
+        : m_archivePath(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("PackedFeatureArchive-%%%%-%%%%.pfa"))
+    {
+    }
+    ~PackedFeatureArchiveFixture()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(m_archivePath, ec);
+    }
+    wstring ArchivePath() const { return m_archivePath.wstring(); }
+
+    boost::filesystem::path m_archivePath;
+};
+
+const size_t featureDimension = 5;
+const unsigned int samplePeriod = 100000;
+const size_t chunkFrames = 12;
+const size_t utteranceFrames[] = { 3, 10, 1, 7, 20, 2 };
+const size_t numUtterances = sizeof(utteranceFrames) / sizeof(*utteranceFrames);
+
+static string Key(size_t utterance)
+{
+    return "utterance" + to_string(utterance) + ".mfc";
+}
+
+// frame values are multiples of 1/8 below 256, which fp16 represents exactly
+static vector<float> Frames(size_t utterance)
+{
+    vector<float> frames(utteranceFrames[utterance] * featureDimension);
+    for (size_t i = 0; i < frames.size(); i++)
+        frames[i] = (float) ((utterance * 97 + i * 13) % 2048) / 8 - 128;
+    return frames;
+}
+
+static void WriteArchive(const wstring& path, PackedArchiveElementType elementType)
+{
+    PackedFeatureArchiveWriter writer(path, "MFCC_E_D", featureDimension, samplePeriod, chunkFrames, elementType);
+    for (size_t u = 0; u < numUtterances; u++)
+        writer.AddUtterance(Key(u), Frames(u).data(), utteranceFrames[u]);
+    writer.Close();
+}
+
+// the utterances are read back in order, grouped into chunks of at least chunkFrames frames
+static void CheckArchive(const wstring& path, PackedArchiveElementType elementType)
+{
+    PackedFeatureArchive archive(path);
+    BOOST_CHECK_EQUAL(archive.GetFeatureKind(), "MFCC_E_D");
+    BOOST_CHECK_EQUAL(archive.GetFeatureDimension(), featureDimension);
+    BOOST_CHECK_EQUAL(archive.GetSamplePeriod(), samplePeriod);
+    BOOST_CHECK(archive.GetElementType() == elementType);
+
+    // chunks: { 3, 10 }, { 1, 7, 20 }, { 2 }
+    const size_t expectedChunkUtterances[] = { 2, 3, 1 };
+    BOOST_REQUIRE_EQUAL(archive.GetNumberOfChunks(), 3);
+    size_t u = 0;
+    vector<float> frames;
+    for (size_t c = 0; c < archive.GetNumberOfChunks(); c++)
+    {
+        const auto& chunk = archive.GetChunk(c);
+        BOOST_CHECK_EQUAL(chunk.offset % PackedArchiveAlignment, 0);
+        BOOST_CHECK_EQUAL(chunk.firstUtterance, u);
+        BOOST_REQUIRE_EQUAL(chunk.numUtterances, expectedChunkUtterances[c]);
+
+        archive.ReadChunk(c, frames);
+        BOOST_REQUIRE_EQUAL(frames.size(), chunk.numFrames * featureDimension);
+        size_t firstFrame = 0;
+        for (; u < chunk.firstUtterance + chunk.numUtterances; u++)
+        {
+            const auto& utterance = archive.GetUtterance(u);
+            BOOST_CHECK_EQUAL(archive.GetKey(u), Key(u));
+            BOOST_CHECK_EQUAL(utterance.numFrames, utteranceFrames[u]);
+            BOOST_CHECK_EQUAL(utterance.firstFrame, firstFrame);
+
+            auto expected = Frames(u);
+            const float* actual = frames.data() + utterance.firstFrame * featureDimension;
+            BOOST_CHECK_EQUAL_COLLECTIONS(actual, actual + expected.size(), expected.begin(), expected.end());
+            firstFrame += utterance.numFrames;
+        }
+        BOOST_CHECK_EQUAL(firstFrame, chunk.numFrames);
+        if (c + 1 < archive.GetNumberOfChunks())
+            BOOST_CHECK_GE(chunk.numFrames, chunkFrames);
+    }
+    BOOST_CHECK_EQUAL(u, numUtterances);
+}
+
+BOOST_FIXTURE_TEST_SUITE(PackedFeatureArchiveSuite, PackedFeatureArchiveFixture)
+
+BOOST_AUTO_TEST_CASE(PackedFeatureArchiveRoundTrip)
+{
+    WriteArchive(ArchivePath(), PackedArchiveElementType::Float32);
+    CheckArchive(ArchivePath(), PackedArchiveElementType::Float32);
+}
+
+BOOST_AUTO_TEST_CASE(PackedFeatureArchiveRoundTripFloat16)
+{
+    WriteArchive(ArchivePath(), PackedArchiveElementType::Float16);
+    CheckArchive(ArchivePath(), PackedArchiveElementType::Float16);
+
+    // other values are rounded to the nearest fp16 value
+    const vector<float> values = { 1 + 1.0f / 4096, 1 + 3.0f / 4096, -0.1f, 70000, 1e-8f };
+    const vector<float> rounded = { 1, 1 + 4.0f / 4096, -0.0999755859375f, numeric_limits<float>::infinity(), 0 };
+    {
+        PackedFeatureArchiveWriter writer(ArchivePath(), "USER", values.size(), samplePeriod, chunkFrames, PackedArchiveElementType::Float16);
+        writer.AddUtterance("rounded", values.data(), 1);
+        writer.Close();
+    }
+    PackedFeatureArchive archive(ArchivePath());
+    vector<float> frames;
+    archive.ReadChunk(0, frames);
+    BOOST_CHECK_EQUAL_COLLECTIONS(frames.begin(), frames.end(), rounded.begin(), rounded.end());
+}
+
+// the sequences of several minibatches, handed over to the writer thread by Flush()
+static void WriteSequences(BinaryOutputWriter& writer, size_t numMinibatches)
+{
+    size_t u = 0;
+    for (size_t minibatch = 0; minibatch < numMinibatches; minibatch++)
+    {
+        for (size_t i = 0; i < 2 && u < numUtterances; i++, u++)
+        {
+            auto frames = Frames(u);
+            copy(frames.begin(), frames.end(), writer.AddSequence(Key(u), utteranceFrames[u]));
+        }
+        writer.Flush();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BinaryOutputWriterRoundTrip)
+{
+    for (auto elementType : { PackedArchiveElementType::Float32, PackedArchiveElementType::Float16 })
+    {
+        {
+            BinaryOutputWriter writer(ArchivePath(), "MFCC_E_D", featureDimension, samplePeriod, elementType, chunkFrames);
+            BOOST_CHECK_EQUAL(writer.GetDimension(), featureDimension);
+            WriteSequences(writer, 3);
+            writer.Close();
+        }
+        CheckArchive(ArchivePath(), elementType);
+    }
+}
+
+// without Close(), the destructor completes the archive with the sequences added so far
+BOOST_AUTO_TEST_CASE(BinaryOutputWriterWithoutClose)
+{
+    {
+        BinaryOutputWriter writer(ArchivePath(), "USER", featureDimension, samplePeriod, PackedArchiveElementType::Float16, chunkFrames);
+        WriteSequences(writer, 1);
+        auto frames = Frames(2);
+        copy(frames.begin(), frames.end(), writer.AddSequence(Key(2), utteranceFrames[2])); // (not flushed)
+    }
+    PackedFeatureArchive archive(ArchivePath());
+    BOOST_CHECK_EQUAL(archive.GetFeatureKind(), "USER");
+    BOOST_CHECK(archive.GetElementType() == PackedArchiveElementType::Float16);
+    BOOST_REQUIRE_EQUAL(archive.GetNumberOfChunks(), 2);
+    BOOST_CHECK_EQUAL(archive.GetKey(2), Key(2));
+    vector<float> frames;
+    archive.ReadChunk(1, frames);
+    auto expected = Frames(2);
+    BOOST_CHECK_EQUAL_COLLECTIONS(frames.begin(), frames.end(), expected.begin(), expected.end());
+}
+
+// an archive without utterances is valid
+BOOST_AUTO_TEST_CASE(PackedFeatureArchiveEmpty)
+{
+    {
+        PackedFeatureArchiveWriter writer(ArchivePath(), "USER", featureDimension, samplePeriod, chunkFrames);
+        writer.Close();
+    }
+    PackedFeatureArchive archive(ArchivePath());
+    BOOST_CHECK_EQUAL(archive.GetNumberOfChunks(), 0);
+    BOOST_CHECK_EQUAL(archive.GetFeatureKind(), "USER");
+}
+
+BOOST_AUTO_TEST_CASE(PackedFeatureArchiveNotAnArchive)
+{
+    {
+        FILE* f = fopen(m_archivePath.string().c_str(), "wb");
+        BOOST_REQUIRE(f != nullptr);
+        const char text[] = "not an archive, but long enough to read a header from it ....................";
+        fwrite(text, 1, sizeof(text), f);
+        fclose(f);
+    }
+    BOOST_CHECK_THROW(PackedFeatureArchive archive(ArchivePath()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
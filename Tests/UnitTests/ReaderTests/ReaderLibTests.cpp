@@ -9,9 +9,12 @@
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
 #include "CorpusDescriptor.h"
+#include "TransformController.h"
 
 #include <numeric>
 #include <random>
+#include <thread>
+#include <chrono>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -404,6 +407,88 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+// Doubles the values of dense float sequences, taking a random amount of time per sequence.
+class MockTransformer : public Transformer
+{
+    struct DoubledSequence : DenseSequenceData
+    {
+        vector<float> m_buffer;
+    };
+
+public:
+    void StartEpoch(const EpochConfiguration&) override {}
+
+    StreamDescription Transform(const StreamDescription& inputStream) override
+    {
+        return inputStream;
+    }
+
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override
+    {
+        auto& input = static_cast<DenseSequenceData&>(*sequence);
+        auto result = make_shared<DoubledSequence>();
+        float* data = reinterpret_cast<float*>(input.m_data);
+        result->m_buffer.assign(data, data + input.m_numberOfSamples);
+        for (auto& value : result->m_buffer)
+            value *= 2;
+        result->m_data = result->m_buffer.data();
+        result->m_numberOfSamples = input.m_numberOfSamples;
+        result->m_sampleLayout = input.m_sampleLayout;
+
+        this_thread::sleep_for(chrono::microseconds(hash<float>()(data[0]) % 100));
+        return result;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(TransformControllerLookAhead)
+{
+    vector<float> data(100);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(20, 5, data);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = data.size();
+
+    // The same sequences, in the same order, with and without transforming ahead.
+    for (size_t lookAhead : { 0, 1, 3 })
+    {
+        auto randomizer = make_shared<NoRandomizer>(mockDeserializer);
+        vector<Transformation> transformations{ Transformation{ make_shared<MockTransformer>(), L"input" } };
+        TransformController controller(transformations, randomizer, lookAhead);
+
+        for (size_t epoch = 0; epoch < 2; epoch++)
+        {
+            epochConfiguration.m_epochIndex = epoch;
+            controller.StartEpoch(epochConfiguration);
+
+            // The second epoch is left early, with sequences still being transformed ahead.
+            size_t numRequests = epoch == 0 ? data.size() / 3 + 2 : 5;
+            vector<float> actual;
+            for (size_t i = 0; i < numRequests; i++)
+            {
+                Sequences sequences = controller.GetNextSequences(3);
+                if (sequences.m_data.empty())
+                {
+                    BOOST_CHECK(sequences.m_endOfEpoch);
+                    continue;
+                }
+                for (const auto& sequence : sequences.m_data[0])
+                {
+                    actual.push_back(*reinterpret_cast<float*>(sequence->m_data));
+                }
+            }
+
+            size_t expectedCount = epoch == 0 ? data.size() : 15;
+            vector<float> expected(expectedCount);
+            transform(data.begin(), data.begin() + expectedCount, expected.begin(), [](float d) { return 2 * d; });
+            BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;